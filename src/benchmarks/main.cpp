@@ -1,8 +1,13 @@
 #include "df.h"
 #include "rng.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <numeric>
+#include <random>
+#include <unordered_map>
 #include <vector>
 #include <execution>
 #include <benchmark/benchmark.h>
@@ -41,6 +46,15 @@ namespace {
     }
     BENCHMARK(calc1_series);
 
+    void calc1_expr(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        constexpr double a = 0.98, b = 1.0, c = 0.9;
+        for (auto _ : state) {
+            c1 = c + df::exp(a + b * c1);
+        }
+    }
+    BENCHMARK(calc1_expr);
+
     void add_scalar(benchmark::State& state) {
         auto c1 = generate_random_series(NUM_CALCS);
         const auto val = c1[0];
@@ -61,12 +75,22 @@ namespace {
     void add_series_operator(benchmark::State& state) {
         auto c1 = generate_random_series(NUM_CALCS);
         for (auto _ : state) {
-            auto c2 = c1 + c1;
+            Series<double> c2 = c1 + c1;
             benchmark::DoNotOptimize(c2);
         }
     }
     BENCHMARK(add_series_operator);
 
+    void add_series_operator_pooled(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        df::memory::PoolScope pool;
+        for (auto _ : state) {
+            Series<double> c2 = c1 + c1;
+            benchmark::DoNotOptimize(c2);
+        }
+    }
+    BENCHMARK(add_series_operator_pooled);
+
     void mul_scalar(benchmark::State& state) {
         auto c1 = generate_random_series(NUM_CALCS);
         const auto val = c1[0];
@@ -87,12 +111,22 @@ namespace {
     void mul_series_operator(benchmark::State& state) {
         auto c1 = generate_random_series(NUM_CALCS);
         for (auto _ : state) {
-            auto c2 = c1 * c1;
+            Series<double> c2 = c1 * c1;
             benchmark::DoNotOptimize(c2);
         }
     }
     BENCHMARK(mul_series_operator);
 
+    void mul_series_operator_pooled(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        df::memory::PoolScope pool;
+        for (auto _ : state) {
+            Series<double> c2 = c1 * c1;
+            benchmark::DoNotOptimize(c2);
+        }
+    }
+    BENCHMARK(mul_series_operator_pooled);
+
     void sqrt_series(benchmark::State& state) {
         auto c1 = generate_random_series(NUM_CALCS);
         for (auto _ : state) {
@@ -109,6 +143,62 @@ namespace {
     }
     BENCHMARK(exp_series);
 
+    // Baselines for the SIMD kernels: the standard algorithm calling the C library
+    void sqrt_loop(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        for (auto _ : state) {
+            std::transform(std::execution::par_unseq, c1.begin(), c1.end(), c1.begin(), [](double x) { return std::sqrt(x); });
+        }
+    }
+    BENCHMARK(sqrt_loop);
+
+    void exp_loop(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        for (auto _ : state) {
+            std::transform(std::execution::par_unseq, c1.begin(), c1.end(), c1.begin(), [](double x) { return std::exp(x); });
+        }
+    }
+    BENCHMARK(exp_loop);
+
+    // The SIMD kernels pinned to one instruction set: 0 = scalar, 1 = SSE2, 2 = AVX2, 3 = AVX-512
+    template <typename F>
+    void with_isa(benchmark::State& state, F&& f) {
+        const auto isa = static_cast<kernels::Isa>(state.range(0));
+        if (isa > kernels::detected_isa()) {
+            state.SkipWithError("instruction set not supported on this CPU");
+            return;
+        }
+        kernels::set_isa(isa);
+        state.SetLabel(kernels::isa_name(isa));
+        f();
+        kernels::set_isa(kernels::detected_isa());
+    }
+
+    void sqrt_series_isa(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        with_isa(state, [&] {
+            for (auto _ : state) {
+                c1.sqrt();
+            }
+        });
+    }
+    BENCHMARK(sqrt_series_isa)->DenseRange(0, 3);
+
+    // Repeated exp in place overflows to inf within a few iterations, so the input is restored untimed
+    void exp_series_isa(benchmark::State& state) {
+        const auto input = generate_random_series(NUM_CALCS);
+        auto c1 = input;
+        with_isa(state, [&] {
+            for (auto _ : state) {
+                c1.exp();
+                state.PauseTiming();
+                std::copy(input.begin(), input.end(), c1.begin());
+                state.ResumeTiming();
+            }
+        });
+    }
+    BENCHMARK(exp_series_isa)->DenseRange(0, 3);
+
     // Benchmarks for sum, variance, stdev, mean, max, min aggregations
     void sum_series(benchmark::State& state) {
         auto c1 = generate_random_series(NUM_CALCS);
@@ -119,6 +209,69 @@ namespace {
     }
     BENCHMARK(sum_series);
 
+    // Sum a chunk at a time through views of 64K elements, which copy nothing
+    void sum_series_chunks(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        constexpr std::size_t CHUNK{1 << 16};
+        for (auto _ : state) {
+            double total = 0;
+            for (std::size_t begin = 0; begin < c1.size(); begin += CHUNK) {
+                total += c1.slice(begin, begin + CHUNK).sum().value();
+            }
+            benchmark::DoNotOptimize(total);
+        }
+    }
+    BENCHMARK(sum_series_chunks);
+
+    // Sum every other element through a strided view
+    void sum_series_strided(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        for (auto _ : state) {
+            volatile auto s = c1.slice(0, c1.size(), 2).sum();
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    BENCHMARK(sum_series_strided);
+
+    // Null-skipping sum: 0 no validity bitmap, 1 an all-valid bitmap, 2 one null in 100, 3 half null
+    void sum_series_nulls(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        if (state.range(0) > 0) {
+            Bitmap valid(c1.size());
+            const std::size_t stride = state.range(0) == 2 ? 100 : state.range(0) == 3 ? 2 : 0;
+            for (std::size_t i = 0; stride && i < c1.size(); i += stride) {
+                valid.set(i, false);
+            }
+            c1.set_validity(std::move(valid));
+        }
+        for (auto _ : state) {
+            volatile auto s = c1.sum();
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    BENCHMARK(sum_series_nulls)->DenseRange(0, 3);
+
+    // Summation modes on a float column: 0 naive, 1 pairwise, 2 Kahan, 3 deterministic
+    void sum_series_mode(benchmark::State& state) {
+        const auto c1 = generate_random_series<float>(NUM_CALCS);
+        const auto mode = static_cast<Summation>(state.range(0));
+        for (auto _ : state) {
+            volatile auto s = c1.sum(mode);
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    BENCHMARK(sum_series_mode)->DenseRange(0, 3);
+
+    void dot_series_mode(benchmark::State& state) {
+        const auto c1 = generate_random_series(NUM_CALCS);
+        const auto mode = static_cast<Summation>(state.range(0));
+        for (auto _ : state) {
+            volatile auto s = c1.dot(c1, mode);
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    BENCHMARK(dot_series_mode)->DenseRange(0, 3);
+
     void mean_series(benchmark::State& state) {
         auto c1 = generate_random_series(NUM_CALCS);
         for (auto _ : state) {
@@ -164,6 +317,508 @@ namespace {
     }
     BENCHMARK(min_series);
 
+    // Both extremes with their positions: 0 min() and max() in two passes, 1 minmax() in one
+    void minmax_series(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        for (auto _ : state) {
+            if (state.range(0)) {
+                auto m = c1.minmax();
+                benchmark::DoNotOptimize(m);
+            }
+            else {
+                auto lo = c1.min();
+                auto hi = c1.max();
+                benchmark::DoNotOptimize(lo);
+                benchmark::DoNotOptimize(hi);
+            }
+        }
+    }
+    BENCHMARK(minmax_series)->Arg(0)->Arg(1);
+
+    // describe() of one column: 0 five separate reductions, 1 a single agg() pass
+    void describe_series(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        for (auto _ : state) {
+            if (state.range(0)) {
+                auto a = c1.agg({Agg::COUNT, Agg::MEAN, Agg::STD, Agg::MIN, Agg::MAX});
+                benchmark::DoNotOptimize(a);
+            }
+            else {
+                volatile auto n = c1.count();
+                auto m = c1.mean();
+                auto s = c1.stddev();
+                auto lo = c1.min();
+                auto hi = c1.max();
+                benchmark::DoNotOptimize(n);
+                benchmark::DoNotOptimize(m);
+                benchmark::DoNotOptimize(s);
+                benchmark::DoNotOptimize(lo);
+                benchmark::DoNotOptimize(hi);
+            }
+        }
+    }
+    BENCHMARK(describe_series)->Arg(0)->Arg(1);
+
+    // Sort order of random doubles: 0 std::stable_sort of positions, 1 argsort() by radix
+    void argsort_series(benchmark::State& state) {
+        auto c1 = generate_random_series(NUM_CALCS);
+        c1.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        for (auto _ : state) {
+            if (state.range(0)) {
+                auto order = c1.argsort();
+                benchmark::DoNotOptimize(order);
+            }
+            else {
+                std::vector<std::size_t> order(c1.size());
+                std::iota(order.begin(), order.end(), std::size_t{0});
+                std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return c1[a] < c1[b]; });
+                benchmark::DoNotOptimize(order);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(argsort_series)->Arg(0)->Arg(1);
+
+    // A frame sorted by a low-cardinality integer key and then a double, gathering a third column
+    void sort_values_frame(benchmark::State& state) {
+        auto keys = generate_random_series(NUM_CALCS);
+        Series<int> groups(ExecPolicy::PAR_UNSEQ, std::vector<int>(NUM_CALCS));
+        for (std::size_t i = 0; i < groups.size(); ++i) {
+            groups[i] = static_cast<int>(keys[i] * 100);
+        }
+        DataFrame frame;
+        frame.add("group", std::move(groups));
+        frame.add("x", generate_random_series(NUM_CALCS));
+        frame.add("y", generate_random_series(NUM_CALCS));
+        frame.column<double>("x").set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        frame.column<double>("y").set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        for (auto _ : state) {
+            auto sorted = frame.sort_values({"group", "x"});
+            benchmark::DoNotOptimize(sorted);
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(sort_values_frame);
+
+    // Running sum in place of 1M and 100M doubles: 0 a scalar loop, 1 cumsum() under AUTO
+    void cumsum_series(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        for (auto _ : state) {
+            if (state.range(1)) {
+                c1.cumsum();
+            }
+            else {
+                double total = 0;
+                for (auto& x : c1) {
+                    x = total += x;
+                }
+            }
+            benchmark::DoNotOptimize(c1);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(cumsum_series)->ArgsProduct({{NUM_CALCS, 100 * NUM_CALCS}, {0, 1}});
+
+    // Rolling aggregations of 1M doubles over a window of 100 elements
+    // 0 the mean of every window recomputed from a view, then rolling 1 mean, 2 stddev, 3 min, 4 median
+    void rolling_series(benchmark::State& state) {
+        constexpr std::size_t WINDOW{100};
+        const auto c1 = generate_random_series(NUM_CALCS);
+        const auto rolling = c1.rolling(WINDOW);
+        for (auto _ : state) {
+            switch (state.range(0)) {
+            case 0: {
+                Series<double>::container_type means(c1.size());
+                for (std::size_t i = WINDOW - 1; i < c1.size(); ++i) {
+                    means[i] = *c1.slice(i + 1 - WINDOW, i + 1).mean();
+                }
+                benchmark::DoNotOptimize(means);
+                break;
+            }
+            case 1:
+                benchmark::DoNotOptimize(rolling.mean());
+                break;
+            case 2:
+                benchmark::DoNotOptimize(rolling.stddev());
+                break;
+            case 3:
+                benchmark::DoNotOptimize(rolling.min());
+                break;
+            default:
+                benchmark::DoNotOptimize(rolling.median());
+                break;
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(rolling_series)->DenseRange(0, 4);
+
+    // Exponentially weighted mean of 1M and 100M doubles with alpha 0.01, adjusted as in pandas
+    // 0 the serial recurrence, 1 ewm().mean() under AUTO, 2 ewm().variance() under AUTO
+    void ewm_series(benchmark::State& state) {
+        constexpr double ALPHA{0.01};
+        const auto c1 = generate_random_series(state.range(0));
+        for (auto _ : state) {
+            if (state.range(1) == 0) {
+                Series<double>::container_type means(c1.size());
+                double sum = 0;
+                double weight = 0;
+                for (std::size_t i = 0; i < c1.size(); ++i) {
+                    sum = (1 - ALPHA) * sum + c1[i];
+                    weight = (1 - ALPHA) * weight + 1;
+                    means[i] = sum / weight;
+                }
+                benchmark::DoNotOptimize(means);
+            }
+            else if (state.range(1) == 1) {
+                benchmark::DoNotOptimize(c1.ewm(ALPHA).mean());
+            }
+            else {
+                benchmark::DoNotOptimize(c1.ewm(ALPHA).variance());
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(ewm_series)->ArgsProduct({{NUM_CALCS, 100 * NUM_CALCS}, {0, 1, 2}});
+
+    // First difference of 1M doubles: 0 a shifted copy and then a dyadic subtraction, 1 diff() in one pass
+    void diff_series(benchmark::State& state) {
+        const auto c1 = generate_random_series(NUM_CALCS);
+        for (auto _ : state) {
+            if (state.range(0)) {
+                const Series<double> result = c1.diff();
+                benchmark::DoNotOptimize(result);
+            }
+            else {
+                Series<double>::container_type lagged(c1.size());
+                std::copy(c1.begin(), c1.end() - 1, lagged.begin() + 1);
+                Series<double> shifted(std::move(lagged));
+                shifted.set_null(0);
+                const Series<double> result = c1 - shifted;
+                benchmark::DoNotOptimize(result);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(diff_series)->DenseRange(0, 1);
+
+    // Elements of 1M doubles below a threshold, by the percentage kept: 0 a loop appending each element
+    // that compares true, 1 filter() with a mask from the comparison operator
+    void filter_series(benchmark::State& state) {
+        const auto c1 = generate_random_series(NUM_CALCS);
+        const double threshold = static_cast<double>(state.range(0)) / 100.0;
+        for (auto _ : state) {
+            if (state.range(1)) {
+                const auto result = c1.filter(c1 < threshold);
+                benchmark::DoNotOptimize(result);
+            }
+            else {
+                Series<double>::container_type kept;
+                for (const auto x : c1) {
+                    if (x < threshold) {
+                        kept.push_back(x);
+                    }
+                }
+                const Series<double> result(std::move(kept));
+                benchmark::DoNotOptimize(result);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(filter_series)->ArgsProduct({{1, 50, 99}, {0, 1}});
+
+    // 1M doubles moved through a random permutation: 0 take(), 1 scatter(), which prefetches the lines
+    // it writes, 2 the same scatter as a plain loop
+    void take_scatter(benchmark::State& state) {
+        const auto c1 = generate_random_series(NUM_CALCS);
+        std::vector<std::size_t> order(NUM_CALCS);
+        std::iota(order.begin(), order.end(), std::size_t{0});
+        std::shuffle(order.begin(), order.end(), std::mt19937_64{42});
+        auto out = c1;
+        for (auto _ : state) {
+            if (state.range(0) == 0) {
+                const auto result = c1.take(order);
+                benchmark::DoNotOptimize(result);
+            }
+            else if (state.range(0) == 1) {
+                out.scatter(order, c1);
+                benchmark::DoNotOptimize(out);
+            }
+            else {
+                for (std::size_t i = 0; i < order.size(); ++i) {
+                    out[order[i]] = c1[i];
+                }
+                benchmark::DoNotOptimize(out);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(take_scatter)->DenseRange(0, 2);
+
+    // Sum and mean of a double column of 1M rows per integer key, by the number of distinct keys, up to
+    // nearly one per row: 0 keys spanning a small range, grouped through direct arrays when there are
+    // few, 1 keys spread over a wide range, grouped through hash tables, or partitioned first when there
+    // are many, 2 the wide keys sorted, grouped by runs; 0 a std::unordered_map from key to running sum
+    // and count, 1 groupby().agg()
+    void groupby_frame(benchmark::State& state) {
+        const auto keys = generate_random_series(NUM_CALCS);
+        const auto groups = static_cast<std::int64_t>(state.range(0));
+        const std::int64_t spread = state.range(1) ? 1'000'003 : 1;
+        Series<std::int64_t> group(ExecPolicy::PAR_UNSEQ, std::vector<std::int64_t>(NUM_CALCS));
+        for (std::size_t i = 0; i < group.size(); ++i) {
+            group[i] = static_cast<std::int64_t>(keys[i] * static_cast<double>(groups)) * spread;
+        }
+        if (state.range(1) == 2) {
+            std::sort(group.begin(), group.end());
+        }
+        DataFrame frame;
+        frame.add("group", group);
+        frame.add("x", generate_random_series(NUM_CALCS));
+        frame.column<double>("x").set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        const auto& x = frame.column<double>("x");
+        for (auto _ : state) {
+            if (state.range(2)) {
+                auto result = frame.groupby({"group"}).agg({Agg::SUM, Agg::MEAN});
+                benchmark::DoNotOptimize(result);
+            }
+            else {
+                std::unordered_map<std::int64_t, std::pair<double, std::size_t>> sums;
+                for (std::size_t i = 0; i < group.size(); ++i) {
+                    auto& [sum, count] = sums[group[i]];
+                    sum += x[i];
+                    ++count;
+                }
+                benchmark::DoNotOptimize(sums);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(groupby_frame)->ArgsProduct({{1'000, 100'000, 1'000'000}, {0, 1, 2}, {0, 1}});
+
+    // 1M fact rows enriched with a double column of a dimension table, by the number of its keys, which
+    // half the fact keys match: 0 keys spanning a small range, probed through an array, 1 keys spread
+    // over a wide range, probed through hash tables; 0 a std::unordered_map from key to dimension row
+    // probed row by row into index vectors, then gathered, 1 merge() as an inner join
+    void merge_frame(benchmark::State& state) {
+        const auto draws = generate_random_series(NUM_CALCS);
+        const auto keys = static_cast<std::int64_t>(state.range(0));
+        const std::int64_t spread = state.range(1) ? 1'000'003 : 1;
+        Series<std::int64_t> fact_keys(ExecPolicy::PAR_UNSEQ, std::vector<std::int64_t>(NUM_CALCS));
+        for (std::size_t i = 0; i < fact_keys.size(); ++i) {
+            fact_keys[i] = static_cast<std::int64_t>(draws[i] * static_cast<double>(2 * keys)) * spread;
+        }
+        Series<std::int64_t> dimension_keys(ExecPolicy::PAR_UNSEQ, std::vector<std::int64_t>(keys));
+        for (std::int64_t k = 0; k < keys; ++k) {
+            dimension_keys[k] = 2 * k * spread;
+        }
+        DataFrame fact;
+        fact.add("key", fact_keys);
+        fact.add("x", generate_random_series(NUM_CALCS));
+        DataFrame dimension;
+        dimension.add("key", dimension_keys);
+        dimension.add("y", generate_random_series(keys));
+        for (auto _ : state) {
+            if (state.range(2)) {
+                auto result = fact.merge(dimension, {"key"});
+                benchmark::DoNotOptimize(result);
+            }
+            else {
+                std::unordered_map<std::int64_t, std::size_t> rows;
+                for (std::int64_t k = 0; k < keys; ++k) {
+                    rows.emplace(dimension_keys[k], k);
+                }
+                std::vector<std::size_t> left;
+                std::vector<std::size_t> right;
+                for (std::size_t i = 0; i < fact_keys.size(); ++i) {
+                    if (const auto it = rows.find(fact_keys[i]); it != rows.end()) {
+                        left.push_back(i);
+                        right.push_back(it->second);
+                    }
+                }
+                auto result = fact.take(left);
+                result.add("y", dimension.column<double>("y").take(right));
+                benchmark::DoNotOptimize(result);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * NUM_CALCS);
+    }
+    BENCHMARK(merge_frame)->ArgsProduct({{1'000, 100'000}, {0, 1}, {0, 1}});
+
+    // Size sweeps locating the crossover points of ExecPolicy::AUTO
+    // Arguments are the number of elements and the policy: 0 SEQ, 1 UNSEQ, 2 PAR_UNSEQ, 3 AUTO
+    void policy_sweep(benchmark::internal::Benchmark* b) {
+        for (std::int64_t policy : {0, 1, 2, 3}) {
+            for (std::int64_t n = 64; n <= (1 << 20); n *= 4) {
+                b->Args({n, policy});
+            }
+        }
+    }
+
+    ExecPolicy sweep_policy(const benchmark::State& state) {
+        constexpr ExecPolicy POLICIES[]{ExecPolicy::SEQ, ExecPolicy::UNSEQ, ExecPolicy::PAR_UNSEQ, ExecPolicy::AUTO};
+        return POLICIES[state.range(1)];
+    }
+
+    // LIGHT
+    void sweep_add_scalar(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(sweep_policy(state));
+        for (auto _ : state) {
+            c1.add(0.5);
+            benchmark::DoNotOptimize(c1);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(sweep_add_scalar)->Apply(policy_sweep);
+
+    void sweep_sum(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(sweep_policy(state));
+        for (auto _ : state) {
+            volatile auto s = c1.sum();
+            benchmark::DoNotOptimize(s);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(sweep_sum)->Apply(policy_sweep);
+
+    // MEDIUM
+    void sweep_sqrt(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(sweep_policy(state));
+        for (auto _ : state) {
+            c1.sqrt();
+            benchmark::DoNotOptimize(c1);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(sweep_sqrt)->Apply(policy_sweep);
+
+    // HEAVY, through an expression
+    void sweep_exp_expr(benchmark::State& state) {
+        const auto input = generate_random_series(state.range(0));
+        auto c1 = input;
+        c1.set_exec_policy(sweep_policy(state));
+        for (auto _ : state) {
+            Series<double> c2 = df::exp(c1) + 1.0;
+            benchmark::DoNotOptimize(c2);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(sweep_exp_expr)->Apply(policy_sweep);
+
+    // Runtime against compile-time policy: 0 a view holding ExecPolicy::UNSEQ, 1 a view tagged exec::Unseq
+    void static_policy_sum(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(ExecPolicy::UNSEQ);
+        const auto dynamic = c1.view();
+        const auto tagged = c1.view<exec::Unseq>();
+        for (auto _ : state) {
+            volatile auto s = state.range(1) ? tagged.sum() : dynamic.sum();
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    BENCHMARK(static_policy_sum)->ArgsProduct({{64, 4096, NUM_CALCS}, {0, 1}});
+
+    void static_policy_expr(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(ExecPolicy::UNSEQ);
+        const auto dynamic = c1.view();
+        const auto tagged = c1.view<exec::Unseq>();
+        for (auto _ : state) {
+            if (state.range(1)) {
+                volatile auto s = (tagged * 2.0 + 1.0).sum();
+                benchmark::DoNotOptimize(s);
+            }
+            else {
+                volatile auto s = (dynamic * 2.0 + 1.0).sum();
+                benchmark::DoNotOptimize(s);
+            }
+        }
+    }
+    BENCHMARK(static_policy_expr)->ArgsProduct({{64, 4096, NUM_CALCS}, {0, 1}});
+
+    // PAR_UNSEQ work on each parallel backend: 0 STD, 1 TBB, 2 OPENMP, 3 POOL
+    // The whole suite runs on one backend by setting DF_BACKEND, DF_THREADS, DF_PIN and DF_GRAIN
+    void backend_sweep(benchmark::internal::Benchmark* b) {
+        b->ArgsProduct({{1 << 16, NUM_CALCS}, {0, 1, 2, 3}});
+    }
+
+    // Run body with the backend of the benchmark, keeping the rest of the configuration
+    template <typename F>
+    void on_backend(benchmark::State& state, F&& body) {
+        constexpr Backend BACKENDS[]{Backend::STD, Backend::TBB, Backend::OPENMP, Backend::POOL};
+        const auto saved = parallel_config();
+        auto config = saved;
+        config.backend = BACKENDS[state.range(1)];
+        if (!backend_available(config.backend)) {
+            state.SkipWithError("backend not built");
+            return;
+        }
+        set_parallel_config(config);
+        body();
+        set_parallel_config(saved);
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void backend_sum(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        on_backend(state, [&] {
+            for (auto _ : state) {
+                volatile auto s = c1.sum();
+                benchmark::DoNotOptimize(s);
+            }
+        });
+    }
+    BENCHMARK(backend_sum)->Apply(backend_sweep);
+
+    void backend_sqrt(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        on_backend(state, [&] {
+            for (auto _ : state) {
+                c1.sqrt();
+                benchmark::DoNotOptimize(c1);
+            }
+        });
+    }
+    BENCHMARK(backend_sqrt)->Apply(backend_sweep);
+
+    void backend_exp_expr(benchmark::State& state) {
+        auto c1 = generate_random_series(state.range(0));
+        c1.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        on_backend(state, [&] {
+            for (auto _ : state) {
+                Series<double> c2 = df::exp(c1) + 1.0;
+                benchmark::DoNotOptimize(c2);
+            }
+        });
+    }
+    BENCHMARK(backend_exp_expr)->Apply(backend_sweep);
+
+    // Bandwidth-bound addition on the POOL backend: 0 unpinned, so pages land wherever the filling thread
+    // runs, 1 pinned, so buffers are first touched and loops scheduled by NUMA node (see numa.h)
+    void numa_add_series(benchmark::State& state) {
+        const auto saved = parallel_config();
+        auto config = saved;
+        config.backend = Backend::POOL;
+        config.pin = state.range(0) != 0;
+        set_parallel_config(config);
+        {
+            auto c1 = generate_random_series(NUM_CALCS * 8);
+            const auto c2 = generate_random_series(NUM_CALCS * 8);
+            c1.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+            for (auto _ : state) {
+                c1 += c2;
+                benchmark::DoNotOptimize(c1);
+            }
+            state.SetBytesProcessed(state.iterations() * NUM_CALCS * 8 * 3 * sizeof(double));
+        }
+        set_parallel_config(saved);
+    }
+    BENCHMARK(numa_add_series)->Arg(0)->Arg(1);
+
 }  // namespace
 
 BENCHMARK_MAIN();
@@ -1,15 +1,16 @@
 #include "dataframe/dataframe.h"
 #include "dataframe/series.h"
+#include <algorithm>
 #include <iostream>
 
 namespace df {
 
-    std::ostream& operator<<(std::ostream& os, const DataFrame& df) {
-        auto [nrows, ncols] = df.shape();
+    void DataFrame::print_rows(std::ostream& os, std::size_t offset, std::size_t nrows) const {
+        const auto ncols = width();
         os << "DataFrame: " << nrows << " rows x " << ncols << " columns\n";
         os << "----------------------------------------\n";
         // Print column names
-        for (const auto& col_name : df.col_order_) {
+        for (const auto& col_name : col_order_) {
             os << col_name << "\t";
         }
         os << "\n";
@@ -17,21 +18,218 @@ namespace df {
 
         // Print first 5 rows or all if less than 5
         std::size_t rows_to_print = std::min<std::size_t>(5, nrows);
-        for (std::size_t i = 0; i < rows_to_print; ++i) {
-            for (const auto& col_name : df.col_order_) {
-                const auto& col = df.cols_.at(col_name);
+        for (std::size_t i = offset; i < offset + rows_to_print; ++i) {
+            for (const auto& col_name : col_order_) {
+                const auto& col = cols_.at(col_name);
                 if (col->type() == typeid(int)) {
                     auto& series = static_cast<WrappedSeries<int>&>(*col).impl();
-                    os << series[i] << "\t";
+                    if (series.is_valid(i)) {
+                        os << series[i] << "\t";
+                    } else {
+                        os << "null\t";
+                    }
                 } else if (col->type() == typeid(double)) {
                     auto& series = static_cast<WrappedSeries<double>&>(*col).impl();
-                    os << series[i] << "\t";
+                    if (series.is_valid(i)) {
+                        os << series[i] << "\t";
+                    } else {
+                        os << "null\t";
+                    }
                 } else {
                     os << "N/A\t"; // Unsupported type
                 }
             }
             os << "\n";
         }
+    }
+
+    DataFrameView DataFrame::slice(std::size_t begin, std::size_t end) const {
+        return DataFrameView(*this, 0, length()).slice(begin, end);
+    }
+
+    DataFrameView DataFrame::head(std::size_t n) const {
+        return DataFrameView(*this, 0, length()).head(n);
+    }
+
+    DataFrameView DataFrame::tail(std::size_t n) const {
+        return DataFrameView(*this, 0, length()).tail(n);
+    }
+
+    namespace {
+
+        const std::vector<Agg> DESCRIBE{Agg::COUNT, Agg::MEAN, Agg::STD, Agg::MIN, Agg::MAX};
+
+    }
+
+    DataFrame DataFrame::agg_rows(const std::vector<Agg>& aggs, std::size_t offset, std::size_t nrows) const {
+        DataFrame out;
+        for (const auto& name : col_order_) {
+            const auto result = cols_.at(name)->agg(aggs, offset, nrows);
+            if (!result) {
+                continue;
+            }
+            const auto& values = result->values();
+            Series<double> column(Series<double>::container_type(values.size()));
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                if (values[i]) {
+                    column[i] = *values[i];
+                }
+                else {
+                    column.set_null(i);
+                }
+            }
+            out.add(name, std::move(column));
+        }
+        return out;
+    }
+
+    DataFrame DataFrame::agg(const std::vector<Agg>& aggs) const {
+        return agg_rows(aggs, 0, length());
+    }
+
+    DataFrame DataFrame::describe() const {
+        return agg(DESCRIBE);
+    }
+
+    DataFrame DataFrameView::describe() const {
+        return agg(DESCRIBE);
+    }
+
+    DataFrame DataFrame::sort_values(const std::vector<std::string>& by, bool ascending) const {
+        if (by.empty()) {
+            throw std::invalid_argument("No columns to sort by");
+        }
+        // least significant key first: each stable pass keeps the order of the later keys among its ties
+        std::vector<std::size_t> order;
+        for (auto it = by.rbegin(); it != by.rend(); ++it) {
+            cols_.at(*it)->sort_order(order, ascending);
+        }
+        return take(order);
+    }
+
+    DataFrame DataFrame::take(const std::vector<std::size_t>& indices) const {
+        detail::check_indices(ExecPolicy::AUTO, indices, length());
+        DataFrame out;
+        for (const auto& name : col_order_) {
+            out.cols_.emplace(name, cols_.at(name)->gather(indices));
+        }
+        out.col_order_ = col_order_;
+        return out;
+    }
+
+    DataFrame DataFrame::filter(const Bitmap& mask) const {
+        if (mask.size() != length()) {
+            throw std::invalid_argument("Mask size does not match the frame");
+        }
+        DataFrame out;
+        for (const auto& name : col_order_) {
+            out.cols_.emplace(name, cols_.at(name)->filter(mask));
+        }
+        out.col_order_ = col_order_;
+        return out;
+    }
+
+    GroupBy DataFrame::groupby(std::vector<std::string> keys) const {
+        return GroupBy(*this, std::move(keys));
+    }
+
+    GroupBy::GroupBy(const DataFrame& frame, std::vector<std::string> keys) : frame_(&frame), keys_(std::move(keys)) {
+        if (keys_.empty()) {
+            throw std::invalid_argument("No columns to group by");
+        }
+        groups_ = frame.cols_.at(keys_[0])->group();
+        for (std::size_t k = 1; k < keys_.size(); ++k) {
+            groups_ = detail::combine(ExecPolicy::AUTO, groups_, frame.cols_.at(keys_[k])->group());
+        }
+    }
+
+    DataFrame GroupBy::agg(const std::vector<Agg>& aggs) const {
+        std::vector<std::string> columns;
+        for (const auto& name : frame_->col_order_) {
+            if (std::find(keys_.begin(), keys_.end(), name) == keys_.end()) {
+                columns.push_back(name);
+            }
+        }
+        return aggregate(columns, aggs, false);
+    }
+
+    DataFrame GroupBy::agg(const std::vector<std::string>& columns, const std::vector<Agg>& aggs) const {
+        return aggregate(columns, aggs, true);
+    }
+
+    DataFrame GroupBy::aggregate(const std::vector<std::string>& columns, const std::vector<Agg>& aggs, bool named) const {
+        DataFrame out;
+        // each key takes its value from the first row of every group
+        for (const auto& key : keys_) {
+            const auto [it, inserted] = out.cols_.emplace(key, frame_->cols_.at(key)->gather(groups_.firsts));
+            if (inserted) {
+                out.col_order_.push_back(key);
+            }
+        }
+        for (const auto& name : columns) {
+            auto results = frame_->cols_.at(name)->group_agg(aggs, groups_);
+            if (!results) {
+                if (named) {
+                    throw std::invalid_argument(std::string("Column does not hold numbers: ") + name);
+                }
+                continue;
+            }
+            for (std::size_t k = 0; k < aggs.size(); ++k) {
+                out.add(name + "_" + agg_name(aggs[k]), std::move((*results)[k]));
+            }
+        }
+        return out;
+    }
+
+    DataFrame DataFrame::merge(const DataFrame& other, const std::vector<std::string>& on, Join how) const {
+        if (on.empty()) {
+            throw std::invalid_argument("No columns to join on");
+        }
+        // the side with fewer rows is built on and the other probes it, the key numbers being shared
+        const bool build_right = other.length() <= length();
+        const auto& build = build_right ? other : *this;
+        const auto& probe = build_right ? *this : other;
+        auto matched = build.cols_.at(on[0])->match(*probe.cols_.at(on[0]));
+        for (std::size_t k = 1; k < on.size(); ++k) {
+            matched = detail::match_pairs(ExecPolicy::AUTO, matched, build.cols_.at(on[k])->match(*probe.cols_.at(on[k])));
+        }
+        const auto& left = build_right ? matched.probe : matched.build.ids;
+        const auto& right = build_right ? matched.build.ids : matched.probe;
+        if (how == Join::SEMI || how == Join::ANTI) {
+            return filter(detail::join_mask(ExecPolicy::AUTO, left, right, matched.build.size(), how == Join::SEMI));
+        }
+
+        const auto rows = detail::join_rows(ExecPolicy::AUTO, left, right, matched.build.size(), how == Join::LEFT);
+        const auto is_key = [&](const std::string& name) { return std::find(on.begin(), on.end(), name) != on.end(); };
+        DataFrame out;
+        for (const auto& name : col_order_) {
+            const auto shared = !is_key(name) && other.cols_.contains(name);
+            const auto [it, inserted] = out.cols_.emplace(shared ? name + "_x" : name, cols_.at(name)->gather(rows.left));
+            if (inserted) {
+                out.col_order_.push_back(it->first);
+            }
+        }
+        for (const auto& name : other.col_order_) {
+            if (is_key(name)) {
+                continue;
+            }
+            const auto& column = other.cols_.at(name);
+            auto gathered = how == Join::LEFT ? column->gather_or_null(rows.right) : column->gather(rows.right);
+            const auto [it, inserted] = out.cols_.emplace(cols_.contains(name) ? name + "_y" : name, std::move(gathered));
+            if (inserted) {
+                out.col_order_.push_back(it->first);
+            }
+        }
+        return out;
+    }
+
+    std::ostream& operator<<(std::ostream& os, const DataFrame& df) {
+        df.print_rows(os, 0, df.length());
+        return os;
+    }
+
+    std::ostream& operator<<(std::ostream& os, const DataFrameView& view) {
+        view.frame_->print_rows(os, view.offset_, view.length_);
         return os;
     }
 
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace df {
+
+    // Aggregations that agg() computes together in a single pass
+    enum class Agg {
+        // number of non-null elements
+        COUNT,
+        SUM,
+        MEAN,
+        MIN,
+        MAX,
+        // population variance, as variance()
+        VAR,
+        // population standard deviation, as stddev()
+        STD
+    };
+
+    // Lower-case name of an aggregation, as in pandas
+    inline const char* agg_name(Agg agg) noexcept;
+
+    // The results of agg(): one value per requested aggregation, in the order requested
+    // A value is std::nullopt where the aggregation is undefined, such as the mean of no elements
+    template <typename T>
+    class Aggregates {
+    public:
+        Aggregates(std::vector<Agg> aggs, std::vector<std::optional<T>> values)
+            : aggs_(std::move(aggs)), values_(std::move(values)) {}
+
+        std::size_t size() const noexcept { return aggs_.size(); }
+        const std::vector<Agg>& aggs() const noexcept { return aggs_; }
+        const std::vector<std::optional<T>>& values() const noexcept { return values_; }
+
+        // The value of an aggregation
+        // Throws std::out_of_range if it was not requested
+        std::optional<T> operator[](Agg agg) const {
+            const auto it = std::find(aggs_.begin(), aggs_.end(), agg);
+            if (it == aggs_.end()) {
+                throw std::out_of_range(std::string("Aggregation not computed: ") + agg_name(agg));
+            }
+            return values_[static_cast<std::size_t>(it - aggs_.begin())];
+        }
+
+    private:
+        std::vector<Agg> aggs_;
+        std::vector<std::optional<T>> values_;
+    };
+
+    // How argmin(), argmax() and minmax() treat NaN elements
+    enum class NanPolicy {
+        // skip them, as nulls are skipped
+        SKIP,
+        // the first NaN is both the minimum and the maximum, as NaN propagates through arithmetic
+        PROPAGATE
+    };
+
+    // An element of a view together with its position in the view, so that the row it came from can
+    // be read directly
+    template <typename T>
+    struct Extremum {
+        std::size_t index;
+        T value;
+
+        friend bool operator==(const Extremum&, const Extremum&) = default;
+    };
+
+    // The results of minmax()
+    template <typename T>
+    struct MinMax {
+        Extremum<T> min;
+        Extremum<T> max;
+
+        friend bool operator==(const MinMax&, const MinMax&) = default;
+    };
+
+    namespace detail {
+
+        // Positions of the first minimum, the first maximum and the first NaN of the elements pushed,
+        // merged across blocks in a single reduction; NONE where there is no such element
+        template <typename T>
+        struct ArgExtrema {
+            static constexpr std::size_t NONE{static_cast<std::size_t>(-1)};
+
+            std::size_t argmin{NONE};
+            std::size_t argmax{NONE};
+            std::size_t nan{NONE};
+            T min{};
+            T max{};
+
+            // Add the element at position i
+            void push(std::size_t i, const T& x) {
+                if constexpr (std::is_floating_point_v<T>) {
+                    if (x != x) {
+                        nan = std::min(nan, i);
+                        return;
+                    }
+                }
+                *this = merge(*this, ArgExtrema{i, i, NONE, x, x});
+            }
+
+            // Union of two sets of elements; of equal elements the one at the lower position wins
+            friend ArgExtrema merge(const ArgExtrema& a, const ArgExtrema& b) {
+                ArgExtrema out{a};
+                out.nan = std::min(a.nan, b.nan);
+                if (b.argmin != NONE && (a.argmin == NONE || b.min < a.min || (!(a.min < b.min) && b.argmin < a.argmin))) {
+                    out.argmin = b.argmin;
+                    out.min = b.min;
+                }
+                if (b.argmax != NONE && (a.argmax == NONE || a.max < b.max || (!(b.max < a.max) && b.argmax < a.argmax))) {
+                    out.argmax = b.argmax;
+                    out.max = b.max;
+                }
+                return out;
+            }
+        };
+
+        // The partial results a set of aggregations needs from the scan, from cheapest to dearest
+        struct AggPlan {
+            bool sum{false};
+            bool extrema{false};
+            bool moments{false};
+
+            explicit AggPlan(const std::vector<Agg>& aggs) noexcept {
+                for (const auto agg : aggs) {
+                    sum |= agg == Agg::SUM || agg == Agg::MEAN;
+                    extrema |= agg == Agg::MIN || agg == Agg::MAX;
+                    moments |= agg == Agg::VAR || agg == Agg::STD;
+                }
+            }
+
+            // Whether the elements have to be read at all; COUNT alone comes from the validity bitmap
+            bool scan() const noexcept { return sum || extrema || moments; }
+        };
+
+        // Combined accumulator of every aggregation, merged across blocks in a single reduction
+        // A block only fills the fields its AggPlan asks for; the others hold unspecified values
+        template <typename T>
+        struct AggState {
+            std::size_t count{0};
+            T sum{};
+            T mean{};
+            T m2{};
+            T min{};
+            T max{};
+
+            // Add one value (Welford for the mean and M2)
+            void push(T x) {
+                if (count == 0) {
+                    *this = {1, x, x, T{}, x, x};
+                    return;
+                }
+                ++count;
+                sum += x;
+                const T delta = x - mean;
+                mean += delta / static_cast<T>(count);
+                m2 += delta * (x - mean);
+                min = std::min(min, x);
+                max = std::max(max, x);
+            }
+
+            // Union of two disjoint sets of values, with Chan's formula for the mean and M2
+            friend AggState merge(const AggState& a, const AggState& b) {
+                if (a.count == 0) {
+                    return b;
+                }
+                if (b.count == 0) {
+                    return a;
+                }
+                const auto n = a.count + b.count;
+                const T na = static_cast<T>(a.count);
+                const T nb = static_cast<T>(b.count);
+                const T delta = b.mean - a.mean;
+                return {
+                    n,
+                    a.sum + b.sum,
+                    a.mean + delta * (nb / static_cast<T>(n)),
+                    a.m2 + b.m2 + delta * delta * (na * nb / static_cast<T>(n)),
+                    std::min(a.min, b.min),
+                    std::max(a.max, b.max)
+                };
+            }
+
+            // The requested aggregations of the accumulated values
+            Aggregates<T> results(const std::vector<Agg>& aggs) const {
+                std::vector<std::optional<T>> values;
+                values.reserve(aggs.size());
+                for (const auto agg : aggs) {
+                    values.emplace_back(result(agg));
+                }
+                return {aggs, std::move(values)};
+            }
+
+            // One aggregation of the accumulated values, std::nullopt where it is undefined
+            std::optional<T> result(Agg agg) const {
+                if (agg == Agg::COUNT) {
+                    return static_cast<T>(count);
+                }
+                if (count == 0) {
+                    return std::nullopt;
+                }
+                return value(agg);
+            }
+
+        private:
+            T value(Agg agg) const {
+                switch (agg) {
+                case Agg::SUM:
+                    return sum;
+                case Agg::MEAN:
+                    return sum / static_cast<T>(count);
+                case Agg::MIN:
+                    return min;
+                case Agg::MAX:
+                    return max;
+                case Agg::VAR:
+                    return m2 / static_cast<T>(count);
+                case Agg::STD:
+                    return static_cast<T>(std::sqrt(m2 / static_cast<T>(count)));
+                case Agg::COUNT:
+                    break;
+                }
+                return static_cast<T>(count);
+            }
+        };
+
+    }
+
+    inline const char* agg_name(Agg agg) noexcept {
+        switch (agg) {
+        case Agg::COUNT:
+            return "count";
+        case Agg::SUM:
+            return "sum";
+        case Agg::MEAN:
+            return "mean";
+        case Agg::MIN:
+            return "min";
+        case Agg::MAX:
+            return "max";
+        case Agg::VAR:
+            return "var";
+        case Agg::STD:
+            return "std";
+        }
+        return "unknown";
+    }
+
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+
+namespace df {
+
+    // A packed sequence of bits, one per element, least significant bit first as in Apache Arrow
+    //
+    // Used as the validity bitmap of a Series: bit i is set when element i holds a value and clear when
+    // it is null. It is also the boolean mask that comparing series produces and filter() consumes, and
+    // combines with &, | and ^ and inverts with ~. Whole-bitmap operations work a 64-bit word at a time,
+    // and bits past size() in the last word are always kept clear so that words can be combined and
+    // counted without masking.
+    class Bitmap {
+    public:
+        using word_type = std::uint64_t;
+        static constexpr std::size_t WORD_BITS{64};
+
+        Bitmap() = default;
+
+        // A bitmap of size bits, all set to value
+        explicit Bitmap(std::size_t size, bool value = true)
+            : words_(word_count(size), value ? ~word_type{0} : word_type{0}), size_(size) {
+            clear_tail();
+        }
+
+        std::size_t size() const noexcept { return size_; }
+
+        // Get bit i without bounds checking
+        bool operator[](std::size_t i) const noexcept {
+            return (words_[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+        }
+
+        // Set bit i to value without bounds checking
+        void set(std::size_t i, bool value = true) noexcept {
+            const auto bit = word_type{1} << (i % WORD_BITS);
+            auto& word = words_[i / WORD_BITS];
+            word = value ? (word | bit) : (word & ~bit);
+        }
+
+        // Resize to size bits, setting any new bits to value
+        void resize(std::size_t size, bool value = true) {
+            if (value && size > size_ && size_ % WORD_BITS != 0) {
+                words_.back() |= ~word_type{0} << (size_ % WORD_BITS);
+            }
+            words_.resize(word_count(size), value ? ~word_type{0} : word_type{0});
+            size_ = size;
+            clear_tail();
+        }
+
+        // Number of set bits
+        std::size_t count() const noexcept {
+            std::size_t total = 0;
+            for (const auto word : words_) {
+                total += static_cast<std::size_t>(std::popcount(word));
+            }
+            return total;
+        }
+
+        // Whether every bit is set
+        bool all() const noexcept {
+            const auto full = size_ / WORD_BITS;
+            for (std::size_t w = 0; w < full; ++w) {
+                if (words_[w] != ~word_type{0}) {
+                    return false;
+                }
+            }
+            return full == words_.size() || words_.back() == ~(~word_type{0} << (size_ % WORD_BITS));
+        }
+
+        // Whether no bit is set
+        bool none() const noexcept {
+            return std::all_of(words_.begin(), words_.end(), [](word_type word) { return word == 0; });
+        }
+
+        // Number of set bits within [begin, end)
+        std::size_t count(std::size_t begin, std::size_t end) const noexcept {
+            std::size_t total = 0;
+            for_each_word(begin, end, [&total](word_type bits, word_type) {
+                total += static_cast<std::size_t>(std::popcount(bits));
+                return true;
+            });
+            return total;
+        }
+
+        // Whether every bit within [begin, end) is set
+        bool all(std::size_t begin, std::size_t end) const noexcept {
+            return for_each_word(begin, end, [](word_type bits, word_type range) { return bits == range; });
+        }
+
+        // Whether no bit within [begin, end) is set
+        bool none(std::size_t begin, std::size_t end) const noexcept {
+            return for_each_word(begin, end, [](word_type bits, word_type) { return bits == 0; });
+        }
+
+        // The bits within [begin, end) as a new bitmap, shifted into place a word at a time
+        Bitmap slice(std::size_t begin, std::size_t end) const {
+            Bitmap out(end - begin, false);
+            const auto first = begin / WORD_BITS;
+            const auto shift = begin % WORD_BITS;
+            for (std::size_t w = 0; w < out.words_.size(); ++w) {
+                auto word = words_[first + w] >> shift;
+                if (shift != 0 && first + w + 1 < words_.size()) {
+                    word |= words_[first + w + 1] << (WORD_BITS - shift);
+                }
+                out.words_[w] = word;
+            }
+            out.clear_tail();
+            return out;
+        }
+
+        // The bitmap moved by periods positions, so that bit i holds bit i - periods, with the bits moved
+        // in from outside cleared; shifted a word at a time
+        Bitmap shifted(std::ptrdiff_t periods) const {
+            Bitmap out(size_, false);
+            const auto distance = static_cast<std::size_t>(periods < 0 ? -periods : periods);
+            if (distance >= size_) {
+                return out;
+            }
+            const auto skip = distance / WORD_BITS;
+            const auto shift = distance % WORD_BITS;
+            const auto n = words_.size();
+            for (std::size_t w = 0; w + skip < n; ++w) {
+                if (periods >= 0) {
+                    // towards higher positions: word w + skip is fed by words w and w - 1
+                    auto word = words_[w] << shift;
+                    if (shift != 0 && w > 0) {
+                        word |= words_[w - 1] >> (WORD_BITS - shift);
+                    }
+                    out.words_[w + skip] = word;
+                }
+                else {
+                    // towards lower positions: word w is fed by words w + skip and w + skip + 1
+                    auto word = words_[w + skip] >> shift;
+                    if (shift != 0 && w + skip + 1 < n) {
+                        word |= words_[w + skip + 1] << (WORD_BITS - shift);
+                    }
+                    out.words_[w] = word;
+                }
+            }
+            out.clear_tail();
+            return out;
+        }
+
+        const word_type* words() const noexcept { return words_.data(); }
+
+        // The words for writing whole, where bits past size() must be left clear
+        word_type* words() noexcept { return words_.data(); }
+        std::size_t num_words() const noexcept { return words_.size(); }
+
+        // Shortest stretch of set bits inside a partially set word that is visited as a run
+        static constexpr std::size_t MIN_RUN{16};
+
+        /// Visit the set bits within [begin, end) a word at a time
+        // run: called with the [begin, end) bounds of each stretch of at least MIN_RUN consecutive set
+        //      bits, coalesced across words
+        // mixed: called with the index of bit 0 of a word and a mask of its set bits in shorter stretches
+        // A fully set range is a single call to run, and clear words are skipped whole
+        template <typename Run, typename Mixed>
+        void for_each_set(std::size_t begin, std::size_t end, Run&& run, Mixed&& mixed) const {
+            bool in_run = false;
+            std::size_t run_begin = begin;
+            while (begin < end) {
+                const auto w = begin / WORD_BITS;
+                const auto base = w * WORD_BITS;
+                const auto hi = std::min(end - base, WORD_BITS);
+                auto pos = begin - base;
+                begin = base + hi;
+                const auto range = (hi == WORD_BITS ? ~word_type{0} : ((word_type{1} << hi) - 1)) & (~word_type{0} << pos);
+                const auto bits = words_[w] & range;
+
+                if (in_run) {
+                    pos += static_cast<std::size_t>(std::countr_one(bits >> pos));
+                    if (pos == hi) {
+                        continue;
+                    }
+                    run(run_begin, base + pos);
+                    in_run = false;
+                }
+
+                // bit i of wide is set when bits i .. i + MIN_RUN - 1 all are
+                auto rest = bits & (~word_type{0} << pos);
+                auto wide = rest;
+                for (std::size_t shift = 1; shift < MIN_RUN; shift *= 2) {
+                    wide &= wide >> shift;
+                }
+                if (wide) {
+                    word_type short_bits = 0;
+                    while (rest) {
+                        const auto start = static_cast<std::size_t>(std::countr_zero(rest));
+                        const auto ones = static_cast<std::size_t>(std::countr_one(rest >> start));
+                        const auto stretch = ones == WORD_BITS ? ~word_type{0} : ((word_type{1} << ones) - 1) << start;
+                        rest &= ~stretch;
+                        if (ones < MIN_RUN) {
+                            short_bits |= stretch;
+                        }
+                        else if (start + ones == hi) {
+                            // may continue into the next word
+                            run_begin = base + start;
+                            in_run = true;
+                        }
+                        else {
+                            run(base + start, base + start + ones);
+                        }
+                    }
+                    rest = short_bits;
+                }
+                if (rest) {
+                    mixed(base, rest);
+                }
+            }
+            if (in_run) {
+                run(run_begin, end);
+            }
+        }
+
+        // Keep only the bits set in both bitmaps, a word at a time
+        Bitmap& operator&=(const Bitmap& other) {
+            if (other.size_ != size_) {
+                throw std::invalid_argument("Bitmap sizes do not match");
+            }
+            for (std::size_t w = 0; w < words_.size(); ++w) {
+                words_[w] &= other.words_[w];
+            }
+            return *this;
+        }
+
+        friend Bitmap operator&(Bitmap lhs, const Bitmap& rhs) {
+            return lhs &= rhs;
+        }
+
+        // Set the bits set in either bitmap, a word at a time
+        Bitmap& operator|=(const Bitmap& other) {
+            if (other.size_ != size_) {
+                throw std::invalid_argument("Bitmap sizes do not match");
+            }
+            for (std::size_t w = 0; w < words_.size(); ++w) {
+                words_[w] |= other.words_[w];
+            }
+            return *this;
+        }
+
+        friend Bitmap operator|(Bitmap lhs, const Bitmap& rhs) {
+            return lhs |= rhs;
+        }
+
+        // Keep the bits set in exactly one of the bitmaps, a word at a time
+        Bitmap& operator^=(const Bitmap& other) {
+            if (other.size_ != size_) {
+                throw std::invalid_argument("Bitmap sizes do not match");
+            }
+            for (std::size_t w = 0; w < words_.size(); ++w) {
+                words_[w] ^= other.words_[w];
+            }
+            return *this;
+        }
+
+        friend Bitmap operator^(Bitmap lhs, const Bitmap& rhs) {
+            return lhs ^= rhs;
+        }
+
+        // Every bit flipped
+        friend Bitmap operator~(Bitmap bits) {
+            for (auto& word : bits.words_) {
+                word = ~word;
+            }
+            bits.clear_tail();
+            return bits;
+        }
+
+        friend bool operator==(const Bitmap&, const Bitmap&) = default;
+
+    private:
+        std::vector<word_type> words_;
+        std::size_t size_{0};
+
+        static std::size_t word_count(std::size_t bits) noexcept {
+            return (bits + WORD_BITS - 1) / WORD_BITS;
+        }
+
+        // Call f(bits, range) for each word overlapping [begin, end), where range masks the positions inside
+        // [begin, end) and bits are the set bits among them; stops at the first call that returns false
+        template <typename F>
+        bool for_each_word(std::size_t begin, std::size_t end, F&& f) const {
+            while (begin < end) {
+                const auto w = begin / WORD_BITS;
+                const auto base = w * WORD_BITS;
+                const auto hi = std::min(end - base, WORD_BITS);
+                const auto range = (hi == WORD_BITS ? ~word_type{0} : ((word_type{1} << hi) - 1)) & (~word_type{0} << (begin - base));
+                if (!f(words_[w] & range, range)) {
+                    return false;
+                }
+                begin = base + hi;
+            }
+            return true;
+        }
+
+        void clear_tail() noexcept {
+            if (size_ % WORD_BITS != 0) {
+                words_.back() &= ~(~word_type{0} << (size_ % WORD_BITS));
+            }
+        }
+    };
+
+    // Validity of the result of an elementwise operation on two operands: valid where both are
+    // An absent bitmap means every element is valid
+    inline std::optional<Bitmap> intersect(const std::optional<Bitmap>& a, const std::optional<Bitmap>& b) {
+        if (!a) {
+            return b;
+        }
+        if (!b) {
+            return a;
+        }
+        return *a & *b;
+    }
+
+}
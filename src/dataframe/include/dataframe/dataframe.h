@@ -1,19 +1,56 @@
 #pragma once
 
+#include "groupby.h"
+#include "join.h"
 #include "series.h"
 
 #include <memory>
+#include <type_traits>
 #include <unordered_map>
 #include <string>
 #include <optional>
 
 
 namespace df {
+    class BaseSeries;
+
+    using SeriesPtr = std::shared_ptr<BaseSeries>;
+
     class BaseSeries {
     public:
         virtual ~BaseSeries() = default;
         virtual std::size_t size() const noexcept = 0;
         virtual const std::type_info& type() const noexcept = 0;
+
+        // Aggregations of the rows [offset, offset + length) as doubles, in a single pass
+        // Returns std::nullopt for a column that does not hold numbers
+        virtual std::optional<Aggregates<double>> agg(const std::vector<Agg>& aggs, std::size_t offset, std::size_t length) const = 0;
+
+        // Stably reorder a permutation of the rows by the values of this column, as Series::argsort
+        // An empty order stands for the rows in order
+        virtual void sort_order(std::vector<std::size_t>& order, bool ascending) const = 0;
+
+        // A column of the rows at the given positions, in order
+        virtual SeriesPtr gather(const std::vector<std::size_t>& order) const = 0;
+
+        // A column of the rows at the given positions, in order, null where the position is detail::NO_ROW
+        virtual SeriesPtr gather_or_null(const std::vector<std::size_t>& order) const = 0;
+
+        // A column of the rows whose bit is set in the mask, in order, as Series::filter
+        virtual SeriesPtr filter(const Bitmap& mask) const = 0;
+
+        // The rows grouped by the value of this column, in order of first appearance, null in no group
+        // Throws std::invalid_argument if its values cannot be hashed and compared
+        virtual detail::Grouping group() const = 0;
+
+        // Aggregations of the rows of each group as double columns, one per aggregation in order
+        // Returns std::nullopt for a column that does not hold numbers
+        virtual std::optional<std::vector<Series<double>>> group_agg(const std::vector<Agg>& aggs, const detail::Grouping& groups) const = 0;
+
+        // The keys of this column numbered as the build side of a join, and each row of probe labelled
+        // with the number of its key here
+        // Throws std::invalid_argument if probe holds another type or the values cannot be keys
+        virtual detail::KeyMatch match(const BaseSeries& probe) const = 0;
     };
 
     template <typename T>
@@ -24,6 +61,70 @@ namespace df {
         std::size_t size() const noexcept override { return series_.size(); }
         const std::type_info& type() const noexcept override { return typeid(T); }
 
+        std::optional<Aggregates<double>> agg(const std::vector<Agg>& aggs, std::size_t offset, std::size_t length) const override {
+            if constexpr (std::is_arithmetic_v<T>) {
+                return series_.view().slice(offset, offset + length).template agg<double>(aggs);
+            }
+            else {
+                return std::nullopt;
+            }
+        }
+
+        void sort_order(std::vector<std::size_t>& order, bool ascending) const override {
+            if (order.empty()) {
+                order = series_.argsort(ascending);
+                return;
+            }
+            // sorting the values in the current order refines it, ties keeping their place
+            const auto by = detail::gather(series_, order).argsort(ascending);
+            std::vector<std::size_t> refined(order.size());
+            detail::gather(series_.exec_policy(), order.data(), by, refined.data());
+            order.swap(refined);
+        }
+
+        SeriesPtr gather(const std::vector<std::size_t>& order) const override {
+            return std::make_shared<WrappedSeries>(detail::gather(series_, order));
+        }
+
+        SeriesPtr gather_or_null(const std::vector<std::size_t>& order) const override {
+            return std::make_shared<WrappedSeries>(detail::gather_or_null(series_, order));
+        }
+
+        SeriesPtr filter(const Bitmap& mask) const override {
+            return std::make_shared<WrappedSeries>(series_.filter(mask));
+        }
+
+        detail::Grouping group() const override {
+            if constexpr (detail::group_key<T>) {
+                return detail::group(series_);
+            }
+            else {
+                throw std::invalid_argument("Column type cannot be a group key");
+            }
+        }
+
+        std::optional<std::vector<Series<double>>> group_agg(const std::vector<Agg>& aggs, const detail::Grouping& groups) const override {
+            if constexpr (std::is_arithmetic_v<T>) {
+                return detail::group_agg(series_, groups, aggs);
+            }
+            else {
+                return std::nullopt;
+            }
+        }
+
+        detail::KeyMatch match(const BaseSeries& probe) const override {
+            const auto* other = dynamic_cast<const WrappedSeries*>(&probe);
+            if (!other) {
+                throw std::invalid_argument("Key columns hold different types");
+            }
+            if constexpr (detail::group_key<T>) {
+                return detail::match_keys(series_, other->series_);
+            }
+            else {
+                throw std::invalid_argument("Column type cannot be a join key");
+            }
+        }
+
         Series<T>& impl() noexcept { return series_; }
         const Series<T>& impl() const noexcept { return series_; }
 
@@ -35,7 +136,8 @@ namespace df {
     };
 
 
-    using SeriesPtr = std::shared_ptr<BaseSeries>;
+    class DataFrameView;
+    class GroupBy;
 
     class DataFrame {
     public:
@@ -87,11 +189,198 @@ namespace df {
             return wrapped->impl();
         }
 
+        template <typename T>
+        const Series<T>& column(const std::string& name) const {
+            auto it = cols_.find(name);
+            if (it == cols_.end()) {
+                throw std::out_of_range(std::string("Column not found: ") + name);
+            }
+
+            const auto* wrapped = dynamic_cast<const WrappedSeries<T>*>(it->second.get());
+            if (!wrapped) {
+                throw std::bad_cast();
+            }
+
+            return wrapped->impl();
+        }
+
+        // Row ranges
+        // Views of the rows share the storage of the frame and are invalidated by changes to its columns
+
+        // A view of the rows [begin, end), clamped to the frame
+        DataFrameView slice(std::size_t begin, std::size_t end) const;
+
+        // A view of the first n rows, or all of them if there are fewer
+        DataFrameView head(std::size_t n = 5) const;
+
+        // A view of the last n rows, or all of them if there are fewer
+        DataFrameView tail(std::size_t n = 5) const;
+
+        // Aggregations
+
+        // Several aggregations of every numeric column, reading each column once
+        // Returns a frame with a double column for each numeric column, in column order, and a row for each
+        // aggregation, in the order requested; null where an aggregation is undefined
+        DataFrame agg(const std::vector<Agg>& aggs) const;
+
+        // Count, mean, standard deviation, minimum and maximum of every numeric column, in rows in that order
+        DataFrame describe() const;
+
+        // Sorting
+
+        // A frame of the rows sorted by the named columns, by the first and then the next among its ties
+        // Each key is sorted as Series::argsort, stably and with NaN and nulls last, and every column is
+        // then gathered through the resulting permutation
+        // Throws std::invalid_argument if no column is named, std::out_of_range if one does not exist
+        DataFrame sort_values(const std::vector<std::string>& by, bool ascending = true) const;
+
+        // Gathering
+
+        // A frame of the rows at the given positions, in order; positions may repeat
+        // The positions are checked once, then each column in turn is gathered through them in parallel
+        // chunks. A column at a time keeps the random reads of each pass within one array, which measured
+        // faster than moving whole rows, or blocks of rows, across every column at once
+        // Throws std::out_of_range if a position is not below length()
+        DataFrame take(const std::vector<std::size_t>& indices) const;
+
+        // Grouping
+
+        // The rows grouped by the values of the named key columns, to aggregate with GroupBy::agg
+        // e.g. df.groupby({"store", "day"}).agg({Agg::SUM, Agg::MEAN})
+        // The groups are found here, once for every aggregation of the result, in order of their first
+        // row; rows with a null key are left out, and NaN keys form one group
+        // Throws std::invalid_argument if no column is named or one cannot be a key, std::out_of_range if
+        // one does not exist
+        GroupBy groupby(std::vector<std::string> keys) const;
+
+        // Joining
+
+        // A frame of the rows of this frame, the left, joined with those of another, the right, where the
+        // named key columns of both hold equal values, as DataFrame::merge in pandas
+        // e.g. sales.merge(stores, {"store"}, Join::LEFT)
+        // An inner or left join has the left columns, then the right columns other than the keys; a name
+        // in both takes the suffix "_x" on the left and "_y" on the right. Its rows follow the left rows,
+        // each repeated for its matches in the order of the right rows. A semi or anti join has the left
+        // rows with a match, or those without one, once each and in order. Null keys match nothing, and
+        // NaN keys match each other
+        // The side with fewer rows is built on and the other probes it in parallel (see join.h), and the
+        // columns are gathered once the rows of the result are known
+        // Throws std::invalid_argument if no key is named, a key has different types in the two frames or
+        // cannot be a key, std::out_of_range if a key is missing from either frame
+        DataFrame merge(const DataFrame& other, const std::vector<std::string>& on, Join how = Join::INNER) const;
+
+        // Filtering
+
+        // A frame of the rows whose bit is set in a mask, in order, such as a comparison of one of its
+        // columns: df.filter(df.column<double>("price") > 100.0)
+        // Each column is filtered as Series::filter
+        // Throws std::invalid_argument if the mask is not the length of the frame
+        DataFrame filter(const Bitmap& mask) const;
+
         friend std::ostream& operator<<(std::ostream& os, const DataFrame& df);
+        friend std::ostream& operator<<(std::ostream& os, const DataFrameView& view);
     
     private:
         std::unordered_map<std::string, SeriesPtr> cols_;
         std::vector<std::string> col_order_;
+
+        // Print the shape, column names and the first 5 of nrows rows starting at row offset
+        void print_rows(std::ostream& os, std::size_t offset, std::size_t nrows) const;
+
+        // agg() over nrows rows starting at row offset
+        DataFrame agg_rows(const std::vector<Agg>& aggs, std::size_t offset, std::size_t nrows) const;
+
+        friend class DataFrameView;
+        friend class GroupBy;
+    };
+
+
+    // A read-only window onto a contiguous range of rows of a DataFrame
+    // Its columns are SeriesViews into the storage of the frame, so taking one copies nothing
+    class DataFrameView {
+    public:
+        DataFrameView(const DataFrame& frame, std::size_t offset, std::size_t length) noexcept
+            : frame_(&frame), offset_(offset), length_(length) {}
+
+        std::size_t length() const noexcept { return length_; }
+        std::size_t width() const { return frame_->width(); }
+
+        std::pair<std::size_t, std::size_t> shape() const {
+            return {length(), width()};
+        }
+
+        // Index of the first row of the view in the frame
+        std::size_t offset() const noexcept { return offset_; }
+
+        // The rows of the named column within the view
+        // Throws std::out_of_range if there is no such column, std::bad_cast if it holds another type
+        template <typename T>
+        SeriesView<const T> column(const std::string& name) const {
+            return frame_->column<T>(name).slice(offset_, offset_ + length_);
+        }
+
+        // A view of the rows [begin, end) of this view, clamped to it
+        DataFrameView slice(std::size_t begin, std::size_t end) const {
+            end = std::min(end, length_);
+            begin = std::min(begin, end);
+            return {*frame_, offset_ + begin, end - begin};
+        }
+
+        // A view of the first n rows, or all of them if there are fewer
+        DataFrameView head(std::size_t n = 5) const {
+            return slice(0, n);
+        }
+
+        // A view of the last n rows, or all of them if there are fewer
+        DataFrameView tail(std::size_t n = 5) const {
+            return slice(length_ - std::min(n, length_), length_);
+        }
+
+        // Several aggregations of every numeric column over the rows of the view, as DataFrame::agg
+        DataFrame agg(const std::vector<Agg>& aggs) const {
+            return frame_->agg_rows(aggs, offset_, length_);
+        }
+
+        // Count, mean, standard deviation, minimum and maximum of every numeric column, as DataFrame::describe
+        DataFrame describe() const;
+
+        friend std::ostream& operator<<(std::ostream& os, const DataFrameView& view);
+
+    private:
+        const DataFrame* frame_;
+        std::size_t offset_;
+        std::size_t length_;
+    };
+
+
+    // The rows of a frame grouped by the values of key columns, as DataFrame::groupby returns them
+    // Refers to the frame, which must outlive it and is not to change while it is in use
+    class GroupBy {
+    public:
+        // Throws as DataFrame::groupby
+        GroupBy(const DataFrame& frame, std::vector<std::string> keys);
+
+        const std::vector<std::string>& keys() const noexcept { return keys_; }
+
+        // Number of groups
+        std::size_t size() const noexcept { return groups_.size(); }
+
+        // Several aggregations of the non-null values of every numeric column other than the keys, per group
+        // Returns a frame with a row per group: the key columns, then a double column named
+        // "<column>_<aggregation>" for each column and aggregation in order, null where undefined
+        DataFrame agg(const std::vector<Agg>& aggs) const;
+
+        // Several aggregations of the named columns per group, as above
+        // Throws std::out_of_range if a column does not exist, std::invalid_argument if one does not hold
+        // numbers
+        DataFrame agg(const std::vector<std::string>& columns, const std::vector<Agg>& aggs) const;
+
+    private:
+        DataFrame aggregate(const std::vector<std::string>& columns, const std::vector<Agg>& aggs, bool named) const;
+
+        const DataFrame* frame_;
+        std::vector<std::string> keys_;
+        detail::Grouping groups_;
     };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include "bitmap.h"
+#include "expr.h"
+#include "kernels.h"
+#include "policy.h"
+#include "scan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Exponentially weighted moving statistics, as returned by Series::ewm() and SeriesView::ewm()
+//
+// The statistics at element i weigh each earlier element by the decay of every step between them, so
+// they follow a recurrence that is serial as written. Carried across a block, though, the decay is a
+// single factor: the state after a block is the state before it scaled by the product of the decays
+// over the block, plus the state of the block alone. That makes them a scan like cumsum(), run by
+// chunked_scan in two passes over one block per thread: each block is reduced on its own, the totals
+// are carried from block to block, and each block is then rescanned from its carry.
+namespace df {
+
+    namespace detail {
+
+        // Elements handed to the recurrence kernel at a time, from a buffer that stays in cache
+        inline constexpr std::size_t EWM_BLOCK{1 << 10};
+
+        // Exponentially weighted sum and total weight of the elements of a block, and the decay across it
+        // A block following a prefix has sum block.sum + block.decay * prefix.sum, and likewise weight
+        template <typename T>
+        struct EwmSum {
+            T decay{1};
+            T sum{};
+            T weight{};
+
+            friend EwmSum merge(const EwmSum& prefix, const EwmSum& block) {
+                return {prefix.decay * block.decay, block.decay * prefix.sum + block.sum, block.decay * prefix.weight + block.weight};
+            }
+        };
+
+        // Exponentially weighted mean and sum of squared deviations M2 of the elements of a block, with
+        // their total and squared weights and the decay across it, as Welford's update and Chan's
+        // formula for weighted elements
+        // The decay across a block is set once the block is done, as a running product would sink
+        // through the denormals on a long block
+        template <typename T>
+        struct EwmMoments {
+            T decay{1};
+            T weight{};
+            T weight_sq{};
+            T mean{};
+            T m2{};
+
+            // Let one step pass, weighing every element so far down by d
+            void pass(T d) {
+                weight *= d;
+                weight_sq *= d * d;
+                m2 *= d;
+            }
+
+            // Add the element x with weight w
+            void push(T x, T w) {
+                const T total = weight + w;
+                const T delta = x - mean;
+                mean += delta * (w / total);
+                m2 += w * delta * (x - mean);
+                weight_sq += w * w;
+                weight = total;
+            }
+
+            // Scale the weights to a total of 1, as the recurrence without adjust does after every
+            // element it takes; the statistics are unchanged, but the next element weighs alpha against 1
+            void normalize() {
+                weight_sq /= weight * weight;
+                m2 /= weight;
+                weight = T{1};
+            }
+
+            friend EwmMoments merge(const EwmMoments& prefix, const EwmMoments& block) {
+                const T before = block.decay * prefix.weight;
+                const T total = before + block.weight;
+                if (total == T{0}) {
+                    return {prefix.decay * block.decay, T{}, T{}, T{}, T{}};
+                }
+                const T delta = block.mean - prefix.mean;
+                return {
+                    prefix.decay * block.decay,
+                    total,
+                    block.decay * block.decay * prefix.weight_sq + block.weight_sq,
+                    prefix.mean + delta * (block.weight / total),
+                    block.decay * prefix.m2 + block.m2 + delta * delta * (before * block.weight / total)
+                };
+            }
+
+            // The weighted variance: M2 over the weight when bias is set, and otherwise corrected by
+            // weight^2 / (weight^2 - weight_sq), which is undefined for a single element
+            std::optional<T> variance(bool bias) const {
+                if (weight == T{0}) {
+                    return std::nullopt;
+                }
+                if (bias) {
+                    return m2 / weight;
+                }
+                const T denominator = weight * weight - weight_sq;
+                if (!(denominator > T{0})) {
+                    return std::nullopt;
+                }
+                return m2 * weight / denominator;
+            }
+        };
+
+    }
+
+    // Exponentially weighted moving statistics of the elements up to and including each element of a view
+    //
+    // With adjust set, as in pandas, the statistics at element i are those of every element j <= i
+    // weighted by (1 - alpha)^(i - j); without it, the mean follows y[i] = (1 - alpha) * y[i - 1] +
+    // alpha * x[i] from the first element, with the variance weighted to match. Across skipped elements
+    // the carried weight decays below 1 and, as in pandas, is reset to 1 by the next element; that no
+    // longer carries across blocks as a single factor, so such a view is scanned in a single pass.
+    // Given times, element j is weighted by (1 - alpha)^(times[i] - times[j]) instead, for irregularly
+    // spaced observations.
+    // Every statistic returns a Series of the same size as the view. Null and NaN elements are skipped
+    // though time still passes over them, as pandas does with ignore_na unset; a null stays null, and
+    // any other element is null until the statistic is defined. Integer elements are aggregated as double.
+    // View_: the read-only SeriesView aggregated
+    template <typename View_>
+    class Ewm {
+    public:
+        using value_type = typename View_::value_type;
+        using result_type = std::conditional_t<std::is_floating_point_v<value_type>, value_type, double>;
+        using series_type = Series<result_type>;
+
+        // Throws std::invalid_argument unless 0 < alpha <= 1
+        // alpha: the smoothing factor, the weight of the newest element when adjust is unset
+        // adjust: whether the weights are normalized over the elements seen so far
+        Ewm(View_ view, double alpha, bool adjust = true)
+            : view_(view), alpha_(static_cast<result_type>(alpha)), adjust_(adjust) {
+            if (!(alpha > 0 && alpha <= 1)) {
+                throw std::invalid_argument("EWM alpha must be in (0, 1]");
+            }
+        }
+
+        // Weights decaying with the time between elements, always adjusted
+        // Throws std::invalid_argument unless 0 < alpha <= 1, or if the times differ in size from the
+        // view, hold nulls or decrease
+        // alpha: the smoothing factor per unit of time
+        // times: a Series or view of the time of each element, in any arithmetic type
+        template <typename Times_>
+        Ewm(View_ view, double alpha, const Times_& times) : Ewm(view, alpha) {
+            const auto t = times.view();
+            if (t.size() != view_.size()) {
+                throw std::invalid_argument("EWM times must be the same size as the series");
+            }
+            if (t.has_nulls()) {
+                throw std::invalid_argument("EWM times must not hold nulls");
+            }
+            for (std::size_t i = 1; i < t.size(); ++i) {
+                if (t[i] < t[i - 1]) {
+                    throw std::invalid_argument("EWM times must not decrease");
+                }
+            }
+            // the decay onto element i over the time since the one before, the first being arbitrary
+            decays_.resize(t.size());
+            const auto keep = std::log1p(-static_cast<double>(alpha_));
+            for_each_chunk(view_.exec_policy(), t.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                for (auto i = std::max<std::size_t>(begin, 1); i < end; ++i) {
+                    decays_[i] = static_cast<result_type>(std::exp(keep * static_cast<double>(t[i] - t[i - 1])));
+                }
+            }, OpCost::HEAVY);
+            if (!decays_.empty()) {
+                decays_[0] = result_type{1};
+            }
+        }
+
+        double alpha() const noexcept { return alpha_; }
+        bool adjust() const noexcept { return adjust_; }
+        bool irregular() const noexcept { return !decays_.empty(); }
+
+        // The weighted mean
+        // With regular spacing, blocks of weighted elements and of their weights each run through
+        // kernels::decayed_cumsum, and the mean is their ratio
+        series_type mean() const {
+            if (renormalizes()) {
+                return moments([](const auto& state) -> std::optional<result_type> {
+                    if (state.weight == result_type{0}) {
+                        return std::nullopt;
+                    }
+                    return state.mean;
+                }, true);
+            }
+            using State = detail::EwmSum<result_type>;
+            const auto n = view_.size();
+            typename series_type::container_type out(n);
+            Bitmap valid(n);
+            const bool nulls = view_.has_nulls();
+            const auto first = first_observed();
+            // scan [begin, end) from carry, writing the means when output is set, and return the state after it
+            const auto run = [&](std::size_t begin, std::size_t end, State carry, bool output) {
+                if (irregular()) {
+                    for (auto i = begin; i < end; ++i) {
+                        const auto x = static_cast<result_type>(view_[i]);
+                        const auto d = decays_[i];
+                        carry.sum *= d;
+                        carry.weight *= d;
+                        if (x == x && (!nulls || view_.is_valid(i))) {
+                            carry.sum += x;
+                            carry.weight += result_type{1};
+                        }
+                        if (output) {
+                            emit(out, valid, i, carry.weight > result_type{0}, carry.sum / carry.weight);
+                        }
+                    }
+                    carry.decay = block_decay(begin, end);
+                    return carry;
+                }
+                const auto decay = result_type{1} - alpha_;
+                result_type sums[detail::EWM_BLOCK];
+                result_type weights[detail::EWM_BLOCK];
+                for (auto b = begin; b < end; b += detail::EWM_BLOCK) {
+                    const auto e = std::min(b + detail::EWM_BLOCK, end);
+                    // skipped elements weigh nothing; without adjust, all but the first weigh alpha
+                    if (!nulls && view_.contiguous() && (adjust_ || e <= first || b > first)) {
+                        const auto* data = view_.data();
+                        const auto weight = adjust_ || e <= first ? result_type{1} : alpha_;
+                        for (auto i = b; i < e; ++i) {
+                            const auto x = static_cast<result_type>(data[i]);
+                            sums[i - b] = x == x ? weight * x : result_type{};
+                            weights[i - b] = x == x ? weight : result_type{};
+                        }
+                    }
+                    else {
+                        for (auto i = b; i < e; ++i) {
+                            const auto x = static_cast<result_type>(view_[i]);
+                            const bool skipped = x != x || (nulls && !view_.is_valid(i));
+                            const auto w = skipped ? result_type{} : (adjust_ || i == first ? result_type{1} : alpha_);
+                            sums[i - b] = skipped ? result_type{} : w * x;
+                            weights[i - b] = w;
+                        }
+                    }
+                    carry.sum = kernels::decayed_cumsum(sums, sums, e - b, decay, carry.sum);
+                    carry.weight = kernels::decayed_cumsum(weights, weights, e - b, decay, carry.weight);
+                    if (!output) {
+                        continue;
+                    }
+                    if (nulls || b <= first) {
+                        for (auto i = b; i < e; ++i) {
+                            emit(out, valid, i, weights[i - b] > result_type{0}, sums[i - b] / weights[i - b]);
+                        }
+                    }
+                    else {
+                        kernels::binary(kernels::BinaryOp::DIV, sums, weights, out.data() + b, e - b);
+                    }
+                }
+                carry.decay = block_decay(begin, end);
+                return carry;
+            };
+            detail::chunked_scan(view_.exec_policy(), n, State{},
+                [](const State& prefix, const State& block) { return merge(prefix, block); },
+                [&](std::size_t begin, std::size_t end) { return run(begin, end, State{}, false); },
+                [&](std::size_t begin, std::size_t end, const State& carry) { run(begin, end, carry, true); });
+            return finish(std::move(out), std::move(valid));
+        }
+
+        // The weighted variance: population by default, as variance(); bias unset applies the
+        // correction for weighted samples that pandas applies by default, and is null for a single element
+        series_type variance(bool bias = true) const {
+            return moments([bias](const auto& state) { return state.variance(bias); }, renormalizes());
+        }
+
+        // The square root of variance()
+        series_type stddev(bool bias = true) const {
+            return moments([bias](const auto& state) -> std::optional<result_type> {
+                const auto v = state.variance(bias);
+                if (!v) {
+                    return std::nullopt;
+                }
+                return std::sqrt(*v);
+            }, renormalizes());
+        }
+
+    private:
+        View_ view_;
+        result_type alpha_;
+        bool adjust_;
+        // the decay onto each element when the spacing is irregular, empty otherwise
+        std::vector<result_type> decays_;
+
+        // Whether element i, of value x, is an observation rather than skipped
+        bool observed(std::size_t i, result_type x) const {
+            return x == x && view_.is_valid(i);
+        }
+
+        // Product of the decays over the elements [begin, end), flushed to zero once it is too small
+        // to weigh anything, rather than sinking through the denormals
+        result_type block_decay(std::size_t begin, std::size_t end) const {
+            if (!irregular()) {
+                return static_cast<result_type>(std::pow(result_type{1} - alpha_, static_cast<result_type>(end - begin)));
+            }
+            result_type decay{1};
+            for (auto i = begin; i < end && decay != result_type{0}; ++i) {
+                decay *= decays_[i];
+                if (decay < std::numeric_limits<result_type>::min()) {
+                    decay = result_type{0};
+                }
+            }
+            return decay;
+        }
+
+        // Whether the weights have to be reset after each element, which matters only without adjust
+        // and once an element has been skipped; until then the carried weight stays at 1
+        bool renormalizes() const {
+            if (adjust_ || irregular()) {
+                return false;
+            }
+            if (view_.has_nulls()) {
+                return true;
+            }
+            if constexpr (std::is_floating_point_v<value_type>) {
+                return reduce_chunks(view_.exec_policy(), view_.size(), DEFAULT_GRAIN, false, std::logical_or<>{}, [&](std::size_t begin, std::size_t end) {
+                    bool nan = false;
+                    for (auto i = begin; i < end; ++i) {
+                        nan |= view_[i] != view_[i];
+                    }
+                    return nan;
+                }, OpCost::LIGHT);
+            }
+            return false;
+        }
+
+        // Position of the first observation, or the size of the view if there is none
+        std::size_t first_observed() const {
+            std::size_t i = 0;
+            while (i < view_.size() && !observed(i, static_cast<result_type>(view_[i]))) {
+                ++i;
+            }
+            return i;
+        }
+
+        // Write the value of element i, null where the input is or where the value is undefined
+        void emit(typename series_type::container_type& out, Bitmap& valid, std::size_t i, bool defined, result_type value) const {
+            if (defined && view_.is_valid(i)) {
+                out[i] = value;
+            }
+            else {
+                out[i] = result_type{};
+                valid.set(i, false);
+            }
+        }
+
+        series_type finish(typename series_type::container_type out, Bitmap valid) const {
+            if (valid.all()) {
+                return series_type(view_.exec_policy(), std::move(out));
+            }
+            series_type series(std::move(out), std::move(valid));
+            series.set_exec_policy(view_.exec_policy());
+            return series;
+        }
+
+        /// Scan the weighted moments and write a statistic of them for every element
+        // statistic: takes the moments up to an element and returns its output, or std::nullopt for a null
+        // normalize: whether the weights are reset after each element, see renormalizes(); the state
+        // then depends on more than the carry into a block, so the scan runs in a single pass
+        template <typename Statistic>
+        series_type moments(const Statistic& statistic, bool normalize) const {
+            using State = detail::EwmMoments<result_type>;
+            const auto n = view_.size();
+            typename series_type::container_type out(n);
+            Bitmap valid(n);
+            const auto first = first_observed();
+            const auto decay = result_type{1} - alpha_;
+            const auto run = [&](std::size_t begin, std::size_t end, State state, bool output) {
+                for (auto i = begin; i < end; ++i) {
+                    const auto x = static_cast<result_type>(view_[i]);
+                    state.pass(irregular() ? decays_[i] : decay);
+                    if (observed(i, x)) {
+                        state.push(x, adjust_ || i == first ? result_type{1} : alpha_);
+                        if (normalize) {
+                            state.normalize();
+                        }
+                    }
+                    if (output) {
+                        const auto value = statistic(state);
+                        emit(out, valid, i, value.has_value(), value.value_or(result_type{}));
+                    }
+                }
+                state.decay = block_decay(begin, end);
+                return state;
+            };
+            detail::chunked_scan(normalize ? ExecPolicy::SEQ : view_.exec_policy(), n, State{},
+                [](const State& prefix, const State& block) { return merge(prefix, block); },
+                [&](std::size_t begin, std::size_t end) { return run(begin, end, State{}, false); },
+                [&](std::size_t begin, std::size_t end, const State& carry) { run(begin, end, carry, true); });
+            return finish(std::move(out), std::move(valid));
+        }
+    };
+
+}
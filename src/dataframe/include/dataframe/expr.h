@@ -0,0 +1,621 @@
+#pragma once
+
+#include "bitmap.h"
+#include "kernels.h"
+#include "memory.h"
+#include "policy.h"
+
+#include <algorithm>
+#include <concepts>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace df {
+
+    template <typename DataType_, typename Allocator_ = AlignedAllocator<DataType_>>
+    class Series;
+
+    template <typename Derived_>
+    class SeriesExpr;
+
+    namespace detail {
+
+        template <typename T>
+        struct is_series : std::false_type {};
+
+        template <typename T, typename A>
+        struct is_series<Series<T, A>> : std::true_type {};
+
+        template <typename T>
+        constexpr bool is_series_v = is_series<std::remove_cvref_t<T>>::value;
+
+        template <typename T>
+        constexpr bool is_expr_v = std::is_base_of_v<SeriesExpr<std::remove_cvref_t<T>>, std::remove_cvref_t<T>>;
+
+    }
+
+    // A Series, or a lazy expression over Series, that yields one element per index
+    template <typename T>
+    concept SeriesOperand = detail::is_series_v<T> || detail::is_expr_v<T>;
+
+    namespace detail {
+
+        // Operands of a binary operator: at least one side must be series-like, the other may be a scalar
+        template <typename Lhs_, typename Rhs_>
+        concept operand_pair = SeriesOperand<Lhs_> || SeriesOperand<Rhs_>;
+
+        // How an operand is held inside an expression node
+        // Named series and expressions are referenced, temporaries are moved into the node so that
+        // they live as long as the expression does, and scalars are always copied
+        template <typename T>
+        using stored_t = std::conditional_t<
+            SeriesOperand<T> && std::is_lvalue_reference_v<T>,
+            const std::remove_reference_t<T>&,
+            std::remove_cvref_t<T>
+        >;
+
+        // Element i of an operand, where a scalar broadcasts to every index
+        template <typename T>
+        decltype(auto) element(const T& operand, std::size_t i) {
+            if constexpr (SeriesOperand<T>) {
+                return operand[i];
+            }
+            else {
+                return (operand);
+            }
+        }
+
+        template <typename T>
+        using element_t = decltype(element(std::declval<const std::remove_cvref_t<T>&>(), std::size_t{}));
+
+        // Result type of a reduction: the requested type, or the element type of the expression
+        // when none is given (which is only known once the derived expression class is complete)
+        template <typename T_, typename Expr_>
+        struct reduce_type {
+            using type = T_;
+        };
+
+        template <typename Expr_>
+        struct reduce_type<void, Expr_> {
+            using type = typename Expr_::value_type;
+        };
+
+        // Cost class of a functor applied by an expression node: the functor's own cost member when it
+        // has one, LIGHT for the arithmetic function objects, and MEDIUM for anything not known to be cheaper
+        template <typename Func_>
+        struct op_cost : std::integral_constant<OpCost, OpCost::MEDIUM> {};
+
+        template <typename Func_> requires requires { { Func_::cost } -> std::convertible_to<OpCost>; }
+        struct op_cost<Func_> : std::integral_constant<OpCost, Func_::cost> {};
+
+        template <>
+        struct op_cost<std::plus<>> : std::integral_constant<OpCost, OpCost::LIGHT> {};
+
+        template <>
+        struct op_cost<std::minus<>> : std::integral_constant<OpCost, OpCost::LIGHT> {};
+
+        template <>
+        struct op_cost<std::multiplies<>> : std::integral_constant<OpCost, OpCost::LIGHT> {};
+
+        template <>
+        struct op_cost<std::negate<>> : std::integral_constant<OpCost, OpCost::LIGHT> {};
+
+        // Cost class of evaluating an operand: that of an expression, and LIGHT for loading a series or scalar
+        template <typename T>
+        constexpr OpCost operand_cost() noexcept {
+            if constexpr (is_expr_v<T>) {
+                return std::remove_cvref_t<T>::cost();
+            }
+            else {
+                return OpCost::LIGHT;
+            }
+        }
+
+        // Elementwise math functions, with the cost class that ExecPolicy::AUTO uses for them and, where
+        // there is one, the kernel that computes them for float and double (see MapExpr::eval_tile)
+
+        struct exp_fn {
+            static constexpr OpCost cost{OpCost::HEAVY};
+            static constexpr kernels::UnaryOp kernel{kernels::UnaryOp::EXP};
+            template <typename T>
+            auto operator()(const T& x) const { return std::exp(x); }
+        };
+
+        struct log_fn {
+            static constexpr OpCost cost{OpCost::HEAVY};
+            static constexpr kernels::UnaryOp kernel{kernels::UnaryOp::LOG};
+            template <typename T>
+            auto operator()(const T& x) const { return std::log(x); }
+        };
+
+        struct sqrt_fn {
+            static constexpr OpCost cost{OpCost::MEDIUM};
+            static constexpr kernels::UnaryOp kernel{kernels::UnaryOp::SQRT};
+            template <typename T>
+            auto operator()(const T& x) const { return std::sqrt(x); }
+        };
+
+        struct abs_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            static constexpr kernels::UnaryOp kernel{kernels::UnaryOp::ABS};
+            template <typename T>
+            auto operator()(const T& x) const { return std::abs(x); }
+        };
+
+        struct signum_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            template <typename T>
+            auto operator()(const T& x) const { return (x > 0) - (x < 0); }
+        };
+
+        struct pow_fn {
+            static constexpr OpCost cost{OpCost::HEAVY};
+            template <typename T, typename U>
+            auto operator()(const T& x, const U& y) const { return std::pow(x, y); }
+        };
+
+        // The policy tag of an operand: that of a view or expression, and Dynamic for a series or scalar
+        template <typename T>
+        struct policy_of {
+            using type = exec::Dynamic;
+        };
+
+        template <typename T> requires requires { typename std::remove_cvref_t<T>::policy_type; }
+        struct policy_of<T> {
+            using type = typename std::remove_cvref_t<T>::policy_type;
+        };
+
+        // The first compile-time policy among the operands of an expression, or Dynamic if none has one
+        template <typename... Args_>
+        struct common_policy {
+            using type = exec::Dynamic;
+        };
+
+        template <typename Arg_, typename... Rest_>
+        struct common_policy<Arg_, Rest_...> {
+            using type = std::conditional_t<
+                StaticPolicy<typename policy_of<Arg_>::type>,
+                typename policy_of<Arg_>::type,
+                typename common_policy<Rest_...>::type
+            >;
+        };
+
+        // Whether element i of an operand reads its series at indices other than i, as a shift does
+        // The result of such an expression cannot be written into the buffer of a series it reads
+        template <typename T>
+        struct reads_across : std::false_type {};
+
+        template <typename T> requires requires { { std::remove_cvref_t<T>::reads_across } -> std::convertible_to<bool>; }
+        struct reads_across<T> : std::bool_constant<std::remove_cvref_t<T>::reads_across> {};
+
+        template <typename T>
+        constexpr bool reads_across_v = reads_across<T>::value;
+
+        // Elements of an expression that reads across positions or vectorizes evaluated at a time, see
+        // SeriesExpr::eval_to
+        inline constexpr std::size_t STAGING_TILE{256};
+
+        // Whether a functor has a kernel that computes it over an array (see kernels.h)
+        template <typename Func_>
+        constexpr bool has_kernel_v = requires { { Func_::kernel } -> std::convertible_to<kernels::UnaryOp>; };
+
+        // Whether an operand holds a node that runs a kernel, so that it is best evaluated a tile at a time
+        template <typename T>
+        struct vectorizes : std::false_type {};
+
+        template <typename T> requires requires { { std::remove_cvref_t<T>::vectorizes } -> std::convertible_to<bool>; }
+        struct vectorizes<T> : std::bool_constant<std::remove_cvref_t<T>::vectorizes> {};
+
+        template <typename T>
+        constexpr bool vectorizes_v = vectorizes<T>::value;
+
+        // Write the elements [begin, begin + n) of an operand to out, through the operand's own
+        // eval_tile when it has one and one element at a time otherwise
+        template <typename T, typename U>
+        void eval_tile(const T& operand, std::size_t begin, std::size_t n, U* out) {
+            if constexpr (requires { operand.eval_tile(begin, n, out); }) {
+                operand.eval_tile(begin, n, out);
+            }
+            else {
+                for (std::size_t j = 0; j < n; ++j) {
+                    out[j] = operand[begin + j];
+                }
+            }
+        }
+
+        // The elements [begin, begin + n) of an operand
+        template <typename T>
+        struct TileRange {
+            const T& operand;
+            std::size_t begin;
+            std::size_t n;
+        };
+
+        // The elements of a TileRange, as read by a node evaluating a tile
+        // An operand that vectorizes is evaluated into a tile of its own up front; any other is read in place
+        template <typename T>
+        struct Staged {
+            const T& operand;
+            std::size_t begin;
+
+            explicit Staged(const TileRange<T>& range) noexcept : operand(range.operand), begin(range.begin) {}
+
+            decltype(auto) operator[](std::size_t j) const {
+                if constexpr (SeriesOperand<T>) {
+                    return operand[begin + j];
+                }
+                else {
+                    return (operand);
+                }
+            }
+        };
+
+        template <typename T> requires vectorizes_v<T>
+        struct Staged<T> {
+            alignas(CACHE_LINE_SIZE) typename T::value_type tile[STAGING_TILE];
+
+            explicit Staged(const TileRange<T>& range) { range.operand.eval_tile(range.begin, range.n, tile); }
+
+            const auto& operator[](std::size_t j) const { return tile[j]; }
+        };
+
+        // Ratio of x to y less one, in double for integers: the relative change from y to x
+        struct pct_change_fn {
+            static constexpr OpCost cost{OpCost::MEDIUM};
+            template <typename T>
+            auto operator()(const T& x, const T& y) const {
+                using R = std::conditional_t<std::is_floating_point_v<T>, T, double>;
+                return static_cast<R>(x) / static_cast<R>(y) - R{1};
+            }
+        };
+
+        // Intersect the validity of an operand into out, where scalars are always valid
+        template <typename T>
+        void collect_validity(const T& operand, std::optional<Bitmap>& out) {
+            if constexpr (is_series_v<T>) {
+                if (operand.validity()) {
+                    out = intersect(out, operand.validity());
+                }
+            }
+            else if constexpr (is_expr_v<T>) {
+                operand.collect_validity(out);
+            }
+        }
+
+        // A temporary Series of exactly the type Target_ held by value in an operand, or nullptr
+        // Its buffer can receive the result of the expression, since every element is computed from
+        // the operands at the same index
+        template <typename Target_, typename T>
+        Target_* owned_series(T& operand) noexcept {
+            if constexpr (std::is_same_v<T, Target_>) {
+                return &operand;
+            }
+            else if constexpr (requires { { operand.template owned_series<Target_>() } -> std::same_as<Target_*>; }) {
+                return operand.template owned_series<Target_>();
+            }
+            else {
+                return nullptr;
+            }
+        }
+
+    }
+
+    // Base class of all lazy expression nodes
+    // Derived classes provide size(), exec_policy(), policy(), cost() and operator[](i); the base provides
+    // evaluation, on the compile-time policy tag returned by policy() when the expression has one
+    // Nothing is computed until the expression is assigned to a Series or reduced, at which point the
+    // whole tree is evaluated in a single pass over the index space
+    template <typename Derived_>
+    class SeriesExpr {
+    public:
+        const Derived_& derived() const noexcept { return static_cast<const Derived_&>(*this); }
+
+        // Materialize the expression into a new Series
+        auto eval() const & {
+            return Series<typename Derived_::value_type>(derived());
+        }
+
+        // Materialize the expression, reusing the buffer of a temporary operand when one has the result type
+        auto eval() && {
+            return Series<typename Derived_::value_type>(std::move(static_cast<Derived_&>(*this)));
+        }
+
+        // Validity of the result: an element is null when it is null in any series operand
+        // Returns std::nullopt when no operand has nulls
+        std::optional<Bitmap> validity() const {
+            std::optional<Bitmap> out;
+            derived().collect_validity(out);
+            return out;
+        }
+
+        // Write every element of the expression to an output range of at least size() elements
+        // Null elements are computed like any other and hold unspecified values
+        template <typename OutputIt_>
+        void eval_to(OutputIt_ out) const {
+            using value_type = typename Derived_::value_type;
+            const auto& expr = derived();
+            if constexpr ((detail::reads_across_v<Derived_> || detail::vectorizes_v<Derived_>) && std::is_trivially_copyable_v<value_type>) {
+                // Evaluated a tile at a time, so that nodes with a kernel run it over the tile (see
+                // MapExpr::eval_tile). An expression that reads across positions is also written through
+                // a tile in L1: an output on the same 4 KiB offset as a series it reads, as every huge page
+                // aligned buffer is, would have each load of source[i - k] wait on the store just made to
+                // out[i - k]. Otherwise the tile is the output itself when it is an array of the same type
+                constexpr std::size_t TILE{detail::STAGING_TILE};
+                constexpr bool direct = !detail::reads_across_v<Derived_> && std::contiguous_iterator<OutputIt_> &&
+                    std::is_same_v<std::iter_value_t<OutputIt_>, value_type>;
+                for_each_partition(expr.policy(), expr.size(), expr.cost(), [&](auto& exec_, std::size_t begin, std::size_t end) {
+                    std::for_each(
+                        exec_,
+                        detail::IndexIterator{0}, detail::IndexIterator{(end - begin + TILE - 1) / TILE},
+                        [&](std::size_t t) {
+                            const auto first = begin + t * TILE;
+                            const auto last = std::min(first + TILE, end);
+                            if constexpr (direct) {
+                                detail::eval_tile(expr, first, last - first, std::to_address(out) + first);
+                            }
+                            else {
+                                alignas(CACHE_LINE_SIZE) value_type tile[TILE];
+                                detail::eval_tile(expr, first, last - first, tile);
+                                std::copy(tile, tile + (last - first), std::next(out, static_cast<std::ptrdiff_t>(first)));
+                            }
+                        }
+                    );
+                });
+                return;
+            }
+            for_each_partition(expr.policy(), expr.size(), expr.cost(), [&](auto& exec_, std::size_t begin, std::size_t end) {
+                std::transform(
+                    exec_,
+                    detail::IndexIterator{begin}, detail::IndexIterator{end},
+                    std::next(out, static_cast<std::ptrdiff_t>(begin)),
+                    [&expr](std::size_t i) { return expr[i]; }
+                );
+            });
+        }
+
+        // Sum of all non-null elements, computed without materializing the expression
+        // Returns std::nullopt if there are none
+        template <typename T_ = void>
+        auto sum() const {
+            return sum_count<result_t<T_>>().first;
+        }
+
+        // Mean of all non-null elements, computed without materializing the expression
+        // Returns std::nullopt if there are none
+        template <typename T_ = void>
+        auto mean() const {
+            using T = result_t<T_>;
+            const auto [s, count] = sum_count<T>();
+            if (!s) {
+                return std::optional<T>{};
+            }
+            return std::optional<T>{*s / static_cast<T>(count)};
+        }
+
+    protected:
+        SeriesExpr() = default;
+
+    private:
+        template <typename T_>
+        using result_t = typename detail::reduce_type<T_, Derived_>::type;
+
+        // Sum and number of the non-null elements
+        template <typename T>
+        std::pair<std::optional<T>, std::size_t> sum_count() const {
+            const auto& expr = derived();
+            const auto valid = validity();
+            const auto count = valid ? valid->count() : expr.size();
+            if (count == 0) {
+                return {std::nullopt, 0};
+            }
+            const auto reduce = [&](const auto& term) {
+                return reduce_partitions(expr.policy(), expr.size(), expr.cost(), T{}, std::plus<>{}, [&](auto& exec_, std::size_t begin, std::size_t end) {
+                    return std::transform_reduce(
+                        exec_,
+                        detail::IndexIterator{begin}, detail::IndexIterator{end},
+                        T{},
+                        std::plus<>{},
+                        term
+                    );
+                });
+            };
+            if (valid) {
+                return {reduce([&](std::size_t i) { return (*valid)[i] ? static_cast<T>(expr[i]) : T{}; }), count};
+            }
+            return {reduce([&expr](std::size_t i) { return static_cast<T>(expr[i]); }), count};
+        }
+    };
+
+    // Lazy elementwise application of a functor to one or more operands
+    // element i is func(args[i]...), with scalar operands broadcast to every index
+    // The expression runs on the first compile-time policy among its operands, if any, and otherwise on
+    // the runtime policy of its first series-like operand
+    template <typename Func_, typename... Args_>
+    class MapExpr : public SeriesExpr<MapExpr<Func_, Args_...>> {
+    public:
+        using value_type = std::remove_cvref_t<std::invoke_result_t<const Func_&, detail::element_t<Args_>...>>;
+        using policy_type = typename detail::common_policy<Args_...>::type;
+        static constexpr bool reads_across{(detail::reads_across_v<Args_> || ...)};
+
+        // Whether this node runs a kernel over its single operand, of the same float or double type
+        static constexpr bool kernel_node{[] {
+            if constexpr (sizeof...(Args_) == 1 && detail::has_kernel_v<Func_>) {
+                return kernels::supported_v<value_type> && (std::is_same_v<std::remove_cvref_t<detail::element_t<Args_>>, value_type> && ...);
+            }
+            return false;
+        }()};
+        static constexpr bool vectorizes{kernel_node || (detail::vectorizes_v<Args_> || ...)};
+
+        template <typename F, typename... A>
+        explicit MapExpr(F&& func, A&&... args)
+            : func_(std::forward<F>(func)), args_(std::forward<A>(args)...) {
+            bool first = true;
+            std::apply([&](const auto&... arg) { (bind(arg, first), ...); }, args_);
+        }
+
+        value_type operator[](std::size_t i) const {
+            return std::apply(
+                [&](const auto&... arg) { return func_(detail::element(arg, i)...); },
+                args_
+            );
+        }
+
+        // Write the elements [begin, begin + n) to out, for n up to detail::STAGING_TILE
+        // A kernel node computes its operand into out, or reads it straight from a series, and runs its
+        // kernel over the tile; any other node stages the operands that vectorize into tiles of their
+        // own and applies its functor to them element by element
+        template <typename T>
+        void eval_tile(std::size_t begin, std::size_t n, T* out) const {
+            if constexpr (kernel_node && std::is_same_v<T, value_type>) {
+                const auto& arg = std::get<0>(args_);
+                if constexpr (detail::is_series_v<decltype(arg)>) {
+                    kernels::unary(Func_::kernel, std::to_address(arg.begin()) + begin, out, n);
+                }
+                else {
+                    detail::eval_tile(arg, begin, n, out);
+                    kernels::unary(Func_::kernel, out, out, n);
+                }
+            }
+            else {
+                // each element is built in place from its range, so a staged tile is never copied
+                using Tiles = std::tuple<detail::Staged<std::remove_cvref_t<Args_>>...>;
+                const Tiles staged = std::apply(
+                    [&](const auto&... arg) { return Tiles(detail::TileRange<std::remove_cvref_t<Args_>>{arg, begin, n}...); },
+                    args_
+                );
+                for (std::size_t j = 0; j < n; ++j) {
+                    out[j] = std::apply([&](const auto&... arg) { return func_(arg[j]...); }, staged);
+                }
+            }
+        }
+
+        std::size_t size() const noexcept { return size_; }
+        ExecPolicy exec_policy() const noexcept { return detail::policy_value(exec_); }
+        detail::policy_holder_t<policy_type> policy() const noexcept { return exec_; }
+
+        // The costliest functor in the expression tree
+        static constexpr OpCost cost() noexcept {
+            return std::max({detail::op_cost<Func_>::value, detail::operand_cost<Args_>()...});
+        }
+
+        void collect_validity(std::optional<Bitmap>& out) const {
+            std::apply([&](const auto&... arg) { (detail::collect_validity(arg, out), ...); }, args_);
+        }
+
+        // The first temporary Series of type Target_ owned by this expression or a sub-expression it owns
+        // None when an operand reads across indices, as it may read one that was already overwritten
+        template <typename Target_>
+        Target_* owned_series() noexcept {
+            if constexpr (reads_across) {
+                return nullptr;
+            }
+            Target_* found = nullptr;
+            std::apply([&](auto&... arg) { ((found = found ? found : detail::owned_series<Target_>(arg)), ...); }, args_);
+            return found;
+        }
+
+    private:
+        Func_ func_;
+        std::tuple<Args_...> args_;
+        std::size_t size_{0};
+        [[no_unique_address]] detail::policy_holder_t<policy_type> exec_{};
+
+        // Take the size and execution policy from the first series-like operand
+        // and check that all series-like operands agree on the size
+        template <typename T>
+        void bind(const T& arg, bool& first) {
+            if constexpr (SeriesOperand<T>) {
+                if (first) {
+                    size_ = arg.size();
+                    if constexpr (std::is_same_v<policy_type, exec::Dynamic>) {
+                        exec_ = arg.exec_policy();
+                    }
+                    first = false;
+                }
+                else if (arg.size() != size_) {
+                    throw std::invalid_argument("Series sizes do not match for dyadic operation");
+                }
+            }
+        }
+    };
+
+    // Build a lazy expression that applies func elementwise across the operands
+    template <typename Func_, typename... Args_>
+    auto map(Func_&& func, Args_&&... args) {
+        return MapExpr<std::decay_t<Func_>, detail::stored_t<Args_>...>(
+            std::forward<Func_>(func), std::forward<Args_>(args)...
+        );
+    }
+
+    // Arithmetic operators build lazy expressions, which reference named operands and own temporary
+    // ones; see the Operators section of Series for when to hold the result as a Series instead
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    auto operator+(Lhs_&& lhs, Rhs_&& rhs) {
+        return map(std::plus<>{}, std::forward<Lhs_>(lhs), std::forward<Rhs_>(rhs));
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    auto operator-(Lhs_&& lhs, Rhs_&& rhs) {
+        return map(std::minus<>{}, std::forward<Lhs_>(lhs), std::forward<Rhs_>(rhs));
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    auto operator*(Lhs_&& lhs, Rhs_&& rhs) {
+        return map(std::multiplies<>{}, std::forward<Lhs_>(lhs), std::forward<Rhs_>(rhs));
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    auto operator/(Lhs_&& lhs, Rhs_&& rhs) {
+        return map(std::divides<>{}, std::forward<Lhs_>(lhs), std::forward<Rhs_>(rhs));
+    }
+
+    template <SeriesOperand E_>
+    auto operator-(E_&& e) {
+        return map(std::negate<>{}, std::forward<E_>(e));
+    }
+
+    // Elementwise math functions build lazy expressions
+    // These are the out-of-place counterparts of the in-place Series members of the same name
+
+    template <SeriesOperand E_>
+    auto exp(E_&& e) {
+        return map(detail::exp_fn{}, std::forward<E_>(e));
+    }
+
+    template <SeriesOperand E_>
+    auto log(E_&& e) {
+        return map(detail::log_fn{}, std::forward<E_>(e));
+    }
+
+    template <SeriesOperand E_>
+    auto sqrt(E_&& e) {
+        return map(detail::sqrt_fn{}, std::forward<E_>(e));
+    }
+
+    template <SeriesOperand E_>
+    auto abs(E_&& e) {
+        return map(detail::abs_fn{}, std::forward<E_>(e));
+    }
+
+    template <SeriesOperand E_>
+    auto signum(E_&& e) {
+        return map(detail::signum_fn{}, std::forward<E_>(e));
+    }
+
+    template <typename Base_, typename Exp_> requires detail::operand_pair<Base_, Exp_>
+    auto pow(Base_&& base, Exp_&& exponent) {
+        return map(detail::pow_fn{}, std::forward<Base_>(base), std::forward<Exp_>(exponent));
+    }
+
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include "bitmap.h"
+#include "expr.h"
+#include "kernels.h"
+#include "policy.h"
+#include "scan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+
+// Comparisons into boolean masks, and filtering by them
+//
+// Comparing a series, view or expression with another or with a scalar is evaluated at once into a
+// Bitmap with one bit per element, set where the comparison holds and neither operand is null. Float
+// and double operands laid out contiguously are compared a vector at a time by the compare kernel, and
+// anything else one element at a time into the same words.
+//
+// Filtering keeps the elements whose bit is set, in order, in two passes over one block of the mask per
+// task: the first counts the set bits of every block, the counts are scanned into the position each
+// block writes at, and the second copies the selected elements there. Contiguous float and double
+// elements are packed by the compress kernel; other types copy whole words of set bits at once and the
+// rest bit by bit.
+namespace df {
+
+    namespace detail {
+
+        // Comparison functors, with the kernel operation of each and the operation that gives the same
+        // result with the operands swapped
+
+        struct less_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            static constexpr kernels::CompareOp op{kernels::CompareOp::LT};
+            static constexpr kernels::CompareOp swapped{kernels::CompareOp::GT};
+            template <typename T, typename U>
+            bool operator()(const T& x, const U& y) const { return x < y; }
+        };
+
+        struct less_equal_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            static constexpr kernels::CompareOp op{kernels::CompareOp::LE};
+            static constexpr kernels::CompareOp swapped{kernels::CompareOp::GE};
+            template <typename T, typename U>
+            bool operator()(const T& x, const U& y) const { return x <= y; }
+        };
+
+        struct greater_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            static constexpr kernels::CompareOp op{kernels::CompareOp::GT};
+            static constexpr kernels::CompareOp swapped{kernels::CompareOp::LT};
+            template <typename T, typename U>
+            bool operator()(const T& x, const U& y) const { return x > y; }
+        };
+
+        struct greater_equal_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            static constexpr kernels::CompareOp op{kernels::CompareOp::GE};
+            static constexpr kernels::CompareOp swapped{kernels::CompareOp::LE};
+            template <typename T, typename U>
+            bool operator()(const T& x, const U& y) const { return x >= y; }
+        };
+
+        struct equal_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            static constexpr kernels::CompareOp op{kernels::CompareOp::EQ};
+            static constexpr kernels::CompareOp swapped{kernels::CompareOp::EQ};
+            template <typename T, typename U>
+            bool operator()(const T& x, const U& y) const { return x == y; }
+        };
+
+        struct not_equal_fn {
+            static constexpr OpCost cost{OpCost::LIGHT};
+            static constexpr kernels::CompareOp op{kernels::CompareOp::NE};
+            static constexpr kernels::CompareOp swapped{kernels::CompareOp::NE};
+            template <typename T, typename U>
+            bool operator()(const T& x, const U& y) const { return x != y; }
+        };
+
+        // The first element of a series, or of a view with unit stride, and nullptr for any other operand
+        template <typename T>
+        auto contiguous_data(const T& operand) noexcept {
+            using E = std::remove_cvref_t<element_t<T>>;
+            if constexpr (is_series_v<T>) {
+                return static_cast<const E*>(std::to_address(operand.begin()));
+            }
+            else if constexpr (requires { { operand.contiguous() } -> std::convertible_to<bool>; operand.data(); }) {
+                return operand.contiguous() ? static_cast<const E*>(operand.data()) : nullptr;
+            }
+            else {
+                return static_cast<const E*>(nullptr);
+            }
+        }
+
+        // Whether a scalar compares with elements of type T exactly as after converting it to T
+        template <typename S, typename T>
+        constexpr bool kernel_compare_scalar_v = std::is_same_v<S, T> || std::is_integral_v<S>;
+
+        /// Compare two operands elementwise into a mask
+        // func: the comparison functor, one of those above
+        // lhs, rhs: series-like operands of equal size, or one of them a scalar
+        template <typename Func_, typename Lhs_, typename Rhs_>
+        Bitmap compare(Func_ func, const Lhs_& lhs, const Rhs_& rhs) {
+            using L = std::remove_cvref_t<element_t<Lhs_>>;
+            using R = std::remove_cvref_t<element_t<Rhs_>>;
+            const auto expr = map(func, lhs, rhs);
+            const auto n = expr.size();
+            Bitmap mask(n, false);
+            auto* words = mask.words();
+
+            // a + begin compared with b + begin, or with b where it is a scalar, by the kernel
+            const auto kernel = [&](kernels::CompareOp op, const auto* a, const auto& b, std::size_t begin, std::size_t end) {
+                if constexpr (std::is_pointer_v<std::remove_cvref_t<decltype(b)>>) {
+                    kernels::compare(op, a + begin, b + begin, words + begin / Bitmap::WORD_BITS, end - begin);
+                }
+                else {
+                    kernels::compare(op, a + begin, b, words + begin / Bitmap::WORD_BITS, end - begin);
+                }
+            };
+            const auto compare_block = [&](std::size_t begin, std::size_t end) {
+                if constexpr (SeriesOperand<Lhs_> && SeriesOperand<Rhs_> && kernels::supported_v<L> && std::is_same_v<L, R>) {
+                    const auto* a = contiguous_data(lhs);
+                    const auto* b = contiguous_data(rhs);
+                    if (a && b) {
+                        return kernel(Func_::op, a, b, begin, end);
+                    }
+                }
+                else if constexpr (SeriesOperand<Lhs_> && !SeriesOperand<Rhs_> && kernels::supported_v<L> && kernel_compare_scalar_v<Rhs_, L>) {
+                    if (const auto* a = contiguous_data(lhs)) {
+                        return kernel(Func_::op, a, static_cast<L>(rhs), begin, end);
+                    }
+                }
+                else if constexpr (!SeriesOperand<Lhs_> && SeriesOperand<Rhs_> && kernels::supported_v<R> && kernel_compare_scalar_v<Lhs_, R>) {
+                    if (const auto* b = contiguous_data(rhs)) {
+                        return kernel(Func_::swapped, b, static_cast<R>(lhs), begin, end);
+                    }
+                }
+                for (auto base = begin; base < end; base += Bitmap::WORD_BITS) {
+                    const auto m = std::min(Bitmap::WORD_BITS, end - base);
+                    Bitmap::word_type word = 0;
+                    for (std::size_t i = 0; i < m; ++i) {
+                        word |= Bitmap::word_type{static_cast<bool>(expr[base + i])} << i;
+                    }
+                    words[base / Bitmap::WORD_BITS] = word;
+                }
+            };
+            // chunks of whole words, so that no two tasks write the same one
+            for_each_chunk(expr.policy(), n, DEFAULT_GRAIN, compare_block, expr.cost());
+
+            if (const auto valid = expr.validity()) {
+                mask &= *valid;
+            }
+            return mask;
+        }
+
+        /// Copy the elements of a view in [begin, end) whose bit is set in a mask to out, in order
+        // Whole words of set bits are copied at once and the others visited bit by bit
+        template <typename View_, typename T>
+        void compress(const View_& view, const Bitmap& mask, std::size_t begin, std::size_t end, T* out) {
+            mask.for_each_set(
+                begin, end,
+                [&](std::size_t first, std::size_t last) {
+                    if (view.contiguous()) {
+                        out = std::copy(view.data() + first, view.data() + last, out);
+                        return;
+                    }
+                    for (auto i = first; i < last; ++i) {
+                        *out++ = view[i];
+                    }
+                },
+                [&](std::size_t base, Bitmap::word_type bits) {
+                    for (; bits != 0; bits &= bits - 1) {
+                        *out++ = view[base + static_cast<std::size_t>(std::countr_zero(bits))];
+                    }
+                }
+            );
+        }
+
+        /// The bits of a bitmap whose bit is set in a mask, in order
+        // count: the number of bits set in the mask
+        // Each block writes the words of the result that it fills alone, and merges into the first and
+        // last, which it may share with its neighbours, atomically. Words where every selected bit is set
+        // are appended whole
+        inline Bitmap compress(ExecPolicy policy, const Bitmap& src, const Bitmap& mask, std::size_t count) {
+            using word_type = Bitmap::word_type;
+            constexpr auto WORD_BITS = Bitmap::WORD_BITS;
+            Bitmap out(count, false);
+            auto* dst = out.words();
+            chunked_scan(
+                policy, mask.size(), std::size_t{0}, std::plus<>{},
+                [&](std::size_t begin, std::size_t end) { return mask.count(begin, end); },
+                [&](std::size_t begin, std::size_t end, std::size_t offset) {
+                    const auto first = offset / WORD_BITS;
+                    auto pos = offset;
+                    word_type pending = 0;
+                    const auto flush = [&](std::size_t w, bool shared) {
+                        if (shared) {
+                            std::atomic_ref<word_type>(dst[w]).fetch_or(pending, std::memory_order_relaxed);
+                        }
+                        else {
+                            dst[w] = pending;
+                        }
+                    };
+                    // append the low k bits of bits
+                    const auto append = [&](word_type bits, std::size_t k) {
+                        const auto shift = pos % WORD_BITS;
+                        pending |= bits << shift;
+                        pos += k;
+                        if (shift + k >= WORD_BITS) {
+                            flush(pos / WORD_BITS - 1, pos / WORD_BITS - 1 == first);
+                            pending = shift == 0 ? 0 : bits >> (WORD_BITS - shift);
+                        }
+                    };
+                    const auto* selected = mask.words();
+                    const auto* valid = src.words();
+                    for (auto w = begin / WORD_BITS; w * WORD_BITS < end; ++w) {
+                        const auto bits = selected[w];
+                        if ((valid[w] & bits) == bits) {
+                            const auto k = static_cast<std::size_t>(std::popcount(bits));
+                            if (k != 0) {
+                                append(k == WORD_BITS ? ~word_type{0} : (word_type{1} << k) - 1, k);
+                            }
+                            continue;
+                        }
+                        for (auto rest = bits; rest != 0; rest &= rest - 1) {
+                            append((valid[w] >> std::countr_zero(rest)) & 1, 1);
+                        }
+                    }
+                    if (pos % WORD_BITS != 0) {
+                        flush(pos / WORD_BITS, true);
+                    }
+                }
+            );
+            return out;
+        }
+
+        /// The elements of a view whose bit is set in a mask, in order, as a series under its policy
+        // Throws std::invalid_argument if the mask is not the size of the view
+        template <typename View_>
+        auto filter(const View_& view, const Bitmap& mask) {
+            using T = std::remove_const_t<typename View_::value_type>;
+            if (mask.size() != view.size()) {
+                throw std::invalid_argument("Mask size does not match the series");
+            }
+            const auto count = mask.count();
+            typename Series<T>::container_type data(count);
+            auto* out = data.data();
+            chunked_scan(
+                view.exec_policy(), view.size(), std::size_t{0}, std::plus<>{},
+                [&](std::size_t begin, std::size_t end) { return mask.count(begin, end); },
+                [&](std::size_t begin, std::size_t end, std::size_t offset) {
+                    if constexpr (kernels::supported_v<T>) {
+                        if (view.contiguous()) {
+                            kernels::compress(view.data() + begin, mask.words() + begin / Bitmap::WORD_BITS, end - begin, out + offset);
+                            return;
+                        }
+                    }
+                    compress(view, mask, begin, end, out + offset);
+                }
+            );
+            Series<T> result(view.exec_policy(), std::move(data));
+            if (view.has_nulls()) {
+                std::optional<Bitmap> valid;
+                view.collect_validity(valid);
+                result.set_validity(compress(view.exec_policy(), *valid, mask, count));
+            }
+            return result;
+        }
+
+    }
+
+    // Comparison operators evaluate at once into a mask, set where the comparison holds and neither
+    // operand is null (see above); as with the operators on numbers, comparing with NaN is false
+    // except for !=
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    Bitmap operator<(const Lhs_& lhs, const Rhs_& rhs) {
+        return detail::compare(detail::less_fn{}, lhs, rhs);
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    Bitmap operator<=(const Lhs_& lhs, const Rhs_& rhs) {
+        return detail::compare(detail::less_equal_fn{}, lhs, rhs);
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    Bitmap operator>(const Lhs_& lhs, const Rhs_& rhs) {
+        return detail::compare(detail::greater_fn{}, lhs, rhs);
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    Bitmap operator>=(const Lhs_& lhs, const Rhs_& rhs) {
+        return detail::compare(detail::greater_equal_fn{}, lhs, rhs);
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    Bitmap operator==(const Lhs_& lhs, const Rhs_& rhs) {
+        return detail::compare(detail::equal_fn{}, lhs, rhs);
+    }
+
+    template <typename Lhs_, typename Rhs_> requires detail::operand_pair<Lhs_, Rhs_>
+    Bitmap operator!=(const Lhs_& lhs, const Rhs_& rhs) {
+        return detail::compare(detail::not_equal_fn{}, lhs, rhs);
+    }
+
+}
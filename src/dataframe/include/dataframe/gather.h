@@ -0,0 +1,210 @@
+#pragma once
+
+#include "bitmap.h"
+#include "expr.h"
+#include "policy.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+
+// Moving elements through an index vector: gathering for take, sorting, filtering and joining frames, and
+// scattering for Series::scatter
+//
+// Both run in parallel over chunks of the index. The random reads of a gather are independent of one
+// another, so the core already keeps as many of them in flight as it can track; prefetching ahead of
+// them, or reading with vector gather instructions, was measured to gain nothing and is not done. The
+// random writes of a scatter are different: every store holds its place in the store buffer until its
+// line has been read for ownership, which stalls the loop once the buffer fills, so each iteration
+// prefetches the line written SCATTER_PREFETCH positions later for writing.
+namespace df::detail {
+
+    // How many positions ahead of the one being written a scatter prefetches
+    inline constexpr std::size_t SCATTER_PREFETCH{16};
+
+    // A position that stands for no row, such as the right row of a left join without a match
+    inline constexpr std::size_t NO_ROW{std::numeric_limits<std::size_t>::max()};
+
+    // Throw std::out_of_range unless every position is below size
+    inline void check_indices(ExecPolicy policy, const std::vector<std::size_t>& indices, std::size_t size) {
+        const bool beyond = reduce_chunks(policy, indices.size(), DEFAULT_GRAIN, false, std::logical_or<>{}, [&](std::size_t begin, std::size_t end) {
+            bool out = false;
+            for (auto i = begin; i < end; ++i) {
+                out |= indices[i] >= size;
+            }
+            return out;
+        }, OpCost::LIGHT);
+        if (beyond) {
+            throw std::out_of_range("Index out of range");
+        }
+    }
+
+    /// Copy the elements at the given positions, in order
+    // policy: the policy the copy runs with
+    // src: the elements
+    // order: positions into src
+    // out: where the result is written, with room for order.size() elements
+    template <typename T>
+    void gather(ExecPolicy policy, const T* src, const std::vector<std::size_t>& order, T* out) {
+        for_each_chunk(policy, order.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                out[i] = src[order[i]];
+            }
+        }, OpCost::LIGHT);
+    }
+
+    // The bits of a bitmap at the given positions, in order
+    // Each task owns whole words of the result
+    inline Bitmap gather(ExecPolicy policy, const Bitmap& src, const std::vector<std::size_t>& order) {
+        Bitmap out(order.size(), false);
+        for_each_chunk(policy, order.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                if (src[order[i]]) {
+                    out.set(i);
+                }
+            }
+        }, OpCost::LIGHT);
+        return out;
+    }
+
+    // A series of the elements and validity of another at the given positions, in order, under its policy
+    template <typename Series_>
+    Series_ gather(const Series_& series, const std::vector<std::size_t>& order) {
+        typename Series_::container_type data(order.size());
+        gather(series.exec_policy(), std::to_address(series.begin()), order, data.data());
+        Series_ out(series.exec_policy(), std::move(data));
+        if (series.validity()) {
+            out.set_validity(gather(series.exec_policy(), *series.validity(), order));
+        }
+        return out;
+    }
+
+    // A series of the elements and validity of another at the given positions, in order, null and
+    // value-initialized at NO_ROW, under its policy
+    template <typename Series_>
+    Series_ gather_or_null(const Series_& series, const std::vector<std::size_t>& order) {
+        const auto policy = series.exec_policy();
+        const auto* src = std::to_address(series.begin());
+        const Bitmap* validity = series.validity() ? &*series.validity() : nullptr;
+        typename Series_::container_type data(order.size());
+        Bitmap valid(order.size(), false);
+        for_each_chunk(policy, order.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                if (order[i] == NO_ROW) {
+                    data[i] = typename Series_::value_type{};
+                    continue;
+                }
+                data[i] = src[order[i]];
+                if (!validity || (*validity)[order[i]]) {
+                    valid.set(i);
+                }
+            }
+        }, OpCost::LIGHT);
+        Series_ out(policy, std::move(data));
+        if (!valid.all()) {
+            out.set_validity(std::move(valid));
+        }
+        return out;
+    }
+
+    // A series of the elements and validity of a view at the given positions, in order, under its policy
+    // The positions are not checked
+    template <typename View_>
+    auto take(const View_& view, const std::vector<std::size_t>& order) {
+        using T = std::remove_const_t<typename View_::value_type>;
+        typename Series<T>::container_type data(order.size());
+        if (view.contiguous()) {
+            gather(view.exec_policy(), view.data(), order, data.data());
+        }
+        else {
+            auto* out = data.data();
+            for_each_chunk(view.exec_policy(), order.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    out[i] = view[order[i]];
+                }
+            }, OpCost::LIGHT);
+        }
+        Series<T> out(view.exec_policy(), std::move(data));
+        if (view.has_nulls()) {
+            Bitmap valid(order.size(), false);
+            for_each_chunk(view.exec_policy(), order.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    if (view.is_valid(order[i])) {
+                        valid.set(i);
+                    }
+                }
+            }, OpCost::LIGHT);
+            out.set_validity(std::move(valid));
+        }
+        return out;
+    }
+
+    // The policy a scatter to the given positions runs with: the given one resolved, or SEQ if it is
+    // parallel and a position repeats, as tasks writing one element at once would race
+    // The positions must be below size
+    inline ExecPolicy scatter_policy(ExecPolicy policy, const std::vector<std::size_t>& order, std::size_t size) {
+        const auto resolved = resolve(policy, order.size(), OpCost::LIGHT);
+        if (resolved != ExecPolicy::PAR && resolved != ExecPolicy::PAR_UNSEQ) {
+            return resolved;
+        }
+        Bitmap seen(size, false);
+        auto* words = seen.words();
+        const bool repeats = reduce_chunks(resolved, order.size(), DEFAULT_GRAIN, false, std::logical_or<>{}, [&](std::size_t begin, std::size_t end) {
+            bool out = false;
+            for (auto i = begin; i < end; ++i) {
+                const auto bit = Bitmap::word_type{1} << (order[i] % Bitmap::WORD_BITS);
+                std::atomic_ref<Bitmap::word_type> word(words[order[i] / Bitmap::WORD_BITS]);
+                out |= (word.fetch_or(bit, std::memory_order_relaxed) & bit) != 0;
+            }
+            return out;
+        }, OpCost::LIGHT);
+        return repeats ? ExecPolicy::SEQ : resolved;
+    }
+
+    /// Copy the elements of src to the given positions, in order
+    // Where a position repeats the last write wins under a sequential policy; under a parallel one the
+    // writes race, so the positions must be unique (see scatter_policy)
+    // policy: the policy the copy runs with
+    // src: order.size() elements
+    // order: positions into out
+    // out: where the elements are written
+    template <typename T>
+    void scatter(ExecPolicy policy, const T* src, const std::vector<std::size_t>& order, T* out) {
+        for_each_chunk(policy, order.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            auto i = begin;
+            for (; i + SCATTER_PREFETCH < end; ++i) {
+                __builtin_prefetch(out + order[i + SCATTER_PREFETCH], 1);
+                out[order[i]] = src[i];
+            }
+            for (; i < end; ++i) {
+                out[order[i]] = src[i];
+            }
+        }, OpCost::LIGHT);
+    }
+
+    // Set the bits of out at the given positions to those of src, in order, or all of them when src is null
+    // Positions from different tasks may share a word, so every bit is written atomically
+    inline void scatter(ExecPolicy policy, const Bitmap* src, const std::vector<std::size_t>& order, Bitmap& out) {
+        using word_type = Bitmap::word_type;
+        auto* words = out.words();
+        for_each_chunk(policy, order.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                const auto bit = word_type{1} << (order[i] % Bitmap::WORD_BITS);
+                std::atomic_ref<word_type> word(words[order[i] / Bitmap::WORD_BITS]);
+                if (!src || (*src)[i]) {
+                    word.fetch_or(bit, std::memory_order_relaxed);
+                }
+                else {
+                    word.fetch_and(~bit, std::memory_order_relaxed);
+                }
+            }
+        }, OpCost::LIGHT);
+    }
+
+}
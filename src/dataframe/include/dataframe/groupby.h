@@ -0,0 +1,1005 @@
+#pragma once
+
+#include "aggregates.h"
+#include "bitmap.h"
+#include "expr.h"
+#include "policy.h"
+#include "scan.h"
+#include "series.h"
+#include "sort.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Grouping rows by key and aggregating each group, as DataFrame::groupby does
+//
+// Grouping numbers the distinct keys densely in order of first appearance and labels every row with
+// the number of its group; rows with a null key belong to none. Integer keys spanning at most
+// DIRECT_GROUP_RANGE values are numbered through arrays indexed by value, with no hashing at all. Other
+// keys are grouped one of three ways, chosen from the keys themselves:
+// - keys already in order, ascending or descending, have each group in one run of rows, and a new
+//   group starts wherever the key changes;
+// - otherwise each task numbers the keys of its block of rows in an open-addressing table of its own,
+//   the tables are merged in parallel with one range of hash values per task, and a last pass
+//   relabels the rows;
+// - but when a sample of the keys estimates groups nearly as many as the rows, every task's table
+//   would grow to hold most of them, missing the cache on nearly every row and then again in the
+//   merge. Then the rows are first split by the high bits of their hash into partitions of about
+//   PARTITION_GROUPS keys each, and every partition is numbered in parallel in a table that fits in
+//   cache. A single task is never partitioned: the extra passes were measured to cost more than the
+//   misses of its one table, which it overlaps by hashing rows in batches.
+// Several key columns are grouped one at a time, each next column paired with the groups so far and
+// the pairs grouped in turn.
+//
+// Aggregating adds every value into the state of its group in arrays indexed by group number. Runs of
+// sorted keys are aggregated a run at a time. Otherwise each task has an array of partial states,
+// merged in parallel over ranges of groups, unless the groups are as many as partitioned keys: then the
+// values are first split by ranges of group numbers into partitions whose states fit in cache, each
+// aggregated by one task in the order of its rows.
+namespace df::detail {
+
+    // Integer keys spanning at most this many values are grouped through arrays indexed by value
+    inline constexpr std::size_t DIRECT_GROUP_RANGE{1 << 16};
+
+    // Fewest rows given to one task of grouping or aggregation
+    inline constexpr std::size_t GROUP_BLOCK{1 << 16};
+
+    // The group of a row whose key is null
+    inline constexpr std::uint32_t NO_GROUP{std::numeric_limits<std::uint32_t>::max()};
+
+    // Rows sampled to estimate the number of groups
+    inline constexpr std::size_t GROUP_SAMPLE{1 << 12};
+
+    // Keys per partition of a partitioned grouping, and groups per partition of a partitioned
+    // aggregation: their hash table, or their states, then fit in a cache of 256KB
+    inline constexpr std::size_t PARTITION_GROUPS{1 << 12};
+
+    // Rows are partitioned once there are more groups than one per PARTITION_RATIO rows and more than
+    // PARTITION_MIN_GROUPS, past which the table or partial states of every task grow nearly as large
+    // as all of them together and merging them costs more than partitioning
+    inline constexpr std::size_t PARTITION_RATIO{32};
+    inline constexpr std::size_t PARTITION_MIN_GROUPS{1 << 16};
+
+    // Most partitions rows are split into in one pass; more would miss the TLB on every write
+    inline constexpr std::size_t MAX_PARTITIONS{256};
+
+    // Rows labelled with dense group numbers
+    struct Grouping {
+        // the group of each row, or NO_GROUP
+        std::vector<std::uint32_t> ids;
+        // the first row of each group, ascending
+        std::vector<std::size_t> firsts;
+        // whether the rows of each group are contiguous, group g spanning the rows from firsts[g] to
+        // firsts[g + 1]
+        bool sorted{false};
+
+        std::size_t size() const noexcept { return firsts.size(); }
+    };
+
+    // Types a column must hold to be a group key: hashable and equality comparable
+    template <typename T>
+    concept group_key = requires(const T& x) {
+        { std::hash<T>{}(x) } -> std::convertible_to<std::size_t>;
+        { x == x } -> std::convertible_to<bool>;
+    };
+
+    // Types whose keys can be checked for order
+    template <typename T>
+    concept ordered_key = requires(const T& x) {
+        { x < x } -> std::convertible_to<bool>;
+    };
+
+    // The finalizer of MurmurHash3, so that every bit of a key affects the low bits a table indexes by
+    inline std::uint64_t mix_hash(std::uint64_t h) noexcept {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Keys are equal as values are, except that every NaN is the same key
+    template <typename T>
+    bool same_key(const T& a, const T& b) {
+        if constexpr (std::is_floating_point_v<T>) {
+            return a == b || (a != a && b != b);
+        }
+        else {
+            return a == b;
+        }
+    }
+
+    // Equal keys hash equal: -0 and +0 alike, and every NaN alike
+    template <typename T>
+    std::uint64_t hash_key(const T& x) {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (x != x) {
+                return mix_hash(~std::uint64_t{0});
+            }
+            return mix_hash(x == 0 ? 0 : std::bit_cast<std::uint64_t>(static_cast<double>(x)));
+        }
+        else if constexpr (std::is_integral_v<T>) {
+            return mix_hash(static_cast<std::uint64_t>(x));
+        }
+        else {
+            return mix_hash(std::hash<T>{}(x));
+        }
+    }
+
+    // Rows whose keys are hashed, and their slots prefetched, before any of them is looked up, so that
+    // the lookups overlap their misses instead of waiting on each in turn
+    inline constexpr std::size_t GROUP_BATCH{64};
+
+    // An open-addressing hash table numbering distinct keys 0, 1, 2... in order of insertion
+    // Linear probing over slots that hold a key beside its number, so that a lookup usually reads a
+    // single cache line. Kept at most a quarter full while its slots fit in SMALL_TABLE_BYTES, where
+    // shorter probes save mispredicted branches, and at most half full beyond, where they would cost
+    // cache misses
+    template <typename Key_>
+    class GroupTable {
+    public:
+        static constexpr std::size_t SMALL_TABLE_BYTES{std::size_t{256} << 10};
+
+        GroupTable() = default;
+
+        // A table with room for expected keys before it grows
+        explicit GroupTable(std::size_t expected) {
+            auto slots = std::bit_ceil(std::max<std::size_t>(16, 2 * expected));
+            while (limit(slots) < expected) {
+                slots *= 2;
+            }
+            slots_.resize(slots);
+            limit_ = limit(slots);
+        }
+
+        std::size_t size() const noexcept { return size_; }
+
+        // Bring the slot a key starts probing from into the cache
+        // hash: hash_key(key)
+        void prefetch(std::uint64_t hash) const noexcept {
+            __builtin_prefetch(&slots_[hash & (slots_.size() - 1)]);
+        }
+
+        // The number of a key, and whether this call inserted it as number size()
+        // hash: hash_key(key)
+        std::pair<std::uint32_t, bool> insert(const Key_& key, std::uint64_t hash) {
+            if (size_ == limit_) {
+                grow();
+            }
+            const auto mask = slots_.size() - 1;
+            for (auto i = hash & mask;; i = (i + 1) & mask) {
+                auto& slot = slots_[i];
+                if (slot.id != NO_GROUP && same_key(slot.key, key)) {
+                    return {slot.id, false};
+                }
+                if (slot.id == NO_GROUP) {
+                    slot.key = key;
+                    slot.id = static_cast<std::uint32_t>(size_++);
+                    return {slot.id, true};
+                }
+            }
+        }
+
+        // The number of a key, or NO_GROUP if it is not in the table
+        // hash: hash_key(key)
+        std::uint32_t find(const Key_& key, std::uint64_t hash) const {
+            const auto mask = slots_.size() - 1;
+            for (auto i = hash & mask;; i = (i + 1) & mask) {
+                const auto& slot = slots_[i];
+                if (slot.id == NO_GROUP || same_key(slot.key, key)) {
+                    return slot.id;
+                }
+            }
+        }
+
+        // The keys in order of their numbers
+        std::vector<Key_> keys() const {
+            std::vector<Key_> out(size_);
+            for (const auto& slot : slots_) {
+                if (slot.id != NO_GROUP) {
+                    out[slot.id] = slot.key;
+                }
+            }
+            return out;
+        }
+
+    private:
+        struct Slot {
+            Key_ key{};
+            std::uint32_t id{NO_GROUP};
+        };
+
+        // Most keys the slots hold before they grow
+        static std::size_t limit(std::size_t slots) noexcept {
+            return slots / (slots * sizeof(Slot) <= SMALL_TABLE_BYTES ? 4 : 2);
+        }
+
+        void grow() {
+            std::vector<Slot> old(2 * slots_.size());
+            old.swap(slots_);
+            limit_ = limit(slots_.size());
+            const auto mask = slots_.size() - 1;
+            for (auto& slot : old) {
+                if (slot.id == NO_GROUP) {
+                    continue;
+                }
+                auto i = hash_key(slot.key) & mask;
+                while (slots_[i].id != NO_GROUP) {
+                    i = (i + 1) & mask;
+                }
+                slots_[i] = std::move(slot);
+            }
+        }
+
+        std::vector<Slot> slots_ = std::vector<Slot>(16);
+        std::size_t size_{0};
+        std::size_t limit_{limit(16)};
+    };
+
+    /// Number the keys of the rows [begin, end) in a table, labelling each row with its number
+    // table: the table the keys are numbered in
+    // key_at: the key of row i, called only where valid(i)
+    // valid: whether row i has a key
+    // ids: the labels of the rows, NO_GROUP where there is no key
+    // firsts: where the first row of each key new to the table is appended
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    void label_rows(GroupTable<Key_>& table, std::size_t begin, std::size_t end, KeyAt_& key_at, Valid_& valid, std::uint32_t* ids, std::vector<std::size_t>& firsts) {
+        std::array<std::uint64_t, GROUP_BATCH> hashes;
+        for (auto batch = begin; batch < end; batch += GROUP_BATCH) {
+            const auto last = std::min(batch + GROUP_BATCH, end);
+            for (auto i = batch; i < last; ++i) {
+                if (valid(i)) {
+                    hashes[i - batch] = hash_key(key_at(i));
+                    table.prefetch(hashes[i - batch]);
+                }
+            }
+            for (auto i = batch; i < last; ++i) {
+                if (!valid(i)) {
+                    ids[i] = NO_GROUP;
+                    continue;
+                }
+                const auto [id, inserted] = table.insert(key_at(i), hashes[i - batch]);
+                if (inserted) {
+                    firsts.push_back(i);
+                }
+                ids[i] = id;
+            }
+        }
+    }
+
+    // Whether n rows in groups groups are partitioned by group rather than split into blocks of rows
+    inline bool partition_groups(std::size_t n, std::size_t groups) noexcept {
+        return groups > std::max(n / PARTITION_RATIO, PARTITION_MIN_GROUPS);
+    }
+
+    // Number of blocks of rows grouped or aggregated into partial results of their own: one unless the
+    // policy resolves to a parallel one, then one per thread with at least GROUP_BLOCK rows each
+    inline std::size_t group_tasks(ExecPolicy policy, std::size_t n) noexcept {
+        const auto resolved = resolve(policy, n, OpCost::MEDIUM);
+        if (resolved != ExecPolicy::PAR && resolved != ExecPolicy::PAR_UNSEQ) {
+            return 1;
+        }
+        return std::clamp<std::size_t>(n / GROUP_BLOCK, 1, parallel_concurrency());
+    }
+
+    // Put the first rows of groups in order, returning the position each group moved to
+    inline std::vector<std::uint32_t> order_groups(ExecPolicy policy, std::vector<std::size_t>& firsts) {
+        std::vector<std::size_t> index(firsts.size());
+        std::iota(index.begin(), index.end(), std::size_t{0});
+        radix_sort(policy, firsts, index);
+        std::vector<std::uint32_t> rank(index.size());
+        for_each_chunk(policy, index.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                rank[index[i]] = static_cast<std::uint32_t>(i);
+            }
+        }, OpCost::LIGHT);
+        return rank;
+    }
+
+    /// Group rows by small integer codes through arrays indexed by code
+    // policy: the policy the passes run with
+    // n: the number of rows
+    // range: the number of codes; every code is below it
+    // code_at: the code of row i, called only where valid(i)
+    // valid: whether row i has a key
+    // Each block records the first row of every code in an array of its own, the arrays are merged by
+    // minimum, and the codes that occur are numbered in order of those rows
+    template <typename CodeAt_, typename Valid_>
+    Grouping direct_groups(ExecPolicy policy, std::size_t n, std::size_t range, CodeAt_ code_at, Valid_ valid) {
+        constexpr auto NONE = std::numeric_limits<std::size_t>::max();
+        Grouping out;
+        if (n == 0) {
+            return out;
+        }
+        const auto tasks = group_tasks(policy, n);
+        const auto block = (n + tasks - 1) / tasks;
+        std::vector<std::vector<std::size_t>> firsts(tasks);
+        for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+            auto& first = firsts[begin / block];
+            first.assign(range, NONE);
+            // backwards, so that the first row of a code is the last written
+            for (auto i = end; i-- > begin;) {
+                if (valid(i)) {
+                    first[code_at(i)] = i;
+                }
+            }
+        }, OpCost::MEDIUM);
+        auto& first = firsts[0];
+        for_each_chunk(policy, range, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t t = 1; t < tasks; ++t) {
+                for (auto c = begin; c < end; ++c) {
+                    first[c] = std::min(first[c], firsts[t][c]);
+                }
+            }
+        }, OpCost::LIGHT);
+
+        std::vector<std::size_t> codes;
+        for (std::size_t c = 0; c < range; ++c) {
+            if (first[c] != NONE) {
+                codes.push_back(c);
+                out.firsts.push_back(first[c]);
+            }
+        }
+        const auto rank = order_groups(policy, out.firsts);
+        std::vector<std::uint32_t> number(range, NO_GROUP);
+        for (std::size_t k = 0; k < codes.size(); ++k) {
+            number[codes[k]] = rank[k];
+        }
+        out.ids.resize(n);
+        for_each_chunk(policy, n, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                out.ids[i] = valid(i) ? number[code_at(i)] : NO_GROUP;
+            }
+        }, OpCost::LIGHT);
+        return out;
+    }
+
+    /// Group rows by key through open-addressing hash tables
+    // policy: the policy the passes run with
+    // n: the number of rows
+    // key_at: the key of row i, called only where valid(i)
+    // valid: whether row i has a key
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    Grouping hash_groups(ExecPolicy policy, std::size_t n, KeyAt_ key_at, Valid_ valid) {
+        Grouping out;
+        out.ids.resize(n);
+        if (n == 0) {
+            return out;
+        }
+        // each block numbers the keys it meets in a table of its own and labels its rows with them
+        const auto tasks = group_tasks(policy, n);
+        const auto block = (n + tasks - 1) / tasks;
+        // loops over blocks or parts are as parallel as those over rows
+        const auto across = resolve(policy, n, OpCost::MEDIUM);
+        std::vector<std::vector<Key_>> keys(tasks);
+        std::vector<std::vector<std::size_t>> firsts(tasks);
+        for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+            const auto t = begin / block;
+            GroupTable<Key_> table;
+            label_rows(table, begin, end, key_at, valid, out.ids.data(), firsts[t]);
+            keys[t] = table.keys();
+        }, OpCost::MEDIUM);
+        if (tasks == 1) {
+            out.firsts = std::move(firsts[0]);
+            return out;
+        }
+
+        // the keys of every block are split by hash into one part per task, in order within each block
+        const auto parts = tasks;
+        struct Split {
+            std::vector<std::uint64_t> hashes;
+            std::vector<std::uint32_t> order;
+            std::vector<std::size_t> offsets;
+        };
+        std::vector<Split> splits(tasks);
+        const auto part_of = [parts](std::uint64_t hash) {
+            return static_cast<std::size_t>((hash >> 32) * parts >> 32);
+        };
+        for_each_chunk(across, tasks, 1, [&](std::size_t t, std::size_t) {
+            auto& split = splits[t];
+            split.hashes.resize(keys[t].size());
+            split.offsets.assign(parts + 1, 0);
+            for (std::size_t k = 0; k < keys[t].size(); ++k) {
+                split.hashes[k] = hash_key(keys[t][k]);
+                ++split.offsets[part_of(split.hashes[k]) + 1];
+            }
+            std::partial_sum(split.offsets.begin(), split.offsets.end(), split.offsets.begin());
+            split.order.resize(keys[t].size());
+            auto next = split.offsets;
+            for (std::size_t k = 0; k < keys[t].size(); ++k) {
+                split.order[next[part_of(split.hashes[k])]++] = static_cast<std::uint32_t>(k);
+            }
+        }, OpCost::HEAVY);
+
+        // each part numbers its keys in a table of its own, visiting the blocks in order so that the
+        // first row of each new key is later than those of the keys before it
+        std::vector<std::vector<std::uint32_t>> numbers(tasks);
+        for (std::size_t t = 0; t < tasks; ++t) {
+            numbers[t].resize(keys[t].size());
+        }
+        std::vector<std::vector<std::size_t>> part_firsts(parts);
+        for_each_chunk(across, parts, 1, [&](std::size_t p, std::size_t) {
+            GroupTable<Key_> table;
+            for (std::size_t t = 0; t < tasks; ++t) {
+                const auto& split = splits[t];
+                for (auto j = split.offsets[p]; j < split.offsets[p + 1]; ++j) {
+                    const auto k = split.order[j];
+                    const auto [id, inserted] = table.insert(keys[t][k], split.hashes[k]);
+                    if (inserted) {
+                        part_firsts[p].push_back(firsts[t][k]);
+                    }
+                    numbers[t][k] = id;
+                }
+            }
+        }, OpCost::HEAVY);
+
+        // the groups of all parts are numbered in order of first row, and the rows relabelled
+        std::vector<std::size_t> part_offsets(parts + 1, 0);
+        for (std::size_t p = 0; p < parts; ++p) {
+            part_offsets[p + 1] = part_offsets[p] + part_firsts[p].size();
+            out.firsts.insert(out.firsts.end(), part_firsts[p].begin(), part_firsts[p].end());
+        }
+        const auto rank = order_groups(policy, out.firsts);
+        for_each_chunk(across, tasks, 1, [&](std::size_t t, std::size_t) {
+            for (std::size_t k = 0; k < keys[t].size(); ++k) {
+                numbers[t][k] = rank[part_offsets[part_of(splits[t].hashes[k])] + numbers[t][k]];
+            }
+        }, OpCost::HEAVY);
+        for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+            const auto& number = numbers[begin / block];
+            for (auto i = begin; i < end; ++i) {
+                if (out.ids[i] != NO_GROUP) {
+                    out.ids[i] = number[out.ids[i]];
+                }
+            }
+        }, OpCost::LIGHT);
+        return out;
+    }
+
+    /// Estimate the number of distinct keys from a sample of GROUP_SAMPLE rows
+    // The bias-corrected Chao1 estimator d + f1 (f1 - 1) / 2 (f2 + 1), where d of the keys sampled are
+    // distinct, f1 of those were sampled once and f2 twice: close for keys drawn evenly, and low rather
+    // than high for skewed ones. Exact when every row is sampled
+    // key_at: the key of row i, called only where valid(i)
+    // valid: whether row i has a key
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    std::size_t estimate_groups(std::size_t n, KeyAt_& key_at, Valid_& valid) {
+        GroupTable<Key_> table;
+        std::vector<std::uint32_t> seen;
+        for (std::size_t k = 0; k < std::min(n, GROUP_SAMPLE); ++k) {
+            const auto i = n <= GROUP_SAMPLE ? k : static_cast<std::size_t>(mix_hash(k) % n);
+            if (!valid(i)) {
+                continue;
+            }
+            const auto& key = key_at(i);
+            const auto [id, inserted] = table.insert(key, hash_key(key));
+            if (inserted) {
+                seen.push_back(0);
+            }
+            ++seen[id];
+        }
+        if (n <= GROUP_SAMPLE) {
+            return seen.size();
+        }
+        const auto once = static_cast<double>(std::count(seen.begin(), seen.end(), 1u));
+        const auto twice = static_cast<double>(std::count(seen.begin(), seen.end(), 2u));
+        const auto unseen = once * (once - 1) / (2 * (twice + 1));
+        return std::min(n, seen.size() + static_cast<std::size_t>(unseen));
+    }
+
+    // The order of two consecutive keys as bits: 1 when they ascend or are the same key, 2 when they
+    // descend or are the same key. A NaN is in neither order beside anything but another NaN
+    template <typename T>
+    int key_order(const T& a, const T& b) {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (same_key(a, b)) {
+                return 3;
+            }
+            return (a < b ? 1 : 0) | (b < a ? 2 : 0);
+        }
+        else {
+            return (b < a ? 0 : 1) | (a < b ? 0 : 2);
+        }
+    }
+
+    /// Whether keys are in order, ascending or descending, so that equal keys are contiguous
+    // key_at: the key of row i
+    // A strided sample of the keys is checked first, which rules out most unsorted keys at once
+    template <typename KeyAt_>
+    bool keys_sorted(ExecPolicy policy, std::size_t n, KeyAt_& key_at) {
+        if (n < 2) {
+            return true;
+        }
+        const auto stride = std::max<std::size_t>(1, n / GROUP_SAMPLE);
+        int sample = 3;
+        for (auto i = stride; i < n && sample; i += stride) {
+            sample &= key_order(key_at(i - stride), key_at(i));
+        }
+        if (!sample) {
+            return false;
+        }
+        return reduce_chunks(policy, n - 1, DEFAULT_GRAIN, 3, std::bit_and<>{}, [&](std::size_t begin, std::size_t end) {
+            int out = sample;
+            for (auto i = begin + 1; i <= end; ++i) {
+                out &= key_order(key_at(i - 1), key_at(i));
+            }
+            return out;
+        }, OpCost::LIGHT) != 0;
+    }
+
+    /// Group rows whose equal keys are contiguous, as sorted keys are: a new group starts wherever the
+    /// key changes, with no hashing
+    // key_at: the key of row i, every row having one
+    template <typename KeyAt_>
+    Grouping sorted_groups(ExecPolicy policy, std::size_t n, KeyAt_& key_at) {
+        Grouping out;
+        out.ids.resize(n);
+        out.sorted = true;
+        if (n == 0) {
+            return out;
+        }
+        const auto starts = [&](std::size_t i) { return i == 0 || !same_key(key_at(i - 1), key_at(i)); };
+        chunked_scan(
+            policy, n, std::size_t{0}, std::plus<>{},
+            [&](std::size_t begin, std::size_t end) {
+                std::size_t count = 0;
+                for (auto i = begin; i < end; ++i) {
+                    count += starts(i);
+                }
+                return count;
+            },
+            [&](std::size_t begin, std::size_t end, std::size_t carry) {
+                for (auto i = begin; i < end; ++i) {
+                    carry += starts(i);
+                    out.ids[i] = static_cast<std::uint32_t>(carry - 1);
+                }
+            }
+        );
+        out.firsts.resize(std::size_t{out.ids[n - 1]} + 1);
+        for_each_chunk(policy, n, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                if (i == 0 || out.ids[i] != out.ids[i - 1]) {
+                    out.firsts[out.ids[i]] = i;
+                }
+            }
+        }, OpCost::LIGHT);
+        return out;
+    }
+
+    // Rows whose keys are copied out by the high bits of their hash into one stretch per partition, made
+    // of one segment per block of rows in order, so that each partition meets its keys in row order
+    template <typename Key_>
+    struct HashPartitions {
+        // number of partitions, and of blocks of rows
+        std::size_t parts;
+        std::size_t tasks;
+        // rows per block
+        std::size_t block;
+        // the partition of each row with a key
+        std::vector<std::uint8_t> part;
+        // the first and one past the last slot of each block's segment of each partition, at
+        // [block * parts + partition]
+        std::vector<std::size_t> starts;
+        std::vector<std::size_t> ends;
+        // the keys, by slot
+        std::vector<Key_> keys;
+
+        std::size_t begin(std::size_t p) const noexcept { return starts[p]; }
+        std::size_t end(std::size_t p) const noexcept { return ends[(tasks - 1) * parts + p]; }
+
+        // Call f(i, slot) for every row with a key, in order within each block and for the blocks in
+        // parallel, with the slot its key was copied to
+        template <typename Valid_, typename F>
+        void rows(ExecPolicy policy, std::size_t n, Valid_& valid, F&& f) const {
+            for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+                const auto* first = starts.data() + begin / block * parts;
+                std::vector<std::size_t> slots(first, first + parts);
+                for (auto i = begin; i < end; ++i) {
+                    if (valid(i)) {
+                        f(i, slots[part[i]]++);
+                    }
+                }
+            }, OpCost::MEDIUM);
+        }
+    };
+
+    /// Split the keys of rows by the high bits of their hash, in a pass counting the rows of each block
+    /// in each partition and a pass copying the keys out
+    // parts: the number of partitions, a power of two from 2 to MAX_PARTITIONS
+    // key_at: the key of row i, called only where valid(i)
+    // valid: whether row i has a key
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    HashPartitions<Key_> partition_keys(ExecPolicy policy, std::size_t n, std::size_t parts, KeyAt_& key_at, Valid_& valid) {
+        HashPartitions<Key_> out;
+        out.parts = parts;
+        out.tasks = group_tasks(policy, n);
+        out.block = std::max<std::size_t>(1, (n + out.tasks - 1) / out.tasks);
+        out.part.resize(n);
+        const auto shift = 64 - std::countr_zero(parts);
+        auto& next = out.ends;
+        next.assign(out.tasks * parts, 0);
+        for_each_chunk(policy, n, out.block, [&](std::size_t begin, std::size_t end) {
+            auto* counts = next.data() + begin / out.block * parts;
+            for (auto i = begin; i < end; ++i) {
+                if (valid(i)) {
+                    out.part[i] = static_cast<std::uint8_t>(hash_key(key_at(i)) >> shift);
+                    ++counts[out.part[i]];
+                }
+            }
+        }, OpCost::MEDIUM);
+        std::size_t total = 0;
+        for (std::size_t p = 0; p < parts; ++p) {
+            for (std::size_t t = 0; t < out.tasks; ++t) {
+                total += std::exchange(next[t * parts + p], total);
+            }
+        }
+        out.starts = next;
+        out.keys.resize(total);
+        for_each_chunk(policy, n, out.block, [&](std::size_t begin, std::size_t end) {
+            auto* slots = next.data() + begin / out.block * parts;
+            for (auto i = begin; i < end; ++i) {
+                if (valid(i)) {
+                    out.keys[slots[out.part[i]]++] = key_at(i);
+                }
+            }
+        }, OpCost::MEDIUM);
+        return out;
+    }
+
+    /// Group rows by key through a hash table per partition of the keys, split by the high bits of
+    /// their hash beforehand so that each table fits in cache
+    // parts: the number of partitions, a power of two from 2 to MAX_PARTITIONS
+    // expected: the number of keys expected per partition, which its table is sized for
+    // key_at: the key of row i, called only where valid(i)
+    // valid: whether row i has a key
+    // Each partition marks the first row of each of its keys. The rows are then labelled in the order
+    // their keys were copied out in, each reading its number back from the stretch of its partition, and
+    // the groups numbered in order of first row by counting the marks before them: every pass streams
+    // through memory, with no sort and no writes at random
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    Grouping partitioned_groups(ExecPolicy policy, std::size_t n, std::size_t parts, std::size_t expected, KeyAt_& key_at, Valid_& valid) {
+        constexpr std::uint32_t FIRST{std::uint32_t{1} << 31};
+        const auto split = partition_keys<Key_>(policy, n, parts, key_at, valid);
+        const auto tasks = split.tasks;
+        const auto across = resolve(policy, n, OpCost::MEDIUM);
+
+        // each partition numbers its keys in a table of its own, marking the first row of each and
+        // counting those marks per segment
+        std::vector<std::uint32_t> numbers(split.keys.size());
+        std::vector<std::size_t> part_offsets(parts + 1, 0);
+        std::vector<std::size_t> marks(tasks * parts, 0);
+        for_each_chunk(across, parts, 1, [&](std::size_t p, std::size_t) {
+            GroupTable<Key_> table(std::min(split.end(p) - split.begin(p), expected + expected / 4));
+            for (std::size_t t = 0; t < tasks; ++t) {
+                for (auto j = split.starts[t * parts + p]; j < split.ends[t * parts + p]; ++j) {
+                    const auto [id, inserted] = table.insert(split.keys[j], hash_key(split.keys[j]));
+                    numbers[j] = inserted ? id | FIRST : id;
+                    marks[t * parts + p] += inserted;
+                }
+            }
+            part_offsets[p + 1] = table.size();
+        }, OpCost::HEAVY);
+        std::partial_sum(part_offsets.begin(), part_offsets.end(), part_offsets.begin());
+
+        // the groups are numbered in order of first row: those first in a block after the marks of the
+        // blocks before it, in order within the block
+        std::vector<std::size_t> bases(tasks, 0);
+        for (std::size_t t = 0, base = 0; t < tasks; ++t) {
+            bases[t] = base;
+            base += std::accumulate(marks.begin() + t * parts, marks.begin() + (t + 1) * parts, std::size_t{0});
+        }
+        Grouping out;
+        out.ids.assign(n, NO_GROUP);
+        out.firsts.resize(part_offsets[parts]);
+        std::vector<std::uint32_t> rank(part_offsets[parts]);
+        split.rows(policy, n, valid, [&](std::size_t i, std::size_t slot) {
+            auto& base = bases[i / split.block];
+            const auto number = numbers[slot];
+            const auto key = static_cast<std::uint32_t>(part_offsets[split.part[i]] + (number & ~FIRST));
+            if (number & FIRST) {
+                rank[key] = static_cast<std::uint32_t>(base);
+                out.firsts[base++] = i;
+            }
+            out.ids[i] = key;
+        });
+        for_each_chunk(policy, n, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                if (out.ids[i] != NO_GROUP) {
+                    out.ids[i] = rank[out.ids[i]];
+                }
+            }
+        }, OpCost::LIGHT);
+        return out;
+    }
+
+    /// Group rows by key, choosing how from the keys (see above)
+    // complete: whether every row has a key, which the check for sorted keys needs
+    // key_at: the key of row i, called only where valid(i)
+    // valid: whether row i has a key
+    // Partitioning copies the keys, so only keys that copy as bytes are partitioned
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    Grouping group_keys(ExecPolicy policy, std::size_t n, bool complete, KeyAt_ key_at, Valid_ valid) {
+        if constexpr (ordered_key<Key_>) {
+            if (complete && keys_sorted(policy, n, key_at)) {
+                return sorted_groups(policy, n, key_at);
+            }
+        }
+        if constexpr (std::is_trivially_copyable_v<Key_>) {
+            const auto estimate = group_tasks(policy, n) > 1 ? estimate_groups<Key_>(n, key_at, valid) : 0;
+            if (partition_groups(n, estimate)) {
+                const auto parts = std::clamp<std::size_t>(std::bit_ceil(estimate / PARTITION_GROUPS), 2, MAX_PARTITIONS);
+                return partitioned_groups<Key_>(policy, n, parts, estimate / parts, key_at, valid);
+            }
+        }
+        return hash_groups<Key_>(policy, n, key_at, valid);
+    }
+
+    // The least and greatest of the valid keys, std::nullopt if there are none
+    // validity: the validity of the keys, or nullptr if all are valid
+    template <typename T>
+    std::optional<std::pair<T, T>> key_bounds(ExecPolicy policy, std::size_t n, const T* data, const Bitmap* validity) {
+        using Bounds = std::optional<std::pair<T, T>>;
+        const auto combine = [](const Bounds& a, const Bounds& b) -> Bounds {
+            if (!a || !b) {
+                return a ? a : b;
+            }
+            return std::pair{std::min(a->first, b->first), std::max(a->second, b->second)};
+        };
+        return reduce_chunks(policy, n, DEFAULT_GRAIN, Bounds{}, combine, [&](std::size_t begin, std::size_t end) {
+            auto lo = std::numeric_limits<T>::max();
+            auto hi = std::numeric_limits<T>::lowest();
+            if (!validity) {
+                for (auto i = begin; i < end; ++i) {
+                    lo = std::min(lo, data[i]);
+                    hi = std::max(hi, data[i]);
+                }
+                return Bounds{std::pair{lo, hi}};
+            }
+            bool any = false;
+            for (auto i = begin; i < end; ++i) {
+                if ((*validity)[i]) {
+                    lo = std::min(lo, data[i]);
+                    hi = std::max(hi, data[i]);
+                    any = true;
+                }
+            }
+            return any ? Bounds{std::pair{lo, hi}} : Bounds{};
+        }, OpCost::LIGHT);
+    }
+
+    // The rows of a series grouped by value, nulls in no group
+    template <typename Series_>
+    Grouping group(const Series_& series) {
+        using T = typename Series_::value_type;
+        const auto* data = std::to_address(series.begin());
+        const Bitmap* validity = series.has_nulls() ? &*series.validity() : nullptr;
+        const auto valid = [validity](std::size_t i) { return !validity || (*validity)[i]; };
+        if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+            const auto bounds = key_bounds(series.exec_policy(), series.size(), data, validity);
+            if (!bounds) {
+                return {std::vector<std::uint32_t>(series.size(), NO_GROUP), {}};
+            }
+            using U = std::make_unsigned_t<T>;
+            const auto lo = static_cast<U>(bounds->first);
+            const auto span = static_cast<U>(static_cast<U>(bounds->second) - lo);
+            if (span < DIRECT_GROUP_RANGE) {
+                const auto code_at = [data, lo](std::size_t i) {
+                    return static_cast<std::size_t>(static_cast<U>(static_cast<U>(data[i]) - lo));
+                };
+                return direct_groups(series.exec_policy(), series.size(), static_cast<std::size_t>(span) + 1, code_at, valid);
+            }
+        }
+        const auto key_at = [data](std::size_t i) -> const T& { return data[i]; };
+        return group_keys<T>(series.exec_policy(), series.size(), !validity, key_at, valid);
+    }
+
+    // The rows grouped by two keys at once, from the groupings by each: the pairs of group numbers are
+    // grouped as keys in turn, directly when there are few enough of them
+    inline Grouping combine(ExecPolicy policy, const Grouping& a, const Grouping& b) {
+        const auto n = a.ids.size();
+        const std::uint64_t width = b.size();
+        const auto valid = [&](std::size_t i) { return a.ids[i] != NO_GROUP && b.ids[i] != NO_GROUP; };
+        const auto code_at = [&](std::size_t i) { return a.ids[i] * width + b.ids[i]; };
+        if (a.size() * width <= DIRECT_GROUP_RANGE) {
+            return direct_groups(policy, n, a.size() * width, code_at, valid);
+        }
+        const auto complete = reduce_chunks(policy, n, DEFAULT_GRAIN, true, std::logical_and<>{}, [&](std::size_t begin, std::size_t end) {
+            bool out = true;
+            for (auto i = begin; i < end; ++i) {
+                out &= valid(i);
+            }
+            return out;
+        }, OpCost::LIGHT);
+        return group_keys<std::uint64_t>(policy, n, complete, code_at, valid);
+    }
+
+    // Call f with whether a plan needs sums, extrema and moments, each as a std::bool_constant
+    template <typename F>
+    decltype(auto) with_plan(const AggPlan& plan, F&& f) {
+        const auto with_sum = [&](auto sum) -> decltype(auto) {
+            const auto with_extrema = [&](auto extrema) -> decltype(auto) {
+                return plan.moments ? f(sum, extrema, std::true_type{}) : f(sum, extrema, std::false_type{});
+            };
+            return plan.extrema ? with_extrema(std::true_type{}) : with_extrema(std::false_type{});
+        };
+        return plan.sum ? with_sum(std::true_type{}) : with_sum(std::false_type{});
+    }
+
+    // Add a value to the partial state of its group, filling only the fields of the plan
+    template <bool Sum, bool Extrema, bool Moments>
+    void group_push(AggState<double>& state, double x) {
+        if constexpr (Extrema) {
+            state.min = state.count == 0 ? x : std::min(state.min, x);
+            state.max = state.count == 0 ? x : std::max(state.max, x);
+        }
+        ++state.count;
+        if constexpr (Sum) {
+            state.sum += x;
+        }
+        if constexpr (Moments) {
+            const double delta = x - state.mean;
+            state.mean += delta / static_cast<double>(state.count);
+            state.m2 += delta * (x - state.mean);
+        }
+    }
+
+    /// Aggregations of the non-null values of each group, as doubles
+    // series: the values, one per row
+    // groups: the grouping of the rows
+    // aggs: the aggregations, computed together in one pass over the values
+    // Returns a series per aggregation, in order, with an element per group that is null where the
+    // aggregation is undefined; under the policy of series
+    template <typename Series_>
+    std::vector<Series<double>> group_agg(const Series_& series, const Grouping& groups, const std::vector<Agg>& aggs) {
+        const auto policy = series.exec_policy();
+        const auto n = series.size();
+        const auto count = groups.size();
+        const AggPlan plan(aggs);
+        const auto* data = std::to_address(series.begin());
+        const Bitmap* validity = series.has_nulls() ? &*series.validity() : nullptr;
+
+        const auto skip = [&](std::size_t i) { return groups.ids[i] == NO_GROUP || (validity && !(*validity)[i]); };
+        const auto tasks = group_tasks(policy, n);
+        const auto across = resolve(policy, n, OpCost::MEDIUM);
+        std::vector<AggState<double>> states;
+
+        if (groups.sorted && count > 0) {
+            // each block aggregates its runs straight into the states of their groups, but for the group
+            // it starts in, which may have begun in an earlier block and is merged in afterwards
+            const auto block = std::max<std::size_t>(1, (n + tasks - 1) / tasks);
+            states.assign(count, {});
+            std::vector<AggState<double>> heads(tasks);
+            for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+                with_plan(plan, [&](auto sum, auto extrema, auto moments) {
+                    auto* state = &heads[begin / block];
+                    for (auto i = begin; i < end; ++i) {
+                        if (i > begin && groups.firsts[groups.ids[i]] == i) {
+                            state = &states[groups.ids[i]];
+                        }
+                        if (!skip(i)) {
+                            group_push<decltype(sum)::value, decltype(extrema)::value, decltype(moments)::value>(*state, static_cast<double>(data[i]));
+                        }
+                    }
+                });
+            }, OpCost::MEDIUM);
+            for (std::size_t begin = 0; begin < n; begin += block) {
+                auto& state = states[groups.ids[begin]];
+                state = merge(state, heads[begin / block]);
+            }
+        }
+        else if (tasks > 1 && partition_groups(n, count)) {
+            // the values are split with their groups into partitions of consecutive group numbers, each
+            // block of rows in order, and every partition aggregated into its own range of the states
+            const auto parts = std::clamp<std::size_t>(std::bit_ceil(count / PARTITION_GROUPS), 2, MAX_PARTITIONS);
+            const auto shift = std::bit_width(count - 1) - std::countr_zero(parts);
+            const auto block = (n + tasks - 1) / tasks;
+            std::vector<std::size_t> next(tasks * parts, 0);
+            for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+                auto* counts = next.data() + begin / block * parts;
+                for (auto i = begin; i < end; ++i) {
+                    if (!skip(i)) {
+                        ++counts[groups.ids[i] >> shift];
+                    }
+                }
+            }, OpCost::LIGHT);
+            std::vector<std::size_t> part_begin(parts + 1, 0);
+            std::size_t total = 0;
+            for (std::size_t p = 0; p < parts; ++p) {
+                part_begin[p] = total;
+                for (std::size_t t = 0; t < tasks; ++t) {
+                    total += std::exchange(next[t * parts + p], total);
+                }
+            }
+            part_begin[parts] = total;
+            std::vector<double> part_values(total);
+            std::vector<std::uint32_t> part_ids(total);
+            for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+                auto* slots = next.data() + begin / block * parts;
+                for (auto i = begin; i < end; ++i) {
+                    if (!skip(i)) {
+                        const auto slot = slots[groups.ids[i] >> shift]++;
+                        part_values[slot] = static_cast<double>(data[i]);
+                        part_ids[slot] = groups.ids[i];
+                    }
+                }
+            }, OpCost::MEDIUM);
+            states.resize(count);
+            for_each_chunk(across, parts, 1, [&](std::size_t p, std::size_t) {
+                with_plan(plan, [&](auto sum, auto extrema, auto moments) {
+                    for (auto j = part_begin[p]; j < part_begin[p + 1]; ++j) {
+                        group_push<decltype(sum)::value, decltype(extrema)::value, decltype(moments)::value>(states[part_ids[j]], part_values[j]);
+                    }
+                });
+            }, OpCost::HEAVY);
+        }
+        else {
+            // fewer blocks when the groups are so many that most partial states of a block would stay empty
+            const auto blocks = std::min(tasks, std::max<std::size_t>(1, n / std::max<std::size_t>(count, 1)));
+            const auto block = std::max<std::size_t>(1, (n + blocks - 1) / blocks);
+            std::vector<std::vector<AggState<double>>> partials(blocks);
+            for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+                auto& partial = partials[begin / block];
+                partial.assign(count, {});
+                with_plan(plan, [&](auto sum, auto extrema, auto moments) {
+                    for (auto i = begin; i < end; ++i) {
+                        if (!skip(i)) {
+                            group_push<decltype(sum)::value, decltype(extrema)::value, decltype(moments)::value>(partial[groups.ids[i]], static_cast<double>(data[i]));
+                        }
+                    }
+                });
+            }, OpCost::MEDIUM);
+            states = std::move(partials[0]);
+            states.resize(count);
+            if (blocks > 1) {
+                for_each_chunk(policy, count, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                    for (auto g = begin; g < end; ++g) {
+                        for (std::size_t t = 1; t < blocks; ++t) {
+                            states[g] = merge(states[g], partials[t][g]);
+                        }
+                    }
+                }, OpCost::MEDIUM);
+            }
+        }
+
+        std::vector<Series<double>::container_type> values(aggs.size(), Series<double>::container_type(count));
+        std::vector<Bitmap> valid(aggs.size(), Bitmap(count, true));
+        for_each_chunk(policy, count, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto g = begin; g < end; ++g) {
+                for (std::size_t k = 0; k < aggs.size(); ++k) {
+                    if (const auto result = states[g].result(aggs[k])) {
+                        values[k][g] = *result;
+                    }
+                    else {
+                        valid[k].set(g, false);
+                    }
+                }
+            }
+        }, OpCost::MEDIUM);
+
+        std::vector<Series<double>> out;
+        out.reserve(aggs.size());
+        for (std::size_t k = 0; k < aggs.size(); ++k) {
+            out.emplace_back(policy, std::move(values[k]));
+            if (!valid[k].all()) {
+                out.back().set_validity(std::move(valid[k]));
+            }
+        }
+        return out;
+    }
+
+}
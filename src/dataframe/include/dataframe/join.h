@@ -0,0 +1,337 @@
+#pragma once
+
+#include "bitmap.h"
+#include "gather.h"
+#include "groupby.h"
+#include "policy.h"
+#include "sort.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+
+// Joining the rows of two frames on equal keys, as DataFrame::merge does
+//
+// A join builds on the side with fewer rows: its keys are grouped as DataFrame::groupby groups them,
+// which numbers the distinct keys, and every row of the other side then probes for the number of its
+// key, in parallel blocks of rows. Integer keys of a narrow range probe an array indexed by value.
+// Others probe one hash table shared by every task while it holds few keys, hashing a batch of rows
+// and prefetching their slots before looking any of them up so that the misses overlap. With many
+// keys, a shared table would miss the cache on nearly every probe: both sides are then split by the
+// high bits of their hash into partitions whose tables fit in cache, and each partition is built and
+// probed by one task. Several key columns are matched one at a time, each next column paired with the
+// matches so far, as groupby combines them.
+//
+// Once every row of both sides is labelled with the number of its key, the result is computed as row
+// positions only: the right rows are sorted by key number, and each left row spans the right rows of
+// its key. The columns are then gathered through the positions, one at a time, so that no value is
+// moved until its row is known to be in the result.
+namespace df {
+
+    // How DataFrame::merge joins the rows of two frames
+    enum class Join {
+        INNER, // a row for every pair of a left and a right row with equal keys
+        LEFT,  // as INNER, and a row for every left row without a match, null in the right columns
+        SEMI,  // every left row with a match, once, with the left columns only
+        ANTI,  // every left row without a match, with the left columns only
+    };
+
+}
+
+namespace df::detail {
+
+    // The rows of both sides of a join labelled with the numbers of the distinct keys of the build side
+    struct KeyMatch {
+        // the build rows grouped by key, nulls in no group
+        Grouping build;
+        // the number of the build key equal to the key of each probe row, NO_GROUP where there is none
+        std::vector<std::uint32_t> probe;
+    };
+
+    /// Label the rows [begin, end) with the numbers of their keys in a table, as label_rows but without
+    /// adding keys the table does not hold
+    // ids: the labels of the rows, NO_GROUP where there is no key or it is not in the table
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    void probe_rows(const GroupTable<Key_>& table, std::size_t begin, std::size_t end, KeyAt_& key_at, Valid_& valid, std::uint32_t* ids) {
+        std::array<std::uint64_t, GROUP_BATCH> hashes;
+        for (auto batch = begin; batch < end; batch += GROUP_BATCH) {
+            const auto last = std::min(batch + GROUP_BATCH, end);
+            for (auto i = batch; i < last; ++i) {
+                if (valid(i)) {
+                    hashes[i - batch] = hash_key(key_at(i));
+                    table.prefetch(hashes[i - batch]);
+                }
+            }
+            for (auto i = batch; i < last; ++i) {
+                ids[i] = valid(i) ? table.find(key_at(i), hashes[i - batch]) : NO_GROUP;
+            }
+        }
+    }
+
+    /// Label rows with the numbers of build keys through an array indexed by code
+    // lookup: the number of the build key of each code, NO_GROUP where there is none
+    // code_at: the code of row i, called only where valid(i); codes beyond the array match nothing
+    template <typename CodeAt_, typename Valid_>
+    std::vector<std::uint32_t> probe_direct(ExecPolicy policy, std::size_t n, const std::vector<std::uint32_t>& lookup, CodeAt_ code_at, Valid_ valid) {
+        std::vector<std::uint32_t> ids(n);
+        for_each_chunk(policy, n, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                const auto code = valid(i) ? code_at(i) : lookup.size();
+                ids[i] = code < lookup.size() ? lookup[code] : NO_GROUP;
+            }
+        }, OpCost::LIGHT);
+        return ids;
+    }
+
+    /// Label rows with the numbers of build keys through a hash table per partition of the keys
+    // keys: the distinct build keys, in order of their numbers
+    // The build keys and then the probe keys are split by the high bits of their hash (see
+    // partition_keys), every partition builds and probes a table of its own, and the rows are labelled
+    // by reading the results back from the stretches of their partitions in row order
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    std::vector<std::uint32_t> probe_partitioned(ExecPolicy policy, const std::vector<Key_>& keys, std::size_t n, KeyAt_& key_at, Valid_& valid) {
+        const auto parts = std::clamp<std::size_t>(std::bit_ceil(keys.size() / PARTITION_GROUPS), 2, MAX_PARTITIONS);
+        const auto across = resolve(policy, n, OpCost::MEDIUM);
+        const auto build_at = [&keys](std::size_t g) -> const Key_& { return keys[g]; };
+        const auto all = [](std::size_t) { return true; };
+        const auto built = partition_keys<Key_>(policy, keys.size(), parts, build_at, all);
+        std::vector<std::uint32_t> numbers(keys.size());
+        built.rows(policy, keys.size(), all, [&](std::size_t g, std::size_t slot) {
+            numbers[slot] = static_cast<std::uint32_t>(g);
+        });
+
+        const auto split = partition_keys<Key_>(policy, n, parts, key_at, valid);
+        std::vector<std::uint32_t> found(split.keys.size());
+        for_each_chunk(across, parts, 1, [&](std::size_t p, std::size_t) {
+            // the build keys are distinct, so each is numbered by its place in the partition
+            GroupTable<Key_> table(built.end(p) - built.begin(p));
+            for (auto j = built.begin(p); j < built.end(p); ++j) {
+                table.insert(built.keys[j], hash_key(built.keys[j]));
+            }
+            for (auto j = split.begin(p); j < split.end(p); ++j) {
+                const auto local = table.find(split.keys[j], hash_key(split.keys[j]));
+                found[j] = local == NO_GROUP ? NO_GROUP : numbers[built.begin(p) + local];
+            }
+        }, OpCost::HEAVY);
+        std::vector<std::uint32_t> ids(n, NO_GROUP);
+        split.rows(policy, n, valid, [&](std::size_t i, std::size_t slot) { ids[i] = found[slot]; });
+        return ids;
+    }
+
+    /// Label rows with the numbers of build keys through hash tables
+    // keys: the distinct build keys, in order of their numbers
+    // key_at: the key of row i, called only where valid(i)
+    // valid: whether row i has a key
+    // One table is shared by every task unless there are several tasks and more keys than
+    // PARTITION_MIN_GROUPS, which are partitioned; keys that do not copy as bytes never are
+    template <typename Key_, typename KeyAt_, typename Valid_>
+    std::vector<std::uint32_t> probe_hashed(ExecPolicy policy, const std::vector<Key_>& keys, std::size_t n, KeyAt_ key_at, Valid_ valid) {
+        if constexpr (std::is_trivially_copyable_v<Key_>) {
+            if (group_tasks(policy, n) > 1 && keys.size() > PARTITION_MIN_GROUPS) {
+                return probe_partitioned(policy, keys, n, key_at, valid);
+            }
+        }
+        GroupTable<Key_> table(keys.size());
+        for (const auto& key : keys) {
+            table.insert(key, hash_key(key));
+        }
+        std::vector<std::uint32_t> ids(n);
+        for_each_chunk(policy, n, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            probe_rows(table, begin, end, key_at, valid, ids.data());
+        }, OpCost::MEDIUM);
+        return ids;
+    }
+
+    // The keys of a series at the first row of each group, in order of the groups
+    template <typename T, typename KeyAt_>
+    std::vector<T> group_keys_at(const Grouping& groups, KeyAt_& key_at) {
+        std::vector<T> keys(groups.size());
+        for (std::size_t g = 0; g < keys.size(); ++g) {
+            keys[g] = key_at(groups.firsts[g]);
+        }
+        return keys;
+    }
+
+    /// Match the keys of two series of the same type, building on one and probing with the other
+    // Nulls match nothing, and NaN keys match one another as they group together
+    // Integer keys whose build side spans at most DIRECT_GROUP_RANGE values probe an array indexed by
+    // value, and others probe_hashed; under the policy of the probe series
+    template <typename Series_>
+    KeyMatch match_keys(const Series_& build, const Series_& probe) {
+        using T = typename Series_::value_type;
+        KeyMatch out;
+        out.build = group(build);
+        const auto policy = probe.exec_policy();
+        const auto n = probe.size();
+        const auto* data = std::to_address(probe.begin());
+        const Bitmap* validity = probe.has_nulls() ? &*probe.validity() : nullptr;
+        const auto valid = [validity](std::size_t i) { return !validity || (*validity)[i]; };
+        const auto* build_data = std::to_address(build.begin());
+        const auto build_at = [build_data](std::size_t i) -> const T& { return build_data[i]; };
+        if (out.build.size() == 0) {
+            out.probe.assign(n, NO_GROUP);
+            return out;
+        }
+        if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+            using U = std::make_unsigned_t<T>;
+            const auto keys = group_keys_at<T>(out.build, build_at);
+            const auto [lo, hi] = std::minmax_element(keys.begin(), keys.end());
+            const auto span = static_cast<U>(static_cast<U>(*hi) - static_cast<U>(*lo));
+            if (span < DIRECT_GROUP_RANGE) {
+                const auto base = static_cast<U>(*lo);
+                const auto code = [base](T x) { return static_cast<std::size_t>(static_cast<U>(static_cast<U>(x) - base)); };
+                std::vector<std::uint32_t> lookup(static_cast<std::size_t>(span) + 1, NO_GROUP);
+                for (std::size_t g = 0; g < keys.size(); ++g) {
+                    lookup[code(keys[g])] = static_cast<std::uint32_t>(g);
+                }
+                out.probe = probe_direct(policy, n, lookup, [&](std::size_t i) { return code(data[i]); }, valid);
+                return out;
+            }
+            out.probe = probe_hashed(policy, keys, n, [data](std::size_t i) -> const T& { return data[i]; }, valid);
+        }
+        else {
+            const auto keys = group_keys_at<T>(out.build, build_at);
+            out.probe = probe_hashed(policy, keys, n, [data](std::size_t i) -> const T& { return data[i]; }, valid);
+        }
+        return out;
+    }
+
+    // The matches of two keys at once, from the matches of each on the same build and probe rows: the
+    // pairs of key numbers are grouped on the build side as combine groups them, and probed in turn,
+    // through an array when there are few enough of them
+    inline KeyMatch match_pairs(ExecPolicy policy, const KeyMatch& a, const KeyMatch& b) {
+        KeyMatch out;
+        out.build = combine(policy, a.build, b.build);
+        const std::uint64_t width = b.build.size();
+        const auto range = a.build.size() * width;
+        const auto build_code = [&](std::size_t i) { return a.build.ids[i] * width + b.build.ids[i]; };
+        const auto code_at = [&](std::size_t i) { return a.probe[i] * width + b.probe[i]; };
+        const auto valid = [&](std::size_t i) { return a.probe[i] != NO_GROUP && b.probe[i] != NO_GROUP; };
+        const auto keys = group_keys_at<std::uint64_t>(out.build, build_code);
+        if (range <= DIRECT_GROUP_RANGE) {
+            std::vector<std::uint32_t> lookup(range, NO_GROUP);
+            for (std::size_t g = 0; g < keys.size(); ++g) {
+                lookup[keys[g]] = static_cast<std::uint32_t>(g);
+            }
+            out.probe = probe_direct(policy, a.probe.size(), lookup, code_at, valid);
+        }
+        else {
+            out.probe = probe_hashed(policy, keys, a.probe.size(), code_at, valid);
+        }
+        return out;
+    }
+
+    // The rows of an inner or left join, as positions into the left and right frames
+    struct JoinRows {
+        std::vector<std::size_t> left;
+        // NO_ROW where a left row has no match
+        std::vector<std::size_t> right;
+    };
+
+    /// The rows of an inner or left join from the key numbers of the rows of each side
+    // left, right: the number of the key of each row, NO_GROUP where it has none or matches nothing
+    // keys: the number of key numbers
+    // outer: whether a left row without a match is kept, with NO_ROW on the right
+    // The right rows are sorted by key number into one range per key. Each block of left rows counts
+    // the rows it makes, and then writes them from the total of the blocks before it: the left rows in
+    // order, each with the right rows of its key in order. A left row without a key reads the empty
+    // range of an extra key instead, and every left row writes its first match, or NO_ROW, before
+    // knowing whether it has one, so that the usual zero or one matches take no branch
+    inline JoinRows join_rows(ExecPolicy policy, const std::vector<std::uint32_t>& left, const std::vector<std::uint32_t>& right, std::size_t keys, bool outer) {
+        auto sorted = right;
+        std::vector<std::size_t> order(right.size());
+        std::iota(order.begin(), order.end(), std::size_t{0});
+        radix_sort(policy, sorted, order);
+        order.push_back(NO_ROW);
+        // the right rows of key g are order[bounds[g + 1]] to order[bounds[g + 2]], so that NO_GROUP wraps
+        // around to the empty slot 0 without a branch; NO_GROUP also sorts last, past bounds[keys + 1]
+        std::vector<std::size_t> bounds(keys + 2, 0);
+        for_each_chunk(policy, sorted.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto j = begin; j < end; ++j) {
+                const auto from = j == 0 ? std::size_t{0} : std::size_t{sorted[j - 1]} + 1;
+                const auto to = std::min<std::size_t>(sorted[j], keys);
+                for (auto g = from; g <= to; ++g) {
+                    bounds[g + 1] = j;
+                }
+            }
+        }, OpCost::LIGHT);
+        for (auto g = sorted.empty() ? std::size_t{0} : std::size_t{sorted.back()} + 1; g <= keys; ++g) {
+            bounds[g + 1] = sorted.size();
+        }
+
+        const auto n = left.size();
+        const auto slot = [&](std::size_t i) { return std::uint32_t(left[i] + 1); };
+        const auto tasks = group_tasks(policy, n);
+        const auto block = std::max<std::size_t>(1, (n + tasks - 1) / tasks);
+        std::vector<std::size_t> starts(tasks + 1, 0);
+        for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+            std::size_t count = 0;
+            for (auto i = begin; i < end; ++i) {
+                const auto h = slot(i);
+                const auto matches = bounds[h + 1] - bounds[h];
+                count += matches + (outer & (matches == 0));
+            }
+            starts[begin / block + 1] = count;
+        }, OpCost::LIGHT);
+        std::partial_sum(starts.begin(), starts.end(), starts.begin());
+
+        JoinRows out;
+        out.left.resize(starts[tasks]);
+        out.right.resize(starts[tasks]);
+        const auto none = order.size() - 1;
+        for_each_chunk(policy, n, block, [&](std::size_t begin, std::size_t end) {
+            auto at = starts[begin / block];
+            const auto limit = starts[begin / block + 1];
+            for (auto i = begin; i < end; ++i) {
+                const auto h = slot(i);
+                const auto first = bounds[h];
+                const auto matches = bounds[h + 1] - first;
+                const auto empty = std::size_t{matches == 0};
+                // the first match is written even if there is none, and then overwritten by the next row
+                if (at < limit) {
+                    out.left[at] = i;
+                    out.right[at] = order[first + empty * (none - first)];
+                }
+                for (std::size_t j = 1; j < matches; ++j) {
+                    out.left[at + j] = i;
+                    out.right[at + j] = order[first + j];
+                }
+                at += matches + (outer & empty);
+            }
+        }, OpCost::MEDIUM);
+        return out;
+    }
+
+    /// The left rows of a semi join, or of an anti join, as a mask
+    // left, right, keys: as join_rows
+    // matched: whether the rows with a match are set, or those without one
+    inline Bitmap join_mask(ExecPolicy policy, const std::vector<std::uint32_t>& left, const std::vector<std::uint32_t>& right, std::size_t keys, bool matched) {
+        // every key with a right row, flagged by the tasks in any order
+        std::vector<std::uint8_t> found(keys, 0);
+        for_each_chunk(policy, right.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto j = begin; j < end; ++j) {
+                if (right[j] != NO_GROUP) {
+                    std::atomic_ref<std::uint8_t>(found[right[j]]).store(1, std::memory_order_relaxed);
+                }
+            }
+        }, OpCost::LIGHT);
+        Bitmap out(left.size(), false);
+        for_each_chunk(policy, left.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                if ((left[i] != NO_GROUP && found[left[i]]) == matched) {
+                    out.set(i);
+                }
+            }
+        }, OpCost::LIGHT);
+        return out;
+    }
+
+}
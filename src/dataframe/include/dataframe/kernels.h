@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+
+// Explicitly vectorized kernels for contiguous float and double arrays
+//
+// Each kernel is compiled once per instruction set (scalar, SSE2, AVX2+FMA, AVX-512F) and the best
+// one supported by the running CPU is selected on first use. Series routes its elementwise operators
+// and aggregations here for float and double data; other element types use the standard algorithms.
+// Lazy expressions (see expr.h) run their exp, log, sqrt and abs nodes of float and double here a tile
+// at a time wherever the nodes sit in the tree, and apply their other nodes element by element; sum()
+// and mean() of an expression still read it one element at a time.
+//
+// Accuracy of the transcendental kernels, measured against long double references on random inputs
+// spanning each function's domain, for both float and double and on every instruction set:
+//   exp:  below 1.5 ULP (below 1 ULP where FMA is available), including subnormal results
+//   log:  below 1 ULP
+//   pow:  below 3 ULP for positive finite bases and finite exponents; the error grows slowly with
+//         |y log x| and is largest close to overflow. Every other input (zero or negative bases,
+//         infinities, NaNs) is handed to std::pow lane by lane
+// sqrt, abs, min, max and the four arithmetic operators are correctly rounded. Special values (NaN,
+// +/-inf, +/-0, overflow and underflow) match the C library in every kernel.
+namespace df::kernels {
+
+    // Instruction sets a kernel can be dispatched to, in increasing order of preference
+    enum class Isa {
+        SCALAR,
+        SSE2,
+        AVX2,
+        AVX512
+    };
+
+    // Elementwise operations on one operand: out[i] = op(a[i])
+    enum class UnaryOp {
+        EXP,
+        LOG,
+        SQRT,
+        ABS
+    };
+
+    // Elementwise operations on two operands: out[i] = op(a[i], b[i]) or op(a[i], b)
+    // RSUB and RDIV reverse the operands, MIN and MAX follow std::min(a, b) and std::max(a, b)
+    enum class BinaryOp {
+        ADD,
+        SUB,
+        RSUB,
+        MUL,
+        DIV,
+        RDIV,
+        MIN,
+        MAX,
+        POW
+    };
+
+    // Elementwise comparisons: op(a[i], b[i]) or op(a[i], b)
+    // As with the C++ operators, a comparison involving NaN is false, except NE which is true
+    enum class CompareOp {
+        LT,
+        LE,
+        GT,
+        GE,
+        EQ,
+        NE
+    };
+
+    // How the reductions accumulate
+    enum class SumMode {
+        // Several independent accumulators per vector lane: fastest, error grows linearly with n
+        NAIVE,
+        // Naive accumulation over small blocks, added as a balanced tree: error grows with log n
+        PAIRWISE,
+        // The rounding error of every operation is carried alongside the sum (Neumaier, Dot2): the
+        // result is as accurate as if accumulated in twice the precision and rounded once
+        COMPENSATED
+    };
+
+    // Deviations of an array from a center: the sum of (a[i] - center), the sum of its squares,
+    // and the smallest and largest element
+    template <typename T>
+    struct Spread {
+        T sum;
+        T sum_sq;
+        T min;
+        T max;
+    };
+
+    // Smallest and largest element of an array other than NaN, with the position of the first element
+    // equal to each, and the position of the first NaN
+    // Positions are the size of the array where there is no such element
+    template <typename T>
+    struct Extrema {
+        T min;
+        T max;
+        std::size_t argmin;
+        std::size_t argmax;
+        std::size_t nan;
+    };
+
+    template <typename T>
+    constexpr bool supported_v = std::is_same_v<T, double> || std::is_same_v<T, float>;
+
+    // The best instruction set supported by this CPU
+    Isa detected_isa() noexcept;
+
+    // The instruction set kernels are currently dispatched to
+    Isa active_isa() noexcept;
+
+    // Dispatch kernels to the given instruction set, or to the best supported one below it
+    // Returns the instruction set that was selected
+    Isa set_isa(Isa isa) noexcept;
+
+    const char* isa_name(Isa isa) noexcept;
+
+    // The output may alias any input
+    void unary(UnaryOp op, const double* a, double* out, std::size_t n) noexcept;
+    void unary(UnaryOp op, const float* a, float* out, std::size_t n) noexcept;
+
+    void binary(BinaryOp op, const double* a, const double* b, double* out, std::size_t n) noexcept;
+    void binary(BinaryOp op, const float* a, const float* b, float* out, std::size_t n) noexcept;
+
+    void binary(BinaryOp op, const double* a, double b, double* out, std::size_t n) noexcept;
+    void binary(BinaryOp op, const float* a, float b, float* out, std::size_t n) noexcept;
+
+    // Sum of a[0..n)
+    double sum(const double* a, std::size_t n, SumMode mode = SumMode::NAIVE) noexcept;
+    float sum(const float* a, std::size_t n, SumMode mode = SumMode::NAIVE) noexcept;
+
+    // Sum of a[i] * b[i] over [0, n)
+    double dot(const double* a, const double* b, std::size_t n, SumMode mode = SumMode::NAIVE) noexcept;
+    float dot(const float* a, const float* b, std::size_t n, SumMode mode = SumMode::NAIVE) noexcept;
+
+    // Spread of a[0..n) around center, for n > 0
+    // With center close to the mean of the block this is the second pass of a numerically stable
+    // variance, and is meant to run over blocks that are still in cache from the first
+    // min and max are unspecified if the block contains NaN
+    Spread<double> spread(const double* a, std::size_t n, double center) noexcept;
+    Spread<float> spread(const float* a, std::size_t n, float center) noexcept;
+
+    // Extrema of a[0..n), in a vectorized pass for the values and a search for their first positions
+    // that stops at the first match and is meant to find the block still in cache
+    // Vectors holding NaN are handled one element at a time
+    Extrema<double> extrema(const double* a, std::size_t n) noexcept;
+    Extrema<float> extrema(const float* a, std::size_t n) noexcept;
+
+    // Running sum of a[0..n) into out, starting from carry, and returns the last sum
+    // Each vector of elements is summed in register in log2(width) steps, then offset by the sum before
+    // it, so the result may differ from sequential addition in the last bits
+    // The output may alias the input
+    double cumsum(const double* a, double* out, std::size_t n, double carry) noexcept;
+    float cumsum(const float* a, float* out, std::size_t n, float carry) noexcept;
+
+    // First-order linear recurrence out[i] = decay * out[i - 1] + a[i] over [0, n), starting from
+    // out[-1] = carry, and returns the last value: the running sum of a with every earlier element
+    // weighted down by decay per step, as in an exponentially weighted moving average
+    // Computed a vector at a time as cumsum() is, so the result may differ from the sequential
+    // recurrence in the last bits
+    // The output may alias the input
+    double decayed_cumsum(const double* a, double* out, std::size_t n, double decay, double carry) noexcept;
+    float decayed_cumsum(const float* a, float* out, std::size_t n, float decay, float carry) noexcept;
+
+    // Compare a[0..n) elementwise into a packed mask: bit i % 64 of out[i / 64] is set where the
+    // comparison holds, a vector of lanes at a time
+    // Writes (n + 63) / 64 words, with the bits past n clear
+    void compare(CompareOp op, const double* a, const double* b, std::uint64_t* out, std::size_t n) noexcept;
+    void compare(CompareOp op, const float* a, const float* b, std::uint64_t* out, std::size_t n) noexcept;
+
+    void compare(CompareOp op, const double* a, double b, std::uint64_t* out, std::size_t n) noexcept;
+    void compare(CompareOp op, const float* a, float b, std::uint64_t* out, std::size_t n) noexcept;
+
+    // Stream compaction: copy the elements of a[0..n) whose bit is set in the mask (bit i % 64 of
+    // mask[i / 64]) to the front of out, in order, and return how many there are
+    // Each vector has its selected lanes packed together, by a compress instruction on AVX-512 and by a
+    // shuffle looked up from the bits of the mask on AVX2; whole words of set bits are copied and clear
+    // words skipped. out must have room for exactly the selected elements and must not overlap a
+    std::size_t compress(const double* a, const std::uint64_t* mask, std::size_t n, double* out) noexcept;
+    std::size_t compress(const float* a, const std::uint64_t* mask, std::size_t n, float* out) noexcept;
+
+}
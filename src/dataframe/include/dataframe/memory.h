@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace df {
+
+    // Alignment of every buffer from AlignedAllocator: one cache line, which also satisfies aligned
+    // AVX-512 loads and keeps chunks handed to different threads from sharing a line
+    inline constexpr std::size_t CACHE_LINE_SIZE{64};
+
+    // Size of a transparent huge page on x86-64 and aarch64 Linux
+    inline constexpr std::size_t HUGE_PAGE_SIZE{std::size_t{2} << 20};
+
+    namespace memory {
+
+        // Allocate at least `bytes` bytes aligned to CACHE_LINE_SIZE, or to at least `alignment` if larger
+        // Buffers of huge_page_threshold() bytes or more are aligned to HUGE_PAGE_SIZE and, where the
+        // platform supports it, advised to be backed by transparent huge pages. When numa::active(),
+        // their pages are then first touched from their home nodes (see numa.h)
+        // Throws std::bad_alloc on failure
+        void* allocate(std::size_t bytes, std::size_t alignment = CACHE_LINE_SIZE);
+
+        // Release a buffer obtained from allocate with the same size and alignment
+        // While a PoolScope is active on the calling thread the buffer is kept for reuse instead
+        void deallocate(void* ptr, std::size_t bytes, std::size_t alignment = CACHE_LINE_SIZE) noexcept;
+
+        // Size in bytes from which buffers are huge page aligned and advised, HUGE_PAGE_SIZE by default
+        // Setting it to std::numeric_limits<std::size_t>::max() disables huge pages
+        // Changing it drops the buffers cached by every PoolScope, each thread on its next use of its pool
+        std::size_t huge_page_threshold() noexcept;
+        void set_huge_page_threshold(std::size_t bytes) noexcept;
+
+        // Default number of bytes a PoolScope keeps cached for reuse
+        inline constexpr std::size_t DEFAULT_POOL_CAPACITY{std::size_t{256} << 20};
+
+        // Recycle buffers released on this thread while the scope is alive
+        //
+        // Buffers freed inside the scope are cached by size and handed back by the next allocation of
+        // the same size, so a pipeline that repeatedly builds and drops temporaries of equal length
+        // stops paying for malloc, free and the page faults of fresh memory after its first iteration.
+        // Scopes nest; cached buffers are released when the outermost scope on the thread ends.
+        // Buffers may be freed on a different thread than the one that allocated them.
+        class PoolScope {
+        public:
+            // capacity: the most bytes kept cached at once, taken from the outermost scope
+            explicit PoolScope(std::size_t capacity = DEFAULT_POOL_CAPACITY) noexcept;
+            ~PoolScope();
+
+            PoolScope(const PoolScope&) = delete;
+            PoolScope& operator=(const PoolScope&) = delete;
+
+            // Bytes currently cached by the pool of the calling thread
+            static std::size_t cached_bytes() noexcept;
+        };
+
+    }
+
+    // Default allocator for Series storage
+    // Stateless, so any two instances compare equal and buffers can move freely between series
+    // Elements constructed without arguments are default-initialized rather than value-initialized, so
+    // sizing a container of arithmetic values leaves them uninitialized instead of zero-filling memory
+    // that is about to be overwritten
+    template <typename T>
+    class AlignedAllocator {
+    public:
+        using value_type = T;
+
+        AlignedAllocator() noexcept = default;
+
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U>&) noexcept {}
+
+        T* allocate(std::size_t n) {
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T*>(memory::allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* ptr, std::size_t n) noexcept {
+            memory::deallocate(ptr, n * sizeof(T), alignof(T));
+        }
+
+        template <typename U>
+        void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+            ::new (static_cast<void*>(ptr)) U;
+        }
+
+        template <typename U, typename... Args>
+        void construct(U* ptr, Args&&... args) {
+            ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+        }
+
+        template <typename U>
+        friend bool operator==(const AlignedAllocator&, const AlignedAllocator<U>&) noexcept {
+            return true;
+        }
+    };
+
+}
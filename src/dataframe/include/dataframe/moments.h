@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+
+
+namespace df {
+
+    namespace detail {
+
+        // The type in which statistics of values of type T are accumulated unless another is asked for:
+        // double for integers, whose mean and variance are fractional, and T itself otherwise
+        template <typename T>
+        using accumulator_t = std::conditional_t<std::is_integral_v<T>, double, T>;
+
+    }
+
+    // Count, mean, sum of squared deviations from the mean (M2) and extrema of a set of values
+    //
+    // Moments are gathered one value at a time with Welford's update, or per block and combined with
+    // Chan's parallel formula, so a single pass over the data yields a numerically stable variance and
+    // blocks can be reduced in any order.
+    // T: the type in which the statistics are accumulated
+    template <typename T>
+    struct Moments {
+        std::size_t count{0};
+        T mean{};
+        T m2{};
+        T min{};
+        T max{};
+
+        // Moments of a single value
+        static Moments of(T x) {
+            return {1, x, T{}, x, x};
+        }
+
+        // Moments of a block of n > 0 values from its sum and M2
+        static Moments of(std::size_t n, T sum, T m2, T min, T max) {
+            return {n, sum / static_cast<T>(n), m2, min, max};
+        }
+
+        // Add one value (Welford)
+        void push(T x) {
+            if (count == 0) {
+                *this = of(x);
+                return;
+            }
+            ++count;
+            const T delta = x - mean;
+            mean += delta / static_cast<T>(count);
+            m2 += delta * (x - mean);
+            min = std::min(min, x);
+            max = std::max(max, x);
+        }
+
+        // Variance with the given delta degrees of freedom: M2 / (count - ddof)
+        // Returns std::nullopt if count <= ddof
+        std::optional<T> variance(std::size_t ddof = 0) const {
+            if (count <= ddof) {
+                return std::nullopt;
+            }
+            return m2 / static_cast<T>(count - ddof);
+        }
+
+        // Standard deviation with the given delta degrees of freedom
+        // Returns std::nullopt if count <= ddof
+        std::optional<T> stddev(std::size_t ddof = 0) const {
+            const auto v = variance(ddof);
+            if (!v) {
+                return std::nullopt;
+            }
+            return std::sqrt(*v);
+        }
+
+        // Moments of the union of two disjoint sets of values (Chan et al.)
+        friend Moments merge(const Moments& a, const Moments& b) {
+            if (a.count == 0) {
+                return b;
+            }
+            if (b.count == 0) {
+                return a;
+            }
+            const auto n = a.count + b.count;
+            const T na = static_cast<T>(a.count);
+            const T nb = static_cast<T>(b.count);
+            const T delta = b.mean - a.mean;
+            return {
+                n,
+                a.mean + delta * (nb / static_cast<T>(n)),
+                a.m2 + b.m2 + delta * delta * (na * nb / static_cast<T>(n)),
+                std::min(a.min, b.min),
+                std::max(a.max, b.max)
+            };
+        }
+    };
+
+}
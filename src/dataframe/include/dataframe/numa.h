@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+
+namespace df::numa {
+
+    // The NUMA nodes of the machine, each as the CPUs it holds
+    struct Topology {
+        std::vector<std::vector<int>> nodes;
+
+        std::size_t size() const noexcept { return nodes.size(); }
+
+        friend bool operator==(const Topology&, const Topology&) = default;
+    };
+
+    // The nodes listed under /sys/devices/system/node, restricted to the CPUs this process may run on
+    // A single node holding every allowed CPU where the platform does not describe its nodes
+    Topology detect();
+
+    // The topology used to place threads and memory, detect() until replaced
+    Topology topology();
+    std::size_t node_count() noexcept;
+
+    // Replace the topology, for instance to simulate several nodes on a machine that has one, and
+    // restart the threads of the parallel backend to follow it
+    // Must not be called while parallel work is running
+    // Throws std::invalid_argument if there are no nodes or a node has no CPU
+    void set_topology(Topology topology);
+
+    // Node of a thread that has none
+    inline constexpr std::size_t NO_NODE{std::numeric_limits<std::size_t>::max()};
+
+    // The node of the calling thread: that of a pinned worker of the POOL backend, NO_NODE otherwise
+    std::size_t current_node() noexcept;
+
+    // The home node of index i of [0, n) among nodes: the range is cut into one block of consecutive
+    // indices per node, in order, and every parallel loop of n indices runs block k on node k
+    constexpr std::size_t home_node(std::size_t i, std::size_t n, std::size_t nodes) noexcept {
+        const auto block = (n + nodes - 1) / nodes;
+        return block == 0 ? 0 : i / block;
+    }
+
+    // Whether memory is placed and work scheduled by node: there is more than one node and the POOL
+    // backend pins its workers
+    bool active() noexcept;
+
+    // Touch every page of a fresh buffer of bytes bytes from a thread on its home node, so that each
+    // page is backed by memory on the node that later runs the loops over it
+    // page: the page size the buffer is backed by
+    // Does nothing unless active()
+    void first_touch(void* ptr, std::size_t bytes, std::size_t page);
+
+    namespace detail {
+
+        // The CPUs this process may run on, in increasing order; empty where the platform cannot tell
+        std::vector<int> allowed_cpus();
+
+        // Where pinned worker w, counting from 0, runs: workers are spread round-robin over the nodes
+        // and in order over the CPUs of each node
+        struct Placement {
+            std::size_t node;
+            int cpu;
+        };
+        Placement placement(const Topology& topology, std::size_t worker);
+
+        // Pin the calling thread to a placement and record its node for current_node(); best effort
+        void pin_thread(const Placement& placement) noexcept;
+
+    }
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace df {
+
+    // Default number of elements handed to a single task by the chunked helpers
+    inline constexpr std::size_t DEFAULT_GRAIN{1 << 14};
+
+    // Where work run under a parallel ExecPolicy is scheduled
+    enum class Backend {
+        // the standard parallel algorithms of the C++ library, on whatever pool it was built with
+        STD,
+        // tbb::parallel_for inside a task arena of the configured concurrency; requires USE_TBB
+        TBB,
+        // an OpenMP parallel loop with dynamic scheduling; requires a compiler with OpenMP
+        OPENMP,
+        // the built-in work-stealing thread pool
+        POOL
+    };
+
+    // How parallel work is scheduled
+    struct ParallelConfig {
+        Backend backend{Backend::STD};
+        // number of threads taking part, including the calling thread; 0 for the hardware concurrency
+        unsigned concurrency{0};
+        // whether worker threads are pinned to one CPU each, spread round-robin over the nodes of
+        // numa::topology() and in order over the CPUs of each node; the POOL backend then also keeps
+        // work on its home node (see numa.h)
+        // The calling thread is never pinned. Linux only; ignored elsewhere and by the STD backend
+        bool pin{false};
+        // largest number of elements given to one task, ignored by the STD backend
+        std::size_t grain{DEFAULT_GRAIN};
+
+        friend bool operator==(const ParallelConfig&, const ParallelConfig&) = default;
+    };
+
+    // Whether a backend was built into this library; STD and POOL always are
+    bool backend_available(Backend backend) noexcept;
+
+    // The configuration used by parallel policies
+    // Taken on first use from the environment when set: DF_BACKEND as one of "std", "tbb", "openmp" or
+    // "pool", DF_THREADS as the concurrency, DF_PIN as 0 or 1 and DF_GRAIN as the grain; a malformed
+    // or unavailable value keeps the default
+    ParallelConfig parallel_config() noexcept;
+    Backend parallel_backend() noexcept;
+
+    // Replace the configuration, starting the threads of the new backend and stopping those of the old
+    // Must not be called while parallel work is running
+    // Throws std::invalid_argument if the backend is not available or the grain is 0
+    void set_parallel_config(const ParallelConfig& config);
+
+    // Number of threads taking part in parallel work under the current configuration
+    unsigned parallel_concurrency() noexcept;
+
+    namespace detail {
+
+        using RangeFn = void (*)(const void* context, std::size_t begin, std::size_t end);
+
+        // Run body over [0, n) on the configured backend, the calling thread included, splitting the range
+        // until no task holds more than grain indices, and return once every index is done
+        // Rethrows the first exception thrown by body; the remaining tasks may be skipped
+        void parallel_for(std::size_t n, std::size_t grain, RangeFn body, const void* context);
+
+    }
+
+    /// Run a function over [0, n) split into tasks on the configured backend
+    // grain: the largest number of indices given to one task
+    // f: the function to execute, which takes the [begin, end) bounds of one task and may be called
+    //    concurrently from several threads
+    template <class F>
+    void parallel_for(std::size_t n, std::size_t grain, const F& f) {
+        detail::parallel_for(n, grain, [](const void* context, std::size_t begin, std::size_t end) {
+            (*static_cast<const F*>(context))(begin, end);
+        }, &f);
+    }
+
+}
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <compare>
+#include <cstddef>
+#include <cstdlib>
+#include <execution>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dataframe/parallel.h"
+
+
+namespace df {
+
+    enum class ExecPolicy {
+        SEQ,
+        PAR,
+        UNSEQ,
+        PAR_UNSEQ,
+        // Chosen per operation from the number of elements and the cost of the operation: SEQ or UNSEQ
+        // for inputs too small to repay handing them to the thread pool, PAR_UNSEQ for the rest
+        AUTO
+    };
+
+    // How much work an operation does per element, which sets how large an input must be before
+    // spreading it over threads repays the dispatch
+    enum class OpCost {
+        // memory bound: arithmetic, comparisons, sums and extrema
+        LIGHT,
+        // a few cycles per element: division, square roots, moments and functors of unknown cost
+        MEDIUM,
+        // tens of cycles per element: exp, log and pow
+        HEAVY
+    };
+
+    // Element counts at which ExecPolicy::AUTO switches policy
+    struct AutoThresholds {
+        // SEQ below this count, UNSEQ from it
+        std::size_t unseq{64};
+        // PAR_UNSEQ from these counts, per OpCost
+        std::size_t par_light{std::size_t{1} << 17};
+        std::size_t par_medium{std::size_t{1} << 15};
+        std::size_t par_heavy{std::size_t{1} << 12};
+
+        std::size_t par(OpCost cost) const noexcept {
+            switch (cost) {
+            case OpCost::LIGHT:
+                return par_light;
+            case OpCost::MEDIUM:
+                return par_medium;
+            case OpCost::HEAVY:
+                return par_heavy;
+            }
+            return par_medium;
+        }
+
+        friend bool operator==(const AutoThresholds&, const AutoThresholds&) = default;
+    };
+
+    // The thresholds used by ExecPolicy::AUTO
+    // Taken on first use from the DF_AUTO_THRESHOLDS environment variable when it is set, either as
+    // "unseq,par_light,par_medium,par_heavy" element counts or as "calibrate" to measure them with
+    // calibrate_auto_thresholds(); the defaults of AutoThresholds otherwise
+    AutoThresholds auto_thresholds() noexcept;
+    void set_auto_thresholds(const AutoThresholds& thresholds) noexcept;
+
+    // Measure the thresholds on this machine: the cost of dispatching to the thread pool against the
+    // time per element of a representative operation of each cost class, run sequentially
+    // Takes a few milliseconds; the PAR_UNSEQ thresholds are never reached on a single hardware thread
+    AutoThresholds calibrate_auto_thresholds();
+
+    // The policy to run an operation of the given cost over n elements with
+    // Policies other than AUTO are returned unchanged
+    inline ExecPolicy resolve(ExecPolicy policy, std::size_t n, OpCost cost) noexcept {
+        if (policy != ExecPolicy::AUTO) {
+            return policy;
+        }
+        const auto thresholds = auto_thresholds();
+        if (n >= thresholds.par(cost)) {
+            return ExecPolicy::PAR_UNSEQ;
+        }
+        return n >= thresholds.unseq ? ExecPolicy::UNSEQ : ExecPolicy::SEQ;
+    }
+
+    [[noreturn]] inline void unreachable_policy() noexcept {
+        assert(false && "Unknown ExecPolicy"); // in debug
+        std::abort();                          // hard-stop in release
+    }
+
+    // Execution policies fixed at compile time
+    //
+    // A view tagged with one of these runs every operation on exactly that policy: each algorithm is
+    // instantiated once, and a chain of calls compiles to one specialized path with nothing left to
+    // switch on at run time. The runtime ExecPolicy is a thin adapter that selects one of these per call,
+    // and Dynamic tags a view that holds an ExecPolicy.
+    namespace exec {
+
+        struct Seq {
+            static constexpr ExecPolicy value{ExecPolicy::SEQ};
+        };
+
+        struct Unseq {
+            static constexpr ExecPolicy value{ExecPolicy::UNSEQ};
+        };
+
+        struct Par {
+            static constexpr ExecPolicy value{ExecPolicy::PAR};
+        };
+
+        struct ParUnseq {
+            static constexpr ExecPolicy value{ExecPolicy::PAR_UNSEQ};
+        };
+
+        struct Dynamic {};
+
+    }
+
+    namespace detail {
+
+        template <typename P>
+        struct is_static_policy : std::false_type {};
+
+        template <>
+        struct is_static_policy<exec::Seq> : std::true_type {};
+
+        template <>
+        struct is_static_policy<exec::Unseq> : std::true_type {};
+
+        template <>
+        struct is_static_policy<exec::Par> : std::true_type {};
+
+        template <>
+        struct is_static_policy<exec::ParUnseq> : std::true_type {};
+
+    }
+
+    template <typename P>
+    concept StaticPolicy = detail::is_static_policy<P>::value;
+
+    // A compile-time policy tag, or exec::Dynamic for an ExecPolicy chosen at run time
+    template <typename P>
+    concept PolicyTag = StaticPolicy<P> || std::is_same_v<P, exec::Dynamic>;
+
+    namespace detail {
+
+        // What an object tagged with P holds to know its policy: an ExecPolicy for exec::Dynamic,
+        // and otherwise the empty tag itself
+        template <PolicyTag P>
+        using policy_holder_t = std::conditional_t<std::is_same_v<P, exec::Dynamic>, ExecPolicy, P>;
+
+        constexpr ExecPolicy policy_value(ExecPolicy policy) noexcept {
+            return policy;
+        }
+
+        template <StaticPolicy P>
+        constexpr ExecPolicy policy_value(P) noexcept {
+            return P::value;
+        }
+
+    }
+
+    /// Helper to execute a function with a compile-time execution policy
+    // f: the function to execute, which takes the matching std::execution policy as argument
+    template <StaticPolicy P, class F>
+    decltype(auto) with_policy(P, F&& f) {
+        if constexpr (std::is_same_v<P, exec::Seq>) {
+            return f(std::execution::seq);
+        }
+        else if constexpr (std::is_same_v<P, exec::Unseq>) {
+            return f(std::execution::unseq);
+        }
+        else if constexpr (std::is_same_v<P, exec::Par>) {
+            return f(std::execution::par);
+        }
+        else {
+            return f(std::execution::par_unseq);
+        }
+    }
+
+    // The size and cost of the work only matter to a runtime AUTO policy
+    template <StaticPolicy P, class F>
+    decltype(auto) with_policy(P policy, std::size_t, OpCost, F&& f) {
+        return with_policy(policy, std::forward<F>(f));
+    }
+
+    /// Helper to call a function with the compile-time policy tag of a runtime policy
+    // policy: the execution policy to use, where AUTO runs PAR_UNSEQ since the work is not known here;
+    //         resolve it first
+    // f: the function to execute, which takes a StaticPolicy tag as argument
+    template <class F>
+    decltype(auto) dispatch(ExecPolicy policy, F&& f) {
+        switch (policy) {
+        case ExecPolicy::SEQ:
+            return f(exec::Seq{});
+        case ExecPolicy::PAR:
+            return f(exec::Par{});
+        case ExecPolicy::PAR_UNSEQ:
+        case ExecPolicy::AUTO:
+            return f(exec::ParUnseq{});
+        case ExecPolicy::UNSEQ:
+            return f(exec::Unseq{});
+        }
+
+        // should not reach here, but assert/abort to be safe
+        unreachable_policy();
+    }
+
+    /// Helper to execute a function with the appropriate execution policy
+    // policy: the execution policy to use, where AUTO runs PAR_UNSEQ since the work is not known here;
+    //         resolve it first, or use the overload taking the size and cost
+    // f: the function to execute, which takes an execution policy as argument
+    template <class F>
+    decltype(auto) with_policy(ExecPolicy policy, F&& f) {
+        return dispatch(policy, [&f](auto tag) -> decltype(auto) { return with_policy(tag, f); });
+    }
+
+    /// Helper to execute a function with the execution policy for an operation over n elements
+    // policy: the execution policy to use, where AUTO is resolved from n and cost
+    // n: the number of elements the operation covers
+    // cost: the cost class of the operation
+    // f: the function to execute, which takes an execution policy as argument
+    template <class F>
+    decltype(auto) with_policy(ExecPolicy policy, std::size_t n, OpCost cost, F&& f) {
+        return with_policy(resolve(policy, n, cost), std::forward<F>(f));
+    }
+
+    namespace detail {
+
+        // Random access iterator over the integers [0, n)
+        // Lets the standard parallel algorithms drive an expression by index rather than by container
+        class IndexIterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = std::size_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = std::size_t;
+
+            IndexIterator() = default;
+            explicit IndexIterator(std::size_t i) noexcept : i_(i) {}
+
+            std::size_t operator*() const noexcept { return i_; }
+            std::size_t operator[](difference_type n) const noexcept { return i_ + n; }
+
+            IndexIterator& operator++() noexcept { ++i_; return *this; }
+            IndexIterator operator++(int) noexcept { auto tmp = *this; ++i_; return tmp; }
+            IndexIterator& operator--() noexcept { --i_; return *this; }
+            IndexIterator operator--(int) noexcept { auto tmp = *this; --i_; return tmp; }
+            IndexIterator& operator+=(difference_type n) noexcept { i_ += n; return *this; }
+            IndexIterator& operator-=(difference_type n) noexcept { i_ -= n; return *this; }
+
+            friend IndexIterator operator+(IndexIterator it, difference_type n) noexcept { return it += n; }
+            friend IndexIterator operator+(difference_type n, IndexIterator it) noexcept { return it += n; }
+            friend IndexIterator operator-(IndexIterator it, difference_type n) noexcept { return it -= n; }
+            friend difference_type operator-(IndexIterator a, IndexIterator b) noexcept {
+                return static_cast<difference_type>(a.i_) - static_cast<difference_type>(b.i_);
+            }
+            friend auto operator<=>(IndexIterator a, IndexIterator b) noexcept = default;
+
+        private:
+            std::size_t i_{0};
+        };
+
+    }
+
+    namespace detail {
+
+        // The policy each task runs with when the work is parallel and scheduled on a backend other than
+        // STD: UNSEQ under PAR_UNSEQ and SEQ under PAR
+        // Returns std::nullopt when the work stays with the standard algorithms
+        template <class Policy>
+        std::optional<ExecPolicy> backend_task_policy(Policy policy, std::size_t n, OpCost cost) {
+            ExecPolicy resolved;
+            if constexpr (StaticPolicy<Policy>) {
+                if constexpr (Policy::value == ExecPolicy::SEQ || Policy::value == ExecPolicy::UNSEQ) {
+                    return std::nullopt;
+                }
+                resolved = Policy::value;
+            }
+            else {
+                resolved = resolve(policy, n, cost);
+            }
+            if ((resolved != ExecPolicy::PAR && resolved != ExecPolicy::PAR_UNSEQ) || parallel_backend() == Backend::STD) {
+                return std::nullopt;
+            }
+            return resolved == ExecPolicy::PAR_UNSEQ ? ExecPolicy::UNSEQ : ExecPolicy::SEQ;
+        }
+
+        // Number of chunks of grain elements batched into one task of the backend
+        inline std::size_t chunks_per_task(std::size_t grain) noexcept {
+            return std::max<std::size_t>(1, parallel_config().grain / grain);
+        }
+
+    }
+
+    /// Run a function over consecutive chunks of the index range [0, n)
+    // policy: the ExecPolicy or StaticPolicy tag used to schedule the chunks, where AUTO is resolved from
+    //         n and cost
+    // grain: the number of elements per chunk (the last chunk may be shorter)
+    // f: the function to execute, which takes the [begin, end) bounds of one chunk
+    // cost: the cost class of f per element
+    template <class Policy, class F>
+    void for_each_chunk(Policy policy, std::size_t n, std::size_t grain, F&& f, OpCost cost = OpCost::MEDIUM) {
+        const std::size_t chunks = (n + grain - 1) / grain;
+        const auto run = [&](std::size_t first, std::size_t last) {
+            for (auto c = first; c < last; ++c) {
+                const std::size_t begin = c * grain;
+                f(begin, std::min(begin + grain, n));
+            }
+        };
+        if (detail::backend_task_policy(policy, n, cost)) {
+            parallel_for(chunks, detail::chunks_per_task(grain), run);
+            return;
+        }
+        with_policy(policy, n, cost, [&](auto& exec_) {
+            std::for_each(exec_, detail::IndexIterator{0}, detail::IndexIterator{chunks}, [&](std::size_t c) {
+                run(c, c + 1);
+            });
+        });
+    }
+
+    /// Reduce the results of a function applied to consecutive chunks of the index range [0, n)
+    // policy: the ExecPolicy or StaticPolicy tag used to schedule the chunks, where AUTO is resolved from
+    //         n and cost
+    // grain: the number of elements per chunk (the last chunk may be shorter)
+    // init: the identity of the reduction
+    // reduce: the binary reduction applied to chunk results
+    // f: the function to execute, which takes the [begin, end) bounds of one chunk and returns its result
+    // cost: the cost class of f per element
+    template <class Policy, class T, class Reduce, class F>
+    T reduce_chunks(Policy policy, std::size_t n, std::size_t grain, T init, Reduce reduce, F&& f, OpCost cost = OpCost::MEDIUM) {
+        const std::size_t chunks = (n + grain - 1) / grain;
+        const auto chunk = [&](std::size_t c) {
+            const std::size_t begin = c * grain;
+            return f(begin, std::min(begin + grain, n));
+        };
+        if (detail::backend_task_policy(policy, n, cost)) {
+            // chunk results are combined in index order once all are in
+            std::vector<T> partials(chunks, init);
+            parallel_for(chunks, detail::chunks_per_task(grain), [&](std::size_t first, std::size_t last) {
+                for (auto c = first; c < last; ++c) {
+                    partials[c] = chunk(c);
+                }
+            });
+            return std::accumulate(partials.begin(), partials.end(), init, reduce);
+        }
+        return with_policy(policy, n, cost, [&](auto& exec_) {
+            return std::transform_reduce(
+                exec_,
+                detail::IndexIterator{0}, detail::IndexIterator{chunks},
+                init,
+                reduce,
+                chunk
+            );
+        });
+    }
+
+    /// Run a standard algorithm over the index range [0, n) under the execution policy for it
+    // policy: the ExecPolicy or StaticPolicy tag to run with, where AUTO is resolved from n and cost
+    // cost: the cost class of the algorithm per element
+    // f: the function to execute, which takes an execution policy and the [begin, end) bounds to run over;
+    //    called once over the whole range, or once per task of the configured grain when a parallel
+    //    policy is scheduled on a backend other than STD, with SEQ or UNSEQ inside the task
+    template <class Policy, class F>
+    void for_each_partition(Policy policy, std::size_t n, OpCost cost, F&& f) {
+        if (const auto task_policy = detail::backend_task_policy(policy, n, cost)) {
+            parallel_for(n, parallel_config().grain, [&](std::size_t begin, std::size_t end) {
+                with_policy(*task_policy, [&](auto& exec_) { f(exec_, begin, end); });
+            });
+            return;
+        }
+        with_policy(policy, n, cost, [&](auto& exec_) { f(exec_, std::size_t{0}, n); });
+    }
+
+    /// Reduce the results of a standard algorithm run over the index range [0, n) under the execution
+    /// policy for it
+    // policy: the ExecPolicy or StaticPolicy tag to run with, where AUTO is resolved from n and cost
+    // cost: the cost class of the algorithm per element
+    // init: the identity of the reduction, used to combine the results of tasks
+    // reduce: the binary reduction applied to task results
+    // f: the function to execute, which takes an execution policy and the [begin, end) bounds to run over
+    //    and returns its result; called as for for_each_partition
+    template <class Policy, class T, class Reduce, class F>
+    T reduce_partitions(Policy policy, std::size_t n, OpCost cost, T init, Reduce reduce, F&& f) {
+        if (const auto task_policy = detail::backend_task_policy(policy, n, cost)) {
+            const auto grain = parallel_config().grain;
+            // fixed tasks, combined in index order, so the result does not depend on scheduling
+            std::vector<T> partials((n + grain - 1) / grain, init);
+            parallel_for(partials.size(), 1, [&](std::size_t first, std::size_t last) {
+                for (auto t = first; t < last; ++t) {
+                    const auto begin = t * grain;
+                    partials[t] = with_policy(*task_policy, [&](auto& exec_) {
+                        return f(exec_, begin, std::min(begin + grain, n));
+                    });
+                }
+            });
+            return std::accumulate(partials.begin(), partials.end(), init, reduce);
+        }
+        return with_policy(policy, n, cost, [&](auto& exec_) { return f(exec_, std::size_t{0}, n); });
+    }
+
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include "bitmap.h"
+#include "expr.h"
+#include "policy.h"
+#include "summation.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Rolling-window aggregations, as returned by Series::rolling() and SeriesView::rolling()
+//
+// A window is never recomputed: each step adds the element entering it and removes the one leaving, so
+// every aggregation costs O(1) amortized per element, and O(log window) for the median. Sums are
+// compensated so that the rounding error of the removals does not build up along the series, the
+// variance uses Welford's update run forwards and backwards, the minimum and maximum a monotonic deque
+// and the median two indexed heaps. The output is split into blocks, and each block starts window - 1
+// elements early to fill its first window, so blocks run in parallel under a parallel policy.
+namespace df {
+
+    namespace detail {
+
+        // Running sum of a window, compensated, with its NaN elements counted apart so that one leaving
+        // the window does not poison the sum for good
+        template <typename T>
+        struct SumWindow {
+            Compensated<T> total;
+            std::size_t nans{0};
+
+            void add(std::size_t, T x) {
+                if (x != x) {
+                    ++nans;
+                    return;
+                }
+                total.add(x);
+            }
+
+            void remove(std::size_t, T x) {
+                if (x != x) {
+                    --nans;
+                    return;
+                }
+                total.add(-x);
+            }
+
+            T sum() const {
+                return nans > 0 ? std::numeric_limits<T>::quiet_NaN() : total.value();
+            }
+        };
+
+        // Running mean and M2 of a window by Welford's update, with its NaN elements counted apart
+        template <typename T>
+        struct MomentsWindow {
+            std::size_t count{0};
+            std::size_t nans{0};
+            T mean{};
+            T m2{};
+
+            void add(std::size_t, T x) {
+                if (x != x) {
+                    ++nans;
+                    return;
+                }
+                ++count;
+                const T delta = x - mean;
+                mean += delta / static_cast<T>(count);
+                m2 += delta * (x - mean);
+            }
+
+            void remove(std::size_t, T x) {
+                if (x != x) {
+                    --nans;
+                    return;
+                }
+                if (--count == 0) {
+                    // start afresh rather than carry the rounding left over
+                    mean = T{};
+                    m2 = T{};
+                    return;
+                }
+                const T delta = x - mean;
+                mean -= delta / static_cast<T>(count);
+                m2 = std::max(T{}, m2 - delta * (x - mean));
+            }
+
+            // Variance with the given delta degrees of freedom; the window holds more than ddof numbers
+            T variance(std::size_t ddof) const {
+                return nans > 0 ? std::numeric_limits<T>::quiet_NaN() : m2 / static_cast<T>(count - ddof);
+            }
+        };
+
+        // Minimum (Max false) or maximum (Max true) of a window: a deque of the elements that can still
+        // become the extremum, in order of position and of value, as a ring buffer of at least window
+        // entries, a power of two so that positions wrap with a mask
+        // NaN elements are skipped
+        template <typename T, bool Max>
+        class ExtremumWindow {
+        public:
+            explicit ExtremumWindow(std::size_t window) : entries_(std::bit_ceil(window)), mask_(entries_.size() - 1) {}
+
+            void add(std::size_t i, T x) {
+                if (x != x) {
+                    return;
+                }
+                // drop every element that x outlasts and beats
+                while (size_ > 0 && !beats(back().second, x)) {
+                    --size_;
+                }
+                entries_[(head_ + size_) & mask_] = {i, x};
+                ++size_;
+            }
+
+            void remove(std::size_t i, T) {
+                if (size_ > 0 && entries_[head_].first == i) {
+                    head_ = (head_ + 1) & mask_;
+                    --size_;
+                }
+            }
+
+            // NaN when the window holds nothing but NaN
+            T value() const {
+                return size_ > 0 ? entries_[head_].second : std::numeric_limits<T>::quiet_NaN();
+            }
+
+        private:
+            std::vector<std::pair<std::size_t, T>> entries_;
+            std::size_t mask_;
+            std::size_t head_{0};
+            std::size_t size_{0};
+
+            static bool beats(T a, T b) { return Max ? b < a : a < b; }
+
+            const std::pair<std::size_t, T>& back() const {
+                return entries_[(head_ + size_ - 1) & mask_];
+            }
+        };
+
+        // Median of a window: the lower half in a max-heap and the upper half in a min-heap, the lower
+        // holding the extra element of an odd count
+        // Element i is kept in slot i modulo a power of two of at least window slots, whose heap and
+        // position are tracked so that the element leaving the window is removed directly rather than
+        // marked and dropped later. NaN elements are skipped
+        template <typename T>
+        class MedianWindow {
+        public:
+            explicit MedianWindow(std::size_t window)
+                : values_(std::bit_ceil(window)), side_(values_.size()), pos_(values_.size(), NONE), mask_(values_.size() - 1) {}
+
+            void add(std::size_t i, T x) {
+                if (x != x) {
+                    return;
+                }
+                const auto slot = i & mask_;
+                values_[slot] = x;
+                push(heaps_[LOW].empty() || !(top(LOW) < x) ? LOW : HIGH, slot);
+                balance();
+            }
+
+            void remove(std::size_t i, T) {
+                const auto slot = i & mask_;
+                if (pos_[slot] == NONE) {
+                    return;
+                }
+                erase(side_[slot], pos_[slot]);
+                pos_[slot] = NONE;
+                balance();
+            }
+
+            // NaN when the window holds nothing but NaN
+            T value() const {
+                if (heaps_[LOW].empty()) {
+                    return std::numeric_limits<T>::quiet_NaN();
+                }
+                if (heaps_[LOW].size() > heaps_[HIGH].size()) {
+                    return top(LOW);
+                }
+                return top(LOW) + (top(HIGH) - top(LOW)) / 2;
+            }
+
+        private:
+            static constexpr std::size_t NONE{static_cast<std::size_t>(-1)};
+            static constexpr std::size_t LOW{0};
+            static constexpr std::size_t HIGH{1};
+
+            std::vector<T> values_;
+            std::vector<std::size_t> heaps_[2];
+            // the heap and the position in it of the element in each slot, NONE when the slot is empty
+            std::vector<std::size_t> side_;
+            std::vector<std::size_t> pos_;
+            std::size_t mask_;
+
+            const T& top(std::size_t h) const { return values_[heaps_[h][0]]; }
+
+            // Whether slot a belongs above slot b in heap h
+            bool above(std::size_t h, std::size_t a, std::size_t b) const {
+                return h == LOW ? values_[b] < values_[a] : values_[a] < values_[b];
+            }
+
+            void place(std::size_t h, std::size_t p, std::size_t slot) {
+                heaps_[h][p] = slot;
+                side_[slot] = h;
+                pos_[slot] = p;
+            }
+
+            void sift_up(std::size_t h, std::size_t p) {
+                const auto slot = heaps_[h][p];
+                while (p > 0 && above(h, slot, heaps_[h][(p - 1) / 2])) {
+                    place(h, p, heaps_[h][(p - 1) / 2]);
+                    p = (p - 1) / 2;
+                }
+                place(h, p, slot);
+            }
+
+            void sift_down(std::size_t h, std::size_t p) {
+                const auto& heap = heaps_[h];
+                const auto slot = heap[p];
+                while (true) {
+                    auto child = 2 * p + 1;
+                    if (child >= heap.size()) {
+                        break;
+                    }
+                    if (child + 1 < heap.size() && above(h, heap[child + 1], heap[child])) {
+                        ++child;
+                    }
+                    if (!above(h, heap[child], slot)) {
+                        break;
+                    }
+                    place(h, p, heap[child]);
+                    p = child;
+                }
+                place(h, p, slot);
+            }
+
+            void push(std::size_t h, std::size_t slot) {
+                heaps_[h].push_back(slot);
+                sift_up(h, heaps_[h].size() - 1);
+            }
+
+            void erase(std::size_t h, std::size_t p) {
+                const auto last = heaps_[h].back();
+                heaps_[h].pop_back();
+                if (p < heaps_[h].size()) {
+                    place(h, p, last);
+                    sift_up(h, p);
+                    sift_down(h, pos_[last]);
+                }
+            }
+
+            // Move the top of heap h to the other heap
+            void move_top(std::size_t h) {
+                const auto slot = heaps_[h][0];
+                erase(h, 0);
+                push(1 - h, slot);
+            }
+
+            void balance() {
+                if (heaps_[LOW].size() > heaps_[HIGH].size() + 1) {
+                    move_top(LOW);
+                }
+                else if (heaps_[HIGH].size() > heaps_[LOW].size()) {
+                    move_top(HIGH);
+                }
+            }
+        };
+
+    }
+
+    // Aggregations over a window of the window elements up to and including each element of a view
+    //
+    // Every aggregation returns a Series of the same size as the view, whose element i aggregates the
+    // non-null elements among [i - window + 1, i]; it is null where there are fewer of them than
+    // min_periods. Integer elements are aggregated as double. The sum, mean, variance and standard
+    // deviation are NaN while the window holds a NaN, as for sum(); the minimum, maximum and median
+    // skip NaN, as min() does, and are NaN when the window holds nothing else.
+    // View_: the read-only SeriesView aggregated
+    template <typename View_>
+    class Rolling {
+    public:
+        using value_type = typename View_::value_type;
+        using result_type = std::conditional_t<std::is_floating_point_v<value_type>, value_type, double>;
+        using series_type = Series<result_type>;
+
+        // Throws std::invalid_argument if window or min_periods is 0, or min_periods exceeds window
+        // min_periods: the fewest non-null elements a window needs for a result, window by default
+        Rolling(View_ view, std::size_t window, std::optional<std::size_t> min_periods = std::nullopt)
+            : view_(view), window_(window), min_periods_(min_periods.value_or(window)) {
+            if (window_ == 0) {
+                throw std::invalid_argument("Rolling window must be positive");
+            }
+            if (min_periods_ == 0 || min_periods_ > window_) {
+                throw std::invalid_argument("Rolling min_periods must be between 1 and the window");
+            }
+        }
+
+        std::size_t window() const noexcept { return window_; }
+        std::size_t min_periods() const noexcept { return min_periods_; }
+
+        series_type sum() const {
+            return slide([] { return detail::SumWindow<result_type>{}; },
+                [](const auto& w, std::size_t) { return w.sum(); }, OpCost::LIGHT);
+        }
+
+        series_type mean() const {
+            return slide([] { return detail::SumWindow<result_type>{}; },
+                [](const auto& w, std::size_t count) { return w.sum() / static_cast<result_type>(count); }, OpCost::LIGHT);
+        }
+
+        // Variance with the given delta degrees of freedom, population by default as variance()
+        // Also null where the window holds no more than ddof non-null elements
+        series_type variance(std::size_t ddof = 0) const {
+            return slide([] { return detail::MomentsWindow<result_type>{}; },
+                [ddof](const auto& w, std::size_t count) -> std::optional<result_type> {
+                    if (count <= ddof) {
+                        return std::nullopt;
+                    }
+                    return w.variance(ddof);
+                }, OpCost::MEDIUM);
+        }
+
+        // Standard deviation with the given delta degrees of freedom, as variance()
+        series_type stddev(std::size_t ddof = 0) const {
+            return slide([] { return detail::MomentsWindow<result_type>{}; },
+                [ddof](const auto& w, std::size_t count) -> std::optional<result_type> {
+                    if (count <= ddof) {
+                        return std::nullopt;
+                    }
+                    return std::sqrt(w.variance(ddof));
+                }, OpCost::MEDIUM);
+        }
+
+        series_type min() const {
+            const auto window = window_;
+            return slide([window] { return detail::ExtremumWindow<result_type, false>(window); },
+                [](const auto& w, std::size_t) { return w.value(); }, OpCost::LIGHT);
+        }
+
+        series_type max() const {
+            const auto window = window_;
+            return slide([window] { return detail::ExtremumWindow<result_type, true>(window); },
+                [](const auto& w, std::size_t) { return w.value(); }, OpCost::LIGHT);
+        }
+
+        // The middle element, or the mean of the two middle elements of an even count
+        series_type median() const {
+            const auto window = window_;
+            return slide([window] { return detail::MedianWindow<result_type>(window); },
+                [](const auto& w, std::size_t) { return w.value(); }, OpCost::HEAVY);
+        }
+
+    private:
+        View_ view_;
+        std::size_t window_;
+        std::size_t min_periods_;
+
+        /// Slide a window over every block of the output, filling each block's first window from the
+        /// elements before it
+        // make: returns an empty window state, with add(i, x) and remove(i, x) for the i-th element x
+        // result: takes the state and its number of non-null elements, at least min_periods, and
+        //         returns the output, or std::nullopt for a null
+        // cost: the cost class of one step, for ExecPolicy::AUTO
+        template <typename Make, typename Result>
+        series_type slide(const Make& make, const Result& result, OpCost cost) const {
+            const auto n = view_.size();
+            typename series_type::container_type out(n);
+            Bitmap valid(n);
+            const bool nulls = view_.has_nulls();
+            const auto& view = view_;
+            const auto window = window_;
+            const auto min_periods = min_periods_;
+            // blocks of whole bitmap words, so that no two tasks write the same word, and several
+            // windows long, so that filling the first window is a small part of each
+            const auto grain = (std::max(DEFAULT_GRAIN, 4 * window) + Bitmap::WORD_BITS - 1) / Bitmap::WORD_BITS * Bitmap::WORD_BITS;
+            for_each_chunk(view_.exec_policy(), n, grain, [&](std::size_t begin, std::size_t end) {
+                auto state = make();
+                std::size_t count = 0;
+                const auto start = begin + 1 >= window ? begin + 1 - window : 0;
+                for (auto i = start; i < end; ++i) {
+                    if (i >= window && i - window >= start && (!nulls || view.is_valid(i - window))) {
+                        state.remove(i - window, static_cast<result_type>(view[i - window]));
+                        --count;
+                    }
+                    if (!nulls || view.is_valid(i)) {
+                        state.add(i, static_cast<result_type>(view[i]));
+                        ++count;
+                    }
+                    if (i < begin) {
+                        continue;
+                    }
+                    std::optional<result_type> value;
+                    if (count >= min_periods) {
+                        value = result(state, count);
+                    }
+                    if (value) {
+                        out[i] = *value;
+                    }
+                    else {
+                        out[i] = result_type{};
+                        valid.set(i, false);
+                    }
+                }
+            }, cost);
+            if (valid.all()) {
+                return series_type(view_.exec_policy(), std::move(out));
+            }
+            series_type series(std::move(out), std::move(valid));
+            series.set_exec_policy(view_.exec_policy());
+            return series;
+        }
+    };
+
+}
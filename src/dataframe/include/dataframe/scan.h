@@ -0,0 +1,99 @@
+#pragma once
+
+#include "bitmap.h"
+#include "policy.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+
+// Parallel inclusive scans, as used by Series::cumsum and the other cumulative operations
+//
+// A scan is run in two passes over one block of the input per task: the first reduces every block,
+// the totals are scanned in order to give the value carried into each block, and the second pass scans
+// every block from its carry. Each element is read twice and written once, all tasks are busy in both
+// passes, and with a single task (a sequential policy, or a single thread) the first pass is skipped.
+// Blocks are whole bitmap words long, so a scan can write a validity bitmap of its own as it goes.
+namespace df::detail {
+
+    // Fewest elements given to one task of a parallel scan
+    inline constexpr std::size_t SCAN_BLOCK{1 << 15};
+
+    // The cumulative operations
+    enum class ScanOp {
+        SUM,
+        PROD,
+        MIN,
+        MAX
+    };
+
+    // The value that leaves every other unchanged under an operation
+    template <ScanOp Op, typename T>
+    constexpr T scan_identity() {
+        using limits = std::numeric_limits<T>;
+        if constexpr (Op == ScanOp::SUM) {
+            return T{0};
+        }
+        else if constexpr (Op == ScanOp::PROD) {
+            return T{1};
+        }
+        else if constexpr (Op == ScanOp::MIN) {
+            return limits::has_infinity ? limits::infinity() : limits::max();
+        }
+        else {
+            return limits::has_infinity ? -limits::infinity() : limits::lowest();
+        }
+    }
+
+    // acc combined with x under an operation; MIN and MAX keep acc when x is NaN
+    template <ScanOp Op, typename T>
+    T scan_apply(const T& acc, const T& x) {
+        if constexpr (Op == ScanOp::SUM) {
+            return acc + x;
+        }
+        else if constexpr (Op == ScanOp::PROD) {
+            return acc * x;
+        }
+        else if constexpr (Op == ScanOp::MIN) {
+            return x < acc ? x : acc;
+        }
+        else {
+            return acc < x ? x : acc;
+        }
+    }
+
+    /// Inclusive scan of the index range [0, n) in two passes over one block per task
+    // policy: the ExecPolicy the blocks are scheduled with, where AUTO is resolved from n
+    // identity: the carry into the first block
+    // op: the associative operation combining the carries with the block totals
+    // reduce: takes the [begin, end) bounds of a block and returns its total
+    // scan: takes the [begin, end) bounds of a block and the carry into it, and scans the block
+    template <typename T, typename Op, typename Reduce, typename Scan>
+    void chunked_scan(ExecPolicy policy, std::size_t n, T identity, Op op, Reduce&& reduce, Scan&& scan) {
+        const auto resolved = resolve(policy, n, OpCost::LIGHT);
+        const auto tasks = resolved == ExecPolicy::PAR || resolved == ExecPolicy::PAR_UNSEQ
+            ? std::min(n / SCAN_BLOCK, parallel_concurrency() > 1 ? 4 * std::size_t{parallel_concurrency()} : 1)
+            : 1;
+        if (tasks <= 1) {
+            scan(std::size_t{0}, n, identity);
+            return;
+        }
+        const auto block = ((n + tasks - 1) / tasks + Bitmap::WORD_BITS - 1) / Bitmap::WORD_BITS * Bitmap::WORD_BITS;
+        std::vector<T> carries((n + block - 1) / block, identity);
+        for_each_chunk(resolved, n, block, [&](std::size_t begin, std::size_t end) {
+            carries[begin / block] = reduce(begin, end);
+        }, OpCost::LIGHT);
+        T carry = identity;
+        for (auto& total : carries) {
+            const T next = op(carry, total);
+            total = carry;
+            carry = next;
+        }
+        for_each_chunk(resolved, n, block, [&](std::size_t begin, std::size_t end) {
+            scan(begin, end, carries[begin / block]);
+        }, OpCost::LIGHT);
+    }
+
+}
@@ -1,190 +1,258 @@
 #pragma once
 
+#include "bitmap.h"
+#include "policy.h"
+#include "expr.h"
+#include "kernels.h"
+#include "moments.h"
+#include "scan.h"
+#include "summation.h"
+#include "view.h"
+
 #include <algorithm>
-#include <cassert>
 #include <cmath>
-#include <cstdlib>
 #include <execution>
 #include <vector>
 #include <iostream>
 #include <optional>
+#include <stdexcept>
 
 
 namespace df {
 
-    enum class ExecPolicy {
-        SEQ,
-        PAR,
-        UNSEQ,
-        PAR_UNSEQ
-    };
-
-    [[noreturn]] inline void unreachable_policy() noexcept {
-        assert(false && "Unknown ExecPolicy"); // in debug
-        std::abort();                          // hard-stop in release
-    }
-
-    /// Helper to execute a function with the appropriate execution policy
-    // policy: the execution policy to use
-    // f: the function to execute, which takes an execution policy as argument
-    template <class F>
-    decltype(auto) with_policy(ExecPolicy policy, F&& f) {
-        switch (policy) {
-        case ExecPolicy::SEQ:
-            return f(std::execution::seq);
-        case ExecPolicy::PAR:
-            return f(std::execution::par);
-        case ExecPolicy::PAR_UNSEQ:
-            return f(std::execution::par_unseq);
-        case ExecPolicy::UNSEQ:
-            return f(std::execution::unseq);
-        }
-
-        // should not reach here, but assert/abort to be safe
-        unreachable_policy();
-    }
-
-    template <typename DataType_>
+    // A column of values stored contiguously
+    // DataType_: the element type
+    // Allocator_: the allocator of the underlying storage, cache-line aligned with huge pages for large buffers by default
+    template <typename DataType_, typename Allocator_>
     class Series {
     public:
         using value_type = DataType_;
-        using container_type = std::vector<DataType_>;
+        using allocator_type = Allocator_;
+        using container_type = std::vector<DataType_, Allocator_>;
         using iterator = typename container_type::iterator;
         using const_iterator = typename container_type::const_iterator;
 
         // Construct a Series by applying a monadic functor to an input Series
-        template <typename T, typename Func>
-        Series(const Series<T>& other, Func&& func) : data_(other.size()) {
+        template <typename T, typename A, typename Func>
+        Series(const Series<T, A>& other, Func&& func) : data_(other.size()), validity_(other.validity_) {
             other.transform_to(*this, std::forward<Func>(func));
         }
         
         // Construct a Series by applying a dyadic functor to two input Series
-        template <typename T, typename J, typename Func>
-        Series(const Series<T>& lhs, const Series<J>& rhs, Func&& func)  {
+        template <typename T, typename A, typename J, typename B, typename Func>
+        Series(const Series<T, A>& lhs, const Series<J, B>& rhs, Func&& func)  {
             if (lhs.size() != rhs.size()) {
                 throw std::invalid_argument("Series sizes do not match for dyadic operation");
             }
             data_.resize(lhs.size());
+            validity_ = intersect(lhs.validity_, rhs.validity_);
             lhs.transform_to(rhs, *this, std::forward<Func>(func));
         }
 
-        explicit Series(std::vector<DataType_> data): data_(std::move(data)) {}
+        // Construct a Series by evaluating a lazy expression in a single pass
+        // The series inherits the execution policy of the expression
+        template <typename E>
+        Series(const SeriesExpr<E>& expr)
+            : exec_(expr.derived().exec_policy()), data_(expr.derived().size()), validity_(expr.validity()) {
+            expr.derived().eval_to(data_.begin());
+        }
+
+        // Construct a Series from a temporary expression
+        // When the expression owns a temporary Series of this type, e.g. std::move(a) + b, the result is
+        // computed in place into that buffer and no new storage is allocated
+        template <typename E> requires (detail::is_expr_v<E> && !std::is_lvalue_reference_v<E>)
+        Series(E&& expr) : exec_(expr.exec_policy()), validity_(expr.validity()) {
+            if (auto* owned = detail::owned_series<Series>(expr)) {
+                expr.eval_to(owned->data_.begin());
+                data_ = std::move(owned->data_);
+            }
+            else {
+                data_.resize(expr.size());
+                expr.eval_to(data_.begin());
+            }
+        }
+
+        explicit Series(container_type data): data_(std::move(data)) {}
         explicit Series(std::initializer_list<DataType_> data): data_(std::move(data)) {}
-        Series(ExecPolicy policy, std::vector<DataType_> data): data_(std::move(data)), exec_(policy) {}
+        Series(ExecPolicy policy, container_type data): exec_(policy), data_(std::move(data)) {}
+
+        // Construct a Series with nulls where the validity bitmap is clear
+        Series(container_type data, Bitmap validity): data_(std::move(data)) {
+            set_validity(std::move(validity));
+        }
+
+        // Construct a Series by copying a vector that uses a different allocator
+        template <typename A> requires (!std::is_same_v<std::vector<DataType_, A>, container_type>)
+        explicit Series(const std::vector<DataType_, A>& data): data_(data.begin(), data.end()) {}
+
+        template <typename A> requires (!std::is_same_v<std::vector<DataType_, A>, container_type>)
+        Series(ExecPolicy policy, const std::vector<DataType_, A>& data): exec_(policy), data_(data.begin(), data.end()) {}
         Series() = default;
 
         // lvalue operations (ops on named values)
 
         template <typename T>
         auto& add(const T& val) & {
-            return transform([val](const auto& x) { return val + x; });
+            return transform(kernels::BinaryOp::ADD, val, [val](const auto& x) { return val + x; });
         }
 
-        template <typename T>
-        auto& add(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return x + o; });
+        template <typename T, typename A>
+        auto& add(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::ADD, other, [](const auto& x, const auto& o) { return x + o; });
         }
 
         template <typename T>
         auto& sub(const T& val) & {
-            return transform([val](const auto& x) { return x - val; });
+            return transform(kernels::BinaryOp::SUB, val, [val](const auto& x) { return x - val; });
         }
 
-        template <typename T>
-        auto& sub(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return x - o; });
+        template <typename T, typename A>
+        auto& sub(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::SUB, other, [](const auto& x, const auto& o) { return x - o; });
         }
 
         template <typename T>
         auto& rsub(const T& val) & {
-            return transform([val](const auto& x) { return val - x; });
+            return transform(kernels::BinaryOp::RSUB, val, [val](const auto& x) { return val - x; });
         }
 
-        template <typename T>
-        auto& rsub(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return o - x; });
+        template <typename T, typename A>
+        auto& rsub(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::RSUB, other, [](const auto& x, const auto& o) { return o - x; });
         }
 
         template <typename T>
         auto& mul(const T& val) & {
-            return transform([val](const auto& x) { return x * val; });
+            return transform(kernels::BinaryOp::MUL, val, [val](const auto& x) { return x * val; });
         }
 
-        template <typename T>
-        auto& mul(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return x * o; });
+        template <typename T, typename A>
+        auto& mul(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::MUL, other, [](const auto& x, const auto& o) { return x * o; });
         }
 
-        template <typename T>
-        auto& div(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return x / o; });
+        template <typename T, typename A>
+        auto& div(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::DIV, other, [](const auto& x, const auto& o) { return x / o; });
         }
 
         template <typename T>
         auto& div(const T& val) & {
-            return transform([val](const auto& x) { return x / val; });
+            return transform(kernels::BinaryOp::DIV, val, [val](const auto& x) { return x / val; });
         }
 
         template <typename T>
         auto& rdiv(const T& val) & {
-            return transform([val](const auto& x) { return val / x; });
+            return transform(kernels::BinaryOp::RDIV, val, [val](const auto& x) { return val / x; });
         }
 
-        template <typename T>
-        auto& rdiv(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return o / x; });
+        template <typename T, typename A>
+        auto& rdiv(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::RDIV, other, [](const auto& x, const auto& o) { return o / x; });
         }
         
         template <typename T>
         auto& pow(const T& val) & {
-            return transform([val](const auto& x) { return std::pow(x, val); });
+            return transform(kernels::BinaryOp::POW, val, [val](const auto& x) { return std::pow(x, val); });
         }
 
-        template <typename T>
-        auto& pow(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return std::pow(x, o); });
+        template <typename T, typename A>
+        auto& pow(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::POW, other, [](const auto& x, const auto& o) { return std::pow(x, o); });
         }
 
         template <typename T>
         auto& min(const T& val) & {
-            return transform([val](const auto& x) { return std::min(x, val); });
+            return transform(kernels::BinaryOp::MIN, val, [val](const auto& x) { return std::min(x, val); });
         }
 
-        template <typename T>
-        auto& min(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return std::min(x, o); });
+        template <typename T, typename A>
+        auto& min(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::MIN, other, [](const auto& x, const auto& o) { return std::min(x, o); });
         }
 
         template <typename T>
         auto& max(const T& val) & {
-            return transform([val](const auto& x) { return std::max(x, val); });
+            return transform(kernels::BinaryOp::MAX, val, [val](const auto& x) { return std::max(x, val); });
         }
 
-        template <typename T>
-        auto& max(const Series<T>& other) & {
-            return transform(other, [](const auto& x, const auto& o) { return std::max(x, o); });
+        template <typename T, typename A>
+        auto& max(const Series<T, A>& other) & {
+            return transform(kernels::BinaryOp::MAX, other, [](const auto& x, const auto& o) { return std::max(x, o); });
         }
 
         auto& exp() & {
-            return transform([](const auto& x) { return std::exp(x); });
+            return transform(kernels::UnaryOp::EXP, [](const auto& x) { return std::exp(x); });
         }
 
         auto& log() & {
-            return transform([](const auto& x) { return std::log(x); });
+            return transform(kernels::UnaryOp::LOG, [](const auto& x) { return std::log(x); });
         }
 
         auto& sqrt() & {
-            return transform([](const auto& x) { return std::sqrt(x); });
+            return transform(kernels::UnaryOp::SQRT, [](const auto& x) { return std::sqrt(x); });
         }
 
         auto& abs() & {
-            return transform([](const auto& x) { return std::abs(x); });
+            return transform(kernels::UnaryOp::ABS, [](const auto& x) { return std::abs(x); });
         }
 
         auto& signum() & {
             return transform([](const auto& x) { return (x > 0) - (x < 0); });
         }
 
+        // Cumulative operations, in place: each element becomes the sum, product, minimum or maximum of
+        // the elements up to and including it
+        // Nulls are skipped and stay null; cummin and cummax also skip NaN, which cumsum and cumprod
+        // propagate. Parallel policies scan one block per thread in two passes, so floating point sums
+        // and products may differ from a sequential loop in the last bits
+
+        auto& cumsum() & {
+            return cumulative<detail::ScanOp::SUM>();
+        }
+
+        auto& cumprod() & {
+            return cumulative<detail::ScanOp::PROD>();
+        }
+
+        auto& cummin() & {
+            return cumulative<detail::ScanOp::MIN>();
+        }
+
+        auto& cummax() & {
+            return cumulative<detail::ScanOp::MAX>();
+        }
+
+        // Put the elements in order, stably, with NaN and then nulls last (see argsort())
+        auto& sort(bool ascending = true) & {
+            *this = detail::gather(*this, argsort(ascending));
+            return *this;
+        }
+
+        // Write the elements of values to the given positions, in order, with their nulls
+        // e.g. s.scatter({3, 0}, Series<double>({1.5, 2.5})) sets s[3] to 1.5 and s[0] to 2.5
+        // Each task prefetches the lines it is about to write. Where a position repeats, the last of its
+        // values is kept; under a parallel policy repeated positions are found first, in a parallel pass,
+        // and the writes then run in order
+        // Throws std::invalid_argument if values is not the size of indices, and std::out_of_range if a
+        // position is not below size()
+        template <typename A>
+        auto& scatter(const std::vector<std::size_t>& indices, const Series<DataType_, A>& values) & {
+            if (values.size() != indices.size()) {
+                throw std::invalid_argument("Values size does not match the indices");
+            }
+            detail::check_indices(exec_, indices, size());
+            const auto policy = detail::scatter_policy(exec_, indices, size());
+            detail::scatter(policy, std::to_address(values.begin()), indices, data_.data());
+            if (validity_ || values.has_nulls()) {
+                if (!validity_) {
+                    validity_.emplace(size(), true);
+                }
+                detail::scatter(policy, values.has_nulls() ? &*values.validity() : nullptr, indices, *validity_);
+            }
+            return *this;
+        }
+
         // rvalue overloads (ops on temporary values)
 
         template <typename T>
@@ -193,8 +261,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& add(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& add(const Series<T, A>& other) && {
            add(other);
            return std::move(*this);
         }
@@ -205,8 +273,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& sub(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& sub(const Series<T, A>& other) && {
            sub(other);
            return std::move(*this);
         }
@@ -217,8 +285,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& rsub(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& rsub(const Series<T, A>& other) && {
            rsub(other);
            return std::move(*this);
         }
@@ -229,8 +297,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& mul(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& mul(const Series<T, A>& other) && {
            mul(other);
            return std::move(*this);
         }
@@ -241,8 +309,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& div(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& div(const Series<T, A>& other) && {
            div(other);
            return std::move(*this);
         }
@@ -253,8 +321,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& rdiv(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& rdiv(const Series<T, A>& other) && {
            rdiv(other);
            return std::move(*this);
         }
@@ -265,8 +333,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& pow(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& pow(const Series<T, A>& other) && {
            pow(other);
            return std::move(*this);
         }
@@ -277,8 +345,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& min(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& min(const Series<T, A>& other) && {
            min(other);
            return std::move(*this);
         }
@@ -289,8 +357,8 @@ namespace df {
            return std::move(*this);
         }
 
-        template <typename T>
-        auto&& max(const Series<T>& other) && {
+        template <typename T, typename A>
+        auto&& max(const Series<T, A>& other) && {
            max(other);
            return std::move(*this);
         }
@@ -320,51 +388,108 @@ namespace df {
            return std::move(*this);
         }
 
-        // Operators
-
-        template <typename LhsT, typename RhsT>
-        friend auto operator+(const Series<LhsT>& lhs, const Series<RhsT>& rhs);
+        auto&& cumsum() && {
+           cumsum();
+           return std::move(*this);
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator+(const Series<LhsT>& lhs, const RhsT& rhs);
+        auto&& cumprod() && {
+           cumprod();
+           return std::move(*this);
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator+(const LhsT& lhs, const Series<RhsT>& rhs);
+        auto&& cummin() && {
+           cummin();
+           return std::move(*this);
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator-(const Series<LhsT>& lhs, const Series<RhsT>& rhs);
+        auto&& cummax() && {
+           cummax();
+           return std::move(*this);
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator-(const Series<LhsT>& lhs, const RhsT& rhs);
+        auto&& sort(bool ascending = true) && {
+           sort(ascending);
+           return std::move(*this);
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator-(const LhsT& lhs, const Series<RhsT>& rhs);
+        template <typename A>
+        auto&& scatter(const std::vector<std::size_t>& indices, const Series<DataType_, A>& values) && {
+           scatter(indices, values);
+           return std::move(*this);
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator*(const Series<LhsT>& lhs, const Series<RhsT>& rhs);
+        // Operators
+        //
+        // The arithmetic operators and math functions of series (see expr.h) return lazy expressions
+        // rather than Series: a + b * 2.0 is a MapExpr, computed in a single pass once it is assigned to
+        // or constructs a Series, is reduced with sum() or mean(), or is materialized with eval().
+        // Temporary operands are moved into the expression and live as long as it does, but named
+        // series are referenced, so `auto c = a + b` must not outlive a or b, and sees any change made
+        // to them before it is evaluated. Declare the result a Series to compute it at once, as in
+        // Series<double> c = a + b
+
+        // Evaluate a lazy expression into this series
+        // Storage is reused when the sizes match, which is safe even when the expression reads this
+        // series as long as every element is computed from the operands at the same index; an
+        // expression that reads across positions, as a shift does, is built into fresh storage
+        template <typename E>
+        Series& operator=(const SeriesExpr<E>& expr) {
+            if constexpr (detail::reads_across_v<E>) {
+                *this = Series(expr);
+            }
+            else if (expr.derived().size() == size()) {
+                validity_ = expr.validity();
+                expr.derived().eval_to(data_.begin());
+            }
+            else {
+                *this = Series(expr);
+            }
+            return *this;
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator*(const Series<LhsT>& lhs, const RhsT& rhs);
+        template <typename E> requires (detail::is_expr_v<E> && !std::is_lvalue_reference_v<E>)
+        Series& operator=(E&& expr) {
+            if constexpr (detail::reads_across_v<E>) {
+                *this = Series(std::move(expr));
+            }
+            else if (expr.size() == size()) {
+                validity_ = expr.validity();
+                expr.eval_to(data_.begin());
+            }
+            else {
+                *this = Series(std::move(expr));
+            }
+            return *this;
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator*(const LhsT& lhs, const Series<RhsT>& rhs);
+        template <typename E> requires detail::is_expr_v<E>
+        auto& operator+=(const E& expr) {
+            return *this = *this + expr;
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator/(const Series<LhsT>& lhs, const Series<RhsT>& rhs);
+        template <typename E> requires detail::is_expr_v<E>
+        auto& operator-=(const E& expr) {
+            return *this = *this - expr;
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator/(const Series<LhsT>& lhs, const RhsT& rhs);
+        template <typename E> requires detail::is_expr_v<E>
+        auto& operator*=(const E& expr) {
+            return *this = *this * expr;
+        }
 
-        template <typename LhsT, typename RhsT>
-        friend auto operator/(const LhsT& lhs, const Series<RhsT>& rhs);
+        template <typename E> requires detail::is_expr_v<E>
+        auto& operator/=(const E& expr) {
+            return *this = *this / expr;
+        }
 
         template <typename T>
         auto& operator+=(const T& val) {
             return add(val);
         }
 
-        template <typename T>
-        auto& operator+=(const Series<T>& other) {
+        template <typename T, typename A>
+        auto& operator+=(const Series<T, A>& other) {
             return add(other);
         }
 
@@ -373,8 +498,8 @@ namespace df {
             return sub(val);
         }
 
-        template <typename T>
-        auto& operator-=(const Series<T>& other) {
+        template <typename T, typename A>
+        auto& operator-=(const Series<T, A>& other) {
             return sub(other);
         }
 
@@ -383,8 +508,8 @@ namespace df {
             return mul(val);
         }
 
-        template <typename T>
-        auto& operator*=(const Series<T>& other) {
+        template <typename T, typename A>
+        auto& operator*=(const Series<T, A>& other) {
             return mul(other);
         }
 
@@ -393,127 +518,284 @@ namespace df {
             return div(val);
         }
 
-        template <typename T>
-        auto& operator/=(const Series<T>& other) {
+        template <typename T, typename A>
+        auto& operator/=(const Series<T, A>& other) {
             return div(other);
         }
 
+        // Views
+
+        // A view of the whole series, through which its aggregations are computed
+        SeriesView<DataType_> view() & noexcept {
+            return {data_.data(), size(), 1, validity_ ? &*validity_ : nullptr, 0, exec_};
+        }
+
+        SeriesView<const DataType_> view() const & noexcept {
+            return {data_.data(), size(), 1, validity_ ? &*validity_ : nullptr, 0, exec_};
+        }
+
+        // A view of the whole series whose every operation runs on a compile-time policy, so that nothing
+        // is dispatched at run time, e.g. s.view<exec::Unseq>().sum()
+        template <StaticPolicy P>
+        SeriesView<DataType_, P> view() & noexcept {
+            return view().template view<P>();
+        }
+
+        template <StaticPolicy P>
+        SeriesView<const DataType_, P> view() const & noexcept {
+            return view().template view<P>();
+        }
+
+        // A view of the elements [begin, end), every step-th one, sharing the storage of the series
+        // The bounds are clamped to the series, as in Python slicing
+        // Throws std::invalid_argument if step is 0
+        SeriesView<DataType_> slice(std::size_t begin, std::size_t end, std::size_t step = 1) & {
+            return view().slice(begin, end, step);
+        }
+
+        SeriesView<const DataType_> slice(std::size_t begin, std::size_t end, std::size_t step = 1) const & {
+            return view().slice(begin, end, step);
+        }
+
+        // A view of the first n elements, or all of them if there are fewer
+        SeriesView<DataType_> head(std::size_t n = 5) & {
+            return view().head(n);
+        }
+
+        SeriesView<const DataType_> head(std::size_t n = 5) const & {
+            return view().head(n);
+        }
+
+        // A view of the last n elements, or all of them if there are fewer
+        SeriesView<DataType_> tail(std::size_t n = 5) & {
+            return view().tail(n);
+        }
+
+        SeriesView<const DataType_> tail(std::size_t n = 5) const & {
+            return view().tail(n);
+        }
+
+        // A view of a temporary would dangle
+        void view() && = delete;
+        template <StaticPolicy P>
+        void view() && = delete;
+        void slice(std::size_t, std::size_t, std::size_t = 1) && = delete;
+        void head(std::size_t = 5) && = delete;
+        void tail(std::size_t = 5) && = delete;
+
         // Aggregation functions
+        // Null elements are skipped; see SeriesView for how each one is computed
 
-        // Dot product of this series with another
+        // Dot product of this series with another series or view, over the elements valid in both
         // Will return the identity element (0) if empty
-        template <typename T, typename J=DataType_>
-        J dot(const Series<T>& other) const {
-            return std::transform_reduce(
-                exec_,
-                data_.begin(), data_.end(),
-                other.data_.begin(),
-                J{},
-                std::plus<>(),
-                std::multiplies<>()
-            );
-        }
-
-        // Sum of all elements in the series
-        // Returns std::nullopt if the series is empty
-        template <typename T = DataType_>
-        std::optional<T> sum() const {
-            if (size() == 0) {
-                return std::nullopt;
-            }
-            return with_policy(exec_, [&](auto& exec_){
-                return std::reduce(exec_, data_.begin(), data_.end(), T{}, std::plus<>{});
-            });
+        // Throws std::invalid_argument if the sizes differ
+        // mode: how the products are accumulated
+        template <typename Other_, typename J = DataType_>
+        J dot(const Other_& other, Summation mode = Summation::NAIVE) const {
+            return view().template dot<Other_, J>(other, mode);
         }
 
-        // Mean of all elements in the series
-        // Returns std::nullopt if the series is empty
+        // Sum of all non-null elements in the series
+        // Returns std::nullopt if there are none
+        // mode: how the elements are accumulated
         template <typename T = DataType_>
-        std::optional<T> mean() const {
-            if (size() == 0) {
-                return std::nullopt;
-            }
-            return sum().value() / static_cast<T>(size());
+        std::optional<T> sum(Summation mode = Summation::NAIVE) const {
+            return view().template sum<T>(mode);
         }
 
-        // Variance of all elements in the series
-        // Returns std::nullopt if the series is empty
+        // Mean of all non-null elements in the series
+        // Returns std::nullopt if there are none
+        // mode: how the elements are accumulated
         template <typename T = DataType_>
+        std::optional<T> mean(Summation mode = Summation::NAIVE) const {
+            return view().template mean<T>(mode);
+        }
+
+        // Count, mean, M2, min and max of all non-null elements, gathered in a single pass over the data
+        // Integers are accumulated in double unless another type is asked for
+        // Returns std::nullopt if there are no non-null elements
+        template <typename T = detail::accumulator_t<DataType_>>
+        std::optional<Moments<T>> moments() const {
+            return view().template moments<T>();
+        }
+
+        // Variance of all non-null elements in the series
+        // Returns std::nullopt if there are none
+        template <typename T = detail::accumulator_t<DataType_>>
         std::optional<T> variance() const {
-            if (size() == 0) {
-                return std::nullopt;
-            }
-            const auto m = mean().value();
-            return with_policy(exec_, [&](auto& exec_){
-                return std::transform_reduce(
-                    exec_,
-                    data_.begin(), data_.end(),
-                    T{},
-                    std::plus<>(),
-                    [&m](const auto& x) { return (x - m) * (x - m); }
-                ) / static_cast<T>(size());
-            });
+            return view().template variance<T>();
         }
 
-        // Standard deviation of all elements in the series
-        // Returns std::nullopt if the series is empty
-        template <typename T = DataType_>
+        // Standard deviation of all non-null elements in the series
+        // Returns std::nullopt if there are none
+        template <typename T = detail::accumulator_t<DataType_>>
         std::optional<T> stddev() const {
-            if (size() == 0) {
-                return std::nullopt;
-            }
-            return std::sqrt(variance().value());
+            return view().template stddev<T>();
         }
 
-        // Minimum element in the series
-        // Returns std::nullopt if the series is empty
+        // Minimum non-null element in the series, the first of equal minima; NaN elements are skipped
+        // Returns std::nullopt if there are none
         std::optional<std::reference_wrapper<const DataType_>> min() const {
-            if (size() == 0) {
-                return std::nullopt;
-            }
-            auto min_it = with_policy(exec_, [&](auto& exec_){
-                return std::min_element(exec_, data_.begin(), data_.end());
-            });
-            return std::ref(*min_it);
+            return view().min();
         }
 
-        // Maximum element in the series
-        // Returns std::nullopt if the series is empty
+        // Maximum non-null element in the series, the first of equal maxima; NaN elements are skipped
+        // Returns std::nullopt if there are none
         std::optional<std::reference_wrapper<const DataType_>> max() const {
-            if (size() == 0) {
-                return std::nullopt;
+            return view().max();
+        }
+
+        // Position and value of the first minimum non-null element
+        // Returns std::nullopt if there are none
+        // nan: whether NaN elements are skipped or the first of them is the result
+        std::optional<Extremum<DataType_>> argmin(NanPolicy nan = NanPolicy::SKIP) const {
+            return view().argmin(nan);
+        }
+
+        // Position and value of the first maximum non-null element
+        // Returns std::nullopt if there are none
+        // nan: whether NaN elements are skipped or the first of them is the result
+        std::optional<Extremum<DataType_>> argmax(NanPolicy nan = NanPolicy::SKIP) const {
+            return view().argmax(nan);
+        }
+
+        // Positions and values of the first minimum and first maximum non-null elements, in one pass
+        // Returns std::nullopt if there are none
+        // nan: whether NaN elements are skipped or the first of them is both results
+        std::optional<MinMax<DataType_>> minmax(NanPolicy nan = NanPolicy::SKIP) const {
+            return view().minmax(nan);
+        }
+
+        // A series of the elements at the given positions, in order, with their nulls; positions may repeat
+        // e.g. s.take({4, 0, 0}) is [s[4], s[0], s[0]]
+        // Throws std::out_of_range if a position is not below size()
+        Series<DataType_> take(const std::vector<std::size_t>& indices) const {
+            return view().take(indices);
+        }
+
+        // A series of the elements whose bit is set in a mask, such as the result of a comparison, in order
+        // e.g. s.filter((s > 0.5) & (s < 2.0))
+        // Throws std::invalid_argument if the mask is not the size of the series
+        Series<DataType_> filter(const Bitmap& mask) const {
+            return view().filter(mask);
+        }
+
+        // The positions of the elements in sorted order: a stable sort, ascending or descending, with
+        // NaN after every number and nulls after that, each in the order they appear
+        std::vector<std::size_t> argsort(bool ascending = true) const {
+            return view().argsort(ascending);
+        }
+
+        // Several aggregations of the non-null elements, computed together in a single pass over the data
+        // e.g. s.agg({Agg::SUM, Agg::MEAN, Agg::MIN, Agg::MAX, Agg::VAR})
+        // Integers are accumulated, and their results given, in double unless another type is asked for
+        template <typename T = detail::accumulator_t<DataType_>>
+        Aggregates<T> agg(const std::vector<Agg>& aggs) const {
+            return view().template agg<T>(aggs);
+        }
+
+        // Lagged operations, as lazy expressions that read this series at an offset rather than copying
+        // it (see SeriesView); each refers to this series, which must outlive it
+
+        // The elements moved periods positions later, or earlier for a negative count, null where vacated
+        auto shift(std::ptrdiff_t periods = 1) const & noexcept {
+            return view().shift(periods);
+        }
+
+        // The difference of each element from the one periods positions before it
+        auto diff(std::ptrdiff_t periods = 1) const & {
+            return view().diff(periods);
+        }
+
+        // The relative change of each element from the one periods positions before it
+        auto pct_change(std::ptrdiff_t periods = 1) const & {
+            return view().pct_change(periods);
+        }
+        void shift(std::ptrdiff_t = 1) && = delete;
+        void diff(std::ptrdiff_t = 1) && = delete;
+        void pct_change(std::ptrdiff_t = 1) && = delete;
+
+        // Aggregations over a sliding window of the elements up to and including each one (see SeriesView)
+        // The Rolling refers to this series, which must outlive it
+        Rolling<SeriesView<const DataType_>> rolling(std::size_t window, std::optional<std::size_t> min_periods = std::nullopt) const & {
+            return view().rolling(window, min_periods);
+        }
+        void rolling(std::size_t, std::optional<std::size_t> = std::nullopt) && = delete;
+
+        // Exponentially weighted moving statistics of the elements up to and including each one, at
+        // regular spacing or at the given times (see SeriesView)
+        // The Ewm refers to this series, which must outlive it
+        Ewm<SeriesView<const DataType_>> ewm(double alpha, bool adjust = true) const & {
+            return view().ewm(alpha, adjust);
+        }
+
+        template <typename Times_> requires (!std::is_same_v<Times_, bool>)
+        Ewm<SeriesView<const DataType_>> ewm(double alpha, const Times_& times) const & {
+            return view().ewm(alpha, times);
+        }
+        void ewm(double, bool = true) && = delete;
+        template <typename Times_>
+        void ewm(double, const Times_&) && = delete;
+
+        // Number of non-null elements
+        std::size_t count() const noexcept {
+            return has_nulls() ? validity_->count() : size();
+        }
+
+        // Whether there are no non-null elements
+        bool empty() const noexcept {
+            return size() == 0 || (validity_ && validity_->none());
+        }
+
+        // Nulls
+
+        // The validity bitmap: bit i is clear when element i is null
+        // Absent when the series has never held a null, in which case every element is valid
+        const std::optional<Bitmap>& validity() const noexcept { return validity_; }
+
+        // Replace the validity bitmap, or remove it to mark every element valid
+        // Throws std::invalid_argument if the bitmap size does not match the series
+        void set_validity(std::optional<Bitmap> validity) {
+            if (validity && validity->size() != size()) {
+                throw std::invalid_argument("Validity bitmap size does not match the series");
             }
-            auto max_it = with_policy(exec_, [&](auto& exec_){
-                return std::max_element(exec_, data_.begin(), data_.end());
-            });
-            return std::ref(*max_it);
-        }
-
-        // output the series as "[ *, *, * ]" where * is the type
-        friend std::ostream& operator<<(std::ostream& os, const Series<DataType_>& obj) {
-            // if 10 or less, show all
-            // otherwise, show first 5, ..., last 5
-            constexpr auto MAX_DISPLAY{10};
-            constexpr auto CHUNK{MAX_DISPLAY / 2};
-            os << "[";
-            if (obj.data_.size() <= MAX_DISPLAY) {
-                for (auto i = 0; i < obj.data_.size(); ++i) {
-                    os << obj.data_[i];
-                    if (i < obj.data_.size() - 1) {
-                        os << ", ";
-                    }
-                }
+            validity_ = std::move(validity);
+        }
+
+        bool is_valid(std::size_t idx) const noexcept {
+            return !validity_ || (*validity_)[idx];
+        }
+
+        bool is_null(std::size_t idx) const noexcept {
+            return !is_valid(idx);
+        }
+
+        // Mark the element at the index null; its value is kept but ignored
+        void set_null(std::size_t idx) {
+            if (!validity_) {
+                validity_.emplace(size());
             }
-            else {
-                const auto f = [&os](const auto& x) { os << x << ", "; };
-                std::for_each_n(obj.data_.begin(), CHUNK, f);
-                os << "..., ";
-                std::for_each_n(obj.data_.end() - CHUNK, CHUNK - 1, f);
-                os << *(obj.data_.end() - 1);
+            validity_->set(idx, false);
+        }
+
+        // Mark the element at the index valid
+        void set_valid(std::size_t idx) noexcept {
+            if (validity_) {
+                validity_->set(idx, true);
             }
-            os << "]";
-            return os;
+        }
 
+        bool has_nulls() const noexcept {
+            return validity_ && !validity_->all();
+        }
+
+        std::size_t null_count() const noexcept {
+            return size() - count();
+        }
+
+        // output the series as "[ *, *, * ]" where * is the type, or null
+        friend std::ostream& operator<<(std::ostream& os, const Series& obj) {
+            return os << obj.view();
         }
 
         ExecPolicy exec_policy() const { return exec_; }
@@ -526,7 +808,13 @@ namespace df {
 
         std::size_t size() const { return data_.size(); }
         void reserve(std::size_t n) { data_.reserve(n); }
-        void resize(std::size_t n) { data_.resize(n); }
+        // New elements are value-initialized, even though internal buffers that are about to be overwritten are not
+        void resize(std::size_t n) {
+            data_.resize(n, DataType_{});
+            if (validity_) {
+                validity_->resize(n);
+            }
+        }
 
         // Get element at the index without bounds checking
         DataType_& operator[](std::size_t idx) {
@@ -550,10 +838,162 @@ namespace df {
 
 
     private:
-        ExecPolicy exec_{ExecPolicy::PAR_UNSEQ};
+        template <typename, typename>
+        friend class Series;
+
+        ExecPolicy exec_{ExecPolicy::AUTO};
 
         // The underlying data storage
-        std::vector<DataType_> data_;
+        container_type data_;
+
+        // Clear bits mark null elements; absent when there are none
+        std::optional<Bitmap> validity_;
+
+        // Whether an op with a scalar of type T can run on the SIMD kernels
+        // Integral scalars qualify because the generic path converts them to DataType_ as well
+        template <typename T>
+        static constexpr bool kernel_scalar_v = kernels::supported_v<DataType_>
+            && (std::is_same_v<T, DataType_> || std::is_integral_v<T>);
+
+        // Replace each element that is not skipped with the scan of Op over those up to it
+        // Without nulls, float and double blocks are reduced by the sum and extrema kernels, and scanned by
+        // the running sum kernel
+        template <detail::ScanOp Op>
+        Series& cumulative() {
+            using detail::ScanOp;
+            constexpr auto identity = detail::scan_identity<Op, DataType_>();
+            auto* data = data_.data();
+            const Bitmap* valid = has_nulls() ? &*validity_ : nullptr;
+            const auto skipped = [valid](std::size_t i, const DataType_& x) {
+                if constexpr (std::is_floating_point_v<DataType_> && (Op == ScanOp::MIN || Op == ScanOp::MAX)) {
+                    if (x != x) {
+                        return true;
+                    }
+                }
+                return valid && !(*valid)[i];
+            };
+            const auto apply = [](const DataType_& acc, const DataType_& x) { return detail::scan_apply<Op>(acc, x); };
+
+            const auto reduce = [&](std::size_t begin, std::size_t end) {
+                if constexpr (kernels::supported_v<DataType_> && Op != ScanOp::PROD) {
+                    if (!valid) {
+                        if constexpr (Op == ScanOp::SUM) {
+                            return kernels::sum(data + begin, end - begin);
+                        }
+                        else {
+                            const auto found = kernels::extrema(data + begin, end - begin);
+                            if (found.argmin == end - begin) {
+                                return identity;
+                            }
+                            return Op == ScanOp::MIN ? found.min : found.max;
+                        }
+                    }
+                }
+                DataType_ total = identity;
+                for (auto i = begin; i < end; ++i) {
+                    if (!skipped(i, data[i])) {
+                        total = apply(total, data[i]);
+                    }
+                }
+                return total;
+            };
+            const auto scan = [&](std::size_t begin, std::size_t end, DataType_ carry) {
+                if constexpr (kernels::supported_v<DataType_> && Op == ScanOp::SUM) {
+                    if (!valid) {
+                        kernels::cumsum(data + begin, data + begin, end - begin, carry);
+                        return;
+                    }
+                }
+                for (auto i = begin; i < end; ++i) {
+                    if (!skipped(i, data[i])) {
+                        carry = apply(carry, data[i]);
+                        data[i] = carry;
+                    }
+                }
+            };
+            detail::chunked_scan(exec_, size(), identity, apply, reduce, scan);
+            return *this;
+        }
+
+        // Cost classes of the SIMD kernels, for ExecPolicy::AUTO
+        static constexpr OpCost cost_of(kernels::UnaryOp op) noexcept {
+            switch (op) {
+            case kernels::UnaryOp::EXP:
+            case kernels::UnaryOp::LOG:
+                return OpCost::HEAVY;
+            case kernels::UnaryOp::SQRT:
+                return OpCost::MEDIUM;
+            case kernels::UnaryOp::ABS:
+                return OpCost::LIGHT;
+            }
+            return OpCost::MEDIUM;
+        }
+
+        static constexpr OpCost cost_of(kernels::BinaryOp op) noexcept {
+            switch (op) {
+            case kernels::BinaryOp::POW:
+                return OpCost::HEAVY;
+            case kernels::BinaryOp::DIV:
+            case kernels::BinaryOp::RDIV:
+                return OpCost::MEDIUM;
+            default:
+                return OpCost::LIGHT;
+            }
+        }
+
+        // Transform this series in place with a unary SIMD kernel, one chunk per task
+        // Falls back to the functor when there is no kernel for DataType_
+        template <typename Func_>
+        auto& transform(kernels::UnaryOp op, Func_&& functor) {
+            if constexpr (kernels::supported_v<DataType_>) {
+                auto* data = data_.data();
+                for_each_chunk(exec_, size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                    kernels::unary(op, data + begin, data + begin, end - begin);
+                }, cost_of(op));
+                return *this;
+            }
+            else {
+                return transform(std::forward<Func_>(functor));
+            }
+        }
+
+        // Transform this series in place with a binary SIMD kernel against a scalar, one chunk per task
+        // Falls back to the monadic functor when the types have no kernel
+        template <typename T, typename Func_>
+        auto& transform(kernels::BinaryOp op, const T& val, Func_&& functor) {
+            if constexpr (kernel_scalar_v<T>) {
+                auto* data = data_.data();
+                const auto b = static_cast<DataType_>(val);
+                for_each_chunk(exec_, size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                    kernels::binary(op, data + begin, b, data + begin, end - begin);
+                }, cost_of(op));
+                return *this;
+            }
+            else {
+                return transform(std::forward<Func_>(functor));
+            }
+        }
+
+        // Transform this series in place with a binary SIMD kernel against another series, one chunk per task
+        // The result is null wherever either operand is
+        // Falls back to the dyadic functor when there is no kernel for DataType_
+        template <typename A, typename Func_>
+        auto& transform(kernels::BinaryOp op, const Series<DataType_, A>& other, Func_&& functor) {
+            if (other.validity_) {
+                validity_ = intersect(validity_, other.validity_);
+            }
+            if constexpr (kernels::supported_v<DataType_>) {
+                auto* data = data_.data();
+                const auto* rhs = other.data_.data();
+                for_each_chunk(exec_, size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                    kernels::binary(op, data + begin, rhs + begin, data + begin, end - begin);
+                }, cost_of(op));
+                return *this;
+            }
+            else {
+                return transform(other, std::forward<Func_>(functor));
+            }
+        }
 
         // Transform this series with the result of a monadic functor applied to each element
         // functor: the monadic functor to apply: functor(this[i]) -> this[i]
@@ -566,10 +1006,10 @@ namespace df {
         // Transform the output with the result of a monadic functor applied to this series elementwise
         // output: the series which receives the output
         // functor: the monadic functor to apply: functor(this[i]) -> this[i]
-        template <typename T, typename Func_>
-        auto& transform_to(Series<T>& output, Func_&& functor) const {
-            with_policy(exec_, [&](auto exec_){
-                std::transform(exec_, data_.begin(), data_.end(), output.data_.begin(), functor);
+        template <typename T, typename A, typename Func_>
+        auto& transform_to(Series<T, A>& output, Func_&& functor) const {
+            for_each_partition(exec_, size(), detail::op_cost<std::remove_cvref_t<Func_>>::value, [&](auto& exc, std::size_t begin, std::size_t end) {
+                std::transform(exc, data_.begin() + begin, data_.begin() + end, output.data_.begin() + begin, functor);
             });
             return *this;
         }
@@ -577,8 +1017,8 @@ namespace df {
         // Transform this series with a functor applied elementwise with another series
         // other: the other series which the functor receives elements from
         // functor: the dyadic functor to apply: functor(this[i], other[i]) -> this[i]
-        template <typename Func_>
-        auto& transform(const Series<DataType_>& other, Func_&& functor) {
+        template <typename A, typename Func_>
+        auto& transform(const Series<DataType_, A>& other, Func_&& functor) {
             transform_to(other, *this, functor);
             return *this;
         }
@@ -587,74 +1027,12 @@ namespace df {
         // other: the other series the functor receives elements from
         // output: the series which receives the output
         // functor: the dyadic functor to apply: functor(this[i], other[i]) -> output[i]
-        template <typename T, typename J, typename Func_>
-        auto& transform_to(const Series<T>& other, Series<J>& output, Func_&& functor) const {
-            with_policy(exec_, [&](auto& exc){
-                std::transform(exc, data_.begin(), data_.end(), other.data_.begin(), output.data_.begin(), functor);
+        template <typename T, typename A, typename J, typename B, typename Func_>
+        auto& transform_to(const Series<T, A>& other, Series<J, B>& output, Func_&& functor) const {
+            for_each_partition(exec_, size(), detail::op_cost<std::remove_cvref_t<Func_>>::value, [&](auto& exc, std::size_t begin, std::size_t end) {
+                std::transform(exc, data_.begin() + begin, data_.begin() + end, other.data_.begin() + begin, output.data_.begin() + begin, functor);
             });
             return *this;
         }
     };
-
-    // Operators that return new Series constructed from transformations
-
-    template <typename LhsT, typename RhsT>
-    auto operator+(const Series<LhsT>& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} + RhsT{})>(lhs, rhs, [](const auto& x, const auto& y) { return x + y; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator+(const Series<LhsT>& lhs, const RhsT& rhs) {
-        return Series<decltype(LhsT{} + RhsT{})>(lhs, [rhs](const auto& x) { return x + rhs; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator+(const LhsT& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} + RhsT{})>(rhs, [lhs](const auto& x) { return lhs + x; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator-(const Series<LhsT>& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} - RhsT{})>(lhs, rhs, [](const auto& x, const auto& y) { return x - y; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator-(const Series<LhsT>& lhs, const RhsT& rhs) {
-        return Series<decltype(LhsT{} - RhsT{})>(lhs, [rhs](const auto& x) { return x - rhs; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator-(const LhsT& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} - RhsT{})>(rhs, [lhs](const auto& x) { return lhs - x; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator*(const Series<LhsT>& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} * RhsT{})>(lhs, rhs, [](const auto& x, const auto& y) { return x * y; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator*(const Series<LhsT>& lhs, const RhsT& rhs) {
-        return Series<decltype(LhsT{} * RhsT{})>(lhs, [rhs](const auto& x) { return x * rhs; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator*(const LhsT& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} * RhsT{})>(rhs, [lhs](const auto& x) { return lhs * x; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator/(const Series<LhsT>& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} / RhsT{})>(lhs, rhs, [](const auto& x, const auto& y) { return x / y; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator/(const Series<LhsT>& lhs, const RhsT& rhs) {
-        return Series<decltype(LhsT{} / RhsT{})>(lhs, [rhs](const auto& x) { return x / rhs; });
-    }
-
-    template <typename LhsT, typename RhsT>
-    auto operator/(const LhsT& lhs, const Series<RhsT>& rhs) {
-        return Series<decltype(LhsT{} / RhsT{})>(rhs, [lhs](const auto& x) { return lhs / x; });
-    }
 }
\ No newline at end of file
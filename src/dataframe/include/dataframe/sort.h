@@ -0,0 +1,336 @@
+#pragma once
+
+#include "bitmap.h"
+#include "gather.h"
+#include "policy.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Sorting building blocks shared by Series::sort, argsort and DataFrame::sort_values
+//
+// Integer and floating point keys are mapped to unsigned integers of the same order and sorted by a
+// parallel LSD radix sort, one byte per pass; every other type goes through a parallel merge sort.
+// Both produce a permutation, which the columns are then gathered through.
+namespace df::detail {
+
+    // Fewer elements than this are sorted by comparison, where counting digits does not pay off
+    inline constexpr std::size_t SMALL_SORT{1 << 10};
+
+    // Fewest elements given to one task of a parallel sort
+    inline constexpr std::size_t SORT_BLOCK{1 << 16};
+
+    // Types sorted by radix: those whose order is that of an unsigned integer key of the same size
+    template <typename T>
+    constexpr bool radix_sortable_v = (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+        || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+    template <typename T>
+    using radix_key_t = std::conditional_t<sizeof(T) <= 4, std::uint32_t, std::uint64_t>;
+
+    // The radix key of x: keys compare as the values do, or in reverse when not ascending
+    // -0 and +0 have the same key, and every NaN has the largest key in either direction
+    template <typename T>
+    radix_key_t<T> radix_key(T x, bool ascending) noexcept {
+        using K = radix_key_t<T>;
+        K key;
+        if constexpr (std::is_floating_point_v<T>) {
+            using U = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+            constexpr U SIGN{U{1} << (8 * sizeof(U) - 1)};
+            if (x != x) {
+                return std::numeric_limits<K>::max();
+            }
+            // flip every bit of a negative and only the sign of a positive
+            const auto bits = std::bit_cast<U>(x == 0 ? T{0} : x);
+            key = static_cast<K>((bits & SIGN) ? ~bits : bits | SIGN);
+        }
+        else if constexpr (std::is_signed_v<T>) {
+            using U = std::make_unsigned_t<T>;
+            key = static_cast<K>(static_cast<U>(static_cast<U>(x) ^ (U{1} << (8 * sizeof(U) - 1))));
+        }
+        else {
+            key = static_cast<K>(x);
+        }
+        return ascending ? key : ~key;
+    }
+
+    // Number of tasks to sort n elements with under a policy: one unless it resolves to a parallel
+    // policy, then enough to keep every thread busy with at least SORT_BLOCK elements each
+    inline std::size_t sort_tasks(ExecPolicy policy, std::size_t n) noexcept {
+        const auto resolved = resolve(policy, n, OpCost::MEDIUM);
+        if (resolved != ExecPolicy::PAR && resolved != ExecPolicy::PAR_UNSEQ) {
+            return 1;
+        }
+        return std::clamp<std::size_t>(n / SORT_BLOCK, 1, 4 * std::size_t{parallel_concurrency()});
+    }
+
+    // Values of one byte of a key
+    inline constexpr std::size_t RADIX{256};
+
+    // Most keys sorted by least significant byte first; larger inputs are split by their most
+    // significant byte into buckets of about this size first, which then sort in cache
+    inline constexpr std::size_t RADIX_LSD_MAX{1 << 16};
+
+    // Fewer keys than this are sorted by insertion
+    inline constexpr std::size_t RADIX_INSERTION{32};
+
+    // Keys gathered per value of a byte before they are written out together
+    inline constexpr std::size_t RADIX_BUFFER{8};
+
+    using RadixCounts = std::array<std::size_t, RADIX>;
+
+    /// Stably scatter keys and their index entries by one byte
+    // offsets: the next slot for each value of the byte, advanced past what is written
+    // buffered: whether writes go through a small buffer per value, flushed a few entries at a time, so
+    //           that writing to 256 places at once does not miss in the cache and TLB on every element;
+    //           only worth it when the output does not fit in cache
+    template <typename K>
+    void radix_scatter(const K* keys, const std::size_t* index, std::size_t n, unsigned shift, RadixCounts& offsets, K* keys_out, std::size_t* index_out, bool buffered) {
+        if (!buffered) {
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto slot = offsets[(keys[i] >> shift) & (RADIX - 1)]++;
+                keys_out[slot] = keys[i];
+                index_out[slot] = index[i];
+            }
+            return;
+        }
+        alignas(64) K key_buffer[RADIX][RADIX_BUFFER];
+        alignas(64) std::size_t index_buffer[RADIX][RADIX_BUFFER];
+        std::array<std::uint8_t, RADIX> fill{};
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto v = (keys[i] >> shift) & (RADIX - 1);
+            auto f = fill[v];
+            key_buffer[v][f] = keys[i];
+            index_buffer[v][f] = index[i];
+            if (++f == RADIX_BUFFER) {
+                const auto slot = offsets[v];
+                offsets[v] += RADIX_BUFFER;
+                std::copy_n(key_buffer[v], RADIX_BUFFER, keys_out + slot);
+                std::copy_n(index_buffer[v], RADIX_BUFFER, index_out + slot);
+                f = 0;
+            }
+            fill[v] = f;
+        }
+        for (std::size_t v = 0; v < RADIX; ++v) {
+            std::copy_n(key_buffer[v], fill[v], keys_out + offsets[v]);
+            std::copy_n(index_buffer[v], fill[v], index_out + offsets[v]);
+            offsets[v] += fill[v];
+        }
+    }
+
+    /// Stably sort keys and their index entries by the low bytes of the keys
+    // policy: the policy the passes run with, over one block of keys per task
+    // keys, index: the n entries to sort, where the result is left
+    // keys_tmp, index_tmp: scratch for n entries
+    // bytes: how many of the low bytes of the keys to sort by; the others are equal across the entries
+    // Passes over a byte that every key shares are skipped, so narrow values in wide types are cheap.
+    // Beyond RADIX_LSD_MAX entries, a pass over the most significant byte that varies splits them into
+    // buckets, which are sorted on the remaining bytes one bucket per task; a bucket larger than the
+    // share of one task is sorted by all the threads in turn
+    template <typename K>
+    void radix_sort(ExecPolicy policy, K* keys, std::size_t* index, K* keys_tmp, std::size_t* index_tmp, std::size_t n, std::size_t bytes) {
+        if (n <= RADIX_INSERTION) {
+            for (std::size_t i = 1; i < n; ++i) {
+                const auto key = keys[i];
+                const auto entry = index[i];
+                auto j = i;
+                for (; j > 0 && key < keys[j - 1]; --j) {
+                    keys[j] = keys[j - 1];
+                    index[j] = index[j - 1];
+                }
+                keys[j] = key;
+                index[j] = entry;
+            }
+            return;
+        }
+        const auto tasks = sort_tasks(policy, n);
+        const auto block = (n + tasks - 1) / tasks;
+        const auto exec = tasks > 1 ? resolve(policy, n, OpCost::MEDIUM) : ExecPolicy::SEQ;
+
+        // histograms of every byte in one pass, per task, which also serve the first pass that runs
+        std::vector<std::vector<RadixCounts>> counts(tasks, std::vector<RadixCounts>(bytes));
+        for_each_chunk(exec, n, block, [&](std::size_t begin, std::size_t end) {
+            auto& local = counts[begin / block];
+            for (auto i = begin; i < end; ++i) {
+                for (std::size_t d = 0; d < bytes; ++d) {
+                    ++local[d][(keys[i] >> (8 * d)) & (RADIX - 1)];
+                }
+            }
+        });
+        std::vector<std::size_t> varying;
+        for (std::size_t d = 0; d < bytes; ++d) {
+            RadixCounts total{};
+            for (const auto& local : counts) {
+                for (std::size_t v = 0; v < RADIX; ++v) {
+                    total[v] += local[d][v];
+                }
+            }
+            if (std::find(total.begin(), total.end(), n) == total.end()) {
+                varying.push_back(d);
+            }
+        }
+        if (varying.empty()) {
+            return;
+        }
+
+        // every task writes each value of the byte after the tasks before it, which keeps the sort stable
+        const auto scatter = [&](std::size_t d, const K* from_keys, const std::size_t* from_index, K* to_keys, std::size_t* to_index) {
+            std::vector<RadixCounts> offsets(tasks);
+            std::size_t next = 0;
+            for (std::size_t v = 0; v < RADIX; ++v) {
+                for (std::size_t t = 0; t < tasks; ++t) {
+                    offsets[t][v] = next;
+                    next += counts[t][d][v];
+                }
+            }
+            for_each_chunk(exec, n, block, [&](std::size_t begin, std::size_t end) {
+                radix_scatter(from_keys + begin, from_index + begin, end - begin, static_cast<unsigned>(8 * d), offsets[begin / block], to_keys, to_index, n > RADIX_LSD_MAX);
+            });
+        };
+
+        if (n <= RADIX_LSD_MAX || varying.size() == 1) {
+            auto* from_keys = keys;
+            auto* from_index = index;
+            auto* to_keys = keys_tmp;
+            auto* to_index = index_tmp;
+            for (std::size_t pass = 0; pass < varying.size(); ++pass) {
+                const auto d = varying[pass];
+                if (pass > 0) {
+                    for_each_chunk(exec, n, block, [&](std::size_t begin, std::size_t end) {
+                        auto& local = counts[begin / block][d];
+                        local.fill(0);
+                        for (auto i = begin; i < end; ++i) {
+                            ++local[(from_keys[i] >> (8 * d)) & (RADIX - 1)];
+                        }
+                    });
+                }
+                scatter(d, from_keys, from_index, to_keys, to_index);
+                std::swap(from_keys, to_keys);
+                std::swap(from_index, to_index);
+            }
+            if (from_keys != keys) {
+                for_each_chunk(exec, n, block, [&](std::size_t begin, std::size_t end) {
+                    std::copy(keys_tmp + begin, keys_tmp + end, keys + begin);
+                    std::copy(index_tmp + begin, index_tmp + end, index + begin);
+                });
+            }
+            return;
+        }
+
+        const auto msd = varying.back();
+        scatter(msd, keys, index, keys_tmp, index_tmp);
+        RadixCounts starts{};
+        RadixCounts sizes{};
+        for (std::size_t v = 0, next = 0; v < RADIX; ++v) {
+            starts[v] = next;
+            for (const auto& local : counts) {
+                sizes[v] += local[msd][v];
+            }
+            next += sizes[v];
+        }
+        // each bucket is sorted in the scratch, using its own range of the output as scratch, then copied back
+        const auto sort_bucket = [&](ExecPolicy bucket_policy, std::size_t v) {
+            const auto b = starts[v];
+            radix_sort(bucket_policy, keys_tmp + b, index_tmp + b, keys + b, index + b, sizes[v], msd);
+            std::copy_n(keys_tmp + b, sizes[v], keys + b);
+            std::copy_n(index_tmp + b, sizes[v], index + b);
+        };
+        std::vector<std::size_t> small;
+        for (std::size_t v = 0; v < RADIX; ++v) {
+            if (tasks > 1 && sizes[v] > block) {
+                sort_bucket(policy, v);
+            }
+            else if (sizes[v] > 0) {
+                small.push_back(v);
+            }
+        }
+        const auto run = [&](std::size_t first, std::size_t last) {
+            for (auto i = first; i < last; ++i) {
+                sort_bucket(ExecPolicy::SEQ, small[i]);
+            }
+        };
+        if (tasks > 1) {
+            df::parallel_for(small.size(), 1, run);
+        }
+        else {
+            run(0, small.size());
+        }
+    }
+
+    // Stably sort index by the keys at the same positions (see above)
+    template <typename K>
+    void radix_sort(ExecPolicy policy, std::vector<K>& keys, std::vector<std::size_t>& index) {
+        std::vector<K> keys_tmp(keys.size());
+        std::vector<std::size_t> index_tmp(index.size());
+        radix_sort(policy, keys.data(), index.data(), keys_tmp.data(), index_tmp.data(), keys.size(), sizeof(K));
+    }
+
+    // Number of elements of a that precede the first diagonal elements of the stable merge of a and b
+    template <typename It, typename Less>
+    std::size_t merge_split(std::size_t diagonal, It a, std::size_t na, It b, std::size_t nb, const Less& less) {
+        auto lo = diagonal > nb ? diagonal - nb : 0;
+        auto hi = std::min(diagonal, na);
+        while (lo < hi) {
+            const auto mid = lo + (hi - lo) / 2;
+            // a[mid] is not after b[diagonal - mid - 1], so more of a belongs before the diagonal
+            if (!less(b[diagonal - mid - 1], a[mid])) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /// Stably sort index by a strict weak order: sorted blocks, merged pairwise
+    // policy: the policy the blocks are sorted and merged with, one block per task
+    // index: the elements to sort
+    // less: the order
+    // Each round of merges is cut into equal pieces of output along merge paths, so every round keeps
+    // every task busy however few pairs of runs are left
+    template <typename Less>
+    void merge_sort(ExecPolicy policy, std::vector<std::size_t>& index, const Less& less) {
+        const auto n = index.size();
+        const auto tasks = sort_tasks(policy, n);
+        const auto block = std::max<std::size_t>(1, (n + tasks - 1) / tasks);
+        const auto exec = tasks > 1 ? resolve(policy, n, OpCost::MEDIUM) : ExecPolicy::SEQ;
+
+        for_each_chunk(exec, n, block, [&](std::size_t begin, std::size_t end) {
+            std::stable_sort(index.begin() + begin, index.begin() + end, less);
+        });
+        if (block >= n) {
+            return;
+        }
+        std::vector<std::size_t> merged(n);
+        for (auto width = block; width < n; width *= 2) {
+            const auto* in = index.data();
+            auto* out = merged.data();
+            // pieces never straddle two pairs of runs, whose bounds are multiples of block
+            for_each_chunk(exec, n, block, [&](std::size_t begin, std::size_t end) {
+                const auto lo = begin - begin % (2 * width);
+                const auto mid = std::min(lo + width, n);
+                const auto hi = std::min(lo + 2 * width, n);
+                const auto a0 = merge_split(begin - lo, in + lo, mid - lo, in + mid, hi - mid, less);
+                const auto a1 = merge_split(end - lo, in + lo, mid - lo, in + mid, hi - mid, less);
+                std::merge(
+                    in + lo + a0, in + lo + a1,
+                    in + mid + (begin - lo - a0), in + mid + (end - lo - a1),
+                    out + begin, less
+                );
+            });
+            index.swap(merged);
+        }
+    }
+
+}
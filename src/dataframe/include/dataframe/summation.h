@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+
+
+namespace df {
+
+    // How sum(), mean() and dot() accumulate
+    enum class Summation {
+        // Independent partial sums per chunk and per vector lane, combined in whatever order the
+        // execution policy runs the chunks: fastest, but the error grows linearly with the size and
+        // parallel results may differ in the last bits from run to run
+        NAIVE,
+        // Partial sums over small blocks added as a balanced tree within each chunk, and chunk results
+        // combined as for NAIVE: the error grows with the logarithm of the chunk size plus the number
+        // of chunks, at almost no extra cost
+        PAIRWISE,
+        // Kahan-Neumaier compensated summation: the rounding error of every addition is carried
+        // alongside the sum, so the result is as accurate as if accumulated in twice the precision
+        KAHAN,
+        // Pairwise summation over fixed chunks whose results are combined in index order: bitwise
+        // reproducible for any execution policy and number of threads (on a given instruction set)
+        DETERMINISTIC
+    };
+
+    [[noreturn]] inline void unreachable_summation() noexcept {
+        assert(false && "Unknown Summation"); // in debug
+        std::abort();                         // hard-stop in release
+    }
+
+    namespace detail {
+
+        // A sum carried together with the accumulated rounding error of its additions (Neumaier)
+        template <typename T>
+        struct Compensated {
+            T sum{};
+            T err{};
+
+            void add(T x) {
+                const T t = sum + x;
+                const T bb = t - sum;
+                err += (sum - (t - bb)) + (x - bb);
+                sum = t;
+            }
+
+            T value() const { return sum + err; }
+
+            friend Compensated merge(Compensated a, const Compensated& b) {
+                a.add(b.sum);
+                a.err += b.err;
+                return a;
+            }
+        };
+
+        // Number of terms summed directly at the leaves of pairwise_sum
+        inline constexpr std::size_t PAIRWISE_BLOCK{128};
+
+        /// Pairwise sum of term(i) over the index range [begin, end)
+        // term: the function returning the i-th term
+        template <typename T, typename F>
+        T pairwise_sum(std::size_t begin, std::size_t end, const F& term) {
+            if (end - begin <= PAIRWISE_BLOCK) {
+                T total{};
+                for (auto i = begin; i < end; ++i) {
+                    total += term(i);
+                }
+                return total;
+            }
+            const auto mid = begin + (end - begin) / 2;
+            return pairwise_sum<T>(begin, mid, term) + pairwise_sum<T>(mid, end, term);
+        }
+
+        /// Compensated sum of term(i) over the index range [begin, end)
+        // term: the function returning the i-th term
+        template <typename T, typename F>
+        Compensated<T> compensated_sum(std::size_t begin, std::size_t end, const F& term) {
+            Compensated<T> total;
+            for (auto i = begin; i < end; ++i) {
+                total.add(term(i));
+            }
+            return total;
+        }
+
+    }
+
+}
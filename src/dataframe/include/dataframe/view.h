@@ -0,0 +1,961 @@
+#pragma once
+
+#include "aggregates.h"
+#include "bitmap.h"
+#include "ewm.h"
+#include "policy.h"
+#include "expr.h"
+#include "filter.h"
+#include "gather.h"
+#include "kernels.h"
+#include "moments.h"
+#include "rolling.h"
+#include "sort.h"
+#include "summation.h"
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+
+namespace df {
+
+    namespace detail {
+
+        // Random access iterator over every stride-th element from a base pointer
+        // Positions are kept as indices so that the end of a strided range never points past the storage
+        template <typename T>
+        class StridedIterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = std::remove_const_t<T>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T*;
+            using reference = T&;
+
+            StridedIterator() = default;
+            StridedIterator(T* base, std::size_t i, std::size_t stride) noexcept : base_(base), i_(i), stride_(stride) {}
+
+            T& operator*() const noexcept { return base_[i_ * stride_]; }
+            T* operator->() const noexcept { return base_ + i_ * stride_; }
+            T& operator[](difference_type n) const noexcept { return base_[(i_ + n) * stride_]; }
+
+            StridedIterator& operator++() noexcept { ++i_; return *this; }
+            StridedIterator operator++(int) noexcept { auto tmp = *this; ++i_; return tmp; }
+            StridedIterator& operator--() noexcept { --i_; return *this; }
+            StridedIterator operator--(int) noexcept { auto tmp = *this; --i_; return tmp; }
+            StridedIterator& operator+=(difference_type n) noexcept { i_ += n; return *this; }
+            StridedIterator& operator-=(difference_type n) noexcept { i_ -= n; return *this; }
+
+            friend StridedIterator operator+(StridedIterator it, difference_type n) noexcept { return it += n; }
+            friend StridedIterator operator+(difference_type n, StridedIterator it) noexcept { return it += n; }
+            friend StridedIterator operator-(StridedIterator it, difference_type n) noexcept { return it -= n; }
+            friend difference_type operator-(const StridedIterator& a, const StridedIterator& b) noexcept {
+                return static_cast<difference_type>(a.i_) - static_cast<difference_type>(b.i_);
+            }
+            friend bool operator==(const StridedIterator& a, const StridedIterator& b) noexcept { return a.i_ == b.i_; }
+            friend auto operator<=>(const StridedIterator& a, const StridedIterator& b) noexcept { return a.i_ <=> b.i_; }
+
+        private:
+            T* base_{nullptr};
+            std::size_t i_{0};
+            std::size_t stride_{1};
+        };
+
+        // The validity of the elements of a view: element i is valid when bit offset + i * stride is set
+        struct ValidBits {
+            const Bitmap* bits{nullptr};
+            std::size_t offset{0};
+            std::size_t stride{1};
+
+            bool operator[](std::size_t i) const noexcept { return (*bits)[offset + i * stride]; }
+
+            // Visit the valid elements within [begin, end) as Bitmap::for_each_set does, for stride 1
+            // mixed receives the element index of bit 0 of the word, which wraps around when the word starts
+            // before the view; base + countr_zero(word) is still the exact index of each set bit
+            template <typename Run, typename Mixed>
+            void for_each_set(std::size_t begin, std::size_t end, Run&& run, Mixed&& mixed) const {
+                bits->for_each_set(
+                    offset + begin, offset + end,
+                    [&](std::size_t run_begin, std::size_t run_end) { run(run_begin - offset, run_end - offset); },
+                    [&](std::size_t base, Bitmap::word_type word) { mixed(base - offset, word); }
+                );
+            }
+        };
+
+    }
+
+    // A non-owning window onto the elements of a Series: size elements from a pointer, stride elements apart
+    //
+    // Views are cheap to copy and never allocate, so a large column can be processed a chunk at a time
+    // through slice(), head() and tail() without copying it. A view has the same aggregations as a Series,
+    // which in fact computes them on a view of itself, and takes part in lazy expressions like one;
+    // materialize it with eval() or by constructing a Series from it. Contiguous views run on the SIMD
+    // kernels and strided ones on scalar loops. A view is invalidated by anything that reallocates the
+    // storage it refers to.
+    // DataType_: the element type, const for a read-only view
+    // Policy_: a StaticPolicy tag that fixes the execution policy of every operation at compile time,
+    //          or exec::Dynamic to hold an ExecPolicy that is switched on per call
+    template <typename View_>
+    class ShiftExpr;
+
+    template <typename DataType_, PolicyTag Policy_ = exec::Dynamic>
+    class SeriesView : public SeriesExpr<SeriesView<DataType_, Policy_>> {
+    public:
+        using value_type = std::remove_const_t<DataType_>;
+        using pointer = DataType_*;
+        using reference = DataType_&;
+        using iterator = detail::StridedIterator<DataType_>;
+        using policy_type = Policy_;
+        using exec_type = detail::policy_holder_t<Policy_>;
+
+        SeriesView() = default;
+
+        // A view of size elements from data, stride elements apart, all of them valid
+        SeriesView(pointer data, std::size_t size, std::size_t stride = 1, exec_type policy = default_exec()) noexcept
+            : data_(data), size_(size), stride_(stride), exec_(policy) {}
+
+        // A view of size elements from data, stride elements apart, where element i is null when bit
+        // offset + i * stride of the validity bitmap is clear
+        // validity: the bitmap of the viewed storage, or nullptr when every element is valid
+        SeriesView(pointer data, std::size_t size, std::size_t stride, const Bitmap* validity, std::size_t offset, exec_type policy) noexcept
+            : data_(data), size_(size), stride_(stride), validity_(validity), offset_(offset), exec_(policy) {}
+
+        // A read-only view of the same elements as a mutable one
+        template <typename T> requires (std::is_same_v<const T, DataType_> && !std::is_const_v<T>)
+        SeriesView(const SeriesView<T, Policy_>& other) noexcept
+            : data_(other.data_), size_(other.size_), stride_(other.stride_),
+              validity_(other.validity_), offset_(other.offset_), exec_(other.exec_) {}
+
+        std::size_t size() const noexcept { return size_; }
+        std::size_t stride() const noexcept { return stride_; }
+        bool contiguous() const noexcept { return stride_ == 1; }
+        pointer data() const noexcept { return data_; }
+
+        ExecPolicy exec_policy() const noexcept { return detail::policy_value(exec_); }
+
+        void set_exec_policy(ExecPolicy policy) noexcept requires std::is_same_v<Policy_, exec::Dynamic> {
+            exec_ = policy;
+        }
+
+        // The ExecPolicy, or the compile-time tag, that every operation of the view runs with
+        exec_type policy() const noexcept { return exec_; }
+
+        // Reading the elements of a view is a load per element
+        static constexpr OpCost cost() noexcept { return OpCost::LIGHT; }
+
+        // Get element at the index without bounds checking
+        reference operator[](std::size_t idx) const noexcept {
+            return data_[idx * stride_];
+        }
+
+        // Get element at the index with bounds checking
+        reference at(std::size_t idx) const {
+            if (idx >= size_) {
+                throw std::out_of_range("SeriesView index out of range");
+            }
+            return (*this)[idx];
+        }
+
+        iterator begin() const noexcept { return {data_, 0, stride_}; }
+        iterator end() const noexcept { return {data_, size_, stride_}; }
+
+        // The same elements under another policy tag, or the view itself by default, so that a view can be
+        // passed wherever a view of a Series is taken
+        // A Dynamic view tagged statically runs every operation on the tag; a static view made Dynamic
+        // holds the policy of its tag
+        template <PolicyTag P = Policy_>
+        SeriesView<DataType_, P> view() const noexcept {
+            if constexpr (std::is_same_v<P, Policy_>) {
+                return *this;
+            }
+            else if constexpr (std::is_same_v<P, exec::Dynamic>) {
+                return {data_, size_, stride_, validity_, offset_, exec_policy()};
+            }
+            else {
+                return {data_, size_, stride_, validity_, offset_, P{}};
+            }
+        }
+
+        // A view of the elements [begin, end) of this view, every step-th one
+        // The bounds are clamped to the view, as in Python slicing
+        // Throws std::invalid_argument if step is 0
+        SeriesView slice(std::size_t begin, std::size_t end, std::size_t step = 1) const {
+            if (step == 0) {
+                throw std::invalid_argument("Slice step must be positive");
+            }
+            end = std::min(end, size_);
+            begin = std::min(begin, end);
+            const auto length = (end - begin + step - 1) / step;
+            return {data_ + begin * stride_, length, stride_ * step, validity_, offset_ + begin * stride_, exec_};
+        }
+
+        // A view of the first n elements, or all of them if there are fewer
+        SeriesView head(std::size_t n = 5) const {
+            return slice(0, n);
+        }
+
+        // A view of the last n elements, or all of them if there are fewer
+        SeriesView tail(std::size_t n = 5) const {
+            return slice(size_ - std::min(n, size_), size_);
+        }
+
+        // Aggregation functions
+        // Null elements are skipped: runs of valid elements are found a bitmap word at a time and
+        // handed to the same kernels, so a view without nulls pays nothing extra
+
+        // Dot product of this view with another view or Series of the same size, over the elements valid in both
+        // Will return the identity element (0) if empty
+        // Throws std::invalid_argument if the sizes differ
+        // mode: how the products are accumulated
+        template <typename Other_, typename J = value_type>
+        J dot(const Other_& other, Summation mode = Summation::NAIVE) const {
+            const auto rhs = other.view();
+            if (rhs.size() != size_) {
+                throw std::invalid_argument("Series sizes do not match for dot product");
+            }
+            const auto both = has_nulls() || rhs.has_nulls() ? intersect(this->validity(), rhs.validity()) : std::nullopt;
+            const detail::ValidBits bits{both ? &*both : nullptr};
+            const auto* mask = both ? &bits : nullptr;
+            const auto* lhs = data_;
+            if constexpr (kernel_reduce_v<typename decltype(rhs)::value_type> && std::is_same_v<J, value_type>) {
+                if (contiguous() && rhs.contiguous()) {
+                    const auto* r = rhs.data();
+                    return accumulate<J>(
+                        mode, mask,
+                        [lhs, r](std::size_t begin, std::size_t end, kernels::SumMode m) {
+                            return kernels::dot(lhs + begin, r + begin, end - begin, m);
+                        },
+                        [lhs, r](std::size_t i) { return lhs[i] * r[i]; }
+                    );
+                }
+            }
+            const auto stride = stride_;
+            return accumulate<J>(mode, mask, [lhs, stride, &rhs](std::size_t i) { return static_cast<J>(lhs[i * stride] * rhs[i]); });
+        }
+
+        // Sum of all non-null elements in the view
+        // Returns std::nullopt if there are none
+        // mode: how the elements are accumulated
+        template <typename T = value_type>
+        std::optional<T> sum(Summation mode = Summation::NAIVE) const {
+            if (empty()) {
+                return std::nullopt;
+            }
+            const auto bits = valid_bits();
+            const auto* mask = bits ? &*bits : nullptr;
+            const auto* data = data_;
+            if constexpr (kernel_reduce_v<T>) {
+                if (contiguous()) {
+                    return accumulate<T>(
+                        mode, mask,
+                        [data](std::size_t begin, std::size_t end, kernels::SumMode m) {
+                            return kernels::sum(data + begin, end - begin, m);
+                        },
+                        [data](std::size_t i) { return data[i]; }
+                    );
+                }
+            }
+            const auto stride = stride_;
+            return accumulate<T>(mode, mask, [data, stride](std::size_t i) { return static_cast<T>(data[i * stride]); });
+        }
+
+        // Mean of all non-null elements in the view
+        // Returns std::nullopt if there are none
+        // mode: how the elements are accumulated
+        template <typename T = value_type>
+        std::optional<T> mean(Summation mode = Summation::NAIVE) const {
+            const auto s = sum<T>(mode);
+            if (!s) {
+                return std::nullopt;
+            }
+            return *s / static_cast<T>(count());
+        }
+
+        // Count, mean, M2, min and max of all non-null elements, gathered in a single pass over the data
+        // Integers are accumulated in double unless another type is asked for
+        // Each cache-sized block is summed and then re-read from cache to accumulate its squared
+        // deviations from the block mean, and the blocks are combined with Chan's formula
+        // Returns std::nullopt if there are no non-null elements
+        template <typename T = detail::accumulator_t<value_type>>
+        std::optional<Moments<T>> moments() const {
+            if (empty()) {
+                return std::nullopt;
+            }
+            const auto* data = data_;
+            if constexpr (kernel_reduce_v<T>) {
+                if (contiguous()) {
+                    return reduce_runs(Moments<T>{}, [data](std::size_t begin, std::size_t end) {
+                        const auto n = end - begin;
+                        const auto count = static_cast<T>(n);
+                        const T center = kernels::sum(data + begin, n) / count;
+                        // the deviations left over from rounding the center correct both the mean and M2
+                        const auto spread = kernels::spread(data + begin, n, center);
+                        return Moments<T>{
+                            n,
+                            center + spread.sum / count,
+                            spread.sum_sq - spread.sum * spread.sum / count,
+                            spread.min,
+                            spread.max
+                        };
+                    });
+                }
+            }
+            const auto stride = stride_;
+            return reduce_runs(Moments<T>{}, [data, stride](std::size_t begin, std::size_t end) {
+                Moments<T> m;
+                for (auto i = begin; i < end; ++i) {
+                    m.push(static_cast<T>(data[i * stride]));
+                }
+                return m;
+            });
+        }
+
+        // Variance of all non-null elements in the view
+        // Returns std::nullopt if there are none
+        template <typename T = detail::accumulator_t<value_type>>
+        std::optional<T> variance() const {
+            const auto m = moments<T>();
+            if (!m) {
+                return std::nullopt;
+            }
+            return m->variance();
+        }
+
+        // Standard deviation of all non-null elements in the view
+        // Returns std::nullopt if there are none
+        template <typename T = detail::accumulator_t<value_type>>
+        std::optional<T> stddev() const {
+            const auto m = moments<T>();
+            if (!m) {
+                return std::nullopt;
+            }
+            return m->stddev();
+        }
+
+        // Minimum non-null element in the view, the first of equal minima; NaN elements are skipped
+        // Returns std::nullopt if there are none
+        std::optional<std::reference_wrapper<const value_type>> min() const {
+            const auto found = arg_extrema();
+            if (found.argmin == found.NONE) {
+                return std::nullopt;
+            }
+            return std::cref((*this)[found.argmin]);
+        }
+
+        // Maximum non-null element in the view, the first of equal maxima; NaN elements are skipped
+        // Returns std::nullopt if there are none
+        std::optional<std::reference_wrapper<const value_type>> max() const {
+            const auto found = arg_extrema();
+            if (found.argmax == found.NONE) {
+                return std::nullopt;
+            }
+            return std::cref((*this)[found.argmax]);
+        }
+
+        // Position and value of the first minimum non-null element
+        // Returns std::nullopt if there are none
+        // nan: whether NaN elements are skipped or the first of them is the result
+        std::optional<Extremum<value_type>> argmin(NanPolicy nan = NanPolicy::SKIP) const {
+            const auto found = minmax(nan);
+            if (!found) {
+                return std::nullopt;
+            }
+            return found->min;
+        }
+
+        // Position and value of the first maximum non-null element
+        // Returns std::nullopt if there are none
+        // nan: whether NaN elements are skipped or the first of them is the result
+        std::optional<Extremum<value_type>> argmax(NanPolicy nan = NanPolicy::SKIP) const {
+            const auto found = minmax(nan);
+            if (!found) {
+                return std::nullopt;
+            }
+            return found->max;
+        }
+
+        // Positions and values of the first minimum and first maximum non-null elements, found together
+        // in a single pass over the data
+        // Returns std::nullopt if there are none
+        // nan: whether NaN elements are skipped or the first of them is both results
+        std::optional<MinMax<value_type>> minmax(NanPolicy nan = NanPolicy::SKIP) const {
+            const auto found = arg_extrema();
+            if (nan == NanPolicy::PROPAGATE && found.nan != found.NONE) {
+                const Extremum<value_type> first{found.nan, (*this)[found.nan]};
+                return MinMax<value_type>{first, first};
+            }
+            if (found.argmin == found.NONE) {
+                return std::nullopt;
+            }
+            return MinMax<value_type>{{found.argmin, found.min}, {found.argmax, found.max}};
+        }
+
+        // Gathering
+
+        // A series of the elements at the given positions, in order and with their nulls, under the
+        // policy of the view; positions may repeat
+        // Throws std::out_of_range if a position is not below size()
+        Series<std::remove_const_t<value_type>> take(const std::vector<std::size_t>& indices) const {
+            detail::check_indices(exec_policy(), indices, size_);
+            return detail::take(*this, indices);
+        }
+
+        // Filtering
+
+        // A series of the elements whose bit is set in a mask, such as the result of a comparison, in
+        // order and with their nulls, under the policy of the view
+        // Counted and copied in two parallel passes, packed a vector at a time for float and double
+        // Throws std::invalid_argument if the mask is not the size of the view
+        Series<std::remove_const_t<value_type>> filter(const Bitmap& mask) const {
+            return detail::filter(*this, mask);
+        }
+
+        // Sorting
+
+        // The positions of the elements in sorted order: a stable sort, ascending or descending, with
+        // NaN after every number and nulls after that, each in the order they appear
+        // Integers, floats and doubles are sorted by a parallel radix sort, other types by a parallel
+        // merge sort, each using the threads of a parallel policy
+        std::vector<std::size_t> argsort(bool ascending = true) const {
+            std::vector<std::size_t> index;
+            std::vector<std::size_t> nulls;
+            if (validity_) {
+                index.reserve(size_);
+                for (std::size_t i = 0; i < size_; ++i) {
+                    (is_valid(i) ? index : nulls).push_back(i);
+                }
+            }
+            else {
+                index.resize(size_);
+                std::iota(index.begin(), index.end(), std::size_t{0});
+            }
+
+            if constexpr (detail::radix_sortable_v<value_type>) {
+                if (index.size() >= detail::SMALL_SORT) {
+                    std::vector<detail::radix_key_t<value_type>> keys(index.size());
+                    for_each_chunk(exec_, index.size(), DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                        for (auto i = begin; i < end; ++i) {
+                            keys[i] = detail::radix_key((*this)[index[i]], ascending);
+                        }
+                    }, OpCost::LIGHT);
+                    detail::radix_sort(exec_, keys, index);
+                    index.insert(index.end(), nulls.begin(), nulls.end());
+                    return index;
+                }
+            }
+            detail::merge_sort(exec_, index, [this, ascending](std::size_t a, std::size_t b) {
+                const auto& x = (*this)[a];
+                const auto& y = (*this)[b];
+                if constexpr (std::is_floating_point_v<value_type>) {
+                    if (x != x || y != y) {
+                        return x == x;
+                    }
+                }
+                return ascending ? x < y : y < x;
+            });
+            index.insert(index.end(), nulls.begin(), nulls.end());
+            return index;
+        }
+
+        // Several aggregations of the non-null elements, computed together in a single pass over the data
+        // The aggregations decide the work per cache-sized block: a sum, a sum with extrema, or the
+        // two-pass moments of moments(), each merged into one combined accumulator
+        // COUNT alone reads only the validity bitmap
+        // Integers are accumulated, and their results given, in double unless another type is asked for
+        template <typename T = detail::accumulator_t<value_type>>
+        Aggregates<T> agg(const std::vector<Agg>& aggs) const {
+            const detail::AggPlan plan(aggs);
+            detail::AggState<T> state;
+            if (!plan.scan()) {
+                state.count = count();
+                return state.results(aggs);
+            }
+            if (empty()) {
+                return state.results(aggs);
+            }
+            const auto* data = data_;
+            if constexpr (kernel_reduce_v<T>) {
+                if (contiguous()) {
+                    state = reduce_runs(state, [data, plan](std::size_t begin, std::size_t end) {
+                        const auto n = end - begin;
+                        const auto count = static_cast<T>(n);
+                        const T sum = kernels::sum(data + begin, n);
+                        if (plan.moments) {
+                            const auto spread = kernels::spread(data + begin, n, sum / count);
+                            return detail::AggState<T>{
+                                n, sum, sum / count + spread.sum / count,
+                                spread.sum_sq - spread.sum * spread.sum / count, spread.min, spread.max
+                            };
+                        }
+                        if (plan.extrema) {
+                            const auto spread = kernels::spread(data + begin, n, T{});
+                            return detail::AggState<T>{n, spread.sum, spread.sum / count, T{}, spread.min, spread.max};
+                        }
+                        return detail::AggState<T>{n, sum, sum / count, T{}, T{}, T{}};
+                    });
+                    return state.results(aggs);
+                }
+            }
+            const auto stride = stride_;
+            state = reduce_runs(state, [data, stride](std::size_t begin, std::size_t end) {
+                detail::AggState<T> block;
+                for (auto i = begin; i < end; ++i) {
+                    block.push(static_cast<T>(data[i * stride]));
+                }
+                return block;
+            });
+            return state.results(aggs);
+        }
+
+        // Lagged operations
+        // Each is a lazy expression that reads this view at an offset rather than copying it, so it can
+        // take part in a larger expression evaluated in a single pass, e.g. (s - s.shift(1)) / s
+
+        // The elements moved periods positions later, or earlier for a negative count, as pandas' shift():
+        // element i is element i - periods of this view, and null where that falls outside it
+        ShiftExpr<SeriesView<const value_type, Policy_>> shift(std::ptrdiff_t periods = 1) const noexcept {
+            return {*this, periods};
+        }
+
+        // The difference of each element from the one periods positions before it, null where there is none
+        // Both operands are views held by value, so the expression outlives this view but not its storage
+        auto diff(std::ptrdiff_t periods = 1) const {
+            return SeriesView<const value_type, Policy_>(*this) - shift(periods);
+        }
+
+        // The relative change of each element from the one periods positions before it, in double for
+        // integers, and null where there is none
+        auto pct_change(std::ptrdiff_t periods = 1) const {
+            return map(detail::pct_change_fn{}, SeriesView<const value_type, Policy_>(*this), shift(periods));
+        }
+
+        // Aggregations over a sliding window of the elements up to and including each one, updated as
+        // the window moves rather than recomputed, e.g. s.rolling(20).mean()
+        // Throws std::invalid_argument if window or min_periods is 0, or min_periods exceeds window
+        // window: the number of elements in each window
+        // min_periods: the fewest non-null elements a window needs for a non-null result, window by default
+        Rolling<SeriesView<const value_type, Policy_>> rolling(std::size_t window, std::optional<std::size_t> min_periods = std::nullopt) const {
+            return {*this, window, min_periods};
+        }
+
+        // Exponentially weighted moving statistics of the elements up to and including each one, e.g.
+        // s.ewm(0.1).mean()
+        // Throws std::invalid_argument unless 0 < alpha <= 1
+        // alpha: the smoothing factor
+        // adjust: whether the weights are normalized over the elements seen so far, as in pandas
+        Ewm<SeriesView<const value_type, Policy_>> ewm(double alpha, bool adjust = true) const {
+            return {*this, alpha, adjust};
+        }
+
+        // Exponentially weighted moving statistics of irregularly spaced elements, each weighted by
+        // (1 - alpha) to the power of the time since it
+        // Throws std::invalid_argument unless 0 < alpha <= 1, or if the times differ in size, hold nulls
+        // or decrease
+        // times: a Series or view of the time of each element
+        template <typename Times_> requires (!std::is_same_v<Times_, bool>)
+        Ewm<SeriesView<const value_type, Policy_>> ewm(double alpha, const Times_& times) const {
+            return {*this, alpha, times};
+        }
+
+        // Nulls
+
+        // Number of non-null elements
+        std::size_t count() const noexcept {
+            if (!validity_) {
+                return size_;
+            }
+            if (contiguous()) {
+                return validity_->count(offset_, offset_ + size_);
+            }
+            std::size_t total = 0;
+            for (std::size_t i = 0; i < size_; ++i) {
+                total += is_valid(i);
+            }
+            return total;
+        }
+
+        // Whether there are no non-null elements
+        bool empty() const noexcept {
+            if (size_ == 0 || !validity_) {
+                return size_ == 0;
+            }
+            return contiguous() ? validity_->none(offset_, offset_ + size_) : count() == 0;
+        }
+
+        bool is_valid(std::size_t idx) const noexcept {
+            return !validity_ || (*validity_)[offset_ + idx * stride_];
+        }
+
+        bool is_null(std::size_t idx) const noexcept {
+            return !is_valid(idx);
+        }
+
+        bool has_nulls() const noexcept {
+            if (!validity_) {
+                return false;
+            }
+            return contiguous() ? !validity_->all(offset_, offset_ + size_) : count() != size_;
+        }
+
+        std::size_t null_count() const noexcept {
+            return size_ - count();
+        }
+
+        // Intersect the validity of the viewed elements into out, copying their bits into a bitmap of size()
+        void collect_validity(std::optional<Bitmap>& out) const {
+            if (!validity_) {
+                return;
+            }
+            if (contiguous()) {
+                out = intersect(out, validity_->slice(offset_, offset_ + size_));
+                return;
+            }
+            Bitmap bits(size_, false);
+            for (std::size_t i = 0; i < size_; ++i) {
+                bits.set(i, is_valid(i));
+            }
+            out = intersect(out, bits);
+        }
+
+        // Write every element of the view to an output range of at least size() elements
+        template <typename OutputIt_>
+        void eval_to(OutputIt_ out) const {
+            if (!contiguous()) {
+                SeriesExpr<SeriesView>::eval_to(out);
+                return;
+            }
+            for_each_partition(exec_, size_, OpCost::LIGHT, [&](auto& exec_, std::size_t begin, std::size_t end) {
+                std::copy(exec_, data_ + begin, data_ + end, std::next(out, static_cast<std::ptrdiff_t>(begin)));
+            });
+        }
+
+        // output the view as "[ *, *, * ]" where * is the type, or null
+        friend std::ostream& operator<<(std::ostream& os, const SeriesView& obj) {
+            // if 10 or less, show all
+            // otherwise, show first 5, ..., last 5
+            constexpr std::size_t MAX_DISPLAY{10};
+            constexpr std::size_t CHUNK{MAX_DISPLAY / 2};
+            const auto n = obj.size();
+            const auto show = [&](std::size_t i) {
+                if (obj.is_valid(i)) {
+                    os << obj[i];
+                }
+                else {
+                    os << "null";
+                }
+            };
+            os << "[";
+            for (std::size_t i = 0; i < n; ++i) {
+                if (n > MAX_DISPLAY && i == CHUNK) {
+                    os << "..., ";
+                    i = n - CHUNK;
+                }
+                show(i);
+                if (i < n - 1) {
+                    os << ", ";
+                }
+            }
+            os << "]";
+            return os;
+        }
+
+    private:
+        template <typename, PolicyTag>
+        friend class SeriesView;
+
+        // Elements per block for passes that re-read each block while it is still in the L1 cache
+        static constexpr std::size_t CACHE_GRAIN{(std::size_t{32} << 10) / sizeof(value_type)};
+
+        pointer data_{nullptr};
+        std::size_t size_{0};
+        std::size_t stride_{1};
+
+        // The bitmap of the viewed storage, where bit offset_ + i * stride_ is that of element i;
+        // nullptr when every element is valid
+        const Bitmap* validity_{nullptr};
+        std::size_t offset_{0};
+
+        [[no_unique_address]] exec_type exec_{default_exec()};
+
+        static constexpr exec_type default_exec() noexcept {
+            if constexpr (std::is_same_v<Policy_, exec::Dynamic>) {
+                return ExecPolicy::AUTO;
+            }
+            else {
+                return Policy_{};
+            }
+        }
+
+        // Whether a reduction to type T can run on the SIMD kernels
+        template <typename T>
+        static constexpr bool kernel_reduce_v = kernels::supported_v<value_type> && std::is_same_v<T, value_type>;
+
+        // The validity bits of the view, or std::nullopt when it has no nulls
+        std::optional<detail::ValidBits> valid_bits() const noexcept {
+            if (!has_nulls()) {
+                return std::nullopt;
+            }
+            return detail::ValidBits{validity_, offset_, stride_};
+        }
+
+        // Accumulate a chunked SIMD reduction over the valid elements in the given summation mode
+        // valid: the contiguous elements to include, or nullptr for all of them
+        // kernel: returns the reduction of the elements [begin, end) in a kernels::SumMode
+        // term: returns the single term i, for the valid elements of words that also hold nulls
+        template <typename T, typename Kernel_, typename Term_>
+            requires std::is_invocable_r_v<T, const Kernel_&, std::size_t, std::size_t, kernels::SumMode>
+        T accumulate(Summation mode, const detail::ValidBits* valid, const Kernel_& kernel, const Term_& term) const {
+            if (valid) {
+                // pieces of a chunk are combined with compensation so that splitting it costs no accuracy
+                return accumulate_all<T>(mode, [valid, &kernel, &term](std::size_t begin, std::size_t end, kernels::SumMode m) {
+                    detail::Compensated<T> total, singles;
+                    T plain{};
+                    valid->for_each_set(
+                        begin, end,
+                        [&](std::size_t run_begin, std::size_t run_end) { total.add(kernel(run_begin, run_end, m)); },
+                        [&](std::size_t base, Bitmap::word_type word) {
+                            for (; word; word &= word - 1) {
+                                const auto i = base + static_cast<std::size_t>(std::countr_zero(word));
+                                if (m == kernels::SumMode::COMPENSATED) {
+                                    singles.add(term(i));
+                                }
+                                else {
+                                    plain += term(i);
+                                }
+                            }
+                        }
+                    );
+                    total.add(plain);
+                    return merge(total, singles).value();
+                });
+            }
+            return accumulate_all<T>(mode, kernel);
+        }
+
+        template <typename T, typename Kernel_>
+            requires std::is_invocable_r_v<T, const Kernel_&, std::size_t, std::size_t, kernels::SumMode>
+        T accumulate_all(Summation mode, const Kernel_& kernel) const {
+            const auto chunk = [&kernel](kernels::SumMode m) {
+                return [&kernel, m](std::size_t begin, std::size_t end) { return kernel(begin, end, m); };
+            };
+            switch (mode) {
+            case Summation::NAIVE:
+                return reduce_chunks(exec_, size_, DEFAULT_GRAIN, T{}, std::plus<>{}, chunk(kernels::SumMode::NAIVE), OpCost::LIGHT);
+            case Summation::PAIRWISE:
+                return reduce_chunks(exec_, size_, DEFAULT_GRAIN, T{}, std::plus<>{}, chunk(kernels::SumMode::PAIRWISE), OpCost::LIGHT);
+            case Summation::KAHAN:
+                return reduce_chunks(
+                    exec_, size_, DEFAULT_GRAIN, detail::Compensated<T>{},
+                    [](const auto& a, const auto& b) { return merge(a, b); },
+                    [&kernel](std::size_t begin, std::size_t end) {
+                        return detail::Compensated<T>{kernel(begin, end, kernels::SumMode::COMPENSATED)};
+                    },
+                    OpCost::MEDIUM
+                ).value();
+            case Summation::DETERMINISTIC: {
+                const auto partials = chunk_partials<T>(chunk(kernels::SumMode::PAIRWISE));
+                return kernels::sum(partials.data(), partials.size(), kernels::SumMode::PAIRWISE);
+            }
+            }
+            unreachable_summation();
+        }
+
+        // Accumulate term(i) over the valid elements in the given summation mode, for types without kernels
+        // and strided views
+        // Integer sums are exact, so every mode accumulates them naively
+        template <typename T, typename Term_>
+            requires std::is_invocable_r_v<T, const Term_&, std::size_t>
+        T accumulate(Summation mode, const detail::ValidBits* valid, const Term_& term) const {
+            if (valid) {
+                return accumulate_all<T>(mode, [valid, &term](std::size_t i) { return (*valid)[i] ? term(i) : T{}; });
+            }
+            return accumulate_all<T>(mode, term);
+        }
+
+        template <typename T, typename Term_>
+            requires std::is_invocable_r_v<T, const Term_&, std::size_t>
+        T accumulate_all(Summation mode, const Term_& term) const {
+            const auto naive = [&term](std::size_t begin, std::size_t end) {
+                T total{};
+                for (auto i = begin; i < end; ++i) {
+                    total += term(i);
+                }
+                return total;
+            };
+            const auto pairwise = [&term](std::size_t begin, std::size_t end) {
+                return detail::pairwise_sum<T>(begin, end, term);
+            };
+            if (std::is_integral_v<T> || mode == Summation::NAIVE) {
+                return reduce_chunks(exec_, size_, DEFAULT_GRAIN, T{}, std::plus<>{}, naive, OpCost::LIGHT);
+            }
+            switch (mode) {
+            case Summation::PAIRWISE:
+                return reduce_chunks(exec_, size_, DEFAULT_GRAIN, T{}, std::plus<>{}, pairwise, OpCost::LIGHT);
+            case Summation::KAHAN:
+                return reduce_chunks(
+                    exec_, size_, DEFAULT_GRAIN, detail::Compensated<T>{},
+                    [](const auto& a, const auto& b) { return merge(a, b); },
+                    [&term](std::size_t begin, std::size_t end) { return detail::compensated_sum<T>(begin, end, term); },
+                    OpCost::MEDIUM
+                ).value();
+            case Summation::NAIVE:
+            case Summation::DETERMINISTIC: {
+                const auto partials = chunk_partials<T>(pairwise);
+                return detail::pairwise_sum<T>(0, partials.size(), [&partials](std::size_t i) { return partials[i]; });
+            }
+            }
+            unreachable_summation();
+        }
+
+        /// Reduce the results of a function over the runs of valid elements within cache-sized chunks
+        // init: the identity of the reduction, whose type provides merge(a, b) and push(x)
+        // f: the function to execute, which takes the [begin, end) bounds of one run and returns its result
+        // The valid elements of words that also hold nulls, and all valid elements of a strided view, are
+        // pushed into the result one at a time
+        template <typename R, typename F>
+        R reduce_runs(R init, const F& f) const {
+            const auto combine = [](const R& a, const R& b) { return merge(a, b); };
+            const auto valid = valid_bits();
+            if (!valid) {
+                return reduce_chunks(exec_, size_, CACHE_GRAIN, init, combine, f, OpCost::MEDIUM);
+            }
+            return reduce_chunks(exec_, size_, CACHE_GRAIN, init, combine, [&](std::size_t begin, std::size_t end) {
+                R result{init};
+                R singles{init};
+                if (contiguous()) {
+                    valid->for_each_set(
+                        begin, end,
+                        [&](std::size_t run_begin, std::size_t run_end) { result = merge(result, f(run_begin, run_end)); },
+                        [&](std::size_t base, Bitmap::word_type word) {
+                            for (; word; word &= word - 1) {
+                                singles.push(data_[base + static_cast<std::size_t>(std::countr_zero(word))]);
+                            }
+                        }
+                    );
+                }
+                else {
+                    for (auto i = begin; i < end; ++i) {
+                        if ((*valid)[i]) {
+                            singles.push((*this)[i]);
+                        }
+                    }
+                }
+                return merge(result, singles);
+            }, OpCost::MEDIUM);
+        }
+
+        // Positions of the first minimum, first maximum and first NaN among the valid elements
+        // Contiguous float and double runs go to the vectorized kernel, whose positions are made relative
+        // to the view; every other element is pushed one at a time
+        detail::ArgExtrema<value_type> arg_extrema() const {
+            using R = detail::ArgExtrema<value_type>;
+            const auto combine = [](const R& a, const R& b) { return merge(a, b); };
+            const auto run = [this](std::size_t begin, std::size_t end) {
+                R result;
+                if constexpr (kernels::supported_v<value_type>) {
+                    if (contiguous()) {
+                        const auto n = end - begin;
+                        const auto found = kernels::extrema(data_ + begin, n);
+                        if (found.argmin != n) {
+                            result = {begin + found.argmin, begin + found.argmax, R::NONE, found.min, found.max};
+                        }
+                        if (found.nan != n) {
+                            result.nan = begin + found.nan;
+                        }
+                        return result;
+                    }
+                }
+                for (auto i = begin; i < end; ++i) {
+                    result.push(i, (*this)[i]);
+                }
+                return result;
+            };
+
+            const auto valid = valid_bits();
+            if (!valid) {
+                return reduce_chunks(exec_, size_, CACHE_GRAIN, R{}, combine, run, OpCost::LIGHT);
+            }
+            return reduce_chunks(exec_, size_, CACHE_GRAIN, R{}, combine, [&](std::size_t begin, std::size_t end) {
+                R result;
+                if (contiguous()) {
+                    valid->for_each_set(
+                        begin, end,
+                        [&](std::size_t run_begin, std::size_t run_end) { result = merge(result, run(run_begin, run_end)); },
+                        [&](std::size_t base, Bitmap::word_type word) {
+                            for (; word; word &= word - 1) {
+                                const auto i = base + static_cast<std::size_t>(std::countr_zero(word));
+                                result.push(i, data_[i]);
+                            }
+                        }
+                    );
+                }
+                else {
+                    for (auto i = begin; i < end; ++i) {
+                        if ((*valid)[i]) {
+                            result.push(i, (*this)[i]);
+                        }
+                    }
+                }
+                return result;
+            }, OpCost::LIGHT);
+        }
+
+        // The result of f over each fixed chunk of DEFAULT_GRAIN elements, in index order
+        template <typename T, typename F>
+        std::vector<T> chunk_partials(const F& f) const {
+            std::vector<T> partials((size_ + DEFAULT_GRAIN - 1) / DEFAULT_GRAIN);
+            for_each_chunk(exec_, size_, DEFAULT_GRAIN, [&](std::size_t begin, std::size_t end) {
+                partials[begin / DEFAULT_GRAIN] = f(begin, end);
+            }, OpCost::LIGHT);
+            return partials;
+        }
+    };
+
+    // A lazy view of a series moved by a number of positions, as returned by shift(): element i is
+    // element i - periods of the source, and null where that falls outside it
+    // Nothing is copied; the offset is applied as each element is read
+    // View_: the read-only SeriesView shifted
+    template <typename View_>
+    class ShiftExpr : public SeriesExpr<ShiftExpr<View_>> {
+    public:
+        using value_type = typename View_::value_type;
+        using policy_type = typename View_::policy_type;
+        static constexpr bool reads_across{true};
+
+        ShiftExpr(View_ source, std::ptrdiff_t periods) noexcept : source_(source), periods_(periods) {}
+
+        // Elements shifted in from outside the source are value-initialized
+        value_type operator[](std::size_t i) const noexcept {
+            // wraps around past the end when i - periods is negative
+            const auto j = i - static_cast<std::size_t>(periods_);
+            return j < source_.size() ? source_[j] : value_type{};
+        }
+
+        std::size_t size() const noexcept { return source_.size(); }
+        std::ptrdiff_t periods() const noexcept { return periods_; }
+        ExecPolicy exec_policy() const noexcept { return source_.exec_policy(); }
+        detail::policy_holder_t<policy_type> policy() const noexcept { return source_.policy(); }
+        static constexpr OpCost cost() noexcept { return OpCost::LIGHT; }
+
+        void collect_validity(std::optional<Bitmap>& out) const {
+            std::optional<Bitmap> source;
+            source_.collect_validity(source);
+            out = intersect(out, (source ? *source : Bitmap(size(), true)).shifted(periods_));
+        }
+
+    private:
+        View_ source_;
+        std::ptrdiff_t periods_;
+    };
+
+}
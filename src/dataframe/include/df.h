@@ -1,2 +1,4 @@
 #include "dataframe/dataframe.h"
+#include "dataframe/numa.h"
+#include "dataframe/parallel.h"
 #include "dataframe/series.h"
@@ -0,0 +1,173 @@
+#include "dataframe/kernels.h"
+#include "kernels_impl.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace df::kernels {
+
+    namespace {
+
+        Isa detect() noexcept {
+#if defined(DF_KERNELS_X86)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+                return Isa::AVX512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return Isa::AVX2;
+            }
+            return Isa::SSE2;
+#else
+            return Isa::SCALAR;
+#endif
+        }
+
+        std::atomic<Isa>& active() noexcept {
+            static std::atomic<Isa> isa{detected_isa()};
+            return isa;
+        }
+
+        const detail::Table& table() noexcept {
+            switch (active().load(std::memory_order_relaxed)) {
+#if defined(DF_KERNELS_X86)
+            case Isa::AVX512:
+                return detail::avx512_table;
+            case Isa::AVX2:
+                return detail::avx2_table;
+            case Isa::SSE2:
+                return detail::sse2_table;
+#endif
+            default:
+                return detail::scalar_table;
+            }
+        }
+
+    }
+
+    Isa detected_isa() noexcept {
+        static const Isa isa = detect();
+        return isa;
+    }
+
+    Isa active_isa() noexcept {
+        return active().load(std::memory_order_relaxed);
+    }
+
+    Isa set_isa(Isa isa) noexcept {
+        const auto selected = std::min(isa, detected_isa());
+        active().store(selected, std::memory_order_relaxed);
+        return selected;
+    }
+
+    const char* isa_name(Isa isa) noexcept {
+        switch (isa) {
+        case Isa::SCALAR:
+            return "scalar";
+        case Isa::SSE2:
+            return "sse2";
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::AVX512:
+            return "avx512";
+        }
+        return "unknown";
+    }
+
+    void unary(UnaryOp op, const double* a, double* out, std::size_t n) noexcept {
+        table().unary_f64(op, a, out, n);
+    }
+
+    void unary(UnaryOp op, const float* a, float* out, std::size_t n) noexcept {
+        table().unary_f32(op, a, out, n);
+    }
+
+    void binary(BinaryOp op, const double* a, const double* b, double* out, std::size_t n) noexcept {
+        table().binary_f64(op, a, b, out, n);
+    }
+
+    void binary(BinaryOp op, const float* a, const float* b, float* out, std::size_t n) noexcept {
+        table().binary_f32(op, a, b, out, n);
+    }
+
+    void binary(BinaryOp op, const double* a, double b, double* out, std::size_t n) noexcept {
+        table().binary_scalar_f64(op, a, b, out, n);
+    }
+
+    void binary(BinaryOp op, const float* a, float b, float* out, std::size_t n) noexcept {
+        table().binary_scalar_f32(op, a, b, out, n);
+    }
+
+    double sum(const double* a, std::size_t n, SumMode mode) noexcept {
+        return table().sum_f64(a, n, mode);
+    }
+
+    float sum(const float* a, std::size_t n, SumMode mode) noexcept {
+        return table().sum_f32(a, n, mode);
+    }
+
+    double dot(const double* a, const double* b, std::size_t n, SumMode mode) noexcept {
+        return table().dot_f64(a, b, n, mode);
+    }
+
+    float dot(const float* a, const float* b, std::size_t n, SumMode mode) noexcept {
+        return table().dot_f32(a, b, n, mode);
+    }
+
+    Spread<double> spread(const double* a, std::size_t n, double center) noexcept {
+        return table().spread_f64(a, n, center);
+    }
+
+    Spread<float> spread(const float* a, std::size_t n, float center) noexcept {
+        return table().spread_f32(a, n, center);
+    }
+
+    Extrema<double> extrema(const double* a, std::size_t n) noexcept {
+        return table().extrema_f64(a, n);
+    }
+
+    Extrema<float> extrema(const float* a, std::size_t n) noexcept {
+        return table().extrema_f32(a, n);
+    }
+
+    double cumsum(const double* a, double* out, std::size_t n, double carry) noexcept {
+        return table().cumsum_f64(a, out, n, carry);
+    }
+
+    float cumsum(const float* a, float* out, std::size_t n, float carry) noexcept {
+        return table().cumsum_f32(a, out, n, carry);
+    }
+
+    double decayed_cumsum(const double* a, double* out, std::size_t n, double decay, double carry) noexcept {
+        return table().decayed_cumsum_f64(a, out, n, decay, carry);
+    }
+
+    float decayed_cumsum(const float* a, float* out, std::size_t n, float decay, float carry) noexcept {
+        return table().decayed_cumsum_f32(a, out, n, decay, carry);
+    }
+
+    void compare(CompareOp op, const double* a, const double* b, std::uint64_t* out, std::size_t n) noexcept {
+        table().compare_f64(op, a, b, out, n);
+    }
+
+    void compare(CompareOp op, const float* a, const float* b, std::uint64_t* out, std::size_t n) noexcept {
+        table().compare_f32(op, a, b, out, n);
+    }
+
+    void compare(CompareOp op, const double* a, double b, std::uint64_t* out, std::size_t n) noexcept {
+        table().compare_scalar_f64(op, a, b, out, n);
+    }
+
+    void compare(CompareOp op, const float* a, float b, std::uint64_t* out, std::size_t n) noexcept {
+        table().compare_scalar_f32(op, a, b, out, n);
+    }
+
+    std::size_t compress(const double* a, const std::uint64_t* mask, std::size_t n, double* out) noexcept {
+        return table().compress_f64(a, mask, n, out);
+    }
+
+    std::size_t compress(const float* a, const std::uint64_t* mask, std::size_t n, float* out) noexcept {
+        return table().compress_f32(a, mask, n, out);
+    }
+
+}
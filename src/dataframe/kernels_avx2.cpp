@@ -0,0 +1,175 @@
+#include "kernels_impl.h"
+
+#include <array>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace df::kernels::detail {
+
+    namespace {
+
+    // Shuffles that move the lanes selected by a mask to the front, in order, for compress
+    // AVX2 has no compress instruction, so the permutation is looked up by the bits of the mask
+
+    // For each 4-bit mask of doubles, the 32-bit lanes to take, two per double
+    constexpr auto COMPRESS_F64 = [] {
+        std::array<std::array<std::int32_t, 8>, 16> table{};
+        for (std::size_t bits = 0; bits < table.size(); ++bits) {
+            std::size_t k = 0;
+            for (std::int32_t lane = 0; lane < 4; ++lane) {
+                if ((bits >> lane) & 1) {
+                    table[bits][2 * k] = 2 * lane;
+                    table[bits][2 * k + 1] = 2 * lane + 1;
+                    ++k;
+                }
+            }
+        }
+        return table;
+    }();
+
+    // For each 8-bit mask of floats, the lanes to take packed three bits each, lowest first
+    constexpr auto COMPRESS_F32 = [] {
+        std::array<std::uint32_t, 256> table{};
+        for (std::size_t bits = 0; bits < table.size(); ++bits) {
+            unsigned k = 0;
+            for (std::uint32_t lane = 0; lane < 8; ++lane) {
+                if ((bits >> lane) & 1) {
+                    table[bits] |= lane << (3 * k++);
+                }
+            }
+        }
+        return table;
+    }();
+
+    struct Avx2F64 {
+        using scalar = double;
+        using reg = __m256d;
+        using ireg = __m256i;
+        using mask = __m256d;
+        static constexpr std::size_t width = 4;
+        static constexpr bool has_fma = true;
+
+        static reg load(const double* p) { return _mm256_loadu_pd(p); }
+        static void store(double* p, reg x) { _mm256_storeu_pd(p, x); }
+        static reg set1(double x) { return _mm256_set1_pd(x); }
+        static ireg iset1(std::int64_t x) { return _mm256_set1_epi64x(x); }
+
+        static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+        static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+        static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+        static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+        static reg sqrt(reg a) { return _mm256_sqrt_pd(a); }
+        static reg abs(reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+
+        static mask lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static mask le(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static mask eq(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        static mask unord(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_UNORD_Q); }
+        static mask mand(mask a, mask b) { return _mm256_and_pd(a, b); }
+        static reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+        static bool all(mask m) { return _mm256_movemask_pd(m) == 0xf; }
+        static std::uint64_t bits(mask m) { return static_cast<std::uint64_t>(_mm256_movemask_pd(m)); }
+
+        static ireg as_int(reg a) { return _mm256_castpd_si256(a); }
+        static reg as_float(ireg a) { return _mm256_castsi256_pd(a); }
+        static ireg iadd(ireg a, ireg b) { return _mm256_add_epi64(a, b); }
+        static ireg isub(ireg a, ireg b) { return _mm256_sub_epi64(a, b); }
+        static ireg iand(ireg a, ireg b) { return _mm256_and_si256(a, b); }
+        static ireg ior(ireg a, ireg b) { return _mm256_or_si256(a, b); }
+        template <int N> static ireg shl(ireg a) { return _mm256_slli_epi64(a, N); }
+        template <int N> static ireg shr(ireg a) { return _mm256_srli_epi64(a, N); }
+
+        template <int N> static reg shift_up(reg a) {
+            // the low half moved up, zeros below it
+            const auto low = _mm256_permute2f128_pd(a, a, 0x08);
+            if constexpr (N == 2) {
+                return low;
+            }
+            else {
+                return _mm256_castsi256_pd(_mm256_alignr_epi8(_mm256_castpd_si256(a), _mm256_castpd_si256(low), 16 - 8 * N));
+            }
+        }
+        static reg broadcast_last(reg a) { return _mm256_permute4x64_pd(a, 0xFF); }
+        static reg compress(reg a, std::uint64_t bits) {
+            const auto index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(COMPRESS_F64[bits].data()));
+            return _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(a), index));
+        }
+
+        static double hsum(reg a) {
+            const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+        }
+    };
+
+    struct Avx2F32 {
+        using scalar = float;
+        using reg = __m256;
+        using ireg = __m256i;
+        using mask = __m256;
+        static constexpr std::size_t width = 8;
+        static constexpr bool has_fma = true;
+
+        static reg load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, reg x) { _mm256_storeu_ps(p, x); }
+        static reg set1(float x) { return _mm256_set1_ps(x); }
+        static ireg iset1(std::int64_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+
+        static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+        static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+        static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+        static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+        static reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+        static reg abs(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+
+        static mask lt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static mask le(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static mask eq(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        static mask unord(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_UNORD_Q); }
+        static mask mand(mask a, mask b) { return _mm256_and_ps(a, b); }
+        static reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+        static bool all(mask m) { return _mm256_movemask_ps(m) == 0xff; }
+        static std::uint64_t bits(mask m) { return static_cast<std::uint64_t>(_mm256_movemask_ps(m)); }
+
+        static ireg as_int(reg a) { return _mm256_castps_si256(a); }
+        static reg as_float(ireg a) { return _mm256_castsi256_ps(a); }
+        static ireg iadd(ireg a, ireg b) { return _mm256_add_epi32(a, b); }
+        static ireg isub(ireg a, ireg b) { return _mm256_sub_epi32(a, b); }
+        static ireg iand(ireg a, ireg b) { return _mm256_and_si256(a, b); }
+        static ireg ior(ireg a, ireg b) { return _mm256_or_si256(a, b); }
+        template <int N> static ireg shl(ireg a) { return _mm256_slli_epi32(a, N); }
+        template <int N> static ireg shr(ireg a) { return _mm256_srli_epi32(a, N); }
+
+        template <int N> static reg shift_up(reg a) {
+            // the low half moved up, zeros below it
+            const auto low = _mm256_permute2f128_ps(a, a, 0x08);
+            if constexpr (N == 4) {
+                return low;
+            }
+            else {
+                return _mm256_castsi256_ps(_mm256_alignr_epi8(_mm256_castps_si256(a), _mm256_castps_si256(low), 16 - 4 * N));
+            }
+        }
+        static reg broadcast_last(reg a) { return _mm256_permutevar8x32_ps(a, _mm256_set1_epi32(7)); }
+        static reg compress(reg a, std::uint64_t bits) {
+            const auto fields = _mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(COMPRESS_F32[bits])), _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21));
+            return _mm256_permutevar8x32_ps(a, _mm256_and_si256(fields, _mm256_set1_epi32(7)));
+        }
+
+        static float hsum(reg a) {
+            __m128 quad = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+            quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+            return _mm_cvtss_f32(_mm_add_ss(quad, _mm_shuffle_ps(quad, quad, 0x1)));
+        }
+    };
+
+    }
+
+    const Table avx2_table = make_table<Avx2F64, Avx2F32>();
+
+}
@@ -0,0 +1,113 @@
+#include "kernels_impl.h"
+
+#include <immintrin.h>
+
+namespace df::kernels::detail {
+
+    namespace {
+
+    struct Avx512F64 {
+        using scalar = double;
+        using reg = __m512d;
+        using ireg = __m512i;
+        using mask = __mmask8;
+        static constexpr std::size_t width = 8;
+        static constexpr bool has_fma = true;
+
+        static reg load(const double* p) { return _mm512_loadu_pd(p); }
+        static void store(double* p, reg x) { _mm512_storeu_pd(p, x); }
+        static reg set1(double x) { return _mm512_set1_pd(x); }
+        static ireg iset1(std::int64_t x) { return _mm512_set1_epi64(x); }
+
+        static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+        static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+        static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+        static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+        static reg sqrt(reg a) { return _mm512_sqrt_pd(a); }
+        static reg abs(reg a) { return _mm512_abs_pd(a); }
+        static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+
+        static mask lt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        static mask le(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+        static mask eq(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+        static mask unord(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_UNORD_Q); }
+        static mask mand(mask a, mask b) { return a & b; }
+        static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, b, a); }
+        static bool all(mask m) { return m == 0xff; }
+        static std::uint64_t bits(mask m) { return m; }
+
+        static ireg as_int(reg a) { return _mm512_castpd_si512(a); }
+        static reg as_float(ireg a) { return _mm512_castsi512_pd(a); }
+        static ireg iadd(ireg a, ireg b) { return _mm512_add_epi64(a, b); }
+        static ireg isub(ireg a, ireg b) { return _mm512_sub_epi64(a, b); }
+        static ireg iand(ireg a, ireg b) { return _mm512_and_si512(a, b); }
+        static ireg ior(ireg a, ireg b) { return _mm512_or_si512(a, b); }
+        template <int N> static ireg shl(ireg a) { return _mm512_slli_epi64(a, N); }
+        template <int N> static ireg shr(ireg a) { return _mm512_srli_epi64(a, N); }
+
+        template <int N> static reg shift_up(reg a) {
+            return _mm512_castsi512_pd(_mm512_alignr_epi64(_mm512_castpd_si512(a), _mm512_setzero_si512(), 8 - N));
+        }
+        static reg broadcast_last(reg a) { return _mm512_permutexvar_pd(_mm512_set1_epi64(7), a); }
+        static reg compress(reg a, std::uint64_t bits) { return _mm512_maskz_compress_pd(static_cast<__mmask8>(bits), a); }
+
+        static double hsum(reg a) { return _mm512_reduce_add_pd(a); }
+    };
+
+    struct Avx512F32 {
+        using scalar = float;
+        using reg = __m512;
+        using ireg = __m512i;
+        using mask = __mmask16;
+        static constexpr std::size_t width = 16;
+        static constexpr bool has_fma = true;
+
+        static reg load(const float* p) { return _mm512_loadu_ps(p); }
+        static void store(float* p, reg x) { _mm512_storeu_ps(p, x); }
+        static reg set1(float x) { return _mm512_set1_ps(x); }
+        static ireg iset1(std::int64_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+
+        static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+        static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+        static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+        static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+        static reg sqrt(reg a) { return _mm512_sqrt_ps(a); }
+        static reg abs(reg a) { return _mm512_abs_ps(a); }
+        static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+
+        static mask lt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static mask le(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+        static mask eq(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+        static mask unord(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_UNORD_Q); }
+        static mask mand(mask a, mask b) { return a & b; }
+        static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_ps(m, b, a); }
+        static bool all(mask m) { return m == 0xffff; }
+        static std::uint64_t bits(mask m) { return m; }
+
+        static ireg as_int(reg a) { return _mm512_castps_si512(a); }
+        static reg as_float(ireg a) { return _mm512_castsi512_ps(a); }
+        static ireg iadd(ireg a, ireg b) { return _mm512_add_epi32(a, b); }
+        static ireg isub(ireg a, ireg b) { return _mm512_sub_epi32(a, b); }
+        static ireg iand(ireg a, ireg b) { return _mm512_and_si512(a, b); }
+        static ireg ior(ireg a, ireg b) { return _mm512_or_si512(a, b); }
+        template <int N> static ireg shl(ireg a) { return _mm512_slli_epi32(a, N); }
+        template <int N> static ireg shr(ireg a) { return _mm512_srli_epi32(a, N); }
+
+        template <int N> static reg shift_up(reg a) {
+            return _mm512_castsi512_ps(_mm512_alignr_epi32(_mm512_castps_si512(a), _mm512_setzero_si512(), 16 - N));
+        }
+        static reg broadcast_last(reg a) { return _mm512_permutexvar_ps(_mm512_set1_epi32(15), a); }
+        static reg compress(reg a, std::uint64_t bits) { return _mm512_maskz_compress_ps(static_cast<__mmask16>(bits), a); }
+
+        static float hsum(reg a) { return _mm512_reduce_add_ps(a); }
+    };
+
+    }
+
+    const Table avx512_table = make_table<Avx512F64, Avx512F32>();
+
+}
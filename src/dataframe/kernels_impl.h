@@ -0,0 +1,1050 @@
+#pragma once
+
+// Generic kernel bodies, instantiated once per instruction set
+//
+// Every algorithm here is written against a "vector traits" type V that wraps one instruction set:
+//   V::scalar, V::reg, V::ireg, V::mask, V::width, V::has_fma
+//   load, store, set1, iset1, add, sub, mul, div, min, max, sqrt, abs, fma
+//   lt, le, eq, unord, mand, select, all
+//   bits: the lanes of a mask as the low bits of an integer, lane 0 lowest
+//   as_int, as_float, iadd, isub, iand, ior, shl<N>, shr<N>, hsum
+//   shift_up<N>: lane i + N takes lane i, the lowest N lanes become zero (for N < width)
+//   broadcast_last: every lane takes the highest lane
+//   compress: the lanes selected by the low bits of an integer moved to the lowest lanes, in order
+// This header is private to the library and is only included by the kernels_*.cpp translation units,
+// each of which is compiled with the flags for its instruction set and with floating point contraction
+// disabled so that the error-free transformations below stay exact.
+
+#include "dataframe/kernels.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+
+namespace df::kernels::detail {
+
+    // Function table for one instruction set
+    struct Table {
+        void (*unary_f64)(UnaryOp, const double*, double*, std::size_t) noexcept;
+        void (*unary_f32)(UnaryOp, const float*, float*, std::size_t) noexcept;
+        void (*binary_f64)(BinaryOp, const double*, const double*, double*, std::size_t) noexcept;
+        void (*binary_f32)(BinaryOp, const float*, const float*, float*, std::size_t) noexcept;
+        void (*binary_scalar_f64)(BinaryOp, const double*, double, double*, std::size_t) noexcept;
+        void (*binary_scalar_f32)(BinaryOp, const float*, float, float*, std::size_t) noexcept;
+        double (*sum_f64)(const double*, std::size_t, SumMode) noexcept;
+        float (*sum_f32)(const float*, std::size_t, SumMode) noexcept;
+        double (*dot_f64)(const double*, const double*, std::size_t, SumMode) noexcept;
+        float (*dot_f32)(const float*, const float*, std::size_t, SumMode) noexcept;
+        Spread<double> (*spread_f64)(const double*, std::size_t, double) noexcept;
+        Spread<float> (*spread_f32)(const float*, std::size_t, float) noexcept;
+        Extrema<double> (*extrema_f64)(const double*, std::size_t) noexcept;
+        Extrema<float> (*extrema_f32)(const float*, std::size_t) noexcept;
+        double (*cumsum_f64)(const double*, double*, std::size_t, double) noexcept;
+        float (*cumsum_f32)(const float*, float*, std::size_t, float) noexcept;
+        double (*decayed_cumsum_f64)(const double*, double*, std::size_t, double, double) noexcept;
+        float (*decayed_cumsum_f32)(const float*, float*, std::size_t, float, float) noexcept;
+        void (*compare_f64)(CompareOp, const double*, const double*, std::uint64_t*, std::size_t) noexcept;
+        void (*compare_f32)(CompareOp, const float*, const float*, std::uint64_t*, std::size_t) noexcept;
+        void (*compare_scalar_f64)(CompareOp, const double*, double, std::uint64_t*, std::size_t) noexcept;
+        void (*compare_scalar_f32)(CompareOp, const float*, float, std::uint64_t*, std::size_t) noexcept;
+        std::size_t (*compress_f64)(const double*, const std::uint64_t*, std::size_t, double*) noexcept;
+        std::size_t (*compress_f32)(const float*, const std::uint64_t*, std::size_t, float*) noexcept;
+    };
+
+    extern const Table scalar_table;
+#if defined(DF_KERNELS_X86)
+    extern const Table sse2_table;
+    extern const Table avx2_table;
+    extern const Table avx512_table;
+#endif
+
+    // Everything below has internal linkage: each kernels_*.cpp is compiled with different instruction
+    // set flags, so sharing a single out-of-line instantiation between them would be unsafe
+    namespace {
+
+    // Format constants and polynomial coefficients
+
+    template <typename T>
+    struct Consts;
+
+    template <>
+    struct Consts<double> {
+        using bits = std::uint64_t;
+        static constexpr int mantissa_bits = 52;
+        static constexpr std::int64_t bias = 1023;
+        static constexpr bits mantissa_mask = 0x000fffffffffffffULL;
+        static constexpr double shifter = 0x1.8p52;        // adding this rounds to an integer held in the low bits
+        static constexpr double two_mantissa = 0x1p52;
+        static constexpr double min_normal = 0x1p-1022;
+        static constexpr double sqrt2 = 1.41421356237309504880;
+        static constexpr double log2e = 1.44269504088896340736;
+        static constexpr double ln2_hi = 6.93147180369123816490e-01;   // 21 significant bits, k * ln2_hi is exact
+        static constexpr double ln2_lo = 1.90821492927058770002e-10;
+        static constexpr double exp_max = 709.8;         // exp overflows above 709.78
+        static constexpr double exp_min = -745.2;        // exp rounds to zero below -745.13
+        static constexpr double dekker_split = 134217729.0;   // 2^27 + 1
+
+        // Taylor series of exp(r) on |r| <= ln2/2, truncation error below 2^-57
+        static constexpr double exp_poly[] = {
+            1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+            1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0,
+            1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0
+        };
+
+        // log(m) = 2 atanh(f) = 2f + f * s * P(s), s = f^2, |f| <= 0.1716, truncation error below 2^-60
+        static constexpr double log_poly[] = {
+            2.0 / 21.0, 2.0 / 19.0, 2.0 / 17.0, 2.0 / 15.0, 2.0 / 13.0,
+            2.0 / 11.0, 2.0 / 9.0, 2.0 / 7.0, 2.0 / 5.0, 2.0 / 3.0
+        };
+    };
+
+    template <>
+    struct Consts<float> {
+        using bits = std::uint32_t;
+        static constexpr int mantissa_bits = 23;
+        static constexpr std::int64_t bias = 127;
+        static constexpr bits mantissa_mask = 0x007fffffU;
+        static constexpr float shifter = 0x1.8p23f;
+        static constexpr float two_mantissa = 0x1p23f;
+        static constexpr float min_normal = 0x1p-126f;
+        static constexpr float sqrt2 = 1.41421356f;
+        static constexpr float log2e = 1.44269504f;
+        static constexpr float ln2_hi = 0.693359375f;    // 9 significant bits, k * ln2_hi is exact
+        static constexpr float ln2_lo = -2.12194440e-4f;
+        static constexpr float exp_max = 88.8f;          // expf overflows above 88.72
+        static constexpr float exp_min = -104.0f;        // expf rounds to zero below -103.97
+        static constexpr float dekker_split = 4097.0f;   // 2^12 + 1
+
+        // Taylor series of exp(r) on |r| <= ln2/2, truncation error below 2^-27
+        static constexpr float exp_poly[] = {
+            1.0f / 40320.0f, 1.0f / 5040.0f, 1.0f / 720.0f, 1.0f / 120.0f,
+            1.0f / 24.0f, 1.0f / 6.0f, 1.0f / 2.0f, 1.0f, 1.0f
+        };
+
+        // log(m) = 2 atanh(f) = 2f + f * s * P(s), s = f^2, |f| <= 0.1716, truncation error below 2^-30
+        static constexpr float log_poly[] = {
+            2.0f / 11.0f, 2.0f / 9.0f, 2.0f / 7.0f, 2.0f / 5.0f, 2.0f / 3.0f
+        };
+    };
+
+    // Width-one traits used for the scalar fallback and for the tail of every vector loop
+
+    template <typename T>
+    struct Scalar {
+        using scalar = T;
+        using reg = T;
+        using ireg = typename Consts<T>::bits;
+        using mask = bool;
+        static constexpr std::size_t width = 1;
+#if defined(__FMA__)
+        static constexpr bool has_fma = true;
+#else
+        static constexpr bool has_fma = false;
+#endif
+
+        static reg load(const T* p) { return *p; }
+        static void store(T* p, reg x) { *p = x; }
+        static reg set1(T x) { return x; }
+        static ireg iset1(std::int64_t x) { return static_cast<ireg>(x); }
+
+        static reg add(reg a, reg b) { return a + b; }
+        static reg sub(reg a, reg b) { return a - b; }
+        static reg mul(reg a, reg b) { return a * b; }
+        static reg div(reg a, reg b) { return a / b; }
+        static reg min(reg a, reg b) { return a < b ? a : b; }
+        static reg max(reg a, reg b) { return a > b ? a : b; }
+        static reg sqrt(reg a) { return std::sqrt(a); }
+        static reg abs(reg a) { return std::fabs(a); }
+        static reg fma(reg a, reg b, reg c) {
+            if constexpr (has_fma) {
+                return std::fma(a, b, c);
+            }
+            else {
+                return a * b + c;
+            }
+        }
+
+        static mask lt(reg a, reg b) { return a < b; }
+        static mask le(reg a, reg b) { return a <= b; }
+        static mask eq(reg a, reg b) { return a == b; }
+        static mask unord(reg a, reg b) { return a != a || b != b; }
+        static mask mand(mask a, mask b) { return a && b; }
+        static reg select(mask m, reg a, reg b) { return m ? a : b; }
+        static bool all(mask m) { return m; }
+        static std::uint64_t bits(mask m) { return m; }
+
+        static ireg as_int(reg a) { return std::bit_cast<ireg>(a); }
+        static reg as_float(ireg a) { return std::bit_cast<reg>(a); }
+        static ireg iadd(ireg a, ireg b) { return a + b; }
+        static ireg isub(ireg a, ireg b) { return a - b; }
+        static ireg iand(ireg a, ireg b) { return a & b; }
+        static ireg ior(ireg a, ireg b) { return a | b; }
+        template <int N> static ireg shl(ireg a) { return a << N; }
+        template <int N> static ireg shr(ireg a) { return a >> N; }
+
+        template <int N> static reg shift_up(reg) { return 0; }
+        static reg broadcast_last(reg a) { return a; }
+        static reg compress(reg a, std::uint64_t) { return a; }
+
+        static T hsum(reg a) { return a; }
+    };
+
+    // Error-free transformations
+
+    // a + b = s + e exactly, for any a and b
+    template <typename V>
+    inline void two_sum(typename V::reg a, typename V::reg b, typename V::reg& s, typename V::reg& e) {
+        s = V::add(a, b);
+        const auto bb = V::sub(s, a);
+        e = V::add(V::sub(a, V::sub(s, bb)), V::sub(b, bb));
+    }
+
+    // a * b = p + e exactly, barring overflow
+    template <typename V>
+    inline void two_prod(typename V::reg a, typename V::reg b, typename V::reg& p, typename V::reg& e) {
+        p = V::mul(a, b);
+        if constexpr (V::has_fma) {
+            e = V::fma(a, b, V::sub(V::set1(0), p));
+        }
+        else {
+            // Dekker's product with Veltkamp splitting
+            using T = typename V::scalar;
+            const auto split = V::set1(Consts<T>::dekker_split);
+            const auto ca = V::mul(split, a);
+            const auto a_hi = V::sub(ca, V::sub(ca, a));
+            const auto a_lo = V::sub(a, a_hi);
+            const auto cb = V::mul(split, b);
+            const auto b_hi = V::sub(cb, V::sub(cb, b));
+            const auto b_lo = V::sub(b, b_hi);
+            e = V::add(
+                V::add(V::add(V::sub(V::mul(a_hi, b_hi), p), V::mul(a_hi, b_lo)), V::mul(a_lo, b_hi)),
+                V::mul(a_lo, b_lo)
+            );
+        }
+    }
+
+    template <typename V, std::size_t N>
+    inline typename V::reg horner(typename V::reg x, const typename V::scalar (&coeffs)[N]) {
+        auto p = V::set1(coeffs[0]);
+        for (std::size_t i = 1; i < N; ++i) {
+            p = V::fma(p, x, V::set1(coeffs[i]));
+        }
+        return p;
+    }
+
+    // 2^k for integer valued k with a biased exponent in the normal range
+    template <typename V>
+    inline typename V::reg pow2(typename V::reg k) {
+        using C = Consts<typename V::scalar>;
+        const auto shifter = V::set1(C::shifter);
+        const auto ki = V::isub(V::as_int(V::add(k, shifter)), V::as_int(shifter));
+        return V::as_float(V::template shl<C::mantissa_bits>(V::iadd(ki, V::iset1(C::bias))));
+    }
+
+    // exp(x + xlo), where xlo is an optional low-order correction with |xlo| << |x|
+    //
+    // x = k ln2 + r with |r| <= ln2/2 (Cody-Waite reduction), exp(r) from its Taylor series, and the
+    // 2^k scaling is applied as two factors so that subnormal and overflowing results come out right
+    template <typename V>
+    inline typename V::reg exp(typename V::reg x, typename V::reg xlo) {
+        using C = Consts<typename V::scalar>;
+        const auto shifter = V::set1(C::shifter);
+
+        const auto xc = V::min(V::max(x, V::set1(C::exp_min)), V::set1(C::exp_max));
+        const auto kd = V::sub(V::fma(xc, V::set1(C::log2e), shifter), shifter);
+
+        auto r = V::fma(kd, V::set1(-C::ln2_hi), xc);
+        r = V::fma(kd, V::set1(-C::ln2_lo), r);
+        r = V::add(r, xlo);
+
+        const auto p = horner<V>(r, C::exp_poly);
+
+        const auto k1 = V::sub(V::fma(kd, V::set1(0.5), shifter), shifter);
+        const auto k2 = V::sub(kd, k1);
+        const auto y = V::mul(V::mul(p, pow2<V>(k1)), pow2<V>(k2));
+
+        return V::select(V::unord(x, x), x, y);
+    }
+
+    // log(x) as an unevaluated sum hi + lo, for positive finite x
+    //
+    // x = 2^e m with sqrt(1/2) <= m < sqrt(2), log(m) = 2 atanh(f) with f = (m - 1) / (m + 1), and the
+    // leading terms of e ln2 + 2f are carried in double-word arithmetic so that pow can use the result
+    template <typename V>
+    inline void log_dd(typename V::reg x, typename V::reg& hi, typename V::reg& lo) {
+        using T = typename V::scalar;
+        using C = Consts<T>;
+        const auto one = V::set1(1);
+
+        // Bring subnormal inputs into the normal range
+        const auto sub = V::lt(x, V::set1(C::min_normal));
+        const auto xs = V::select(sub, V::mul(x, V::set1(C::two_mantissa)), x);
+        const auto eadj = V::select(sub, V::set1(-static_cast<T>(C::mantissa_bits)), V::set1(0));
+
+        // Split into exponent and mantissa with integer operations
+        // The biased exponent is converted to floating point by OR-ing it into the mantissa of 2^mantissa_bits
+        const auto bits = V::as_int(xs);
+        const auto two_m = V::set1(C::two_mantissa);
+        auto e = V::sub(V::as_float(V::ior(V::template shr<C::mantissa_bits>(bits), V::as_int(two_m))), two_m);
+        auto m = V::as_float(V::ior(V::iand(bits, V::iset1(static_cast<std::int64_t>(C::mantissa_mask))), V::as_int(one)));
+
+        const auto big = V::lt(V::set1(C::sqrt2), m);
+        m = V::select(big, V::mul(m, V::set1(0.5)), m);
+        e = V::add(V::select(big, V::add(e, one), e), V::sub(eadj, V::set1(static_cast<T>(C::bias))));
+
+        // f = (m - 1) / (m + 1) to double-word precision
+        const auto u = V::sub(m, one);                         // exact
+        typename V::reg v_hi, v_lo;
+        two_sum<V>(m, one, v_hi, v_lo);
+        const auto f = V::div(u, v_hi);
+        typename V::reg p, p_err;
+        two_prod<V>(f, v_hi, p, p_err);
+        const auto rem = V::sub(V::sub(V::sub(u, p), p_err), V::mul(f, v_lo));
+        const auto f_lo = V::div(rem, v_hi);
+
+        const auto s = V::mul(f, f);
+        const auto tail = V::mul(V::mul(f, s), horner<V>(s, C::log_poly));
+
+        // e ln2_hi and 2f are exact, their sum is carried as a pair
+        typename V::reg h, h_err;
+        two_sum<V>(V::mul(e, V::set1(C::ln2_hi)), V::add(f, f), h, h_err);
+        const auto l = V::add(h_err, V::add(V::mul(e, V::set1(C::ln2_lo)), V::add(V::add(f_lo, f_lo), tail)));
+
+        hi = V::add(h, l);
+        lo = V::sub(l, V::sub(hi, h));
+    }
+
+    template <typename V>
+    inline typename V::reg log(typename V::reg x) {
+        using T = typename V::scalar;
+        typename V::reg hi, lo;
+        log_dd<V>(x, hi, lo);
+        auto y = V::add(hi, lo);
+
+        const auto zero = V::set1(0);
+        const auto inf = V::set1(std::numeric_limits<T>::infinity());
+        y = V::select(V::eq(x, inf), inf, y);
+        y = V::select(V::eq(x, zero), V::set1(-std::numeric_limits<T>::infinity()), y);
+        y = V::select(V::lt(x, zero), V::set1(std::numeric_limits<T>::quiet_NaN()), y);
+        return V::select(V::unord(x, x), x, y);
+    }
+
+    // pow(x, y) = exp(y log x) with log x and the product carried in double-word arithmetic
+    // Only valid for positive finite x and finite y, see pow_valid
+    template <typename V>
+    inline typename V::reg pow(typename V::reg x, typename V::reg y) {
+        typename V::reg l_hi, l_lo, p_hi, p_lo;
+        log_dd<V>(x, l_hi, l_lo);
+        two_prod<V>(y, l_hi, p_hi, p_lo);
+        p_lo = V::fma(y, l_lo, p_lo);
+        return exp<V>(p_hi, p_lo);
+    }
+
+    // Lanes for which the vector pow is valid: 0 < x < inf and |y| < inf (false for NaN)
+    template <typename V>
+    inline typename V::mask pow_valid(typename V::reg x, typename V::reg y) {
+        const auto inf = V::set1(std::numeric_limits<typename V::scalar>::infinity());
+        return V::mand(V::mand(V::lt(V::set1(0), x), V::lt(x, inf)), V::lt(V::abs(y), inf));
+    }
+
+    // Elementwise operations as types so that each loop is instantiated with its operation inlined
+
+    struct ExpOp {
+        template <typename V> static typename V::reg apply(typename V::reg a) { return exp<V>(a, V::set1(0)); }
+    };
+    struct LogOp {
+        template <typename V> static typename V::reg apply(typename V::reg a) { return log<V>(a); }
+    };
+    struct SqrtOp {
+        template <typename V> static typename V::reg apply(typename V::reg a) { return V::sqrt(a); }
+    };
+    struct AbsOp {
+        template <typename V> static typename V::reg apply(typename V::reg a) { return V::abs(a); }
+    };
+
+    struct AddOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::add(a, b); }
+    };
+    struct SubOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::sub(a, b); }
+    };
+    struct RSubOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::sub(b, a); }
+    };
+    struct MulOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::mul(a, b); }
+    };
+    struct DivOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::div(a, b); }
+    };
+    struct RDivOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::div(b, a); }
+    };
+    // std::min(a, b) is (b < a) ? b : a, and std::max(a, b) is (a < b) ? b : a
+    struct MinOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::min(b, a); }
+    };
+    struct MaxOp {
+        template <typename V> static typename V::reg apply(typename V::reg a, typename V::reg b) { return V::max(b, a); }
+    };
+
+    // Loops
+
+    template <typename V, typename Op>
+    void map_unary(const typename V::scalar* a, typename V::scalar* out, std::size_t n) noexcept {
+        using S = Scalar<typename V::scalar>;
+        std::size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, Op::template apply<V>(V::load(a + i)));
+        }
+        for (; i < n; ++i) {
+            out[i] = Op::template apply<S>(a[i]);
+        }
+    }
+
+    template <typename V, typename Op>
+    void map_binary(const typename V::scalar* a, const typename V::scalar* b, typename V::scalar* out, std::size_t n) noexcept {
+        using S = Scalar<typename V::scalar>;
+        std::size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, Op::template apply<V>(V::load(a + i), V::load(b + i)));
+        }
+        for (; i < n; ++i) {
+            out[i] = Op::template apply<S>(a[i], b[i]);
+        }
+    }
+
+    template <typename V, typename Op>
+    void map_binary_scalar(const typename V::scalar* a, typename V::scalar b, typename V::scalar* out, std::size_t n) noexcept {
+        using S = Scalar<typename V::scalar>;
+        const auto vb = V::set1(b);
+        std::size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, Op::template apply<V>(V::load(a + i), vb));
+        }
+        for (; i < n; ++i) {
+            out[i] = Op::template apply<S>(a[i], b);
+        }
+    }
+
+    // pow over one block of V::width lanes, handing special lanes to std::pow
+    // The inputs are read before the output is written so that out may alias a or b
+    template <typename V>
+    inline void pow_block(typename V::reg x, typename V::reg y, typename V::scalar* out) {
+        using T = typename V::scalar;
+        const auto valid = pow_valid<V>(x, y);
+        const auto r = pow<V>(x, y);
+        if (V::all(valid)) {
+            V::store(out, r);
+            return;
+        }
+        T xs[V::width], ys[V::width];
+        V::store(xs, x);
+        V::store(ys, y);
+        V::store(out, r);
+        for (std::size_t j = 0; j < V::width; ++j) {
+            if (!pow_valid<Scalar<T>>(xs[j], ys[j])) {
+                out[j] = std::pow(xs[j], ys[j]);
+            }
+        }
+    }
+
+    template <typename V>
+    void pow_binary(const typename V::scalar* a, const typename V::scalar* b, typename V::scalar* out, std::size_t n) noexcept {
+        std::size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            pow_block<V>(V::load(a + i), V::load(b + i), out + i);
+        }
+        for (; i < n; ++i) {
+            pow_block<Scalar<typename V::scalar>>(a[i], b[i], out + i);
+        }
+    }
+
+    template <typename V>
+    void pow_binary_scalar(const typename V::scalar* a, typename V::scalar b, typename V::scalar* out, std::size_t n) noexcept {
+        const auto vb = V::set1(b);
+        std::size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            pow_block<V>(V::load(a + i), vb, out + i);
+        }
+        for (; i < n; ++i) {
+            pow_block<Scalar<typename V::scalar>>(a[i], b, out + i);
+        }
+    }
+
+    template <typename V>
+    void unary(UnaryOp op, const typename V::scalar* a, typename V::scalar* out, std::size_t n) noexcept {
+        switch (op) {
+        case UnaryOp::EXP: return map_unary<V, ExpOp>(a, out, n);
+        case UnaryOp::LOG: return map_unary<V, LogOp>(a, out, n);
+        case UnaryOp::SQRT: return map_unary<V, SqrtOp>(a, out, n);
+        case UnaryOp::ABS: return map_unary<V, AbsOp>(a, out, n);
+        }
+    }
+
+    template <typename V>
+    void binary(BinaryOp op, const typename V::scalar* a, const typename V::scalar* b, typename V::scalar* out, std::size_t n) noexcept {
+        switch (op) {
+        case BinaryOp::ADD: return map_binary<V, AddOp>(a, b, out, n);
+        case BinaryOp::SUB: return map_binary<V, SubOp>(a, b, out, n);
+        case BinaryOp::RSUB: return map_binary<V, RSubOp>(a, b, out, n);
+        case BinaryOp::MUL: return map_binary<V, MulOp>(a, b, out, n);
+        case BinaryOp::DIV: return map_binary<V, DivOp>(a, b, out, n);
+        case BinaryOp::RDIV: return map_binary<V, RDivOp>(a, b, out, n);
+        case BinaryOp::MIN: return map_binary<V, MinOp>(a, b, out, n);
+        case BinaryOp::MAX: return map_binary<V, MaxOp>(a, b, out, n);
+        case BinaryOp::POW: return pow_binary<V>(a, b, out, n);
+        }
+    }
+
+    template <typename V>
+    void binary_scalar(BinaryOp op, const typename V::scalar* a, typename V::scalar b, typename V::scalar* out, std::size_t n) noexcept {
+        switch (op) {
+        case BinaryOp::ADD: return map_binary_scalar<V, AddOp>(a, b, out, n);
+        case BinaryOp::SUB: return map_binary_scalar<V, SubOp>(a, b, out, n);
+        case BinaryOp::RSUB: return map_binary_scalar<V, RSubOp>(a, b, out, n);
+        case BinaryOp::MUL: return map_binary_scalar<V, MulOp>(a, b, out, n);
+        case BinaryOp::DIV: return map_binary_scalar<V, DivOp>(a, b, out, n);
+        case BinaryOp::RDIV: return map_binary_scalar<V, RDivOp>(a, b, out, n);
+        case BinaryOp::MIN: return map_binary_scalar<V, MinOp>(a, b, out, n);
+        case BinaryOp::MAX: return map_binary_scalar<V, MaxOp>(a, b, out, n);
+        case BinaryOp::POW: return pow_binary_scalar<V>(a, b, out, n);
+        }
+    }
+
+    // Reductions keep four independent vector accumulators to hide the latency of the adds
+
+    template <typename V>
+    typename V::scalar sum_naive(const typename V::scalar* a, std::size_t n) noexcept {
+        using T = typename V::scalar;
+        auto s0 = V::set1(0), s1 = V::set1(0), s2 = V::set1(0), s3 = V::set1(0);
+        std::size_t i = 0;
+        for (; i + 4 * V::width <= n; i += 4 * V::width) {
+            s0 = V::add(s0, V::load(a + i));
+            s1 = V::add(s1, V::load(a + i + V::width));
+            s2 = V::add(s2, V::load(a + i + 2 * V::width));
+            s3 = V::add(s3, V::load(a + i + 3 * V::width));
+        }
+        for (; i + V::width <= n; i += V::width) {
+            s0 = V::add(s0, V::load(a + i));
+        }
+        T total = V::hsum(V::add(V::add(s0, s1), V::add(s2, s3)));
+        for (; i < n; ++i) {
+            total += a[i];
+        }
+        return total;
+    }
+
+    template <typename V>
+    typename V::scalar dot_naive(const typename V::scalar* a, const typename V::scalar* b, std::size_t n) noexcept {
+        using T = typename V::scalar;
+        auto s0 = V::set1(0), s1 = V::set1(0), s2 = V::set1(0), s3 = V::set1(0);
+        std::size_t i = 0;
+        for (; i + 4 * V::width <= n; i += 4 * V::width) {
+            s0 = V::fma(V::load(a + i), V::load(b + i), s0);
+            s1 = V::fma(V::load(a + i + V::width), V::load(b + i + V::width), s1);
+            s2 = V::fma(V::load(a + i + 2 * V::width), V::load(b + i + 2 * V::width), s2);
+            s3 = V::fma(V::load(a + i + 3 * V::width), V::load(b + i + 3 * V::width), s3);
+        }
+        for (; i + V::width <= n; i += V::width) {
+            s0 = V::fma(V::load(a + i), V::load(b + i), s0);
+        }
+        T total = V::hsum(V::add(V::add(s0, s1), V::add(s2, s3)));
+        for (; i < n; ++i) {
+            total += a[i] * b[i];
+        }
+        return total;
+    }
+
+    // Pairwise reductions run the naive kernel over blocks small enough that its error stays bounded,
+    // and add the block results as a balanced tree, so the error grows with the logarithm of n
+
+    template <typename V>
+    constexpr std::size_t pairwise_block = 64 * V::width;
+
+    template <typename V>
+    typename V::scalar sum_pairwise(const typename V::scalar* a, std::size_t n) noexcept {
+        if (n <= pairwise_block<V>) {
+            return sum_naive<V>(a, n);
+        }
+        // split on a whole number of blocks so every leaf but the last is full
+        const auto half = (n / pairwise_block<V> + 1) / 2 * pairwise_block<V>;
+        return sum_pairwise<V>(a, half) + sum_pairwise<V>(a + half, n - half);
+    }
+
+    template <typename V>
+    typename V::scalar dot_pairwise(const typename V::scalar* a, const typename V::scalar* b, std::size_t n) noexcept {
+        if (n <= pairwise_block<V>) {
+            return dot_naive<V>(a, b, n);
+        }
+        const auto half = (n / pairwise_block<V> + 1) / 2 * pairwise_block<V>;
+        return dot_pairwise<V>(a, b, half) + dot_pairwise<V>(a + half, b + half, n - half);
+    }
+
+    // Compensated reductions carry the exact rounding error of every addition (and product) in a second
+    // accumulator per lane, as in Neumaier's summation and Ogita, Rump and Oishi's Dot2: the result is
+    // as accurate as if accumulated in twice the working precision, then rounded once
+
+    // Add x to the compensated pair (s, c) on scalars
+    template <typename T>
+    inline void neumaier(T& s, T& c, T x) {
+        const T t = s + x;
+        const T bb = t - s;
+        c += (s - (t - bb)) + (x - bb);
+        s = t;
+    }
+
+    // Fold the lanes of compensated accumulators into one scalar
+    template <typename V>
+    typename V::scalar fold_lanes(const typename V::reg (&s)[2], const typename V::reg (&c)[2]) {
+        using T = typename V::scalar;
+        T lanes[V::width];
+        T total = 0, err = 0;
+        for (const auto& reg : s) {
+            V::store(lanes, reg);
+            for (const auto x : lanes) {
+                neumaier(total, err, x);
+            }
+        }
+        for (const auto& reg : c) {
+            V::store(lanes, reg);
+            for (const auto x : lanes) {
+                err += x;
+            }
+        }
+        return total + err;
+    }
+
+    template <typename V>
+    typename V::scalar sum_compensated(const typename V::scalar* a, std::size_t n) noexcept {
+        using T = typename V::scalar;
+        typename V::reg s[2] = {V::set1(0), V::set1(0)}, c[2] = {V::set1(0), V::set1(0)};
+        std::size_t i = 0;
+        for (; i + 2 * V::width <= n; i += 2 * V::width) {
+            for (std::size_t k = 0; k < 2; ++k) {
+                typename V::reg e;
+                two_sum<V>(s[k], V::load(a + i + k * V::width), s[k], e);
+                c[k] = V::add(c[k], e);
+            }
+        }
+        T total = fold_lanes<V>(s, c), err = 0;
+        for (; i < n; ++i) {
+            neumaier(total, err, a[i]);
+        }
+        return total + err;
+    }
+
+    template <typename V>
+    typename V::scalar dot_compensated(const typename V::scalar* a, const typename V::scalar* b, std::size_t n) noexcept {
+        using T = typename V::scalar;
+        typename V::reg s[2] = {V::set1(0), V::set1(0)}, c[2] = {V::set1(0), V::set1(0)};
+        std::size_t i = 0;
+        for (; i + 2 * V::width <= n; i += 2 * V::width) {
+            for (std::size_t k = 0; k < 2; ++k) {
+                typename V::reg p, p_err, e;
+                two_prod<V>(V::load(a + i + k * V::width), V::load(b + i + k * V::width), p, p_err);
+                two_sum<V>(s[k], p, s[k], e);
+                c[k] = V::add(c[k], V::add(e, p_err));
+            }
+        }
+        T total = fold_lanes<V>(s, c), err = 0;
+        for (; i < n; ++i) {
+            typename Scalar<T>::reg p, p_err;
+            two_prod<Scalar<T>>(a[i], b[i], p, p_err);
+            neumaier(total, err, p);
+            err += p_err;
+        }
+        return total + err;
+    }
+
+    template <typename V>
+    typename V::scalar sum(const typename V::scalar* a, std::size_t n, SumMode mode) noexcept {
+        switch (mode) {
+        case SumMode::NAIVE: return sum_naive<V>(a, n);
+        case SumMode::PAIRWISE: return sum_pairwise<V>(a, n);
+        case SumMode::COMPENSATED: return sum_compensated<V>(a, n);
+        }
+        return sum_naive<V>(a, n);
+    }
+
+    template <typename V>
+    typename V::scalar dot(const typename V::scalar* a, const typename V::scalar* b, std::size_t n, SumMode mode) noexcept {
+        switch (mode) {
+        case SumMode::NAIVE: return dot_naive<V>(a, b, n);
+        case SumMode::PAIRWISE: return dot_pairwise<V>(a, b, n);
+        case SumMode::COMPENSATED: return dot_compensated<V>(a, b, n);
+        }
+        return dot_naive<V>(a, b, n);
+    }
+
+    template <typename V>
+    Spread<typename V::scalar> spread(const typename V::scalar* a, std::size_t n, typename V::scalar center) noexcept {
+        using T = typename V::scalar;
+        const auto c = V::set1(center);
+        auto s0 = V::set1(0), s1 = V::set1(0), s2 = V::set1(0), s3 = V::set1(0);
+        auto q0 = V::set1(0), q1 = V::set1(0), q2 = V::set1(0), q3 = V::set1(0);
+        auto lo = V::set1(a[0]), hi = lo;
+        std::size_t i = 0;
+        for (; i + 4 * V::width <= n; i += 4 * V::width) {
+            const auto x0 = V::load(a + i);
+            const auto x1 = V::load(a + i + V::width);
+            const auto x2 = V::load(a + i + 2 * V::width);
+            const auto x3 = V::load(a + i + 3 * V::width);
+            const auto d0 = V::sub(x0, c);
+            const auto d1 = V::sub(x1, c);
+            const auto d2 = V::sub(x2, c);
+            const auto d3 = V::sub(x3, c);
+            s0 = V::add(s0, d0);
+            s1 = V::add(s1, d1);
+            s2 = V::add(s2, d2);
+            s3 = V::add(s3, d3);
+            q0 = V::fma(d0, d0, q0);
+            q1 = V::fma(d1, d1, q1);
+            q2 = V::fma(d2, d2, q2);
+            q3 = V::fma(d3, d3, q3);
+            lo = V::min(lo, V::min(V::min(x0, x1), V::min(x2, x3)));
+            hi = V::max(hi, V::max(V::max(x0, x1), V::max(x2, x3)));
+        }
+        for (; i + V::width <= n; i += V::width) {
+            const auto x = V::load(a + i);
+            const auto d = V::sub(x, c);
+            s0 = V::add(s0, d);
+            q0 = V::fma(d, d, q0);
+            lo = V::min(lo, x);
+            hi = V::max(hi, x);
+        }
+
+        Spread<T> out{
+            V::hsum(V::add(V::add(s0, s1), V::add(s2, s3))),
+            V::hsum(V::add(V::add(q0, q1), V::add(q2, q3))),
+            a[0],
+            a[0]
+        };
+        T lanes[V::width];
+        V::store(lanes, lo);
+        for (const auto x : lanes) {
+            out.min = std::min(out.min, x);
+        }
+        V::store(lanes, hi);
+        for (const auto x : lanes) {
+            out.max = std::max(out.max, x);
+        }
+        for (; i < n; ++i) {
+            const T d = a[i] - center;
+            out.sum += d;
+            out.sum_sq += d * d;
+            out.min = std::min(out.min, a[i]);
+            out.max = std::max(out.max, a[i]);
+        }
+        return out;
+    }
+
+    template <typename V>
+    Extrema<typename V::scalar> extrema(const typename V::scalar* a, std::size_t n) noexcept {
+        using T = typename V::scalar;
+        constexpr T inf = std::numeric_limits<T>::infinity();
+        Extrema<T> out{inf, -inf, n, n, n};
+
+        // the values: whole vectors while they hold no NaN (x == x), the others one element at a time
+        const auto visit = [&out, a](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                if (a[i] != a[i]) {
+                    out.nan = std::min(out.nan, i);
+                }
+                else {
+                    out.min = std::min(out.min, a[i]);
+                    out.max = std::max(out.max, a[i]);
+                }
+            }
+        };
+        auto lo0 = V::set1(inf), lo1 = lo0;
+        auto hi0 = V::set1(-inf), hi1 = hi0;
+        std::size_t i = 0;
+        for (; i + 4 * V::width <= n; i += 4 * V::width) {
+            const auto x0 = V::load(a + i);
+            const auto x1 = V::load(a + i + V::width);
+            const auto x2 = V::load(a + i + 2 * V::width);
+            const auto x3 = V::load(a + i + 3 * V::width);
+            if (!V::all(V::mand(V::mand(V::eq(x0, x0), V::eq(x1, x1)), V::mand(V::eq(x2, x2), V::eq(x3, x3))))) {
+                visit(i, i + 4 * V::width);
+                continue;
+            }
+            lo0 = V::min(lo0, V::min(x0, x1));
+            lo1 = V::min(lo1, V::min(x2, x3));
+            hi0 = V::max(hi0, V::max(x0, x1));
+            hi1 = V::max(hi1, V::max(x2, x3));
+        }
+        visit(i, n);
+        T lanes[V::width];
+        V::store(lanes, V::min(lo0, lo1));
+        for (const auto x : lanes) {
+            out.min = std::min(out.min, x);
+        }
+        V::store(lanes, V::max(hi0, hi1));
+        for (const auto x : lanes) {
+            out.max = std::max(out.max, x);
+        }
+        if (out.max < out.min) {
+            // every element is NaN
+            return out;
+        }
+
+        // the first positions: skip whole vectors whose lanes all differ strictly from the value
+        const auto lo = V::set1(out.min);
+        for (i = 0; i + V::width <= n && V::all(V::lt(lo, V::load(a + i))); i += V::width) {}
+        for (; a[i] != out.min; ++i) {}
+        out.argmin = i;
+        const auto hi = V::set1(out.max);
+        for (i = 0; i + V::width <= n && V::all(V::lt(V::load(a + i), hi)); i += V::width) {}
+        for (; a[i] != out.max; ++i) {}
+        out.argmax = i;
+        // of equal zeros, the sign of the one found first
+        out.min = a[out.argmin];
+        out.max = a[out.argmax];
+        return out;
+    }
+
+    // Inclusive prefix sum of the lanes of x, in log2(width) shift and add steps
+    template <typename V, int N = 1>
+    typename V::reg prefix_sum(typename V::reg x) noexcept {
+        if constexpr (N < static_cast<int>(V::width)) {
+            return prefix_sum<V, 2 * N>(V::add(x, V::template shift_up<N>(x)));
+        }
+        else {
+            return x;
+        }
+    }
+
+    template <typename V>
+    typename V::scalar cumsum(const typename V::scalar* a, typename V::scalar* out, std::size_t n, typename V::scalar carry) noexcept {
+        // the carry stays in a register, so consecutive vectors depend on each other through a single add
+        typename V::reg running = V::set1(carry);
+        std::size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            running = V::add(prefix_sum<V>(V::load(a + i)), running);
+            V::store(out + i, running);
+            running = V::broadcast_last(running);
+        }
+        if (i > 0) {
+            carry = out[i - 1];
+        }
+        for (; i < n; ++i) {
+            carry += a[i];
+            out[i] = carry;
+        }
+        return carry;
+    }
+
+    // Inclusive prefix of the lanes of x decayed by decay per lane: lane i becomes the sum over j <= i
+    // of decay^(i - j) * x[j], in log2(width) shift, multiply and add steps
+    // decay_n: decay^N, the weight of the lanes N below
+    template <typename V, int N = 1>
+    typename V::reg decayed_prefix(typename V::reg x, typename V::scalar decay_n) noexcept {
+        if constexpr (N < static_cast<int>(V::width)) {
+            return decayed_prefix<V, 2 * N>(V::add(x, V::mul(V::set1(decay_n), V::template shift_up<N>(x))), decay_n * decay_n);
+        }
+        else {
+            return x;
+        }
+    }
+
+    template <typename V>
+    typename V::scalar decayed_cumsum(const typename V::scalar* a, typename V::scalar* out, std::size_t n,
+                                      typename V::scalar decay, typename V::scalar carry) noexcept {
+        using T = typename V::scalar;
+        // lane i weighs the carry from the vector before by decay^(i + 1)
+        T powers[V::width];
+        T power = decay;
+        for (auto& p : powers) {
+            p = power;
+            power *= decay;
+        }
+        const auto carry_weights = V::load(powers);
+        typename V::reg running = V::set1(carry);
+        std::size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            running = V::add(decayed_prefix<V>(V::load(a + i), decay), V::mul(carry_weights, running));
+            V::store(out + i, running);
+            running = V::broadcast_last(running);
+        }
+        if (i > 0) {
+            carry = out[i - 1];
+        }
+        for (; i < n; ++i) {
+            carry = decay * carry + a[i];
+            out[i] = carry;
+        }
+        return carry;
+    }
+
+    // Bits of a mask word, least significant first, and the number of lanes of a vector they cover
+    inline constexpr std::size_t MASK_WORD_BITS{64};
+
+    // The lanes of a comparison as the low bits of a word; GT and GE swap the operands of LT and LE,
+    // and NE is left as EQ for the caller to invert
+    template <typename V, CompareOp Op>
+    inline std::uint64_t compare_lanes(typename V::reg a, typename V::reg b) noexcept {
+        if constexpr (Op == CompareOp::LT) {
+            return V::bits(V::lt(a, b));
+        }
+        else if constexpr (Op == CompareOp::LE) {
+            return V::bits(V::le(a, b));
+        }
+        else if constexpr (Op == CompareOp::GT) {
+            return V::bits(V::lt(b, a));
+        }
+        else if constexpr (Op == CompareOp::GE) {
+            return V::bits(V::le(b, a));
+        }
+        else {
+            return V::bits(V::eq(a, b));
+        }
+    }
+
+    // The right operand of a comparison at index i: an element of an array, or a scalar broadcast
+    template <typename V, typename B>
+    inline typename V::reg compare_operand(B b, std::size_t i) noexcept {
+        if constexpr (std::is_pointer_v<B>) {
+            return V::load(b + i);
+        }
+        else {
+            return V::set1(b);
+        }
+    }
+
+    // One word of the mask at a time, from V::width lanes per comparison
+    template <typename V, CompareOp Op, typename B>
+    void compare_words(const typename V::scalar* a, B b, std::uint64_t* out, std::size_t n) noexcept {
+        using S = Scalar<typename V::scalar>;
+        for (std::size_t base = 0; base < n; base += MASK_WORD_BITS) {
+            const auto m = std::min(MASK_WORD_BITS, n - base);
+            std::uint64_t word = 0;
+            std::size_t i = 0;
+            for (; i + V::width <= m; i += V::width) {
+                word |= compare_lanes<V, Op>(V::load(a + base + i), compare_operand<V>(b, base + i)) << i;
+            }
+            for (; i < m; ++i) {
+                word |= compare_lanes<S, Op>(a[base + i], compare_operand<S>(b, base + i)) << i;
+            }
+            if constexpr (Op == CompareOp::NE) {
+                word = ~word & (m == MASK_WORD_BITS ? ~std::uint64_t{0} : (std::uint64_t{1} << m) - 1);
+            }
+            out[base / MASK_WORD_BITS] = word;
+        }
+    }
+
+    template <typename V, typename B>
+    void compare(CompareOp op, const typename V::scalar* a, B b, std::uint64_t* out, std::size_t n) noexcept {
+        switch (op) {
+        case CompareOp::LT:
+            return compare_words<V, CompareOp::LT>(a, b, out, n);
+        case CompareOp::LE:
+            return compare_words<V, CompareOp::LE>(a, b, out, n);
+        case CompareOp::GT:
+            return compare_words<V, CompareOp::GT>(a, b, out, n);
+        case CompareOp::GE:
+            return compare_words<V, CompareOp::GE>(a, b, out, n);
+        case CompareOp::EQ:
+            return compare_words<V, CompareOp::EQ>(a, b, out, n);
+        case CompareOp::NE:
+            return compare_words<V, CompareOp::NE>(a, b, out, n);
+        }
+    }
+
+    template <typename V>
+    std::size_t compress(const typename V::scalar* a, const std::uint64_t* mask, std::size_t n, typename V::scalar* out) noexcept {
+        using T = typename V::scalar;
+        constexpr std::uint64_t lanes = V::width == MASK_WORD_BITS ? ~std::uint64_t{0} : (std::uint64_t{1} << V::width) - 1;
+        const auto words = (n + MASK_WORD_BITS - 1) / MASK_WORD_BITS;
+        const auto word_at = [&](std::size_t w) {
+            const auto m = std::min(MASK_WORD_BITS, n - w * MASK_WORD_BITS);
+            return m == MASK_WORD_BITS ? mask[w] : mask[w] & ((std::uint64_t{1} << m) - 1);
+        };
+        // counted first, so that whole vectors can be stored past the last selected lane while the
+        // output still has room for them, and are overwritten by the lanes that follow
+        std::size_t total = 0;
+        for (std::size_t w = 0; w < words; ++w) {
+            total += static_cast<std::size_t>(std::popcount(word_at(w)));
+        }
+        std::size_t k = 0;
+        for (std::size_t w = 0; w < words; ++w) {
+            const auto word = word_at(w);
+            const auto* src = a + w * MASK_WORD_BITS;
+            const auto m = std::min(MASK_WORD_BITS, n - w * MASK_WORD_BITS);
+            if (word == 0) {
+                continue;
+            }
+            if (word == ~std::uint64_t{0}) {
+                for (std::size_t i = 0; i < MASK_WORD_BITS; i += V::width) {
+                    V::store(out + k + i, V::load(src + i));
+                }
+                k += MASK_WORD_BITS;
+                continue;
+            }
+            std::size_t i = 0;
+            for (; i + V::width <= m; i += V::width) {
+                const auto bits = (word >> i) & lanes;
+                if constexpr (V::width > 1) {
+                    if (bits == 0) {
+                        continue;
+                    }
+                }
+                const auto packed = V::compress(V::load(src + i), bits);
+                if (k + V::width <= total) {
+                    V::store(out + k, packed);
+                }
+                else {
+                    T spill[V::width];
+                    V::store(spill, packed);
+                    std::copy_n(spill, std::popcount(bits), out + k);
+                }
+                k += static_cast<std::size_t>(std::popcount(bits));
+            }
+            for (; i < m; ++i) {
+                if ((word >> i) & 1) {
+                    out[k++] = src[i];
+                }
+            }
+        }
+        return k;
+    }
+
+    // Build the function table for one instruction set from its double and float traits
+    template <typename VD, typename VF>
+    constexpr Table make_table() {
+        return Table{
+            &unary<VD>,
+            &unary<VF>,
+            &binary<VD>,
+            &binary<VF>,
+            &binary_scalar<VD>,
+            &binary_scalar<VF>,
+            &sum<VD>,
+            &sum<VF>,
+            &dot<VD>,
+            &dot<VF>,
+            &spread<VD>,
+            &spread<VF>,
+            &extrema<VD>,
+            &extrema<VF>,
+            &cumsum<VD>,
+            &cumsum<VF>,
+            &decayed_cumsum<VD>,
+            &decayed_cumsum<VF>,
+            &compare<VD, const double*>,
+            &compare<VF, const float*>,
+            &compare<VD, double>,
+            &compare<VF, float>,
+            &compress<VD>,
+            &compress<VF>,
+        };
+    }
+
+    }
+
+}
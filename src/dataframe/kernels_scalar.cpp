@@ -0,0 +1,7 @@
+#include "kernels_impl.h"
+
+namespace df::kernels::detail {
+
+    const Table scalar_table = make_table<Scalar<double>, Scalar<float>>();
+
+}
@@ -0,0 +1,124 @@
+#include "kernels_impl.h"
+
+#include <emmintrin.h>
+
+namespace df::kernels::detail {
+
+    namespace {
+
+    struct Sse2F64 {
+        using scalar = double;
+        using reg = __m128d;
+        using ireg = __m128i;
+        using mask = __m128d;
+        static constexpr std::size_t width = 2;
+        static constexpr bool has_fma = false;
+
+        static reg load(const double* p) { return _mm_loadu_pd(p); }
+        static void store(double* p, reg x) { _mm_storeu_pd(p, x); }
+        static reg set1(double x) { return _mm_set1_pd(x); }
+        static ireg iset1(std::int64_t x) { return _mm_set1_epi64x(x); }
+
+        static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+        static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+        static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+        static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+        static reg sqrt(reg a) { return _mm_sqrt_pd(a); }
+        static reg abs(reg a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+        static reg fma(reg a, reg b, reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+
+        static mask lt(reg a, reg b) { return _mm_cmplt_pd(a, b); }
+        static mask le(reg a, reg b) { return _mm_cmple_pd(a, b); }
+        static mask eq(reg a, reg b) { return _mm_cmpeq_pd(a, b); }
+        static mask unord(reg a, reg b) { return _mm_cmpunord_pd(a, b); }
+        static mask mand(mask a, mask b) { return _mm_and_pd(a, b); }
+        static reg select(mask m, reg a, reg b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+        static bool all(mask m) { return _mm_movemask_pd(m) == 0x3; }
+        static std::uint64_t bits(mask m) { return static_cast<std::uint64_t>(_mm_movemask_pd(m)); }
+
+        static ireg as_int(reg a) { return _mm_castpd_si128(a); }
+        static reg as_float(ireg a) { return _mm_castsi128_pd(a); }
+        static ireg iadd(ireg a, ireg b) { return _mm_add_epi64(a, b); }
+        static ireg isub(ireg a, ireg b) { return _mm_sub_epi64(a, b); }
+        static ireg iand(ireg a, ireg b) { return _mm_and_si128(a, b); }
+        static ireg ior(ireg a, ireg b) { return _mm_or_si128(a, b); }
+        template <int N> static ireg shl(ireg a) { return _mm_slli_epi64(a, N); }
+        template <int N> static ireg shr(ireg a) { return _mm_srli_epi64(a, N); }
+
+        template <int N> static reg shift_up(reg a) { return _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(a), 8 * N)); }
+        static reg broadcast_last(reg a) { return _mm_unpackhi_pd(a, a); }
+        static reg compress(reg a, std::uint64_t bits) { return bits == 0x2 ? _mm_unpackhi_pd(a, a) : a; }
+
+        static double hsum(reg a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+    };
+
+    struct Sse2F32 {
+        using scalar = float;
+        using reg = __m128;
+        using ireg = __m128i;
+        using mask = __m128;
+        static constexpr std::size_t width = 4;
+        static constexpr bool has_fma = false;
+
+        static reg load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, reg x) { _mm_storeu_ps(p, x); }
+        static reg set1(float x) { return _mm_set1_ps(x); }
+        static ireg iset1(std::int64_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+
+        static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+        static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+        static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+        static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+        static reg sqrt(reg a) { return _mm_sqrt_ps(a); }
+        static reg abs(reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static reg fma(reg a, reg b, reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+        static mask lt(reg a, reg b) { return _mm_cmplt_ps(a, b); }
+        static mask le(reg a, reg b) { return _mm_cmple_ps(a, b); }
+        static mask eq(reg a, reg b) { return _mm_cmpeq_ps(a, b); }
+        static mask unord(reg a, reg b) { return _mm_cmpunord_ps(a, b); }
+        static mask mand(mask a, mask b) { return _mm_and_ps(a, b); }
+        static reg select(mask m, reg a, reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static bool all(mask m) { return _mm_movemask_ps(m) == 0xf; }
+        static std::uint64_t bits(mask m) { return static_cast<std::uint64_t>(_mm_movemask_ps(m)); }
+
+        static ireg as_int(reg a) { return _mm_castps_si128(a); }
+        static reg as_float(ireg a) { return _mm_castsi128_ps(a); }
+        static ireg iadd(ireg a, ireg b) { return _mm_add_epi32(a, b); }
+        static ireg isub(ireg a, ireg b) { return _mm_sub_epi32(a, b); }
+        static ireg iand(ireg a, ireg b) { return _mm_and_si128(a, b); }
+        static ireg ior(ireg a, ireg b) { return _mm_or_si128(a, b); }
+        template <int N> static ireg shl(ireg a) { return _mm_slli_epi32(a, N); }
+        template <int N> static ireg shr(ireg a) { return _mm_srli_epi32(a, N); }
+
+        template <int N> static reg shift_up(reg a) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(a), 4 * N)); }
+        static reg broadcast_last(reg a) { return _mm_shuffle_ps(a, a, 0xFF); }
+        static reg compress(reg a, std::uint64_t bits) {
+            // SSE2 has no variable shuffle: pack the lanes through memory
+            alignas(16) float lanes[4];
+            alignas(16) float packed[4]{};
+            _mm_store_ps(lanes, a);
+            std::size_t k = 0;
+            for (std::size_t j = 0; j < 4; ++j) {
+                packed[k] = lanes[j];
+                k += (bits >> j) & 1;
+            }
+            return _mm_load_ps(packed);
+        }
+
+        static float hsum(reg a) {
+            const reg hi = _mm_movehl_ps(a, a);
+            const reg pair = _mm_add_ps(a, hi);
+            return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 0x1)));
+        }
+    };
+
+    }
+
+    const Table sse2_table = make_table<Sse2F64, Sse2F32>();
+
+}
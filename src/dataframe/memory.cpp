@@ -0,0 +1,218 @@
+#include "dataframe/memory.h"
+#include "dataframe/numa.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace df::memory {
+
+    namespace {
+
+        std::atomic<std::size_t> threshold{HUGE_PAGE_SIZE};
+        // Bumped by every change of the threshold so that each thread drops the buffers it cached before
+        std::atomic<std::size_t> threshold_generation{0};
+
+        // Smallest page size on x86-64 and aarch64 Linux, the granularity of first touch placement
+        constexpr std::size_t SMALL_PAGE_SIZE{4096};
+
+        std::size_t round_up(std::size_t bytes, std::size_t alignment) noexcept {
+            return (bytes + alignment - 1) / alignment * alignment;
+        }
+
+        // The size and alignment actually requested from the system for a buffer
+        struct Layout {
+            std::size_t size;
+            std::size_t alignment;
+            bool huge;
+
+            friend bool operator==(const Layout&, const Layout&) = default;
+        };
+
+        Layout layout(std::size_t bytes, std::size_t alignment) {
+            alignment = std::max(alignment, CACHE_LINE_SIZE);
+            const bool huge = bytes >= huge_page_threshold();
+            if (huge) {
+                alignment = std::max(alignment, HUGE_PAGE_SIZE);
+            }
+
+            // aligned_alloc requires the size to be a non-zero multiple of the alignment
+            const auto size = round_up(std::max<std::size_t>(bytes, 1), alignment);
+            if (size < bytes) {
+                throw std::bad_alloc();
+            }
+            return {size, alignment, huge};
+        }
+
+        // What a cached buffer is known to satisfy, independent of the huge page threshold
+        // The threshold may change between the allocation of a buffer and its release, so its actual
+        // layout cannot be recomputed when it is freed. Any buffer requested with the same key is at
+        // least key.size bytes aligned to at least key.alignment, whether it was made huge or not
+        Layout key(std::size_t bytes, std::size_t alignment) {
+            alignment = std::max(alignment, CACHE_LINE_SIZE);
+            const auto size = round_up(std::max<std::size_t>(bytes, 1), alignment);
+            if (size < bytes) {
+                throw std::bad_alloc();
+            }
+            return {size, alignment, false};
+        }
+
+        void release(void* ptr) noexcept {
+#if defined(_WIN32)
+            _aligned_free(ptr);
+#else
+            std::free(ptr);
+#endif
+        }
+
+        // Buffers released while a PoolScope is active, owned by one thread
+        struct Pool {
+            struct Block {
+                void* ptr;
+                Layout key;
+            };
+
+            int depth{0};
+            std::size_t generation{0};
+            std::size_t capacity{0};
+            std::size_t cached{0};
+            std::vector<Block> blocks;
+
+            void* take(const Layout& wanted) noexcept {
+                // Search from the back: the most recently released buffer is the most likely to be cache hot
+                for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+                    if (it->key == wanted) {
+                        void* ptr = it->ptr;
+                        cached -= wanted.size;
+                        blocks.erase(std::next(it).base());
+                        return ptr;
+                    }
+                }
+                return nullptr;
+            }
+
+            bool put(void* ptr, const Layout& key) noexcept {
+                if (depth == 0 || cached + key.size > capacity) {
+                    return false;
+                }
+                try {
+                    blocks.push_back({ptr, key});
+                }
+                catch (...) {
+                    return false;
+                }
+                cached += key.size;
+                return true;
+            }
+
+            void clear() noexcept {
+                for (auto& block : blocks) {
+                    release(block.ptr);
+                }
+                blocks.clear();
+                cached = 0;
+            }
+
+            ~Pool() { clear(); }
+        };
+
+        Pool& pool() noexcept {
+            thread_local Pool instance;
+            const auto current = threshold_generation.load(std::memory_order_relaxed);
+            if (instance.generation != current) {
+                // buffers cached under another threshold may be huge when they should not be, or not when they should
+                instance.clear();
+                instance.generation = current;
+            }
+            return instance;
+        }
+
+    }
+
+    void* allocate(std::size_t bytes, std::size_t alignment) {
+        const auto wanted = layout(bytes, alignment);
+
+        if (void* ptr = pool().take(key(bytes, alignment))) {
+            return ptr;
+        }
+
+#if defined(_WIN32)
+        void* ptr = _aligned_malloc(wanted.size, wanted.alignment);
+#else
+        void* ptr = std::aligned_alloc(wanted.alignment, wanted.size);
+#endif
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (wanted.huge) {
+            // Advisory only: if transparent huge pages are disabled the buffer simply uses 4K pages
+            madvise(ptr, wanted.size, MADV_HUGEPAGE);
+        }
+#endif
+        if (wanted.huge) {
+            // Large buffers come straight from the system with no page backed yet, so where the first
+            // write lands decides the node of each page
+            try {
+                numa::first_touch(ptr, wanted.size, SMALL_PAGE_SIZE);
+            }
+            catch (...) {
+                release(ptr);
+                throw;
+            }
+        }
+        return ptr;
+    }
+
+    void deallocate(void* ptr, std::size_t bytes, std::size_t alignment) noexcept {
+        if (!ptr) {
+            return;
+        }
+        auto& cache = pool();
+        if (cache.depth > 0) {
+            // key only throws for sizes that could never have been allocated
+            if (cache.put(ptr, key(bytes, alignment))) {
+                return;
+            }
+        }
+        release(ptr);
+    }
+
+    PoolScope::PoolScope(std::size_t capacity) noexcept {
+        auto& cache = pool();
+        if (cache.depth++ == 0) {
+            cache.capacity = capacity;
+        }
+    }
+
+    PoolScope::~PoolScope() {
+        auto& cache = pool();
+        if (--cache.depth == 0) {
+            cache.clear();
+        }
+    }
+
+    std::size_t PoolScope::cached_bytes() noexcept {
+        return pool().cached;
+    }
+
+    std::size_t huge_page_threshold() noexcept {
+        return threshold.load(std::memory_order_relaxed);
+    }
+
+    void set_huge_page_threshold(std::size_t bytes) noexcept {
+        threshold.store(bytes, std::memory_order_relaxed);
+        threshold_generation.fetch_add(1, std::memory_order_relaxed);
+        // the calling thread flushes now, every other thread on its next allocation or release
+        pool();
+    }
+
+}
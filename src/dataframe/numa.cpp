@@ -0,0 +1,187 @@
+#include "dataframe/numa.h"
+#include "dataframe/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace df::numa {
+
+    namespace {
+
+        // CPU numbers in the kernel list format, such as "0-3,8,10-11"
+        std::vector<int> parse_cpu_list(const std::string& list) {
+            std::vector<int> cpus;
+            std::istringstream in(list);
+            std::string item;
+            while (std::getline(in, item, ',')) {
+                const auto dash = item.find('-');
+                try {
+                    const int first = std::stoi(item.substr(0, dash));
+                    const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+                    for (int cpu = first; cpu <= last; ++cpu) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                catch (const std::exception&) {
+                    // skip malformed entries
+                }
+            }
+            return cpus;
+        }
+
+        struct State {
+            std::mutex mutex;
+            Topology topology{detect()};
+            std::atomic<std::size_t> nodes{topology.size()};
+        };
+
+        State& state() {
+            static State s;
+            return s;
+        }
+
+        thread_local std::size_t node_of_thread{NO_NODE};
+
+    }
+
+    Topology detect() {
+        auto allowed = detail::allowed_cpus();
+        if (allowed.empty()) {
+            for (int cpu = 0; cpu < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++cpu) {
+                allowed.push_back(cpu);
+            }
+        }
+
+        Topology topology;
+#if defined(__linux__)
+        // node directories are numbered from 0 but may have gaps
+        constexpr int MAX_NODES{1024};
+        for (int node = 0; node < MAX_NODES; ++node) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!in) {
+                continue;
+            }
+            std::string list;
+            std::getline(in, list);
+            std::vector<int> cpus;
+            for (const int cpu : parse_cpu_list(list)) {
+                if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty()) {
+                topology.nodes.push_back(std::move(cpus));
+            }
+        }
+#endif
+        if (topology.nodes.empty()) {
+            topology.nodes.push_back(std::move(allowed));
+        }
+        return topology;
+    }
+
+    Topology topology() {
+        auto& s = state();
+        std::lock_guard lock(s.mutex);
+        return s.topology;
+    }
+
+    std::size_t node_count() noexcept {
+        return state().nodes.load(std::memory_order_relaxed);
+    }
+
+    void set_topology(Topology topology) {
+        if (topology.nodes.empty()) {
+            throw std::invalid_argument("Topology has no nodes");
+        }
+        for (const auto& cpus : topology.nodes) {
+            if (cpus.empty()) {
+                throw std::invalid_argument("Topology node has no CPU");
+            }
+        }
+        {
+            auto& s = state();
+            std::lock_guard lock(s.mutex);
+            s.nodes.store(topology.size(), std::memory_order_relaxed);
+            s.topology = std::move(topology);
+        }
+        set_parallel_config(parallel_config());
+    }
+
+    std::size_t current_node() noexcept {
+        return node_of_thread;
+    }
+
+    bool active() noexcept {
+        if (node_count() < 2) {
+            return false;
+        }
+        const auto config = parallel_config();
+        return config.backend == Backend::POOL && config.pin;
+    }
+
+    void first_touch(void* ptr, std::size_t bytes, std::size_t page) {
+        if (!active() || bytes == 0) {
+            return;
+        }
+        // the loop over pages is partitioned by node like every other loop, so page p is written from
+        // a thread of home_node(p, pages, nodes)
+        constexpr std::size_t PAGES_PER_TASK{64};
+        auto* base = static_cast<volatile char*>(ptr);
+        const auto pages = (bytes + page - 1) / page;
+        parallel_for(pages, PAGES_PER_TASK, [base, page](std::size_t begin, std::size_t end) {
+            for (auto p = begin; p < end; ++p) {
+                base[p * page] = 0;
+            }
+        });
+    }
+
+    namespace detail {
+
+        std::vector<int> allowed_cpus() {
+            std::vector<int> cpus;
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            return cpus;
+        }
+
+        Placement placement(const Topology& topology, std::size_t worker) {
+            const auto node = worker % topology.size();
+            const auto& cpus = topology.nodes[node];
+            return {node, cpus[(worker / topology.size()) % cpus.size()]};
+        }
+
+        void pin_thread(const Placement& placement) noexcept {
+            node_of_thread = placement.node;
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(placement.cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+        }
+
+    }
+
+}
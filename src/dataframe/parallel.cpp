@@ -0,0 +1,549 @@
+#include "dataframe/parallel.h"
+#include "dataframe/memory.h"
+#include "dataframe/numa.h"
+#include "dataframe/policy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(USE_TBB)
+#include <tbb/blocked_range.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+#endif
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace df {
+
+    namespace {
+
+        unsigned effective_concurrency(const ParallelConfig& config) noexcept {
+            return config.concurrency != 0 ? config.concurrency : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Keeps the first exception thrown by any task
+        class FirstError {
+        public:
+            bool failed() const noexcept { return failed_.load(std::memory_order_relaxed); }
+
+            void capture() noexcept {
+                std::lock_guard lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                    failed_.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            void rethrow() const {
+                if (error_) {
+                    std::rethrow_exception(error_);
+                }
+            }
+
+        private:
+            std::atomic<bool> failed_{false};
+            std::mutex mutex_;
+            std::exception_ptr error_;
+        };
+
+        // Work-stealing thread pool
+        //
+        // Each of the concurrency slots owns a deque of index ranges; slot 0 belongs to the calling thread
+        // and the others to worker threads. A thread takes a range from the back of its own deque and,
+        // while the range holds more than grain indices, pushes its upper half back and keeps the lower,
+        // so work is split lazily and only as far as idle threads need it. A thread whose deque is empty
+        // steals from the front of the others', where the largest ranges are.
+        //
+        // Pinned workers are spread over the nodes of numa::topology(). With more than one node, each job
+        // starts as one block per node (see numa::home_node) on the deque of a worker of that node, and
+        // workers only steal from workers of their own node, so a block never leaves its node except
+        // through the calling thread, which helps everywhere and runs the blocks of nodes without workers.
+        class Pool {
+        public:
+            Pool(unsigned concurrency, bool pin) : queues_(std::max(1u, concurrency)), node_of_(queues_.size(), 0) {
+                const auto topology = pin ? numa::topology() : numa::Topology{};
+                nodes_ = std::max<std::size_t>(1, topology.size());
+                node_of_[0] = numa::NO_NODE;
+                for (unsigned slot = 1; slot < queues_.size(); ++slot) {
+                    if (pin) {
+                        const auto placement = numa::detail::placement(topology, slot - 1);
+                        node_of_[slot] = placement.node;
+                        threads_.emplace_back([this, slot, placement] {
+                            numa::detail::pin_thread(placement);
+                            worker(slot);
+                        });
+                    }
+                    else {
+                        threads_.emplace_back([this, slot] { worker(slot); });
+                    }
+                }
+            }
+
+            ~Pool() {
+                {
+                    std::lock_guard lock(mutex_);
+                    stop_ = true;
+                }
+                wake_.notify_all();
+                for (auto& thread : threads_) {
+                    thread.join();
+                }
+            }
+
+            Pool(const Pool&) = delete;
+            Pool& operator=(const Pool&) = delete;
+
+            void run(std::size_t n, std::size_t grain, detail::RangeFn body, const void* context) {
+                // nested parallel work runs on the thread that reached it
+                if (inside_ == this || threads_.empty()) {
+                    body(context, 0, n);
+                    return;
+                }
+
+                std::lock_guard running(run_mutex_);
+                Job job{body, context, grain, {}, {}};
+                job.remaining.store(n, std::memory_order_relaxed);
+                if (nodes_ > 1) {
+                    const auto block = (n + nodes_ - 1) / nodes_;
+                    for (std::size_t node = 0; node < nodes_ && node * block < n; ++node) {
+                        push(first_slot(node), {node * block, std::min(n, (node + 1) * block)});
+                    }
+                }
+                else {
+                    push(0, {0, n});
+                }
+                {
+                    std::lock_guard lock(mutex_);
+                    job_ = &job;
+                    ++generation_;
+                }
+                wake_.notify_all();
+
+                inside_ = this;
+                work(0, job);
+                inside_ = nullptr;
+
+                // workers may still be looking for ranges; the job must outlive them
+                {
+                    std::unique_lock lock(mutex_);
+                    job_ = nullptr;
+                    done_.wait(lock, [this] { return active_ == 0; });
+                }
+                job.error.rethrow();
+            }
+
+        private:
+            struct Range {
+                std::size_t begin;
+                std::size_t end;
+            };
+
+            struct alignas(CACHE_LINE_SIZE) Queue {
+                std::mutex mutex;
+                std::deque<Range> ranges;
+            };
+
+            struct Job {
+                detail::RangeFn body;
+                const void* context;
+                std::size_t grain;
+                std::atomic<std::size_t> remaining{0};
+                FirstError error;
+            };
+
+            std::vector<Queue> queues_;
+            // node of each slot, numa::NO_NODE for the calling thread
+            std::vector<std::size_t> node_of_;
+            std::size_t nodes_{1};
+            std::vector<std::thread> threads_;
+
+            std::mutex run_mutex_;
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::condition_variable done_;
+            Job* job_{nullptr};
+            std::uint64_t generation_{0};
+            unsigned active_{0};
+            bool stop_{false};
+
+            // The pool whose job the calling thread is running, if any
+            static thread_local const Pool* inside_;
+
+            void push(unsigned slot, Range range) {
+                std::lock_guard lock(queues_[slot].mutex);
+                queues_[slot].ranges.push_back(range);
+            }
+
+            // The first worker slot on node, or the calling thread's when the node has no worker
+            unsigned first_slot(std::size_t node) const noexcept {
+                for (unsigned slot = 1; slot < queues_.size(); ++slot) {
+                    if (node_of_[slot] == node) {
+                        return slot;
+                    }
+                }
+                return 0;
+            }
+
+            // Whether the thread of slot may take ranges from the deque of victim
+            bool may_steal(unsigned slot, std::size_t victim) const noexcept {
+                return nodes_ == 1 || slot == 0 || node_of_[victim] == node_of_[slot];
+            }
+
+            // Take a range from the back of the deque of slot, or steal one from the front of another
+            bool next(unsigned slot, Range& range) {
+                {
+                    auto& own = queues_[slot];
+                    std::lock_guard lock(own.mutex);
+                    if (!own.ranges.empty()) {
+                        range = own.ranges.back();
+                        own.ranges.pop_back();
+                        return true;
+                    }
+                }
+                for (std::size_t i = 1; i < queues_.size(); ++i) {
+                    const auto v = (slot + i) % queues_.size();
+                    if (!may_steal(slot, v)) {
+                        continue;
+                    }
+                    auto& victim = queues_[v];
+                    std::lock_guard lock(victim.mutex);
+                    if (!victim.ranges.empty()) {
+                        range = victim.ranges.front();
+                        victim.ranges.pop_front();
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void execute(unsigned slot, Job& job, Range range) {
+                while (range.end - range.begin > job.grain) {
+                    const auto mid = range.begin + (range.end - range.begin) / 2;
+                    push(slot, {mid, range.end});
+                    range.end = mid;
+                }
+                if (!job.error.failed()) {
+                    try {
+                        job.body(job.context, range.begin, range.end);
+                    }
+                    catch (...) {
+                        job.error.capture();
+                    }
+                }
+                job.remaining.fetch_sub(range.end - range.begin, std::memory_order_acq_rel);
+            }
+
+            // Take part in job until every index is done
+            void work(unsigned slot, Job& job) {
+                Range range;
+                while (job.remaining.load(std::memory_order_acquire) != 0) {
+                    if (next(slot, range)) {
+                        execute(slot, job, range);
+                    }
+                    else {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+
+            void worker(unsigned slot) {
+                inside_ = this;
+                std::uint64_t seen = 0;
+                for (;;) {
+                    Job* job;
+                    {
+                        std::unique_lock lock(mutex_);
+                        wake_.wait(lock, [&] { return stop_ || (job_ && generation_ != seen); });
+                        if (stop_) {
+                            return;
+                        }
+                        seen = generation_;
+                        job = job_;
+                        ++active_;
+                    }
+                    work(slot, *job);
+                    {
+                        std::lock_guard lock(mutex_);
+                        if (--active_ == 0) {
+                            done_.notify_all();
+                        }
+                    }
+                }
+            }
+        };
+
+        thread_local const Pool* Pool::inside_{nullptr};
+
+#if defined(USE_TBB)
+        // Pins each worker thread entering the arena to the placement of its arena slot
+        class PinObserver : public tbb::task_scheduler_observer {
+        public:
+            explicit PinObserver(tbb::task_arena& arena)
+                : tbb::task_scheduler_observer(arena), topology_(numa::topology()) {
+                observe(true);
+            }
+
+            ~PinObserver() override {
+                observe(false);
+            }
+
+            void on_scheduler_entry(bool is_worker) override {
+                const auto slot = tbb::this_task_arena::current_thread_index();
+                if (is_worker && slot > 0) {
+                    numa::detail::pin_thread(numa::detail::placement(topology_, static_cast<std::size_t>(slot - 1)));
+                }
+            }
+
+        private:
+            numa::Topology topology_;
+        };
+#endif
+
+        // The threads and settings of the current backend
+        struct State {
+            std::mutex mutex;
+            std::atomic<Backend> backend{Backend::STD};
+            std::atomic<unsigned> concurrency{0};
+            std::atomic<bool> pin{false};
+            std::atomic<std::size_t> grain{DEFAULT_GRAIN};
+
+            std::unique_ptr<Pool> pool;
+#if defined(USE_TBB)
+            std::unique_ptr<tbb::global_control> control;
+            std::unique_ptr<tbb::task_arena> arena;
+            std::unique_ptr<PinObserver> observer;
+#endif
+
+            ParallelConfig load() const noexcept {
+                return {
+                    backend.load(std::memory_order_relaxed),
+                    concurrency.load(std::memory_order_relaxed),
+                    pin.load(std::memory_order_relaxed),
+                    grain.load(std::memory_order_relaxed)
+                };
+            }
+
+            void apply(const ParallelConfig& config) {
+                std::lock_guard lock(mutex);
+                pool.reset();
+#if defined(USE_TBB)
+                observer.reset();
+                arena.reset();
+                control.reset();
+                // the standard algorithms run on TBB too, so the limit applies to the STD backend as well
+                if (config.concurrency != 0) {
+                    control = std::make_unique<tbb::global_control>(
+                        tbb::global_control::max_allowed_parallelism, config.concurrency
+                    );
+                }
+#endif
+                const auto threads = effective_concurrency(config);
+                switch (config.backend) {
+                case Backend::STD:
+                    break;
+                case Backend::TBB:
+#if defined(USE_TBB)
+                    arena = std::make_unique<tbb::task_arena>(static_cast<int>(threads));
+                    arena->initialize();
+                    if (config.pin) {
+                        observer = std::make_unique<PinObserver>(*arena);
+                    }
+#endif
+                    break;
+                case Backend::OPENMP:
+#if defined(_OPENMP)
+                    if (config.pin) {
+                        // the runtime keeps these threads for later regions of the same size
+                        const auto topology = numa::topology();
+                        #pragma omp parallel num_threads(threads)
+                        {
+                            const auto slot = static_cast<std::size_t>(omp_get_thread_num());
+                            if (slot != 0) {
+                                numa::detail::pin_thread(numa::detail::placement(topology, slot - 1));
+                            }
+                        }
+                    }
+#endif
+                    break;
+                case Backend::POOL:
+                    pool = std::make_unique<Pool>(threads, config.pin);
+                    break;
+                }
+                backend.store(config.backend, std::memory_order_relaxed);
+                concurrency.store(config.concurrency, std::memory_order_relaxed);
+                pin.store(config.pin, std::memory_order_relaxed);
+                grain.store(config.grain, std::memory_order_relaxed);
+            }
+        };
+
+        // The configuration named by the environment, keeping the default for anything unset or malformed
+        ParallelConfig configured() {
+            ParallelConfig config;
+            if (const char* env = std::getenv("DF_BACKEND")) {
+                const std::string name(env);
+                if (name == "tbb" && backend_available(Backend::TBB)) {
+                    config.backend = Backend::TBB;
+                }
+                else if (name == "openmp" && backend_available(Backend::OPENMP)) {
+                    config.backend = Backend::OPENMP;
+                }
+                else if (name == "pool") {
+                    config.backend = Backend::POOL;
+                }
+            }
+            const auto number = [](const char* name, std::size_t fallback) {
+                const char* env = std::getenv(name);
+                if (!env || !*env) {
+                    return fallback;
+                }
+                char* end = nullptr;
+                const auto value = std::strtoull(env, &end, 10);
+                return *end == '\0' ? static_cast<std::size_t>(value) : fallback;
+            };
+            config.concurrency = static_cast<unsigned>(number("DF_THREADS", config.concurrency));
+            config.pin = number("DF_PIN", config.pin) != 0;
+            config.grain = std::max<std::size_t>(1, number("DF_GRAIN", config.grain));
+            return config;
+        }
+
+        State& state() {
+            static State s;
+            static std::once_flag once;
+            std::call_once(once, [] { s.apply(configured()); });
+            return s;
+        }
+
+    }
+
+    bool backend_available(Backend backend) noexcept {
+        switch (backend) {
+        case Backend::STD:
+        case Backend::POOL:
+            return true;
+        case Backend::TBB:
+#if defined(USE_TBB)
+            return true;
+#else
+            return false;
+#endif
+        case Backend::OPENMP:
+#if defined(_OPENMP)
+            return true;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    ParallelConfig parallel_config() noexcept {
+        return state().load();
+    }
+
+    Backend parallel_backend() noexcept {
+        return state().backend.load(std::memory_order_relaxed);
+    }
+
+    void set_parallel_config(const ParallelConfig& config) {
+        if (!backend_available(config.backend)) {
+            throw std::invalid_argument("Parallel backend is not available in this build");
+        }
+        if (config.grain == 0) {
+            throw std::invalid_argument("Parallel grain must be positive");
+        }
+        state().apply(config);
+    }
+
+    unsigned parallel_concurrency() noexcept {
+        return effective_concurrency(parallel_config());
+    }
+
+    namespace detail {
+
+        void parallel_for(std::size_t n, std::size_t grain, RangeFn body, const void* context) {
+            if (n == 0) {
+                return;
+            }
+            grain = std::max<std::size_t>(1, grain);
+            auto& s = state();
+            switch (s.backend.load(std::memory_order_relaxed)) {
+            case Backend::STD:
+                break;
+            case Backend::TBB:
+#if defined(USE_TBB)
+                s.arena->execute([&] {
+                    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, n, grain), [&](const tbb::blocked_range<std::size_t>& r) {
+                        body(context, r.begin(), r.end());
+                    });
+                });
+                return;
+#else
+                break;
+#endif
+            case Backend::OPENMP: {
+#if defined(_OPENMP)
+                const auto tasks = static_cast<std::ptrdiff_t>((n + grain - 1) / grain);
+                const auto threads = static_cast<int>(effective_concurrency(s.load()));
+                FirstError error;
+                #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+                for (std::ptrdiff_t t = 0; t < tasks; ++t) {
+                    if (error.failed()) {
+                        continue;
+                    }
+                    const auto begin = static_cast<std::size_t>(t) * grain;
+                    try {
+                        body(context, begin, std::min(begin + grain, n));
+                    }
+                    catch (...) {
+                        error.capture();
+                    }
+                }
+                error.rethrow();
+                return;
+#else
+                break;
+#endif
+            }
+            case Backend::POOL:
+                s.pool->run(n, grain, body, context);
+                return;
+            }
+
+            // an exception escaping a standard parallel algorithm would terminate the program
+            const auto tasks = (n + grain - 1) / grain;
+            FirstError error;
+            std::for_each(std::execution::par, IndexIterator{0}, IndexIterator{tasks}, [&](std::size_t t) {
+                if (error.failed()) {
+                    return;
+                }
+                const auto begin = t * grain;
+                try {
+                    body(context, begin, std::min(begin + grain, n));
+                }
+                catch (...) {
+                    error.capture();
+                }
+            });
+            error.rethrow();
+        }
+
+    }
+
+}
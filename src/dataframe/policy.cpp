@@ -0,0 +1,139 @@
+#include "dataframe/policy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace df {
+
+    namespace {
+
+        struct Thresholds {
+            std::atomic<std::size_t> unseq;
+            std::atomic<std::size_t> par_light;
+            std::atomic<std::size_t> par_medium;
+            std::atomic<std::size_t> par_heavy;
+
+            explicit Thresholds(const AutoThresholds& t)
+                : unseq(t.unseq), par_light(t.par_light), par_medium(t.par_medium), par_heavy(t.par_heavy) {}
+
+            void store(const AutoThresholds& t) noexcept {
+                unseq.store(t.unseq, std::memory_order_relaxed);
+                par_light.store(t.par_light, std::memory_order_relaxed);
+                par_medium.store(t.par_medium, std::memory_order_relaxed);
+                par_heavy.store(t.par_heavy, std::memory_order_relaxed);
+            }
+
+            AutoThresholds load() const noexcept {
+                return {
+                    unseq.load(std::memory_order_relaxed),
+                    par_light.load(std::memory_order_relaxed),
+                    par_medium.load(std::memory_order_relaxed),
+                    par_heavy.load(std::memory_order_relaxed)
+                };
+            }
+        };
+
+        // The thresholds named by DF_AUTO_THRESHOLDS, or the defaults when it is unset or malformed
+        AutoThresholds configured() {
+            const char* env = std::getenv("DF_AUTO_THRESHOLDS");
+            if (!env) {
+                return {};
+            }
+            const std::string value(env);
+            if (value == "calibrate") {
+                return calibrate_auto_thresholds();
+            }
+            std::istringstream in(value);
+            AutoThresholds t;
+            char comma1 = 0, comma2 = 0, comma3 = 0;
+            if (in >> t.unseq >> comma1 >> t.par_light >> comma2 >> t.par_medium >> comma3 >> t.par_heavy
+                && comma1 == ',' && comma2 == ',' && comma3 == ',') {
+                return t;
+            }
+            return {};
+        }
+
+        Thresholds& thresholds() {
+            static Thresholds t{configured()};
+            return t;
+        }
+
+        using Clock = std::chrono::steady_clock;
+
+        // Smallest time per call of f in seconds, over a few rounds of reps calls
+        template <typename F>
+        double time_per_call(std::size_t reps, F&& f) {
+            constexpr int ROUNDS{5};
+            double best = std::numeric_limits<double>::max();
+            for (int r = 0; r < ROUNDS; ++r) {
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < reps; ++i) {
+                    f();
+                }
+                const std::chrono::duration<double> elapsed = Clock::now() - start;
+                best = std::min(best, elapsed.count() / static_cast<double>(reps));
+            }
+            return best;
+        }
+
+        // The count from which splitting per_element seconds of work per element over threads saves
+        // more than dispatch seconds, or the largest count when it never does
+        std::size_t crossover(double dispatch, double per_element, unsigned threads) {
+            if (threads < 2 || per_element <= 0) {
+                return std::numeric_limits<std::size_t>::max();
+            }
+            const double saved = per_element * (1.0 - 1.0 / threads);
+            return static_cast<std::size_t>(std::ceil(dispatch / saved));
+        }
+
+    }
+
+    AutoThresholds auto_thresholds() noexcept {
+        return thresholds().load();
+    }
+
+    void set_auto_thresholds(const AutoThresholds& t) noexcept {
+        thresholds().store(t);
+    }
+
+    AutoThresholds calibrate_auto_thresholds() {
+        constexpr std::size_t N{4096};
+        std::vector<double> data(N), out(N);
+        for (std::size_t i = 0; i < N; ++i) {
+            data[i] = 1.0 + static_cast<double>(i) / N;
+        }
+
+        // Representative sequential work per element for each cost class
+        const auto per_element = [&](auto op) {
+            return time_per_call(64, [&] {
+                std::transform(std::execution::unseq, data.begin(), data.end(), out.begin(), op);
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            }) / N;
+        };
+        const double light = per_element([](double x) { return x * 1.5 + 0.5; });
+        const double medium = per_element([](double x) { return std::sqrt(x) / (x + 1.0); });
+        const double heavy = per_element([](double x) { return std::exp(x) + std::log(x); });
+
+        // Handing one element to each thread of the configured backend costs the dispatch and nothing else
+        const unsigned threads = parallel_concurrency();
+        const double dispatch = time_per_call(256, [&] {
+            parallel_for(threads, 1, [&](std::size_t begin, std::size_t) { out[begin] += 1.0; });
+        });
+
+        // Per-element time of a sequential against a vectorized trivial loop is too small to separate
+        // reliably, so the SEQ/UNSEQ switch keeps its default
+        AutoThresholds t;
+        t.par_light = crossover(dispatch, light, threads);
+        t.par_medium = crossover(dispatch, medium, threads);
+        t.par_heavy = crossover(dispatch, heavy, threads);
+        return t;
+    }
+
+}
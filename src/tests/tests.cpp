@@ -1,6 +1,21 @@
 #include "gtest/gtest.h"
 #include "df.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
 namespace {
     using namespace df;
 
@@ -139,4 +154,2566 @@ namespace {
         const Series<double> s1({});
         EXPECT_EQ(s1.variance(), std::nullopt) << "Expect variance of an empty series to be undefined";
     }
-}
\ No newline at end of file
+
+    TEST(ExprTests, ChainedOperatorsAreLazy) {
+        const Series<double> a({1.0, 2.0, 3.0});
+        const Series<double> b({4.0, 5.0, 6.0});
+        const auto e = (a + b) * 2.0 - a / b;
+        EXPECT_EQ(e.size(), 3);
+        EXPECT_DOUBLE_EQ(e[0], 10.0 - 0.25);
+        EXPECT_DOUBLE_EQ(e[2], 18.0 - 0.5);
+    }
+
+    TEST(ExprTests, MaterializeIntoSeries) {
+        const Series<double> a({0.0, 1.0, 2.0});
+        const Series<double> s = 0.5 + df::exp(a * 2.0);
+        ASSERT_EQ(s.size(), 3);
+        EXPECT_DOUBLE_EQ(s[0], 0.5 + std::exp(0.0));
+        EXPECT_DOUBLE_EQ(s[1], 0.5 + std::exp(2.0));
+        EXPECT_DOUBLE_EQ(s[2], 0.5 + std::exp(4.0));
+    }
+
+    TEST(ExprTests, AssignInPlaceReadingSelf) {
+        Series<double> s({1.0, 2.0, 3.0});
+        const auto* storage = &s[0];
+        s = s * s + 1.0;
+        EXPECT_EQ(&s[0], storage) << "Expect assignment of a same-sized expression to reuse storage";
+        EXPECT_DOUBLE_EQ(s[0], 2.0);
+        EXPECT_DOUBLE_EQ(s[1], 5.0);
+        EXPECT_DOUBLE_EQ(s[2], 10.0);
+        s += s * 2.0;
+        EXPECT_DOUBLE_EQ(s[2], 30.0);
+    }
+
+    TEST(ExprTests, OwnsTemporaryOperands) {
+        const Series<int> s1({1, 2, 3});
+        const auto e = s1 * Series<int>({4, 5, 6}) + 1;
+        EXPECT_EQ(e[0], 5);
+        EXPECT_EQ(e[1], 11);
+        EXPECT_EQ(e[2], 19);
+    }
+
+    TEST(ExprTests, ReferencesNamedOperands) {
+        // an expression built only from temporaries owns them all, so it can leave the scope that built it
+        const auto make = [] { return Series<double>({1, 2, 3}) + Series<double>({4, 5, 6}) * 2.0; };
+        const auto owned = make();
+        static_assert(!detail::is_series_v<decltype(owned)>);
+        EXPECT_EQ(owned[2], 15.0);
+
+        // a named series is referenced, and changes made to it before evaluation are seen
+        Series<double> a({1, 2, 3});
+        const auto lazy = a + 1.0;
+        const Series<double> eager = a + 1.0;
+        a[0] = 10.0;
+        EXPECT_EQ(lazy[0], 11.0);
+        EXPECT_EQ(lazy.eval()[0], 11.0);
+        EXPECT_EQ(eager[0], 2.0);
+    }
+
+    TEST(ExprTests, ReduceWithoutMaterializing) {
+        const Series<double> a({1.0, 2.0, 3.0, 4.0});
+        EXPECT_DOUBLE_EQ((a * a).sum().value(), 30.0);
+        EXPECT_DOUBLE_EQ((a + 1.0).mean().value(), 3.5);
+        EXPECT_EQ((Series<double>({}) * 2.0).sum(), std::nullopt);
+    }
+
+    TEST(ExprTests, TemporaryOperandBufferIsReused) {
+        const Series<double> a({1, 2, 3});
+        const Series<double> b({10, 20, 30});
+
+        Series<double> t = a + b;
+        const double* buffer = &t[0];
+        const Series<double> r = (std::move(t) * 2.0 + b) / 2.0;
+        EXPECT_EQ(&r[0], buffer);
+        EXPECT_EQ(r[0], 16.0);
+        EXPECT_EQ(r[2], 48.0);
+
+        // the temporary may appear more than once and on either side
+        Series<double> u = a * 1.0;
+        buffer = &u[0];
+        const Series<double> v = b - std::move(u) * a;
+        EXPECT_EQ(&v[0], buffer);
+        EXPECT_EQ(v[1], 16.0);
+
+        Series<double> w = a * 1.0;
+        buffer = &w[0];
+        const auto x = (std::move(w) + 1.0).eval();
+        EXPECT_EQ(&x[0], buffer);
+        EXPECT_EQ(x[2], 4.0);
+
+        // a temporary of another element type cannot hold the result
+        Series<float> f({1, 2, 3});
+        const Series<double> y = std::move(f) + a;
+        EXPECT_EQ(y[2], 6.0);
+    }
+
+    TEST(ExprTests, MismatchedSizesThrow) {
+        const Series<int> a({1, 2, 3});
+        const Series<int> b({1, 2});
+        EXPECT_THROW(a + b, std::invalid_argument);
+    }
+
+    // Distance from a result to a long double reference, in units of the last place of the reference
+    template <typename T>
+    double ulp_error(T got, long double ref) {
+        const auto r = static_cast<T>(ref);
+        if (std::isinf(r) || std::isinf(got)) {
+            return got == r ? 0.0 : std::numeric_limits<double>::infinity();
+        }
+        const auto ulp = std::max(
+            std::nextafter(std::fabs(r), std::numeric_limits<T>::infinity()) - std::fabs(r),
+            std::numeric_limits<T>::denorm_min()
+        );
+        return static_cast<double>(std::fabs(static_cast<long double>(got) - ref) / ulp);
+    }
+
+    // Run a test body once for every instruction set the CPU supports
+    template <typename F>
+    void for_each_isa(F&& f) {
+        const auto detected = kernels::detected_isa();
+        for (int i = 0; i <= static_cast<int>(detected); ++i) {
+            const auto isa = kernels::set_isa(static_cast<kernels::Isa>(i));
+            SCOPED_TRACE(kernels::isa_name(isa));
+            f();
+        }
+        kernels::set_isa(detected);
+    }
+
+    template <typename T>
+    void expect_transcendental_ulp() {
+        std::mt19937_64 gen(7);
+        const std::size_t n = 100'003;
+        std::vector<T> x(n), y(n), out(n);
+
+        for_each_isa([&] {
+            std::uniform_real_distribution<double> exp_dist(
+                std::is_same_v<T, double> ? -745.0 : -103.0,
+                std::is_same_v<T, double> ? 709.0 : 88.0
+            );
+            for (auto& v : x) v = static_cast<T>(exp_dist(gen));
+            kernels::unary(kernels::UnaryOp::EXP, x.data(), out.data(), n);
+            for (std::size_t i = 0; i < n; ++i) {
+                ASSERT_LT(ulp_error(out[i], ::expl(x[i])), 1.5) << "exp(" << x[i] << ")";
+            }
+
+            std::uniform_real_distribution<double> log_dist(-30.0, 30.0);
+            for (auto& v : x) v = static_cast<T>(std::exp2(log_dist(gen)));
+            kernels::unary(kernels::UnaryOp::LOG, x.data(), out.data(), n);
+            for (std::size_t i = 0; i < n; ++i) {
+                ASSERT_LT(ulp_error(out[i], ::logl(x[i])), 1.0) << "log(" << x[i] << ")";
+            }
+
+            std::uniform_real_distribution<double> base_dist(0.0, 100.0), exp_arg_dist(-30.0, 30.0);
+            for (std::size_t i = 0; i < n; ++i) {
+                x[i] = static_cast<T>(base_dist(gen));
+                y[i] = static_cast<T>(exp_arg_dist(gen));
+            }
+            kernels::binary(kernels::BinaryOp::POW, x.data(), y.data(), out.data(), n);
+            for (std::size_t i = 0; i < n; ++i) {
+                ASSERT_LT(ulp_error(out[i], ::powl(x[i], y[i])), 3.0) << "pow(" << x[i] << ", " << y[i] << ")";
+            }
+        });
+    }
+
+    TEST(KernelTests, DoubleTranscendentalsWithinDocumentedUlp) {
+        expect_transcendental_ulp<double>();
+    }
+
+    TEST(KernelTests, FloatTranscendentalsWithinDocumentedUlp) {
+        expect_transcendental_ulp<float>();
+    }
+
+    TEST(KernelTests, SpecialValuesMatchLibm) {
+        constexpr auto inf = std::numeric_limits<double>::infinity();
+        constexpr auto nan = std::numeric_limits<double>::quiet_NaN();
+        const std::vector<double> exp_in{nan, inf, -inf, 0.0, -0.0, 710.0, -746.0, -740.0};
+        const std::vector<double> log_in{nan, inf, 0.0, -0.0, -1.0, 1.0, std::numeric_limits<double>::denorm_min()};
+        const std::vector<double> base{-2.0, -2.0, 0.0, 0.0, 2.0, nan, 1.0, inf, 0.5};
+        const std::vector<double> expo{3.0, 0.5, 0.0, -1.0, nan, 0.0, nan, -2.0, inf};
+
+        for_each_isa([&] {
+            std::vector<double> out(exp_in.size());
+            kernels::unary(kernels::UnaryOp::EXP, exp_in.data(), out.data(), out.size());
+            for (std::size_t i = 0; i < out.size(); ++i) {
+                const auto expected = std::exp(exp_in[i]);
+                EXPECT_TRUE(std::isnan(expected) ? std::isnan(out[i]) : ulp_error(out[i], expected) < 1.5) << "exp(" << exp_in[i] << ")";
+            }
+
+            out.resize(log_in.size());
+            kernels::unary(kernels::UnaryOp::LOG, log_in.data(), out.data(), out.size());
+            for (std::size_t i = 0; i < out.size(); ++i) {
+                const auto expected = std::log(log_in[i]);
+                EXPECT_TRUE(std::isnan(expected) ? std::isnan(out[i]) : ulp_error(out[i], expected) < 1.0) << "log(" << log_in[i] << ")";
+            }
+
+            out.resize(base.size());
+            kernels::binary(kernels::BinaryOp::POW, base.data(), expo.data(), out.data(), out.size());
+            for (std::size_t i = 0; i < out.size(); ++i) {
+                const auto expected = std::pow(base[i], expo[i]);
+                EXPECT_TRUE(std::isnan(expected) ? std::isnan(out[i]) : out[i] == expected) << "pow(" << base[i] << ", " << expo[i] << ")";
+            }
+        });
+    }
+
+    TEST(KernelTests, SeriesOperatorsMatchScalarSemantics) {
+        // 37 elements exercises both the vector body and the scalar tail on every instruction set
+        std::vector<double> a(37), b(37);
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            a[i] = 0.5 * static_cast<double>(i) - 7.0;
+            b[i] = 3.0 - 0.25 * static_cast<double>(i);
+        }
+        a[3] = std::numeric_limits<double>::quiet_NaN();
+
+        for_each_isa([&] {
+            Series<double> s(a);
+            const Series<double> o(b);
+            s.mul(o).add(2).min(o).max(-1.5).abs().sqrt();
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                const auto expected = std::sqrt(std::abs(std::max(std::min(a[i] * b[i] + 2.0, b[i]), -1.5)));
+                if (std::isnan(expected)) {
+                    EXPECT_TRUE(std::isnan(s[i])) << i;
+                }
+                else {
+                    EXPECT_EQ(s[i], expected) << i;
+                }
+            }
+        });
+    }
+
+    TEST(KernelTests, FusedExpressionsRunTranscendentalKernels) {
+        // spans several staging tiles and a partial one
+        std::vector<double> a(1000);
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            a[i] = 0.01 * static_cast<double>(i) - 3.0;
+        }
+
+        for_each_isa([&] {
+            const Series<double> s(a);
+            std::vector<double> scaled(a.size()), expected(a.size());
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                scaled[i] = a[i] * 2.0;
+            }
+            kernels::unary(kernels::UnaryOp::EXP, scaled.data(), expected.data(), expected.size());
+
+            // a kernel node nested under arithmetic, with a computed and then a series operand
+            const Series<double> fused = df::exp(s * 2.0) + 1.0;
+            std::vector<double> direct(a.size());
+            kernels::unary(kernels::UnaryOp::LOG, a.data(), direct.data(), direct.size());
+            const Series<double> logs = df::log(s) * 1.0;
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                ASSERT_EQ(fused[i], expected[i] + 1.0) << i;
+                if (std::isnan(direct[i])) {
+                    ASSERT_TRUE(std::isnan(logs[i])) << i;
+                }
+                else {
+                    ASSERT_EQ(logs[i], direct[i]) << i;
+                }
+            }
+
+            // in place, and nested kernel nodes
+            Series<double> t(a);
+            t = df::sqrt(df::abs(df::exp(t * 2.0)));
+            kernels::unary(kernels::UnaryOp::SQRT, expected.data(), expected.data(), expected.size());
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                ASSERT_EQ(t[i], expected[i]) << i;
+            }
+        });
+
+        // integers have no kernel and are computed element by element
+        const Series<double> ints = df::exp(Series<int>({0, 1, 2}));
+        EXPECT_EQ(ints[1], std::exp(1));
+    }
+
+    TEST(KernelTests, SumAndDotMatchReference) {
+        std::vector<float> data(1001);
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<float>(i % 17) * 0.5f;
+        }
+        const double expected_sum = std::accumulate(data.begin(), data.end(), 0.0);
+        const double expected_dot = std::inner_product(data.begin(), data.end(), data.begin(), 0.0);
+
+        for_each_isa([&] {
+            const Series<float> s(data);
+            EXPECT_FLOAT_EQ(s.sum().value(), static_cast<float>(expected_sum));
+            EXPECT_FLOAT_EQ(s.dot(s), static_cast<float>(expected_dot));
+        });
+    }
+
+    TEST(MemoryTests, SeriesStorageIsCacheLineAligned) {
+        for (std::size_t n : {1, 3, 17, 1000}) {
+            const Series<double> s(std::vector<double>(n, 1.0));
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&s[0]) % CACHE_LINE_SIZE, 0u) << n;
+            const auto t = s + s;
+            const Series<double> u(t);
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&u[0]) % CACHE_LINE_SIZE, 0u) << n;
+        }
+    }
+
+    TEST(MemoryTests, LargeBuffersAreHugePageAligned) {
+        const Series<float> s(std::vector<float>(HUGE_PAGE_SIZE / sizeof(float), 1.0f));
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&s[0]) % HUGE_PAGE_SIZE, 0u);
+
+        const auto threshold = memory::huge_page_threshold();
+        memory::set_huge_page_threshold(std::numeric_limits<std::size_t>::max());
+        void* ptr = memory::allocate(HUGE_PAGE_SIZE);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % CACHE_LINE_SIZE, 0u);
+        memory::deallocate(ptr, HUGE_PAGE_SIZE);
+        memory::set_huge_page_threshold(threshold);
+    }
+
+    TEST(MemoryTests, SeriesWithStandardAllocator) {
+        using StdSeries = Series<double, std::allocator<double>>;
+        StdSeries a(std::vector<double>{1, 2, 3});
+        const Series<double> b({4, 5, 6});
+
+        a.add(b).mul(2);
+        EXPECT_EQ(a[0], 10.0);
+        EXPECT_EQ(a[2], 18.0);
+
+        const StdSeries c = a + b;
+        EXPECT_EQ(c[1], 19.0);
+        const Series<double> d = c - a;
+        EXPECT_EQ(d[1], 5.0);
+        EXPECT_EQ(a.dot(b), 10.0 * 4 + 14.0 * 5 + 18.0 * 6);
+    }
+
+    TEST(MemoryTests, PoolScopeRecyclesBuffers) {
+        void* first = nullptr;
+        {
+            memory::PoolScope pool;
+            {
+                const Series<double> s(std::vector<double>(1000, 1.0));
+                first = const_cast<double*>(&s[0]);
+            }
+            EXPECT_GE(memory::PoolScope::cached_bytes(), 1000 * sizeof(double));
+
+            // temporaries of the same size draw from the pool instead of the system allocator
+            const Series<double> a({1, 2, 3});
+            const Series<double> t(std::vector<double>(1000, 2.0));
+            EXPECT_EQ(static_cast<const void*>(&t[0]), first);
+            EXPECT_EQ(memory::PoolScope::cached_bytes(), 0u);
+            {
+                memory::PoolScope nested;
+                const Series<double> b = a + a;
+            }
+            EXPECT_GT(memory::PoolScope::cached_bytes(), 0u);
+        }
+        EXPECT_EQ(memory::PoolScope::cached_bytes(), 0u);
+
+        // without a scope buffers go straight back to the system
+        { const Series<double> s(std::vector<double>(1000, 1.0)); }
+        EXPECT_EQ(memory::PoolScope::cached_bytes(), 0u);
+    }
+
+    TEST(MemoryTests, PoolScopeRespectsCapacity) {
+        memory::PoolScope pool(1024);
+        { const Series<double> s(std::vector<double>(1000, 1.0)); }
+        EXPECT_EQ(memory::PoolScope::cached_bytes(), 0u);
+        { const Series<double> s(std::vector<double>(100, 1.0)); }
+        EXPECT_GT(memory::PoolScope::cached_bytes(), 0u);
+    }
+
+    TEST(MemoryTests, PoolScopeSurvivesThresholdChange) {
+        const auto threshold = memory::huge_page_threshold();
+        {
+            memory::PoolScope pool;
+            void* small = memory::allocate(std::size_t{1} << 20);
+            memory::set_huge_page_threshold(std::size_t{512} << 10);
+            memory::deallocate(small, std::size_t{1} << 20);
+
+            // the buffer freed under the new threshold is not mistaken for a huge one of a larger size
+            const std::size_t larger = std::size_t{3} << 19;
+            void* large = memory::allocate(larger);
+            EXPECT_NE(large, small);
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(large) % HUGE_PAGE_SIZE, 0u);
+            memory::deallocate(large, larger);
+            EXPECT_GT(memory::PoolScope::cached_bytes(), 0u);
+
+            // changing the threshold flushes the pool
+            memory::set_huge_page_threshold(threshold);
+            EXPECT_EQ(memory::PoolScope::cached_bytes(), 0u);
+        }
+        EXPECT_EQ(memory::huge_page_threshold(), threshold);
+    }
+
+    TEST(MemoryTests, ResizeValueInitializes) {
+        memory::PoolScope pool;
+        { Series<int> dirty(std::vector<int>(64, 7)); }
+        Series<int> s;
+        s.resize(64);
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            EXPECT_EQ(s[i], 0) << i;
+        }
+    }
+
+    TEST(MomentsTests, MatchTwoPassReference) {
+        std::mt19937_64 gen(7);
+        std::normal_distribution<double> dist(1e6, 3.0);
+        std::vector<double> data(100'003);
+        for (auto& x : data) {
+            x = dist(gen);
+        }
+        long double mean = 0;
+        for (const auto x : data) {
+            mean += x;
+        }
+        mean /= data.size();
+        long double m2 = 0;
+        for (const auto x : data) {
+            m2 += (x - mean) * (x - mean);
+        }
+
+        for_each_isa([&] {
+            for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+                const Series<double> s(policy, data);
+                const auto m = s.moments().value();
+                EXPECT_EQ(m.count, data.size());
+                EXPECT_NEAR(m.mean, static_cast<double>(mean), 1e-9);
+                EXPECT_NEAR(m.m2 / static_cast<double>(m2), 1.0, 1e-10);
+                EXPECT_EQ(m.min, *std::min_element(data.begin(), data.end()));
+                EXPECT_EQ(m.max, *std::max_element(data.begin(), data.end()));
+                EXPECT_NEAR(s.variance().value(), static_cast<double>(m2 / data.size()), 1e-8);
+                EXPECT_NEAR(s.stddev().value(), std::sqrt(static_cast<double>(m2 / data.size())), 1e-9);
+                EXPECT_NEAR(m.variance(1).value(), static_cast<double>(m2 / (data.size() - 1)), 1e-8);
+            }
+        });
+
+        // float data with a large offset, where a one-pass sum of squares would lose every digit
+        std::vector<float> floats(data.begin(), data.end());
+        const Series<float> f(floats);
+        EXPECT_NEAR(f.variance().value() / 9.0f, 1.0f, 0.05f);
+
+        // accumulating in another type takes the generic path
+        const Series<int> ints({1, 2, 3, 4});
+        const auto mi = ints.moments<double>().value();
+        EXPECT_EQ(mi.mean, 2.5);
+        EXPECT_EQ(mi.m2, 5.0);
+        EXPECT_EQ(mi.min, 1.0);
+        EXPECT_EQ(mi.max, 4.0);
+    }
+
+    TEST(MomentsTests, MergeAndEmpty) {
+        Moments<double> a, b, all;
+        for (int i = 0; i < 10; ++i) {
+            (i < 3 ? a : b).push(i * 1.5);
+            all.push(i * 1.5);
+        }
+        const auto m = merge(a, b);
+        EXPECT_EQ(m.count, all.count);
+        EXPECT_DOUBLE_EQ(m.mean, all.mean);
+        EXPECT_DOUBLE_EQ(m.m2, all.m2);
+        EXPECT_EQ(m.min, 0.0);
+        EXPECT_EQ(m.max, 13.5);
+        EXPECT_EQ(merge(Moments<double>{}, a).m2, a.m2);
+
+        EXPECT_FALSE(Moments<double>::of(1.0).variance(1));
+        EXPECT_FALSE(Series<double>().moments());
+        EXPECT_FALSE(Series<double>().variance());
+    }
+
+    TEST(MomentsTests, IntegersAccumulateInDouble) {
+        const Series<int> ints({1, 2, 3, 4});
+        static_assert(std::is_same_v<decltype(ints.variance()), std::optional<double>>);
+        EXPECT_DOUBLE_EQ(ints.variance().value(), 1.25);
+        EXPECT_DOUBLE_EQ(ints.stddev().value(), std::sqrt(1.25));
+        const auto m = ints.moments().value();
+        EXPECT_DOUBLE_EQ(m.mean, 2.5);
+        EXPECT_DOUBLE_EQ(m.m2, 5.0);
+        EXPECT_DOUBLE_EQ(m.variance(1).value(), 5.0 / 3);
+
+        const Series<long> longs({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+        EXPECT_DOUBLE_EQ(longs.variance().value(), 8.25);
+        EXPECT_DOUBLE_EQ(longs.view().slice(0, 10, 2).variance().value(), 8.0);
+    }
+
+    TEST(SummationTests, ModesBoundTheError) {
+        // many small terms after a large one: naive float accumulation drops most of them
+        std::vector<float> data(1 << 20, 0.1f);
+        data[0] = 1e6f;
+        long double exact = 0;
+        for (const auto x : data) {
+            exact += x;
+        }
+
+        for_each_isa([&] {
+            const Series<float> s(data);
+            const auto error = [&](Summation mode) {
+                return std::abs(static_cast<long double>(s.sum(mode).value()) - exact) / exact;
+            };
+            const auto eps = std::numeric_limits<float>::epsilon();
+            EXPECT_LT(error(Summation::KAHAN), eps);
+            EXPECT_LT(error(Summation::PAIRWISE), 16 * eps);
+            EXPECT_LT(error(Summation::DETERMINISTIC), 8 * eps);
+            EXPECT_LE(error(Summation::PAIRWISE), error(Summation::NAIVE));
+            EXPECT_NEAR(s.mean(Summation::KAHAN).value(), static_cast<float>(exact / data.size()), 1e-6f);
+
+            // sum(x * x) for x = 1 + 2^-12 needs the low bits of every product
+            const Series<float> x(std::vector<float>(1000, 1.0f + 0x1p-12f));
+            const long double exact_dot = 1000.0L * (1.0L + 0x1p-12L) * (1.0L + 0x1p-12L);
+            EXPECT_EQ(static_cast<long double>(x.dot(x, Summation::KAHAN)), static_cast<long double>(static_cast<float>(exact_dot)));
+            EXPECT_NEAR(x.dot(x, Summation::PAIRWISE), static_cast<float>(exact_dot), 1e-3f);
+        });
+    }
+
+    TEST(SummationTests, DeterministicAcrossPolicies) {
+        std::mt19937 gen(11);
+        std::uniform_real_distribution<double> dist(-1e6, 1e6);
+        std::vector<double> data(200'001);
+        for (auto& x : data) {
+            x = dist(gen);
+        }
+        const auto expected = Series<double>(ExecPolicy::SEQ, data).sum(Summation::DETERMINISTIC).value();
+        for (const auto policy : {ExecPolicy::PAR, ExecPolicy::UNSEQ, ExecPolicy::PAR_UNSEQ}) {
+            const Series<double> s(policy, data);
+            EXPECT_EQ(s.sum(Summation::DETERMINISTIC).value(), expected);
+            EXPECT_EQ(s.dot(s, Summation::DETERMINISTIC), Series<double>(ExecPolicy::SEQ, data).dot(s, Summation::DETERMINISTIC));
+        }
+    }
+
+    TEST(SummationTests, GenericTypes) {
+        const Series<int> ints({1, 2, 3, 4});
+        for (const auto mode : {Summation::NAIVE, Summation::PAIRWISE, Summation::KAHAN, Summation::DETERMINISTIC}) {
+            EXPECT_EQ(ints.sum(mode).value(), 10);
+            EXPECT_EQ(ints.dot(ints, mode), 30);
+        }
+
+        // float data accumulated in double takes the generic path
+        std::vector<float> data(1 << 16, 0.1f);
+        data[0] = 1e8f;
+        const Series<float> s(data);
+        const long double exact = 1e8L + (data.size() - 1) * static_cast<long double>(0.1f);
+        EXPECT_NEAR(static_cast<long double>(s.sum<double>(Summation::KAHAN).value()), exact, 1e-6L);
+        EXPECT_NEAR(static_cast<long double>(s.sum<double>(Summation::PAIRWISE).value()), exact, 1e-6L);
+        EXPECT_NEAR(static_cast<long double>(s.sum<double>(Summation::DETERMINISTIC).value()), exact, 1e-6L);
+    }
+
+    Bitmap bitmap_with_gaps() {
+        Bitmap bits(130);
+        bits.set(3, false);
+        bits.set(64, false);
+        bits.set(129, false);
+        return bits;
+    }
+
+    TEST(BitmapTests, CountAllAndNone) {
+        Bitmap a(130);
+        EXPECT_EQ(a.count(), 130u);
+        EXPECT_TRUE(a.all());
+        EXPECT_FALSE(a.none());
+        EXPECT_TRUE(Bitmap(130, false).none());
+        EXPECT_TRUE(Bitmap(128).all());
+
+        a = bitmap_with_gaps();
+        EXPECT_EQ(a.count(), 127u);
+        EXPECT_FALSE(a.all());
+        EXPECT_FALSE(a[64]);
+        EXPECT_TRUE(a[65]);
+    }
+
+    TEST(BitmapTests, AndOfEqualSizes) {
+        Bitmap a = bitmap_with_gaps();
+        Bitmap b(130, false);
+        b.set(3);
+        b.set(70);
+        EXPECT_EQ((a & b).count(), 1u);
+        EXPECT_TRUE((a & b)[70]);
+        EXPECT_THROW(a &= Bitmap(10), std::invalid_argument);
+    }
+
+    TEST(BitmapTests, ForEachSetCoalescesRuns) {
+        // stretches of set bits are coalesced across words, short ones are visited bit by bit
+        Bitmap c(300);
+        c.set(70, false);
+        c.set(200, false);
+        c.set(203, false);
+        std::vector<std::pair<std::size_t, std::size_t>> runs;
+        std::vector<std::size_t> bits;
+        const auto visit = [&](const Bitmap& bitmap, std::size_t begin, std::size_t end) {
+            runs.clear();
+            bits.clear();
+            bitmap.for_each_set(
+                begin, end,
+                [&](std::size_t b, std::size_t e) { runs.emplace_back(b, e); },
+                [&](std::size_t base, Bitmap::word_type word) {
+                    for (; word; word &= word - 1) {
+                        bits.push_back(base + std::countr_zero(word));
+                    }
+                }
+            );
+        };
+        visit(c, 0, 300);
+        EXPECT_EQ(runs, (std::vector<std::pair<std::size_t, std::size_t>>{{0, 70}, {71, 200}, {204, 300}}));
+        EXPECT_EQ(bits, (std::vector<std::size_t>{201, 202}));
+        visit(c, 5, 66);
+        EXPECT_EQ(runs, (std::vector<std::pair<std::size_t, std::size_t>>{{5, 66}}));
+        EXPECT_TRUE(bits.empty());
+        visit(c, 66, 75);
+        EXPECT_TRUE(runs.empty());
+        EXPECT_EQ(bits, (std::vector<std::size_t>{66, 67, 68, 69, 71, 72, 73, 74}));
+        visit(Bitmap(300, false), 0, 300);
+        EXPECT_TRUE(runs.empty());
+        EXPECT_TRUE(bits.empty());
+    }
+
+    TEST(BitmapTests, ResizeFillsNewBits) {
+        Bitmap a = bitmap_with_gaps();
+        a.resize(200);
+        EXPECT_EQ(a.count(), 197u);
+        a.resize(10, false);
+        EXPECT_EQ(a.count(), 9u);
+        a.resize(100, false);
+        EXPECT_EQ(a.count(), 9u);
+    }
+
+    TEST(NullTests, SetNullAndQueryValidity) {
+        Series<double> a({1, 2, 3, 4});
+        EXPECT_FALSE(a.validity());
+        a.set_null(1);
+        EXPECT_EQ(a.null_count(), 1u);
+        EXPECT_TRUE(a.is_null(1));
+        EXPECT_TRUE(a.is_valid(2));
+        EXPECT_FALSE(a.validity()->all());
+    }
+
+    TEST(NullTests, ArithmeticPropagatesNulls) {
+        Series<double> a({1, 2, 3, 4});
+        Series<double> b({10, 20, 30, 40});
+        a.set_null(1);
+        b.set_null(3);
+
+        const Series<double> c = a + b * 2.0;
+        EXPECT_EQ(c.null_count(), 2u);
+        EXPECT_TRUE(c.is_valid(0));
+        EXPECT_TRUE(c.is_null(1));
+        EXPECT_TRUE(c.is_valid(2));
+        EXPECT_TRUE(c.is_null(3));
+        EXPECT_EQ(c[2], 63.0);
+    }
+
+    TEST(NullTests, InPlaceOperationsPropagateNulls) {
+        Series<double> a({1, 2, 3, 4});
+        Series<double> b({10, 20, 30, 40});
+        a.set_null(1);
+        b.set_null(3);
+
+        Series<double> d({1, 1, 1, 1});
+        d.add(a).mul(b);
+        EXPECT_EQ(d.null_count(), 2u);
+        d.mul(2.0).sqrt();
+        EXPECT_EQ(d.null_count(), 2u);
+    }
+
+    TEST(NullTests, ExpressionReductionsSkipNulls) {
+        Series<double> a({1, 2, 3, 4});
+        Series<double> b({10, 20, 30, 40});
+        a.set_null(1);
+        b.set_null(3);
+        EXPECT_EQ((a * 2.0).sum().value(), 16.0);
+        EXPECT_EQ((a + b).mean().value(), (11.0 + 33.0) / 2);
+    }
+
+    TEST(NullTests, PrintsNulls) {
+        Series<double> a({1, 2, 3, 4});
+        a.set_null(1);
+        std::ostringstream os;
+        os << a;
+        EXPECT_EQ(os.str(), "[1, null, 3, 4]");
+    }
+
+    TEST(NullTests, SetValidity) {
+        Series<double> a({1, 2, 3, 4});
+        a.set_null(1);
+        EXPECT_THROW(a.set_validity(Bitmap(3)), std::invalid_argument);
+        a.set_validity(std::nullopt);
+        EXPECT_EQ(a.null_count(), 0u);
+    }
+
+    // Values with nulls every seventh row and in one long stretch, and the statistics of the valid ones
+    struct NullableData {
+        std::vector<double> data;
+        Bitmap valid;
+        double sum{0};
+        double lo{1e300};
+        double hi{-1e300};
+        double m2{0};
+        std::size_t count{0};
+    };
+
+    NullableData nullable_data() {
+        NullableData d{std::vector<double>(10'000), Bitmap(10'000)};
+        for (std::size_t i = 0; i < d.data.size(); ++i) {
+            d.data[i] = static_cast<double>((i * 37) % 101) - 50;
+            if (i % 7 == 0 || (i >= 3000 && i < 3500)) {
+                d.data[i] = 1e9;  // sentinel values that must not leak into any aggregation
+                d.valid.set(i, false);
+            }
+            else {
+                d.sum += d.data[i];
+                d.lo = std::min(d.lo, d.data[i]);
+                d.hi = std::max(d.hi, d.data[i]);
+                ++d.count;
+            }
+        }
+        const double mean = d.sum / d.count;
+        for (std::size_t i = 0; i < d.data.size(); ++i) {
+            if (d.valid[i]) {
+                d.m2 += (d.data[i] - mean) * (d.data[i] - mean);
+            }
+        }
+        return d;
+    }
+
+    TEST(NullTests, AggregationsSkipNulls) {
+        const auto d = nullable_data();
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            Series<double> s(policy, d.data);
+            s.set_validity(d.valid);
+            EXPECT_EQ(s.count(), d.count);
+            for (const auto mode : {Summation::NAIVE, Summation::PAIRWISE, Summation::KAHAN, Summation::DETERMINISTIC}) {
+                EXPECT_DOUBLE_EQ(s.sum(mode).value(), d.sum);
+            }
+            EXPECT_DOUBLE_EQ(s.mean().value(), d.sum / d.count);
+            EXPECT_NEAR(s.variance().value(), d.m2 / d.count, 1e-9);
+            EXPECT_EQ(s.min().value().get(), d.lo);
+            EXPECT_EQ(s.max().value().get(), d.hi);
+            EXPECT_EQ(s.moments()->count, d.count);
+        }
+    }
+
+    TEST(NullTests, DotSkipsNulls) {
+        const auto d = nullable_data();
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            Series<double> s(policy, d.data);
+            s.set_validity(d.valid);
+            Series<double> ones(policy, std::vector<double>(d.data.size(), 1.0));
+            EXPECT_DOUBLE_EQ(s.dot(ones), d.sum);
+        }
+    }
+
+    TEST(NullTests, IntegerAggregationsSkipNulls) {
+        // integer columns take the generic paths
+        const auto d = nullable_data();
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            Series<int> ints(policy, std::vector<int>(d.data.begin(), d.data.end()));
+            ints.set_validity(d.valid);
+            EXPECT_EQ(ints.sum().value(), static_cast<int>(d.sum));
+            EXPECT_EQ(ints.min().value().get(), static_cast<int>(d.lo));
+            EXPECT_NEAR(ints.variance<double>().value(), d.m2 / d.count, 1e-9);
+        }
+    }
+
+    TEST(NullTests, AllNullIsUndefined) {
+        Series<double> none({1, 2});
+        none.set_validity(Bitmap(2, false));
+        EXPECT_FALSE(none.sum());
+        EXPECT_FALSE(none.mean());
+        EXPECT_FALSE(none.min());
+        EXPECT_FALSE(none.variance());
+    }
+
+    TEST(BitmapTests, RangeQueries) {
+        Bitmap a(300);
+        for (std::size_t i = 0; i < a.size(); i += 3) {
+            a.set(i, false);
+        }
+        for (const auto& [begin, end] : {std::pair<std::size_t, std::size_t>{0, 300}, {5, 6}, {7, 130}, {64, 128}, {100, 300}, {17, 17}}) {
+            std::size_t count = 0;
+            for (auto i = begin; i < end; ++i) {
+                count += a[i];
+            }
+            EXPECT_EQ(a.count(begin, end), count);
+            EXPECT_EQ(a.all(begin, end), count == end - begin);
+            EXPECT_EQ(a.none(begin, end), count == 0);
+        }
+        EXPECT_TRUE(a.all(1, 3));
+        EXPECT_TRUE(a.none(3, 4));
+    }
+
+    TEST(BitmapTests, SliceCopiesRange) {
+        Bitmap a(300);
+        for (std::size_t i = 0; i < a.size(); i += 3) {
+            a.set(i, false);
+        }
+        for (const auto& [begin, end] : {std::pair<std::size_t, std::size_t>{0, 300}, {5, 6}, {7, 130}, {64, 128}, {100, 300}, {17, 17}}) {
+            const auto sliced = a.slice(begin, end);
+            ASSERT_EQ(sliced.size(), end - begin);
+            EXPECT_EQ(sliced.count(), a.count(begin, end));
+            for (std::size_t i = 0; i < sliced.size(); ++i) {
+                EXPECT_EQ(sliced[i], a[begin + i]);
+            }
+        }
+    }
+
+    // Elements and nulls viewed by the ViewTests, and the (begin, end, step) ranges they slice
+    std::pair<std::vector<double>, Bitmap> view_data() {
+        std::vector<double> data(20'000);
+        Bitmap valid(data.size());
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<double>((i * 37) % 101) - 50;
+            if (i % 11 == 0 || (i >= 5000 && i < 5300)) {
+                valid.set(i, false);
+            }
+        }
+        return {std::move(data), std::move(valid)};
+    }
+
+    const std::vector<std::tuple<std::size_t, std::size_t, std::size_t>> VIEW_RANGES{
+        {0, 20'000, 1}, {3, 17'001, 1}, {4'990, 5'400, 1}, {1, 20'000, 3}, {7, 9'000, 64}
+    };
+
+    // A Series holding a copy of the elements of a view
+    template <typename View>
+    auto copy_of(const View& view) {
+        Series<typename View::value_type> out(view);
+        EXPECT_EQ(out.size(), view.size());
+        EXPECT_EQ(out.null_count(), view.null_count());
+        return out;
+    }
+
+    TEST(ViewTests, AggregationsMatchCopies) {
+        const auto [data, valid] = view_data();
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            for (const auto nulls : {false, true}) {
+                Series<double> s(policy, data);
+                if (nulls) {
+                    s.set_validity(valid);
+                }
+                for (const auto& [begin, end, step] : VIEW_RANGES) {
+                    const auto v = s.slice(begin, end, step);
+                    const auto c = copy_of(v);
+                    EXPECT_EQ(v.count(), c.count());
+                    EXPECT_EQ(v[1], s[begin + step]);
+                    for (const auto mode : {Summation::NAIVE, Summation::PAIRWISE, Summation::KAHAN, Summation::DETERMINISTIC}) {
+                        EXPECT_DOUBLE_EQ(v.sum(mode).value(), c.sum(mode).value());
+                    }
+                    EXPECT_DOUBLE_EQ(v.mean().value(), c.mean().value());
+                    EXPECT_NEAR(v.variance().value(), c.variance().value(), 1e-9);
+                    EXPECT_EQ(v.min().value().get(), c.min().value().get());
+                    EXPECT_EQ(v.max().value().get(), c.max().value().get());
+                }
+            }
+        }
+    }
+
+    TEST(ViewTests, DotMatchesCopies) {
+        const auto [data, valid] = view_data();
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            Series<double> s(policy, data);
+            s.set_validity(valid);
+            for (const auto& [begin, end, step] : VIEW_RANGES) {
+                const auto v = s.slice(begin, end, step);
+                const auto c = copy_of(v);
+                EXPECT_DOUBLE_EQ(v.dot(v), c.dot(c));
+                EXPECT_DOUBLE_EQ(v.dot(c), c.dot(c));
+            }
+        }
+    }
+
+    TEST(ViewTests, IntegerAggregationsMatchCopies) {
+        const auto [data, valid] = view_data();
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            Series<int> ints(policy, std::vector<int>(data.begin(), data.end()));
+            ints.set_validity(valid);
+            for (const auto& [begin, end, step] : VIEW_RANGES) {
+                const auto iv = ints.slice(begin, end, step);
+                EXPECT_EQ(iv.sum().value(), copy_of(iv).sum().value());
+                EXPECT_EQ(iv.min().value().get(), copy_of(iv).min().value().get());
+            }
+        }
+    }
+
+    TEST(ViewTests, ChunkedSumsMatchWhole) {
+        Series<double> s(std::vector<double>(100'000, 0.5));
+        s.set_null(12'345);
+        double total = 0;
+        for (std::size_t begin = 0; begin < s.size(); begin += 4096) {
+            total += s.slice(begin, begin + 4096).sum().value();
+        }
+        EXPECT_DOUBLE_EQ(total, s.sum().value());
+    }
+
+    TEST(ViewTests, HeadTailAndEmptyRanges) {
+        Series<double> s(std::vector<double>(100'000, 0.5));
+        EXPECT_EQ(s.head(3).size(), 3u);
+        EXPECT_EQ(s.tail(3).data(), &s[s.size() - 3]);
+        EXPECT_EQ(s.head(1'000'000).size(), s.size());
+        EXPECT_EQ(s.slice(10, 5).size(), 0u);
+        EXPECT_FALSE(s.slice(10, 5).sum());
+        EXPECT_THROW(s.slice(0, 10, 0), std::invalid_argument);
+    }
+
+    TEST(ViewTests, NestedViewsComposeStrides) {
+        // views of views compose their offsets and strides
+        Series<int> ints({0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+        const auto odd = ints.slice(1, 10, 2);
+        EXPECT_EQ(odd.stride(), 2u);
+        EXPECT_EQ(odd.tail(2)[0], 7);
+        EXPECT_EQ(odd.slice(1, 4, 2)[1], 7);
+        EXPECT_EQ(std::vector<int>(odd.begin(), odd.end()), (std::vector<int>{1, 3, 5, 7, 9}));
+    }
+
+    TEST(ViewTests, ExpressionsTakeViews) {
+        Series<double> a({1, 2, 3, 4, 5, 6});
+        a.set_null(4);
+        const Series<double> b({10, 20, 30, 40, 50, 60});
+
+        // lazy expressions take views as operands, and propagate the nulls of the viewed range
+        const Series<double> c = a.slice(2, 6) + b.head(4) * 2.0;
+        ASSERT_EQ(c.size(), 4u);
+        EXPECT_EQ(c[0], 23.0);
+        EXPECT_EQ(c[1], 44.0);
+        EXPECT_TRUE(c.is_null(2));
+        EXPECT_EQ(c[3], 86.0);
+        EXPECT_DOUBLE_EQ(df::sqrt(b.slice(0, 6, 3)).sum().value(), std::sqrt(10.0) + std::sqrt(40.0));
+        EXPECT_THROW(a.slice(0, 3).dot(b), std::invalid_argument);
+    }
+
+    TEST(ViewTests, EvalCopiesStridedView) {
+        const Series<double> b({10, 20, 30, 40, 50, 60});
+        const auto evens = b.slice(0, 6, 2).eval();
+        EXPECT_EQ(evens.size(), 3u);
+        EXPECT_EQ(evens[2], 50.0);
+    }
+
+    TEST(ViewTests, MutableViewWritesThrough) {
+        Series<double> a({1, 2, 3, 4, 5, 6});
+        a.set_null(4);
+        auto tail = a.tail(2);
+        tail[1] = 100;
+        EXPECT_EQ(a[5], 100.0);
+        SeriesView<const double> ro = tail;
+        EXPECT_EQ(ro.max().value().get(), 100.0);
+
+        std::ostringstream os;
+        os << a.slice(3, 6);
+        EXPECT_EQ(os.str(), "[4, null, 100]");
+    }
+
+    TEST(ViewTests, DataFrameRowRanges) {
+        DataFrame frame;
+        frame.add("x", Series<double>({1, 2, 3, 4, 5, 6, 7}));
+        frame.add("n", Series<int>({7, 6, 5, 4, 3, 2, 1}));
+
+        const auto rows = frame.slice(2, 6);
+        EXPECT_EQ(rows.shape(), std::make_pair(std::size_t{4}, std::size_t{2}));
+        EXPECT_EQ(rows.column<double>("x").sum().value(), 3.0 + 4 + 5 + 6);
+        EXPECT_EQ(rows.column<double>("x").data(), &frame.column<double>("x")[2]);
+        EXPECT_EQ(rows.tail(1).column<int>("n")[0], 2);
+        EXPECT_EQ(frame.head(2).column<int>("n").max().value().get(), 7);
+        EXPECT_EQ(frame.tail(100).length(), 7u);
+        EXPECT_THROW(rows.column<int>("x"), std::bad_cast);
+        EXPECT_THROW(rows.column<int>("y"), std::out_of_range);
+    }
+
+    TEST(ViewTests, PrintDataFrameRowRange) {
+        DataFrame frame;
+        frame.add("x", Series<double>({1, 2, 3, 4, 5, 6, 7}));
+        frame.add("n", Series<int>({7, 6, 5, 4, 3, 2, 1}));
+        std::ostringstream os;
+        os << frame.slice(2, 6).head(1);
+        EXPECT_NE(os.str().find("1 rows x 2 columns"), std::string::npos);
+        EXPECT_NE(os.str().find("3\t5"), std::string::npos);
+    }
+
+    TEST(PolicyTests, AutoResolvesBySizeAndCost) {
+        const auto saved = auto_thresholds();
+        set_auto_thresholds({16, 1000, 100, 10});
+        EXPECT_EQ(auto_thresholds(), (AutoThresholds{16, 1000, 100, 10}));
+
+        EXPECT_EQ(resolve(ExecPolicy::AUTO, 8, OpCost::HEAVY), ExecPolicy::SEQ);
+        EXPECT_EQ(resolve(ExecPolicy::AUTO, 500, OpCost::LIGHT), ExecPolicy::UNSEQ);
+        EXPECT_EQ(resolve(ExecPolicy::AUTO, 500, OpCost::MEDIUM), ExecPolicy::PAR_UNSEQ);
+        EXPECT_EQ(resolve(ExecPolicy::AUTO, 1000, OpCost::LIGHT), ExecPolicy::PAR_UNSEQ);
+        EXPECT_EQ(resolve(ExecPolicy::AUTO, 10, OpCost::HEAVY), ExecPolicy::PAR_UNSEQ);
+        EXPECT_EQ(resolve(ExecPolicy::SEQ, 1'000'000, OpCost::HEAVY), ExecPolicy::SEQ);
+        set_auto_thresholds(saved);
+    }
+
+    TEST(PolicyTests, ExpressionCostIsCostliestNode) {
+        const Series<double> a({1, 2, 3});
+        static_assert(decltype(a + a * 2.0)::cost() == OpCost::LIGHT);
+        static_assert(decltype(a / a)::cost() == OpCost::MEDIUM);
+        static_assert(decltype(df::exp(a) + 1.0)::cost() == OpCost::HEAVY);
+        static_assert(decltype(a.head(2) - 1.0)::cost() == OpCost::LIGHT);
+    }
+
+    TEST(PolicyTests, AutoMatchesPickedPolicies) {
+        // AUTO computes the same results as the policies it picks, on either side of every threshold
+        const auto saved = auto_thresholds();
+        set_auto_thresholds({16, 1000, 100, 10});
+        std::vector<double> data(3000);
+        std::iota(data.begin(), data.end(), 1.0);
+        for (const std::size_t n : {5, 50, 500, 3000}) {
+            const std::vector<double> head(data.begin(), data.begin() + n);
+            Series<double> automatic(head);
+            Series<double> seq(ExecPolicy::SEQ, head);
+            EXPECT_EQ(automatic.exec_policy(), ExecPolicy::AUTO);
+            automatic.mul(2.0).sqrt().exp();
+            seq.mul(2.0).sqrt().exp();
+            for (std::size_t i = 0; i < n; ++i) {
+                EXPECT_EQ(automatic[i], seq[i]);
+            }
+            EXPECT_DOUBLE_EQ(automatic.sum(Summation::DETERMINISTIC).value(), seq.sum(Summation::DETERMINISTIC).value());
+            EXPECT_EQ(Series<double>(df::log(automatic) + 1.0)[n - 1], Series<double>(df::log(seq) + 1.0)[n - 1]);
+        }
+        set_auto_thresholds(saved);
+    }
+
+    TEST(PolicyTests, Calibration) {
+        const auto t = calibrate_auto_thresholds();
+        EXPECT_EQ(t.unseq, AutoThresholds{}.unseq);
+        // dearer operations repay the dispatch sooner
+        EXPECT_LE(t.par_heavy, t.par_medium);
+        EXPECT_LE(t.par_medium, t.par_light);
+        if (std::thread::hardware_concurrency() < 2) {
+            EXPECT_EQ(t.par_heavy, std::numeric_limits<std::size_t>::max());
+        }
+    }
+
+    // A sine wave with one null, for comparing compile-time against runtime policies
+    Series<double> policy_data() {
+        std::vector<double> data(100'000);
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = std::sin(static_cast<double>(i));
+        }
+        Series<double> s(data);
+        s.set_null(17);
+        return s;
+    }
+
+    TEST(PolicyTests, ViewsCarryCompileTimePolicy) {
+        const auto s = policy_data();
+        const auto seq = s.view<exec::Seq>();
+        const auto par = s.view<exec::ParUnseq>();
+        static_assert(std::is_same_v<decltype(seq)::policy_type, exec::Seq>);
+        static_assert(std::is_same_v<decltype(seq.slice(0, 10))::policy_type, exec::Seq>);
+        static_assert(sizeof(SeriesView<const double, exec::Seq>) < sizeof(SeriesView<const double>));
+        EXPECT_EQ(seq.exec_policy(), ExecPolicy::SEQ);
+        EXPECT_EQ(par.exec_policy(), ExecPolicy::PAR_UNSEQ);
+    }
+
+    TEST(PolicyTests, CompileTimePoliciesMatchRuntime) {
+        // the results match the runtime policies for every aggregation
+        const auto s = policy_data();
+        const auto seq = s.view<exec::Seq>();
+        const auto par = s.view<exec::ParUnseq>();
+        EXPECT_EQ(seq.sum(Summation::DETERMINISTIC).value(), s.sum(Summation::DETERMINISTIC).value());
+        EXPECT_EQ(par.sum(Summation::DETERMINISTIC).value(), s.sum(Summation::DETERMINISTIC).value());
+        EXPECT_NEAR(seq.variance().value(), s.variance().value(), 1e-12);
+        EXPECT_EQ(seq.min().value().get(), s.min().value().get());
+        EXPECT_EQ(par.max().value().get(), s.max().value().get());
+        EXPECT_NEAR(seq.dot(par), s.dot(s), 1e-9);
+    }
+
+    TEST(PolicyTests, ExpressionsTakeFirstCompileTimePolicy) {
+        // expressions run on the first compile-time policy among their operands
+        const auto s = policy_data();
+        const auto seq = s.view<exec::Seq>();
+        const auto expr = s + seq * 2.0;
+        static_assert(std::is_same_v<decltype(expr)::policy_type, exec::Seq>);
+        static_assert(std::is_same_v<decltype(s + s)::policy_type, exec::Dynamic>);
+        EXPECT_EQ(expr.exec_policy(), ExecPolicy::SEQ);
+        const Series<double> tripled = expr;
+        EXPECT_EQ(tripled.exec_policy(), ExecPolicy::SEQ);
+        EXPECT_EQ(tripled[5], 3 * s[5]);
+        EXPECT_TRUE(tripled.is_null(17));
+    }
+
+    TEST(PolicyTests, BackToRuntimePolicy) {
+        const auto s = policy_data();
+        const SeriesView<const double> dynamic = s.view<exec::Seq>().view<exec::Dynamic>();
+        EXPECT_EQ(dynamic.exec_policy(), ExecPolicy::SEQ);
+    }
+
+    // Every backend built into the library, each with a few threads and a small grain
+    std::vector<ParallelConfig> backend_configs() {
+        std::vector<ParallelConfig> configs;
+        for (const auto backend : {Backend::STD, Backend::TBB, Backend::OPENMP, Backend::POOL}) {
+            if (backend_available(backend)) {
+                configs.push_back({backend, 3, false, 1000});
+            }
+        }
+        return configs;
+    }
+
+    TEST(BackendTests, ParallelForCoversEveryIndex) {
+        const auto saved = parallel_config();
+        for (const auto& config : backend_configs()) {
+            set_parallel_config(config);
+            EXPECT_EQ(parallel_config(), config);
+            EXPECT_EQ(parallel_concurrency(), 3u);
+
+            std::vector<std::atomic<int>> hits(100'003);
+            std::atomic<std::size_t> largest{0};
+            parallel_for(hits.size(), 1000, [&](std::size_t begin, std::size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    ++hits[i];
+                }
+                auto seen = largest.load();
+                while (end - begin > seen && !largest.compare_exchange_weak(seen, end - begin)) {}
+            });
+            EXPECT_TRUE(std::all_of(hits.begin(), hits.end(), [](const auto& h) { return h == 1; }));
+            if (config.backend != Backend::STD) {
+                EXPECT_LE(largest.load(), 1000u);
+            }
+        }
+        set_parallel_config(saved);
+    }
+
+    TEST(BackendTests, ExceptionReachesCaller) {
+        // the first exception reaches the caller, and the backend stays usable
+        const auto saved = parallel_config();
+        constexpr std::size_t N{100'003};
+        for (const auto& config : backend_configs()) {
+            set_parallel_config(config);
+            EXPECT_THROW(parallel_for(N, 1000, [](std::size_t begin, std::size_t) {
+                if (begin >= 50'000) {
+                    throw std::runtime_error("task failed");
+                }
+            }), std::runtime_error);
+            std::atomic<std::size_t> total{0};
+            parallel_for(N, 1000, [&](std::size_t begin, std::size_t end) { total += end - begin; });
+            EXPECT_EQ(total.load(), N);
+        }
+        set_parallel_config(saved);
+    }
+
+    TEST(BackendTests, InvalidConfigThrows) {
+        EXPECT_THROW(set_parallel_config({Backend::POOL, 2, false, 0}), std::invalid_argument);
+        EXPECT_TRUE(backend_available(Backend::POOL));
+    }
+
+    // A shifted sine wave with one null, computed on every backend
+    std::vector<double> backend_data() {
+        std::vector<double> data(300'000);
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = std::sin(static_cast<double>(i)) + 2.0;
+        }
+        return data;
+    }
+
+    TEST(BackendTests, AggregationsMatchAcrossBackends) {
+        Series<double> s(backend_data());
+        s.set_null(123'457);
+        s.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+
+        const auto sum = s.sum(Summation::DETERMINISTIC).value();
+        const auto variance = s.variance().value();
+        const auto smallest = s.min().value().get();
+        const auto strided_max = s.view<exec::Seq>().slice(0, s.size(), 3).max().value().get();
+
+        const auto saved = parallel_config();
+        for (const auto& config : backend_configs()) {
+            set_parallel_config(config);
+            EXPECT_EQ(s.sum(Summation::DETERMINISTIC).value(), sum);
+            EXPECT_NEAR(s.variance().value(), variance, 1e-12);
+            EXPECT_EQ(s.min().value().get(), smallest);
+            EXPECT_EQ(s.view().slice(0, s.size(), 3).max().value().get(), strided_max);
+        }
+        set_parallel_config(saved);
+    }
+
+    TEST(BackendTests, ExpressionsMatchAcrossBackends) {
+        Series<double> s(backend_data());
+        s.set_null(123'457);
+        s.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+
+        const Series<double> roots = sqrt(s) + s;
+        const auto expr_sum = (s * 2.0).sum().value();
+
+        const auto saved = parallel_config();
+        for (const auto& config : backend_configs()) {
+            set_parallel_config(config);
+            const Series<double> again = sqrt(s) + s;
+            ASSERT_EQ(again.size(), roots.size());
+            for (std::size_t i = 0; i < again.size(); i += 997) {
+                EXPECT_EQ(again[i], roots[i]);
+            }
+            EXPECT_TRUE(again.is_null(123'457));
+            EXPECT_NEAR((s * 2.0).sum().value(), expr_sum, 1e-6);
+        }
+        set_parallel_config(saved);
+    }
+
+    TEST(BackendTests, InPlaceOperationsMatchAcrossBackends) {
+        const auto data = backend_data();
+        const auto saved = parallel_config();
+        for (const auto& config : backend_configs()) {
+            set_parallel_config(config);
+            Series<double> signs(data);
+            signs.set_exec_policy(ExecPolicy::PAR);
+            signs -= 2.5;
+            signs.signum();
+            EXPECT_EQ(signs[299'999], data[299'999] > 2.5 ? 1.0 : -1.0);
+            EXPECT_EQ(signs[0], -1.0);
+        }
+        set_parallel_config(saved);
+    }
+
+    TEST(NumaTests, DetectedTopology) {
+        const auto detected = numa::detect();
+        ASSERT_GE(detected.size(), 1u);
+        for (const auto& cpus : detected.nodes) {
+            EXPECT_FALSE(cpus.empty());
+            EXPECT_TRUE(std::is_sorted(cpus.begin(), cpus.end()));
+        }
+        EXPECT_EQ(numa::current_node(), numa::NO_NODE);
+    }
+
+    TEST(NumaTests, WorkersAlternateNodes) {
+        // workers alternate between nodes and walk the CPUs of each
+        const numa::Topology two{{{0, 1}, {2, 3}}};
+        const std::pair<std::size_t, int> expected[]{{0, 0}, {1, 2}, {0, 1}, {1, 3}, {0, 0}};
+        for (std::size_t w = 0; w < std::size(expected); ++w) {
+            const auto placement = numa::detail::placement(two, w);
+            EXPECT_EQ(placement.node, expected[w].first);
+            EXPECT_EQ(placement.cpu, expected[w].second);
+        }
+    }
+
+    TEST(NumaTests, HomeNodeSplitsRangeEvenly) {
+        EXPECT_EQ(numa::home_node(0, 10, 2), 0u);
+        EXPECT_EQ(numa::home_node(4, 10, 2), 0u);
+        EXPECT_EQ(numa::home_node(5, 10, 2), 1u);
+        EXPECT_EQ(numa::home_node(9, 10, 3), 2u);
+    }
+
+    TEST(NumaTests, InvalidTopologyThrows) {
+        EXPECT_THROW(numa::set_topology({}), std::invalid_argument);
+        EXPECT_THROW(numa::set_topology({{{0}, {}}}), std::invalid_argument);
+    }
+
+    TEST(NumaTests, SingleNodeIsInactive) {
+        // a single simulated node schedules like a plain pool
+        const auto saved = parallel_config();
+        numa::set_topology({{{numa::detect().nodes[0][0]}}});
+        set_parallel_config({Backend::POOL, 3, true, 100});
+        EXPECT_FALSE(numa::active());
+        numa::set_topology(numa::detect());
+        set_parallel_config(saved);
+    }
+
+    TEST(NumaTests, SimulatedNodesKeepWorkHome) {
+        // two simulated nodes on the same CPU: each index runs on its home node, or on the caller
+        const auto saved = parallel_config();
+        const auto cpu = numa::detect().nodes[0][0];
+        numa::set_topology({{{cpu}, {cpu}}});
+        set_parallel_config({Backend::POOL, 3, true, 100});
+        EXPECT_EQ(numa::node_count(), 2u);
+        EXPECT_TRUE(numa::active());
+        constexpr std::size_t N{20'000};
+        std::vector<std::size_t> node(N, 99);
+        parallel_for(N, 100, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                node[i] = numa::current_node();
+            }
+        });
+        for (std::size_t i = 0; i < N; ++i) {
+            ASSERT_TRUE(node[i] == numa::home_node(i, N, 2) || node[i] == numa::NO_NODE) << i;
+        }
+        numa::set_topology(numa::detect());
+        set_parallel_config(saved);
+    }
+
+    TEST(NumaTests, FirstTouchedBuffersCompute) {
+        // buffers are first touched by node and compute as usual
+        const auto saved = parallel_config();
+        const auto cpu = numa::detect().nodes[0][0];
+        numa::set_topology({{{cpu}, {cpu}}});
+        set_parallel_config({Backend::POOL, 3, true, 100});
+        ASSERT_TRUE(numa::active());
+        std::vector<double> data(1 << 19);
+        std::iota(data.begin(), data.end(), 0.0);
+        Series<double> s(data);
+        s.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        const Series<double> doubled = s + s;
+        EXPECT_EQ(doubled.sum().value(), 2 * s.sum().value());
+        EXPECT_EQ(doubled[data.size() - 1], 2 * data.back());
+        numa::set_topology(numa::detect());
+        set_parallel_config(saved);
+    }
+
+    TEST(AggTests, MatchSeparateReductions) {
+        std::vector<double> data(20'000);
+        Bitmap valid(data.size());
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<double>((i * 37) % 101) - 50;
+            if (i % 11 == 0 || (i >= 5000 && i < 5300)) {
+                valid.set(i, false);
+            }
+        }
+        const std::vector<Agg> all{Agg::MAX, Agg::COUNT, Agg::SUM, Agg::MEAN, Agg::MIN, Agg::VAR, Agg::STD};
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            for (const auto nulls : {false, true}) {
+                Series<double> s(policy, data);
+                if (nulls) {
+                    s.set_validity(valid);
+                }
+                for (const auto& [begin, end, step] : {std::tuple<std::size_t, std::size_t, std::size_t>{0, 20'000, 1}, {3, 17'001, 1}, {1, 20'000, 3}}) {
+                    const auto v = s.slice(begin, end, step);
+                    const auto a = v.agg(all);
+                    ASSERT_EQ(a.size(), all.size());
+                    EXPECT_EQ(a.aggs(), all);
+                    EXPECT_EQ(a[Agg::COUNT].value(), static_cast<double>(v.count()));
+                    EXPECT_NEAR(a[Agg::SUM].value(), v.sum().value(), 1e-6);
+                    EXPECT_NEAR(a[Agg::MEAN].value(), v.mean().value(), 1e-9);
+                    EXPECT_EQ(a[Agg::MIN].value(), v.min().value().get());
+                    EXPECT_EQ(a[Agg::MAX].value(), v.max().value().get());
+                    EXPECT_NEAR(a[Agg::VAR].value(), v.variance().value(), 1e-9);
+                    EXPECT_NEAR(a[Agg::STD].value(), v.stddev().value(), 1e-9);
+                    EXPECT_EQ(a.values().front(), a[Agg::MAX]);
+                }
+
+                // integer columns aggregate into a wider type
+                Series<int> ints(policy, std::vector<int>(data.begin(), data.end()));
+                ints.set_validity(s.validity());
+                const auto ia = ints.agg<double>({Agg::SUM, Agg::VAR});
+                EXPECT_EQ(ia[Agg::SUM].value(), static_cast<double>(ints.sum().value()));
+                EXPECT_NEAR(ia[Agg::VAR].value(), ints.variance<double>().value(), 1e-9);
+                EXPECT_THROW(ia[Agg::MEAN], std::out_of_range);
+            }
+        }
+
+        Series<double> none({1, 2});
+        none.set_validity(Bitmap(2, false));
+        const auto empty = none.agg({Agg::COUNT, Agg::MEAN, Agg::MIN});
+        EXPECT_EQ(empty[Agg::COUNT].value(), 0.0);
+        EXPECT_FALSE(empty[Agg::MEAN]);
+        EXPECT_FALSE(empty[Agg::MIN]);
+        EXPECT_EQ(Series<double>({1, 2, 3}).agg({Agg::COUNT})[Agg::COUNT].value(), 3.0);
+    }
+
+    TEST(AggTests, IntegersAggregateInDouble) {
+        const auto ints = Series<int>({1, 2, 3, 4}).agg({Agg::MEAN, Agg::VAR, Agg::STD, Agg::MAX});
+        static_assert(std::is_same_v<decltype(ints), const Aggregates<double>>);
+        EXPECT_DOUBLE_EQ(ints[Agg::MEAN].value(), 2.5);
+        EXPECT_DOUBLE_EQ(ints[Agg::VAR].value(), 1.25);
+        EXPECT_DOUBLE_EQ(ints[Agg::STD].value(), std::sqrt(1.25));
+        EXPECT_EQ(ints[Agg::MAX].value(), 4.0);
+
+        const Series<long> longs({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+        const auto a = longs.agg({Agg::MEAN, Agg::VAR});
+        EXPECT_DOUBLE_EQ(a[Agg::MEAN].value(), 5.5);
+        EXPECT_DOUBLE_EQ(a[Agg::VAR].value(), 8.25);
+        EXPECT_EQ(longs.agg<long>({Agg::SUM})[Agg::SUM].value(), 55);
+    }
+
+    TEST(AggTests, DataFrameDescribe) {
+        DataFrame frame;
+        frame.add("x", Series<double>({1, 2, 3, 4}));
+        frame.add("name", Series<std::string>({"a", "b", "c", "d"}));
+        Series<int> n({4, 0, 2, 6});
+        n.set_null(1);
+        frame.add("n", std::move(n));
+
+        const auto described = frame.describe();
+        EXPECT_EQ(described.shape(), std::make_pair(std::size_t{5}, std::size_t{2}));
+        const auto& x = described.column<double>("x");
+        EXPECT_EQ(x[0], 4.0);
+        EXPECT_EQ(x[1], 2.5);
+        EXPECT_DOUBLE_EQ(x[2], std::sqrt(1.25));
+        EXPECT_EQ(x[3], 1.0);
+        EXPECT_EQ(x[4], 4.0);
+        const auto& counts = described.column<double>("n");
+        EXPECT_EQ(counts[0], 3.0);
+        EXPECT_EQ(counts[1], 4.0);
+        EXPECT_THROW(described.column<double>("name"), std::out_of_range);
+
+        // the rows follow the requested order; undefined results are null
+        const auto rows = frame.slice(1, 2).agg({Agg::SUM, Agg::VAR});
+        EXPECT_EQ(rows.column<double>("x")[0], 2.0);
+        EXPECT_EQ(rows.column<double>("x")[1], 0.0);
+        EXPECT_EQ(rows.column<double>("n").null_count(), 2u);
+    }
+
+    TEST(ExtremaTests, ArgMinMaxMatchReference) {
+        constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+        std::vector<double> data(50'000);
+        Bitmap valid(data.size());
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<double>((i * 7919) % 10'007) - 5000;
+            if (i % 13 == 0) {
+                valid.set(i, false);
+            }
+        }
+        data[40'000] = NaN;
+        data[41'234] = NaN;
+        data[7] = NaN;   // null, so never seen
+
+        for (const auto isa : {kernels::Isa::SCALAR, kernels::detected_isa()}) {
+            kernels::set_isa(isa);
+            for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+                Series<double> s(policy, data);
+                s.set_validity(valid);
+                for (const auto& [begin, end, step] : {std::tuple<std::size_t, std::size_t, std::size_t>{0, 50'000, 1}, {3, 39'999, 1}, {1, 50'000, 3}}) {
+                    const auto v = s.slice(begin, end, step);
+                    // reference: first minimum and maximum of the valid elements other than NaN
+                    std::size_t lo = v.size(), hi = v.size(), nan = v.size();
+                    for (std::size_t i = 0; i < v.size(); ++i) {
+                        if (!v.is_valid(i)) {
+                            continue;
+                        }
+                        if (std::isnan(v[i])) {
+                            nan = std::min(nan, i);
+                            continue;
+                        }
+                        if (lo == v.size() || v[i] < v[lo]) {
+                            lo = i;
+                        }
+                        if (hi == v.size() || v[i] > v[hi]) {
+                            hi = i;
+                        }
+                    }
+                    const auto mm = v.minmax().value();
+                    EXPECT_EQ(mm.min, (Extremum<double>{lo, v[lo]}));
+                    EXPECT_EQ(mm.max, (Extremum<double>{hi, v[hi]}));
+                    EXPECT_EQ(v.argmin()->index, lo);
+                    EXPECT_EQ(v.argmax()->index, hi);
+                    EXPECT_EQ(&v.min().value().get(), &v[lo]);
+                    EXPECT_EQ(&v.max().value().get(), &v[hi]);
+                    const auto propagated = v.minmax(NanPolicy::PROPAGATE).value();
+                    EXPECT_EQ(propagated.min.index, nan == v.size() ? lo : nan);
+                    EXPECT_EQ(propagated.max.index, nan == v.size() ? hi : nan);
+                    EXPECT_EQ(std::isnan(v.argmax(NanPolicy::PROPAGATE)->value), nan != v.size());
+                }
+            }
+        }
+        kernels::set_isa(kernels::detected_isa());
+
+        // ties go to the first position, and a position reads its row straight from the frame
+        DataFrame frame;
+        frame.add("x", Series<float>({3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 9, 0.5f, 9}));
+        frame.add("n", Series<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13}));
+        const auto& x = frame.column<float>("x");
+        EXPECT_EQ(x.argmax()->index, 5u);
+        EXPECT_EQ(frame.column<int>("n")[x.argmin()->index], 12);
+        EXPECT_EQ(x.slice(0, 12).argmin(), (Extremum<float>{1, 1.0f}));
+        const Series<int> ints({4, -2, 7, -2, 7});
+        EXPECT_EQ(ints.minmax(), (MinMax<int>{{1, -2}, {2, 7}}));
+
+        // nothing left after skipping
+        Series<double> nans({NaN, NaN, 1.0});
+        nans.set_null(2);
+        EXPECT_FALSE(nans.minmax());
+        EXPECT_FALSE(nans.min());
+        EXPECT_EQ(nans.argmin(NanPolicy::PROPAGATE)->index, 0u);
+        EXPECT_FALSE(Series<double>(std::vector<double>{}).argmax());
+    }
+
+    // Stable reference order: valid values, NaN after them, nulls last
+    template <typename T>
+    std::vector<std::size_t> reference_argsort(const Series<T>& s, bool ascending) {
+        std::vector<std::size_t> index, nulls;
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            (s.is_valid(i) ? index : nulls).push_back(i);
+        }
+        std::stable_sort(index.begin(), index.end(), [&](std::size_t a, std::size_t b) {
+            const auto& x = s[a];
+            const auto& y = s[b];
+            if constexpr (std::is_floating_point_v<T>) {
+                if (std::isnan(x) || std::isnan(y)) {
+                    return !std::isnan(x);
+                }
+            }
+            return ascending ? x < y : y < x;
+        });
+        index.insert(index.end(), nulls.begin(), nulls.end());
+        return index;
+    }
+
+    TEST(SortTests, ArgsortMatchesStableSort) {
+        std::mt19937_64 rng(7);
+        for (const std::size_t n : {std::size_t{0}, std::size_t{1}, std::size_t{100}, std::size_t{5'000}, std::size_t{200'000}}) {
+            std::vector<double> doubles(n);
+            std::vector<std::int8_t> bytes(n);
+            std::vector<std::int64_t> longs(n);
+            std::vector<std::uint32_t> words(n);
+            std::vector<std::string> strings(n);
+            Bitmap valid(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto r = rng();
+                doubles[i] = static_cast<double>(static_cast<std::int64_t>(r % 2001) - 1000) / 8;
+                if (r % 97 == 0) {
+                    doubles[i] = std::numeric_limits<double>::quiet_NaN();
+                }
+                else if (r % 89 == 0) {
+                    doubles[i] = r % 2 ? 0.0 : -0.0;
+                }
+                bytes[i] = static_cast<std::int8_t>(r);
+                longs[i] = static_cast<std::int64_t>(r >> 3) * (r % 2 ? -1 : 1);
+                words[i] = static_cast<std::uint32_t>(r % 1000);
+                strings[i] = std::to_string(r % 500);
+                valid.set(i, r % 31 != 0);
+            }
+            for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+                for (const auto ascending : {true, false}) {
+                    const auto check = [&](auto values, bool nulls) {
+                        Series<typename decltype(values)::value_type> s(policy, std::move(values));
+                        if (nulls) {
+                            s.set_validity(valid);
+                        }
+                        EXPECT_EQ(s.argsort(ascending), reference_argsort(s, ascending)) << n;
+                    };
+                    check(doubles, false);
+                    check(doubles, true);
+                    check(bytes, false);
+                    check(longs, true);
+                    check(words, false);
+                    if (n <= 5'000) {
+                        check(strings, true);
+                    }
+                }
+            }
+        }
+    }
+
+    TEST(SortTests, SortSeriesAndFrame) {
+        Series<double> s({3, std::numeric_limits<double>::quiet_NaN(), -1, 2, 5});
+        s.set_null(3);
+        s.sort();
+        EXPECT_EQ(s[0], -1);
+        EXPECT_EQ(s[1], 3);
+        EXPECT_EQ(s[2], 5);
+        EXPECT_TRUE(std::isnan(s[3]));
+        EXPECT_TRUE(s.is_null(4));
+        EXPECT_EQ(s.null_count(), 1u);
+        EXPECT_EQ(Series<int>({1, 3, 2}).sort(false)[0], 3);
+
+        DataFrame frame;
+        frame.add("k", Series<int>({2, 1, 2, 1, 2, 1}));
+        frame.add("x", Series<double>({0.5, 0.25, 0.5, 0.75, 0.125, 0.25}));
+        frame.add("id", Series<std::string>({"a", "b", "c", "d", "e", "f"}));
+        const auto sorted = frame.sort_values({"k", "x"});
+        EXPECT_EQ(sorted.shape(), frame.shape());
+        const std::vector<std::string> ids{"b", "f", "d", "e", "a", "c"};
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            EXPECT_EQ(sorted.column<std::string>("id")[i], ids[i]);
+        }
+        EXPECT_EQ(sorted.column<double>("x")[2], 0.75);
+        EXPECT_EQ(frame.sort_values({"x"}, false).column<std::string>("id")[0], "d");
+        EXPECT_THROW(frame.sort_values({}), std::invalid_argument);
+        EXPECT_THROW(frame.sort_values({"y"}), std::out_of_range);
+    }
+
+    TEST(ScanTests, CumulativeMatchSequentialLoop) {
+        constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+        // integer-valued sums are exact in any order, so every instruction set and policy must agree
+        for (const auto isa : {kernels::Isa::SCALAR, kernels::Isa::SSE2, kernels::Isa::AVX2, kernels::Isa::AVX512}) {
+            kernels::set_isa(isa);
+            for (std::size_t n = 0; n < 40; ++n) {
+                std::vector<double> d(n);
+                std::vector<float> f(n);
+                std::iota(d.begin(), d.end(), -3.0);
+                std::iota(f.begin(), f.end(), 2.0f);
+                double expect_d = 10;
+                float expect_f = 0;
+                std::vector<double> want_d(n);
+                std::vector<float> want_f(n);
+                for (std::size_t i = 0; i < n; ++i) {
+                    want_d[i] = expect_d += d[i];
+                    want_f[i] = expect_f += f[i];
+                }
+                EXPECT_EQ(kernels::cumsum(d.data(), d.data(), n, 10.0), expect_d);
+                EXPECT_EQ(kernels::cumsum(f.data(), f.data(), n, 0.0f), expect_f);
+                EXPECT_EQ(d, want_d) << kernels::isa_name(isa);
+                EXPECT_EQ(f, want_f) << kernels::isa_name(isa);
+            }
+        }
+        kernels::set_isa(kernels::detected_isa());
+
+        std::vector<double> data(100'003);
+        Bitmap valid(data.size());
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = 1 + (static_cast<double>((i * 37) % 101) - 50) / 4096;
+            valid.set(i, i % 17 != 0);
+        }
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            for (const auto nulls : {false, true}) {
+                Series<double> s(policy, data);
+                if (nulls) {
+                    s.set_validity(valid);
+                }
+                auto sum = s, prod = s, lo = s, hi = s;
+                sum.cumsum();
+                prod.cumprod();
+                lo.cummin();
+                hi.cummax();
+                double acc_sum = 0, acc_prod = 1, acc_lo = 1e300, acc_hi = -1e300;
+                for (std::size_t i = 0; i < data.size(); ++i) {
+                    if (s.is_null(i)) {
+                        ASSERT_TRUE(sum.is_null(i) && lo.is_null(i));
+                        continue;
+                    }
+                    acc_sum += data[i];
+                    acc_prod *= data[i];
+                    acc_lo = std::min(acc_lo, data[i]);
+                    acc_hi = std::max(acc_hi, data[i]);
+                    ASSERT_NEAR(sum[i], acc_sum, 1e-9 * (1 + std::abs(acc_sum))) << i;
+                    ASSERT_NEAR(prod[i], acc_prod, 1e-9 * acc_prod) << i;
+                    ASSERT_EQ(lo[i], acc_lo) << i;
+                    ASSERT_EQ(hi[i], acc_hi) << i;
+                }
+
+                // integer scans are exact
+                Series<std::int64_t> ints(policy, std::vector<std::int64_t>(data.size()));
+                std::iota(ints.begin(), ints.end(), std::int64_t{-1000});
+                if (nulls) {
+                    ints.set_validity(valid);
+                }
+                ints.cumsum();
+                std::int64_t total = 0;
+                for (std::size_t i = 0; i < data.size(); ++i) {
+                    if (ints.is_valid(i)) {
+                        total += static_cast<std::int64_t>(i) - 1000;
+                        ASSERT_EQ(ints[i], total) << i;
+                    }
+                }
+                EXPECT_EQ(Series<int>(policy, std::vector<int>{3, 1, 2, 0}).cummin()[3], 0);
+                EXPECT_EQ(Series<int>(policy, std::vector<int>{3, 1, 2, 5}).cummax()[2], 3);
+            }
+        }
+
+        // NaN propagates through sums and products, and is skipped by minimum and maximum
+        const Series<double> with_nan({2, NaN, 1, 3});
+        const auto sum = Series<double>(with_nan).cumsum();
+        const auto lo = Series<double>(with_nan).cummin();
+        const auto hi = Series<double>(with_nan).cummax();
+        EXPECT_EQ(sum[0], 2);
+        EXPECT_TRUE(std::isnan(sum[1]) && std::isnan(sum[3]));
+        EXPECT_TRUE(std::isnan(lo[1]));
+        EXPECT_EQ(lo[2], 1);
+        EXPECT_EQ(lo[3], 1);
+        EXPECT_EQ(hi[3], 3);
+        EXPECT_EQ(Series<double>({2, 3, 4}).cumprod()[2], 24);
+    }
+
+    TEST(RollingTests, MatchWindowRecomputedFromScratch) {
+        std::vector<double> data(40'000);
+        Bitmap valid(data.size());
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            // few distinct values so that windows hold ties, and a level far from zero for the variance
+            data[i] = 1e4 + static_cast<double>((i * 7919) % 23);
+            valid.set(i, i % 13 != 5);
+        }
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR_UNSEQ}) {
+            for (const auto nulls : {false, true}) {
+                Series<double> s(policy, data);
+                if (nulls) {
+                    s.set_validity(valid);
+                }
+                for (const std::size_t window : {1, 4, 37, 300}) {
+                    const auto min_periods = std::max<std::size_t>(1, window / 2);
+                    const auto rolling = s.rolling(window, min_periods);
+                    const auto sum = rolling.sum(), mean = rolling.mean(), var = rolling.variance(1);
+                    const auto lo = rolling.min(), hi = rolling.max(), median = rolling.median();
+                    std::vector<double> values;
+                    for (std::size_t i = 0; i < data.size(); ++i) {
+                        values.clear();
+                        for (auto j = i + 1 >= window ? i + 1 - window : 0; j <= i; ++j) {
+                            if (s.is_valid(j)) {
+                                values.push_back(data[j]);
+                            }
+                        }
+                        if (values.size() < min_periods) {
+                            ASSERT_TRUE(sum.is_null(i) && mean.is_null(i) && lo.is_null(i) && median.is_null(i)) << i;
+                            continue;
+                        }
+                        const auto n = static_cast<double>(values.size());
+                        const double total = std::accumulate(values.begin(), values.end(), 0.0);
+                        double m2 = 0;
+                        for (const auto x : values) {
+                            m2 += (x - total / n) * (x - total / n);
+                        }
+                        std::sort(values.begin(), values.end());
+                        const auto k = values.size() / 2;
+                        const double mid = values.size() % 2 ? values[k] : (values[k - 1] + values[k]) / 2;
+                        ASSERT_NEAR(sum[i], total, 1e-9 * total) << i;
+                        ASSERT_NEAR(mean[i], total / n, 1e-9 * total / n) << i;
+                        if (values.size() > 1) {
+                            ASSERT_NEAR(var[i], m2 / (n - 1), 1e-6) << i;
+                        }
+                        else {
+                            ASSERT_TRUE(var.is_null(i)) << i;
+                        }
+                        ASSERT_EQ(lo[i], values.front()) << i;
+                        ASSERT_EQ(hi[i], values.back()) << i;
+                        ASSERT_EQ(median[i], mid) << i;
+                    }
+                }
+            }
+        }
+
+        // integers aggregate as double, and a view rolls like a series
+        const Series<int> ints({4, 1, 3, 2, 5});
+        const auto sums = ints.rolling(2).sum();
+        static_assert(std::is_same_v<decltype(sums), const Series<double>>);
+        EXPECT_TRUE(sums.is_null(0));
+        EXPECT_EQ(sums[1], 5);
+        EXPECT_EQ(sums[4], 7);
+        EXPECT_EQ(ints.view().slice(1, 5).rolling(3).median()[2], 2);
+
+        // NaN holds the sum and mean at NaN while in the window, and is skipped by the extrema and median
+        constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+        const Series<double> with_nan({1, NaN, 3, 4, 5});
+        const auto rolling = with_nan.rolling(2);
+        const auto sum = rolling.sum(), lo = rolling.min(), median = rolling.median();
+        EXPECT_TRUE(std::isnan(sum[1]) && std::isnan(sum[2]));
+        EXPECT_EQ(sum[3], 7);
+        EXPECT_EQ(lo[1], 1);
+        EXPECT_EQ(lo[2], 3);
+        EXPECT_EQ(median[4], 4.5);
+        const Series<double> all_nan({NaN, NaN});
+        EXPECT_TRUE(std::isnan(all_nan.rolling(2).max()[1]));
+
+        EXPECT_THROW(ints.rolling(0), std::invalid_argument);
+        EXPECT_THROW(ints.rolling(2, 3), std::invalid_argument);
+        EXPECT_THROW(ints.rolling(2, 0), std::invalid_argument);
+    }
+
+    TEST(EwmTests, DecayedCumsumKernelMatchesLoop) {
+        for (const auto isa : {kernels::Isa::SCALAR, kernels::Isa::SSE2, kernels::Isa::AVX2, kernels::Isa::AVX512}) {
+            kernels::set_isa(isa);
+            for (std::size_t n = 0; n < 40; ++n) {
+                std::vector<double> d(n);
+                std::vector<float> f(n);
+                std::iota(d.begin(), d.end(), -3.0);
+                std::iota(f.begin(), f.end(), 2.0f);
+                double expect_d = 10;
+                float expect_f = 0;
+                std::vector<double> out_d(n);
+                std::vector<float> out_f(n);
+                kernels::decayed_cumsum(d.data(), out_d.data(), n, 0.9, 10.0);
+                kernels::decayed_cumsum(f.data(), out_f.data(), n, 0.9f, 0.0f);
+                for (std::size_t i = 0; i < n; ++i) {
+                    expect_d = 0.9 * expect_d + d[i];
+                    expect_f = 0.9f * expect_f + f[i];
+                    ASSERT_NEAR(out_d[i], expect_d, 1e-12 * std::abs(expect_d)) << kernels::isa_name(isa);
+                    ASSERT_NEAR(out_f[i], expect_f, 1e-5f * std::abs(expect_f)) << kernels::isa_name(isa);
+                }
+            }
+        }
+        kernels::set_isa(kernels::detected_isa());
+    }
+
+    // Mean and variance at position i straight from the weights: element j weighs its base times the decays
+    // after it, the base being 1 with adjust and otherwise alpha times the total weight after the element before
+    std::pair<double, double> ewm_reference(const Series<double>& s, const std::vector<double>& decays, double alpha,
+                                            bool adjust, std::size_t i, bool bias) {
+        double last = 1;
+        std::vector<std::pair<double, double>> terms;
+        for (std::size_t j = 0; j <= i; ++j) {
+            for (auto& term : terms) {
+                term.first *= decays[j];
+            }
+            if (s.is_valid(j) && !std::isnan(s[j])) {
+                terms.emplace_back(adjust || terms.empty() ? 1 : alpha * last, s[j]);
+                last = 0;
+                for (const auto& term : terms) {
+                    last += term.first;
+                }
+            }
+        }
+        double weight = 0, weight_sq = 0, total = 0;
+        for (const auto& [w, x] : terms) {
+            weight += w;
+            weight_sq += w * w;
+            total += w * x;
+        }
+        const double mean = total / weight;
+        double m2 = 0;
+        for (const auto& [w, x] : terms) {
+            m2 += w * (x - mean) * (x - mean);
+        }
+        const double variance = bias ? m2 / weight : m2 / weight * weight * weight / (weight * weight - weight_sq);
+        constexpr double none = std::numeric_limits<double>::quiet_NaN();
+        return {terms.empty() ? none : mean, terms.size() < (bias ? 1u : 2u) ? none : variance};
+    }
+
+    // A series with nulls and a NaN, irregular timestamps, and the decay of each step for alpha 0.25
+    struct EwmData {
+        Series<double> s;
+        Series<std::int64_t> times;
+        std::vector<double> regular;
+        std::vector<double> irregular;
+    };
+
+    EwmData ewm_data() {
+        constexpr std::size_t n{500};
+        EwmData d{Series<double>(std::vector<double>(n)), Series<std::int64_t>(std::vector<std::int64_t>(n)),
+                  std::vector<double>(n, 0.75), std::vector<double>(n, 1.0)};
+        for (std::size_t i = 0; i < n; ++i) {
+            d.s[i] = std::sin(static_cast<double>(i)) * 10 + 100;
+            d.times[i] = 1'700'000'000'000'000'000 + static_cast<std::int64_t>(3 * i + i % 4);
+            if (i > 0) {
+                d.irregular[i] = std::pow(0.75, static_cast<double>(d.times[i] - d.times[i - 1]));
+            }
+        }
+        d.s.set_null(0);
+        d.s.set_null(17);
+        d.s.set_null(200);
+        d.s[30] = std::numeric_limits<double>::quiet_NaN();
+        return d;
+    }
+
+    TEST(EwmTests, MatchWeightedDefinition) {
+        const auto [s, times, regular, irregular] = ewm_data();
+        for (const auto adjust : {true, false}) {
+            for (const auto bias : {true, false}) {
+                const auto mean = s.ewm(0.25, adjust).mean();
+                const auto variance = s.ewm(0.25, adjust).variance(bias);
+                for (std::size_t i = 0; i < s.size(); ++i) {
+                    if (s.is_null(i)) {
+                        ASSERT_TRUE(mean.is_null(i) && variance.is_null(i)) << i;
+                        continue;
+                    }
+                    const auto [m, v] = ewm_reference(s, regular, 0.25, adjust, i, bias);
+                    ASSERT_NEAR(mean[i], m, 1e-9) << i;
+                    if (std::isnan(v)) {
+                        ASSERT_TRUE(variance.is_null(i)) << i;
+                    }
+                    else {
+                        ASSERT_NEAR(variance[i], v, 1e-9 * v) << i;
+                    }
+                }
+            }
+        }
+    }
+
+    TEST(EwmTests, TimesMatchWeightedDefinition) {
+        const auto [s, times, regular, irregular] = ewm_data();
+        for (const auto bias : {true, false}) {
+            const auto timed_mean = s.ewm(0.25, times).mean();
+            const auto timed_std = s.ewm(0.25, times).stddev(bias);
+            for (std::size_t i = 0; i < s.size(); ++i) {
+                if (s.is_null(i)) {
+                    ASSERT_TRUE(timed_mean.is_null(i)) << i;
+                    continue;
+                }
+                const auto [tm, tv] = ewm_reference(s, irregular, 0.25, true, i, bias);
+                ASSERT_NEAR(timed_mean[i], tm, 1e-9) << i;
+                if (!std::isnan(tv)) {
+                    ASSERT_NEAR(timed_std[i], std::sqrt(tv), 1e-9 * std::sqrt(tv)) << i;
+                }
+            }
+        }
+    }
+
+    TEST(EwmTests, DenseBlocksMatchRecurrence) {
+        // without nulls, blocks are weighed in a vectorized loop
+        Series<double> dense(std::vector<double>(3000));
+        for (std::size_t i = 0; i < dense.size(); ++i) {
+            dense[i] = i == 1500 ? std::numeric_limits<double>::quiet_NaN() : std::sin(static_cast<double>(i));
+        }
+        for (const auto adjust : {true, false}) {
+            const auto mean = dense.ewm(0.25, adjust).mean();
+            double sum = 0, weight = 0;
+            for (std::size_t i = 0; i < dense.size(); ++i) {
+                sum *= 0.75;
+                weight *= 0.75;
+                if (!std::isnan(dense[i])) {
+                    const double w = adjust || i == 0 ? 1 : 0.25;
+                    sum += w * dense[i];
+                    weight += w;
+                    if (!adjust) {
+                        sum /= weight;
+                        weight = 1;
+                    }
+                }
+                ASSERT_NEAR(mean[i], sum / weight, 1e-12) << i;
+            }
+        }
+    }
+
+    TEST(EwmTests, PlainRecurrenceWithoutAdjust) {
+        // adjust unset is the plain recurrence from the first element
+        const Series<double> steps({4, 8, 0});
+        const auto plain = steps.ewm(0.5, false).mean();
+        EXPECT_EQ(plain[1], 6);
+        EXPECT_EQ(plain[2], 3);
+        EXPECT_EQ(steps.ewm(0.5).mean()[1], (8 + 0.5 * 4) / 1.5);
+    }
+
+    TEST(EwmTests, GapResetsCarriedWeight) {
+        // across a skipped element the carried weight is reset once the next one is taken, as in pandas
+        const Series<double> gap({1, std::numeric_limits<double>::quiet_NaN(), 3, 5});
+        const auto gap_mean = gap.ewm(0.5, false).mean();
+        const auto gap_var = gap.ewm(0.5, false).variance();
+        const auto gap_sample = gap.ewm(0.5, false).variance(false);
+        const std::vector<double> pandas_mean{1, 1, 7.0 / 3, 11.0 / 3};
+        const std::vector<double> pandas_var{0, 0, 8.0 / 9, 20.0 / 9};
+        for (std::size_t i = 0; i < gap.size(); ++i) {
+            EXPECT_NEAR(gap_mean[i], pandas_mean[i], 1e-12) << i;
+            EXPECT_NEAR(gap_var[i], pandas_var[i], 1e-12) << i;
+        }
+        EXPECT_TRUE(gap_sample.is_null(1));
+        EXPECT_NEAR(gap_sample[2], 2.0, 1e-12);
+        EXPECT_NEAR(gap_sample[3], 40.0 / 11, 1e-12);
+    }
+
+    TEST(EwmTests, ParallelMatchesSequential) {
+        // blocks scanned in parallel from their carries agree with a single pass
+        Series<double> large(std::vector<double>(100'003));
+        for (std::size_t i = 0; i < large.size(); ++i) {
+            large[i] = std::cos(static_cast<double>(i) / 7) + (i % 1000 == 3 ? 50 : 0);
+            if (i % 101 == 7) {
+                large.set_null(i);
+            }
+        }
+        large.set_exec_policy(ExecPolicy::SEQ);
+        const auto seq_mean = large.ewm(0.01).mean();
+        const auto seq_var = large.ewm(0.01, false).variance(false);
+        const auto saved = parallel_config();
+        set_parallel_config({Backend::POOL, 3, false, 1000});
+        large.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        const auto par_mean = large.ewm(0.01).mean();
+        const auto par_var = large.ewm(0.01, false).variance(false);
+        set_parallel_config(saved);
+        for (std::size_t i = 0; i < large.size(); ++i) {
+            ASSERT_EQ(par_mean.is_null(i), seq_mean.is_null(i)) << i;
+            if (large.is_valid(i)) {
+                ASSERT_NEAR(par_mean[i], seq_mean[i], 1e-9) << i;
+                ASSERT_NEAR(par_var[i], seq_var[i], 1e-9 * seq_var[i]) << i;
+            }
+        }
+    }
+
+    TEST(EwmTests, InvalidParametersThrow) {
+        auto [s, times, regular, irregular] = ewm_data();
+        EXPECT_THROW(s.ewm(0), std::invalid_argument);
+        EXPECT_THROW(s.ewm(1.5), std::invalid_argument);
+        EXPECT_THROW(s.ewm(0.5, Series<double>({1, 2})), std::invalid_argument);
+        times[5] = times[4] - 1;
+        EXPECT_THROW(s.ewm(0.5, times), std::invalid_argument);
+    }
+
+    TEST(LagTests, ShiftDiffAndPctChange) {
+        Series<double> s({1, 2, 4, 7, 11});
+        s.set_null(2);
+        const auto expect = [](const Series<double>& actual, const std::vector<std::optional<double>>& expected) {
+            ASSERT_EQ(actual.size(), expected.size());
+            for (std::size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_EQ(actual.is_valid(i), expected[i].has_value()) << i;
+                if (expected[i]) {
+                    EXPECT_EQ(actual[i], *expected[i]) << i;
+                }
+            }
+        };
+        const std::optional<double> null;
+        expect(s.shift(1), {null, 1, 2, null, 7});
+        expect(s.shift(-2), {null, 7, 11, null, null});
+        expect(s.shift(0), {1, 2, null, 7, 11});
+        expect(s.shift(9), {null, null, null, null, null});
+        expect(s.shift(-9), {null, null, null, null, null});
+        expect(s.diff(), {null, 1, null, null, 4});
+        expect(s.diff(-1), {-1, null, null, -4, null});
+        expect(s.pct_change(3), {null, null, null, 6, 4.5});
+        expect(s.view().slice(1, 5).diff(), {null, null, null, 4});
+
+        // a lagged operand fuses into a larger expression, and the result matches the explicit form
+        const Series<double> fused = (s - s.shift(1)) / s;
+        expect(fused, {null, 0.5, null, null, 4.0 / 11});
+        const Series<double> explicit_diff = s - s.shift(1);
+        expect(explicit_diff, {null, 1, null, null, 4});
+
+        // integers change relatively in double
+        const Series<int> ints({2, 4, 5});
+        const Series<double> change = ints.pct_change();
+        expect(change, {null, 1, 0.25});
+
+        // a temporary operand is not overwritten while a shift still reads it
+        Series<double> a({1, 3, 6, 10});
+        const Series<double> steps = std::move(a) - a.shift(1);
+        expect(steps, {null, 2, 3, 4});
+
+        // nor is a series assigned a lagged expression of itself, across staging tiles
+        Series<double> squares(std::vector<double>(1000));
+        for (std::size_t i = 0; i < squares.size(); ++i) {
+            squares[i] = static_cast<double>(i * i);
+        }
+        Series<double> in_place = squares;
+        in_place = in_place.diff();
+        ASSERT_TRUE(in_place.is_null(0));
+        for (std::size_t i = 1; i < in_place.size(); ++i) {
+            ASSERT_EQ(in_place[i], static_cast<double>(2 * i - 1)) << i;
+        }
+        in_place = squares;
+        in_place -= in_place.shift(3);
+        ASSERT_TRUE(in_place.is_null(2) && in_place.is_valid(3));
+        for (std::size_t i = 3; i < in_place.size(); ++i) {
+            ASSERT_EQ(in_place[i], squares[i] - squares[i - 3]) << i;
+        }
+
+        Series<double> large(std::vector<double>(100'003));
+        for (std::size_t i = 0; i < large.size(); ++i) {
+            large[i] = static_cast<double>(i * i % 1009);
+        }
+        large.set_exec_policy(ExecPolicy::PAR_UNSEQ);
+        const Series<double> diffs = large.diff(3);
+        ASSERT_TRUE(diffs.is_null(2) && diffs.is_valid(3));
+        for (std::size_t i = 3; i < large.size(); ++i) {
+            ASSERT_EQ(diffs[i], large[i] - large[i - 3]) << i;
+        }
+
+        // nulls move with their elements across bitmap words, both ways
+        for (std::size_t i = 0; i < large.size(); i += 7) {
+            large.set_null(i);
+        }
+        for (const std::ptrdiff_t periods : {70, -130, 64, -1}) {
+            const Series<double> moved = large.shift(periods);
+            for (std::size_t i = 0; i < large.size(); ++i) {
+                const auto j = static_cast<std::ptrdiff_t>(i) - periods;
+                const bool valid = j >= 0 && j < static_cast<std::ptrdiff_t>(large.size()) && large.is_valid(static_cast<std::size_t>(j));
+                ASSERT_EQ(moved.is_valid(i), valid) << periods << " " << i;
+            }
+        }
+    }
+
+    TEST(FilterTests, CompareAndCompressKernelsMatchLoop) {
+        using kernels::CompareOp;
+        std::mt19937_64 gen(21);
+        std::uniform_int_distribution<int> value(-3, 3);
+        const auto check = [&]<typename T>(T) {
+            for (const std::size_t n : {0, 1, 7, 63, 64, 65, 130, 1000}) {
+                std::vector<T> a(n);
+                std::vector<T> b(n);
+                for (std::size_t i = 0; i < n; ++i) {
+                    a[i] = i % 11 == 5 ? std::numeric_limits<T>::quiet_NaN() : static_cast<T>(value(gen));
+                    b[i] = static_cast<T>(value(gen));
+                }
+                const auto words = (n + 63) / 64;
+                for (const auto op : {CompareOp::LT, CompareOp::LE, CompareOp::GT, CompareOp::GE, CompareOp::EQ, CompareOp::NE}) {
+                    const auto holds = [op](T x, T y) {
+                        switch (op) {
+                        case CompareOp::LT: return x < y;
+                        case CompareOp::LE: return x <= y;
+                        case CompareOp::GT: return x > y;
+                        case CompareOp::GE: return x >= y;
+                        case CompareOp::EQ: return x == y;
+                        case CompareOp::NE: return x != y;
+                        }
+                        return false;
+                    };
+                    std::vector<std::uint64_t> pair(words, ~std::uint64_t{0});
+                    std::vector<std::uint64_t> scalar(words, ~std::uint64_t{0});
+                    kernels::compare(op, a.data(), b.data(), pair.data(), n);
+                    kernels::compare(op, a.data(), T{1}, scalar.data(), n);
+                    for (std::size_t w = 0; w < words; ++w) {
+                        std::uint64_t want_pair = 0;
+                        std::uint64_t want_scalar = 0;
+                        for (std::size_t i = w * 64; i < std::min(n, w * 64 + 64); ++i) {
+                            want_pair |= std::uint64_t{holds(a[i], b[i])} << (i % 64);
+                            want_scalar |= std::uint64_t{holds(a[i], T{1})} << (i % 64);
+                        }
+                        ASSERT_EQ(pair[w], want_pair) << n << " " << static_cast<int>(op);
+                        ASSERT_EQ(scalar[w], want_scalar) << n << " " << static_cast<int>(op);
+                    }
+                }
+
+                // masks from empty through sparse and dense to full
+                for (const int density : {0, 1, 50, 99, 100}) {
+                    std::vector<std::uint64_t> mask(words);
+                    std::vector<T> want;
+                    for (std::size_t i = 0; i < n; ++i) {
+                        if (static_cast<int>(gen() % 100) < density) {
+                            mask[i / 64] |= std::uint64_t{1} << (i % 64);
+                            want.push_back(a[i]);
+                        }
+                    }
+                    // compared bitwise, as some of the elements are NaN
+                    using Bits = std::conditional_t<sizeof(T) == 8, std::uint64_t, std::uint32_t>;
+                    std::vector<T> out(want.size());
+                    ASSERT_EQ(kernels::compress(a.data(), mask.data(), n, out.data()), want.size());
+                    for (std::size_t i = 0; i < want.size(); ++i) {
+                        ASSERT_EQ(std::bit_cast<Bits>(out[i]), std::bit_cast<Bits>(want[i])) << n << " " << density;
+                    }
+                }
+            }
+        };
+        for_each_isa([&] {
+            check(0.0);
+            check(0.0f);
+        });
+    }
+
+    TEST(FilterTests, FilterSeriesAndFrameByComparison) {
+        const auto nan = std::numeric_limits<double>::quiet_NaN();
+        Series<double> s({1, 5, nan, 3, 8, 2});
+        s.set_null(4);
+        const auto bits = [](const Bitmap& mask) {
+            std::string out;
+            for (std::size_t i = 0; i < mask.size(); ++i) {
+                out += mask[i] ? '1' : '0';
+            }
+            return out;
+        };
+        // a null element compares false, as does NaN except under !=
+        EXPECT_EQ(bits(s > 2.0), "010100");
+        EXPECT_EQ(bits(s <= 3), "100101");
+        EXPECT_EQ(bits(s != 3.0), "111001");
+        EXPECT_EQ(bits(4 < s), "010000");
+        EXPECT_EQ(bits(s == s), "110101");
+        EXPECT_EQ(bits(s * 2.0 >= s + 3.0), "010100");
+        EXPECT_EQ(bits(s.view().slice(0, 6, 2) < 3.0), "100");
+        EXPECT_EQ(bits((s > 1.0) & (s < 5.0)), "000101");
+        EXPECT_EQ(bits((s < 2.0) | (s > 4.0)), "110000");
+        EXPECT_EQ(bits(~(s > 2.0)), "101011");
+
+        const auto kept = s.filter((s > 1.5) | (s != s));
+        ASSERT_EQ(kept.size(), 4u);
+        EXPECT_EQ(kept[0], 5);
+        EXPECT_TRUE(std::isnan(kept[1]));
+        EXPECT_EQ(kept[2], 3);
+        EXPECT_EQ(kept[3], 2);
+        const auto with_null = s.filter(~Bitmap(6, false));
+        EXPECT_EQ(with_null.null_count(), 1u);
+        EXPECT_TRUE(with_null.is_null(4));
+        EXPECT_EQ(s.view().slice(1, 6, 2).filter(Bitmap(3)).size(), 3u);
+        EXPECT_EQ(s.filter(Bitmap(6, false)).size(), 0u);
+        EXPECT_THROW(s.filter(Bitmap(5)), std::invalid_argument);
+
+        const Series<std::string> names({"a", "b", "c"});
+        const auto picked = names.filter(Series<int>({3, 1, 4}) > 2);
+        ASSERT_EQ(picked.size(), 2u);
+        EXPECT_EQ(picked[1], "c");
+
+        // blocks filtered by different threads, with nulls whose bits straddle block boundaries
+        const auto saved = parallel_config();
+        set_parallel_config({Backend::POOL, 3, false, 1000});
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR}) {
+            Series<double> large(std::vector<double>(300'007));
+            Series<std::int64_t> ints(std::vector<std::int64_t>(large.size()));
+            for (std::size_t i = 0; i < large.size(); ++i) {
+                large[i] = static_cast<double>(i * 7919 % 1000);
+                ints[i] = static_cast<std::int64_t>(i);
+                if (i % 13 == 0) {
+                    large.set_null(i);
+                }
+            }
+            large.set_exec_policy(policy);
+            ints.set_exec_policy(policy);
+            const auto mask = large < 300.0;
+            const auto values = large.filter(mask);
+            const auto positions = ints.filter(mask);
+            ASSERT_EQ(values.size(), mask.count());
+            ASSERT_EQ(positions.size(), mask.count());
+            std::size_t k = 0;
+            for (std::size_t i = 0; i < large.size(); ++i) {
+                if (large.is_valid(i) && large[i] < 300.0) {
+                    ASSERT_EQ(values[k], large[i]) << i;
+                    ASSERT_EQ(positions[k], static_cast<std::int64_t>(i)) << i;
+                    ++k;
+                }
+            }
+            ASSERT_EQ(k, values.size());
+            EXPECT_FALSE(values.has_nulls());
+
+            // the validity of the kept elements is compacted with them
+            const auto every_other = ~(ints.view() < 0);
+            Bitmap alternate(large.size(), false);
+            for (std::size_t i = 0; i < large.size(); i += 2) {
+                alternate.set(i);
+            }
+            const auto halves = large.filter(every_other & alternate);
+            for (std::size_t i = 0; i < halves.size(); ++i) {
+                ASSERT_EQ(halves.is_valid(i), large.is_valid(2 * i)) << i;
+            }
+        }
+        set_parallel_config(saved);
+
+        DataFrame frame;
+        frame.add("k", Series<int>({2, 1, 2, 1}));
+        frame.add("id", Series<std::string>({"a", "b", "c", "d"}));
+        const auto ones = frame.filter(frame.column<int>("k") == 1);
+        EXPECT_EQ(ones.shape(), std::make_pair(std::size_t{2}, std::size_t{2}));
+        EXPECT_EQ(ones.column<std::string>("id")[1], "d");
+        EXPECT_THROW(frame.filter(Bitmap(3)), std::invalid_argument);
+    }
+
+    TEST(TakeTests, TakeAndScatterByPosition) {
+        Series<double> s({10, 11, 12, 13, 14});
+        s.set_null(3);
+        const auto taken = s.take({4, 0, 3, 0});
+        ASSERT_EQ(taken.size(), 4u);
+        EXPECT_EQ(taken[0], 14);
+        EXPECT_EQ(taken[1], 10);
+        EXPECT_TRUE(taken.is_null(2));
+        EXPECT_EQ(taken[3], 10);
+        EXPECT_EQ(taken.null_count(), 1u);
+        const auto strided = s.view().slice(0, 5, 2).take({2, 1});
+        EXPECT_EQ(strided[0], 14);
+        EXPECT_EQ(strided[1], 12);
+        EXPECT_EQ(s.take({}).size(), 0u);
+        EXPECT_THROW(s.take({1, 5}), std::out_of_range);
+
+        Series<double> values({1.5, 2.5});
+        values.set_null(1);
+        s.scatter({3, 0}, values);
+        EXPECT_EQ(s[3], 1.5);
+        EXPECT_TRUE(s.is_valid(3));
+        EXPECT_TRUE(s.is_null(0));
+        EXPECT_EQ(s.null_count(), 1u);
+        EXPECT_THROW(s.scatter({1}, values), std::invalid_argument);
+        EXPECT_THROW(s.scatter({1, 9}, values), std::out_of_range);
+        EXPECT_EQ(Series<int>({1, 2, 3}).scatter({2}, Series<int>({7}))[2], 7);
+
+        // chunks gathered and scattered by different threads, with validity bits shared between them
+        const auto saved = parallel_config();
+        set_parallel_config({Backend::POOL, 3, false, 1000});
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR}) {
+            const std::size_t n = 200'003;
+            Series<double> large{std::vector<double>(n)};
+            std::vector<std::size_t> order(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                large[i] = static_cast<double>(i);
+                order[i] = i * 7919 % n;
+                if (i % 11 == 0) {
+                    large.set_null(i);
+                }
+            }
+            large.set_exec_policy(policy);
+            const auto shuffled = large.take(order);
+            for (std::size_t i = 0; i < n; ++i) {
+                ASSERT_EQ(shuffled.is_valid(i), large.is_valid(order[i])) << i;
+                ASSERT_EQ(shuffled[i], large[order[i]]) << i;
+            }
+            Series<double> back(std::vector<double>(n, -1.0));
+            back.set_exec_policy(policy);
+            back.scatter(order, shuffled);
+            for (std::size_t i = 0; i < n; ++i) {
+                ASSERT_EQ(back.is_valid(i), large.is_valid(i)) << i;
+                ASSERT_EQ(back[i], large[i]) << i;
+            }
+
+            // a repeated position keeps its last value and validity under either policy
+            std::vector<std::size_t> repeated(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                repeated[i] = i % 1000;
+            }
+            back.scatter(repeated, large);
+            for (std::size_t i = 0; i < 1000; ++i) {
+                const auto last = n - 1 - (n - 1 - i) % 1000;
+                ASSERT_EQ(back.is_valid(i), large.is_valid(last)) << i;
+                ASSERT_EQ(back[i], large[last]) << i;
+            }
+        }
+        set_parallel_config(saved);
+
+        DataFrame frame;
+        frame.add("k", Series<int>({2, 1, 2, 1}));
+        frame.add("id", Series<std::string>({"a", "b", "c", "d"}));
+        const auto rows = frame.take({3, 3, 0});
+        EXPECT_EQ(rows.shape(), std::make_pair(std::size_t{3}, std::size_t{2}));
+        EXPECT_EQ(rows.column<int>("k")[2], 2);
+        EXPECT_EQ(rows.column<std::string>("id")[1], "d");
+        EXPECT_THROW(frame.take({4}), std::out_of_range);
+    }
+
+    TEST(GroupByTests, AggregatePerGroupInOrderOfFirstRow) {
+        const auto nan = std::numeric_limits<double>::quiet_NaN();
+        DataFrame frame;
+        Series<int> k({3, 1, 3, 2, 1, 3, 7});
+        k.set_null(6);
+        Series<double> x({1, 2, 3, 4, 5, 6, 100});
+        x.set_null(3);
+        frame.add("k", std::move(k));
+        frame.add("name", Series<std::string>({"a", "b", "a", "c", "b", "a", "d"}));
+        frame.add("x", std::move(x));
+
+        const auto grouped = frame.groupby({"k"});
+        EXPECT_EQ(grouped.size(), 3u);
+        const auto out = grouped.agg({Agg::SUM, Agg::COUNT, Agg::MEAN, Agg::MAX});
+        EXPECT_EQ(out.shape(), std::make_pair(std::size_t{3}, std::size_t{5}));
+        const auto& keys = out.column<int>("k");
+        EXPECT_EQ(keys[0], 3);
+        EXPECT_EQ(keys[1], 1);
+        EXPECT_EQ(keys[2], 2);
+        EXPECT_EQ(out.column<double>("x_sum")[0], 10);
+        EXPECT_EQ(out.column<double>("x_sum")[1], 7);
+        EXPECT_EQ(out.column<double>("x_count")[2], 0);
+        EXPECT_EQ(out.column<double>("x_mean")[1], 3.5);
+        EXPECT_TRUE(out.column<double>("x_mean").is_null(2));
+        EXPECT_EQ(out.column<double>("x_max")[0], 6);
+
+        // several keys of different types, and NaN keys as one group
+        const auto pairs = frame.groupby({"name", "k"}).agg({"x"}, {Agg::VAR});
+        EXPECT_EQ(pairs.shape(), std::make_pair(std::size_t{3}, std::size_t{3}));
+        EXPECT_EQ(pairs.column<std::string>("name")[2], "c");
+        EXPECT_DOUBLE_EQ(pairs.column<double>("x_var")[0], 38.0 / 9.0);
+        DataFrame floats;
+        floats.add("f", Series<double>({nan, 0.0, nan, -0.0}));
+        floats.add("v", Series<int>({1, 2, 3, 4}));
+        const auto by_float = floats.groupby({"f"}).agg({Agg::SUM});
+        ASSERT_EQ(by_float.length(), 2u);
+        EXPECT_EQ(by_float.column<double>("v_sum")[0], 4);
+        EXPECT_EQ(by_float.column<double>("v_sum")[1], 6);
+
+        EXPECT_THROW(frame.groupby({}), std::invalid_argument);
+        EXPECT_THROW(frame.groupby({"missing"}), std::out_of_range);
+        EXPECT_THROW(grouped.agg({"name"}, {Agg::SUM}), std::invalid_argument);
+
+        // blocks grouped and aggregated by different threads, through direct arrays, hash tables and
+        // pairs of keys, against a grouping by std::map
+        const auto saved = parallel_config();
+        set_parallel_config({Backend::POOL, 3, false, 1000});
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR}) {
+            const std::size_t n = 300'007;
+            Series<std::int64_t> small{std::vector<std::int64_t>(n)};
+            Series<std::int64_t> wide{std::vector<std::int64_t>(n)};
+            Series<double> values{std::vector<double>(n)};
+            for (std::size_t i = 0; i < n; ++i) {
+                small[i] = static_cast<std::int64_t>(i * 7919 % 1000) - 500;
+                wide[i] = static_cast<std::int64_t>(i * 104729 % 20011) * 1'000'003;
+                values[i] = static_cast<double>(i % 97);
+                if (i % 17 == 0) {
+                    small.set_null(i);
+                }
+            }
+            small.set_exec_policy(policy);
+            wide.set_exec_policy(policy);
+            values.set_exec_policy(policy);
+            DataFrame large;
+            large.add("small", small);
+            large.add("wide", wide);
+            large.add("v", values);
+            for (const auto& by : {std::vector<std::string>{"small"}, {"wide"}, {"small", "wide"}}) {
+                std::map<std::vector<std::int64_t>, std::pair<std::size_t, double>> expected;
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (by[0] == "small" && small.is_null(i)) {
+                        continue;
+                    }
+                    std::vector<std::int64_t> key;
+                    for (const auto& name : by) {
+                        key.push_back(name == "small" ? small[i] : wide[i]);
+                    }
+                    const auto [it, inserted] = expected.try_emplace(key, i, 0.0);
+                    it->second.second += values[i];
+                }
+                const auto out = large.groupby(by).agg({"v"}, {Agg::SUM});
+                ASSERT_EQ(out.length(), expected.size());
+                std::size_t previous = 0;
+                for (std::size_t g = 0; g < out.length(); ++g) {
+                    std::vector<std::int64_t> key;
+                    for (const auto& name : by) {
+                        key.push_back(out.column<std::int64_t>(name)[g]);
+                    }
+                    const auto& [first, sum] = expected.at(key);
+                    ASSERT_TRUE(g == 0 || first > previous) << g;
+                    previous = first;
+                    ASSERT_EQ(out.column<double>("v_sum")[g], sum) << g;
+                }
+            }
+        }
+        set_parallel_config(saved);
+    }
+
+    TEST(GroupByTests, SortedAndHighCardinalityKeys) {
+        // runs of sorted keys, where NaN is a key of its own wherever it is
+        const auto nan = std::numeric_limits<double>::quiet_NaN();
+        DataFrame runs;
+        runs.add("f", Series<double>({nan, 1, 2, 2, nan}));
+        runs.add("v", Series<int>({1, 2, 3, 4, 5}));
+        const auto by_run = runs.groupby({"f"}).agg({Agg::SUM});
+        ASSERT_EQ(by_run.length(), 3u);
+        EXPECT_EQ(by_run.column<double>("v_sum")[0], 6);
+        EXPECT_EQ(by_run.column<double>("v_sum")[2], 7);
+
+        // ascending and descending keys grouped by runs, and keys nearly as many as the rows partitioned
+        // by hash and then aggregated by partitions of groups, against a grouping by std::map
+        const auto saved = parallel_config();
+        set_parallel_config({Backend::POOL, 3, false, 1000});
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR}) {
+            const std::size_t n = 300'007;
+            Series<std::int64_t> ascending{std::vector<std::int64_t>(n)};
+            Series<std::int64_t> descending{std::vector<std::int64_t>(n)};
+            Series<std::int64_t> many{std::vector<std::int64_t>(n)};
+            Series<double> values{std::vector<double>(n)};
+            for (std::size_t i = 0; i < n; ++i) {
+                ascending[i] = static_cast<std::int64_t>(i / 3);
+                descending[i] = static_cast<std::int64_t>((n - i) / 5) * 1'000'003;
+                many[i] = static_cast<std::int64_t>(i * 7919 % 150'001) * 1'000'003;
+                values[i] = static_cast<double>(i % 89);
+                if (i % 13 == 0) {
+                    many.set_null(i);
+                }
+                if (i % 31 == 0) {
+                    values.set_null(i);
+                }
+            }
+            DataFrame large;
+            for (auto* series : {&ascending, &descending, &many}) {
+                series->set_exec_policy(policy);
+            }
+            values.set_exec_policy(policy);
+            large.add("ascending", ascending);
+            large.add("descending", descending);
+            large.add("many", many);
+            large.add("v", values);
+            for (const auto& by : {std::vector<std::string>{"ascending"}, {"descending"}, {"many"}, {"descending", "many"}}) {
+                std::map<std::vector<std::int64_t>, std::tuple<std::size_t, double, double>> expected;
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (std::find(by.begin(), by.end(), "many") != by.end() && many.is_null(i)) {
+                        continue;
+                    }
+                    std::vector<std::int64_t> key;
+                    for (const auto& name : by) {
+                        key.push_back(large.column<std::int64_t>(name)[i]);
+                    }
+                    auto& [first, sum, max] = expected.try_emplace(key, i, 0.0, -1.0).first->second;
+                    if (values.is_valid(i)) {
+                        sum += values[i];
+                        max = std::max(max, values[i]);
+                    }
+                }
+                const auto out = large.groupby(by).agg({"v"}, {Agg::SUM, Agg::MAX});
+                ASSERT_EQ(out.length(), expected.size());
+                std::size_t previous = 0;
+                for (std::size_t g = 0; g < out.length(); ++g) {
+                    std::vector<std::int64_t> key;
+                    for (const auto& name : by) {
+                        key.push_back(out.column<std::int64_t>(name)[g]);
+                    }
+                    const auto& [first, sum, max] = expected.at(key);
+                    ASSERT_TRUE(g == 0 || first > previous) << g;
+                    previous = first;
+                    // a group of null values only has neither a sum nor a greatest value
+                    ASSERT_EQ(out.column<double>("v_max").is_null(g), max < 0) << g;
+                    ASSERT_EQ(out.column<double>("v_sum").is_null(g), max < 0) << g;
+                    if (max >= 0) {
+                        ASSERT_EQ(out.column<double>("v_sum")[g], sum) << g;
+                        ASSERT_EQ(out.column<double>("v_max")[g], max) << g;
+                    }
+                }
+            }
+        }
+        set_parallel_config(saved);
+    }
+
+    TEST(MergeTests, JoinOnEqualKeys) {
+        DataFrame left;
+        Series<int> left_keys({1, 2, 2, 3, 0, 4});
+        left_keys.set_null(4);
+        left.add("k", std::move(left_keys));
+        left.add("name", Series<std::string>({"a", "b", "c", "a", "b", "c"}));
+        left.add("v", Series<int>({10, 20, 30, 40, 50, 60}));
+        DataFrame right;
+        Series<int> right_keys({2, 1, 2, 5, 0});
+        right_keys.set_null(4);
+        right.add("k", std::move(right_keys));
+        right.add("name", Series<std::string>({"b", "a", "c", "a", "b"}));
+        right.add("v", Series<double>({0.5, 1.5, 2.5, 3.5, 4.5}));
+
+        // the right frame has fewer rows and is built on
+        const auto inner = left.merge(right, {"k"});
+        EXPECT_EQ(inner.shape(), std::make_pair(std::size_t{5}, std::size_t{5}));
+        const auto& v_x = inner.column<int>("v_x");
+        const auto& v_y = inner.column<double>("v_y");
+        const std::vector<std::pair<int, double>> pairs{{10, 1.5}, {20, 0.5}, {20, 2.5}, {30, 0.5}, {30, 2.5}};
+        for (std::size_t i = 0; i < pairs.size(); ++i) {
+            EXPECT_EQ(v_x[i], pairs[i].first);
+            EXPECT_EQ(v_y[i], pairs[i].second);
+        }
+        EXPECT_EQ(inner.column<std::string>("name_y")[0], "a");
+
+        const auto outer = left.merge(right, {"k"}, Join::LEFT);
+        ASSERT_EQ(outer.length(), 8u);
+        EXPECT_EQ(outer.column<int>("v_x")[5], 40);
+        EXPECT_TRUE(outer.column<double>("v_y").is_null(5));
+        EXPECT_EQ(outer.column<double>("v_y")[5], 0.0);
+        EXPECT_TRUE(outer.column<int>("k").is_null(6));
+        EXPECT_TRUE(outer.column<std::string>("name_y").is_null(7));
+        EXPECT_EQ(outer.column<double>("v_y")[4], 2.5);
+
+        const auto semi = left.merge(right, {"k"}, Join::SEMI);
+        EXPECT_EQ(semi.shape(), std::make_pair(std::size_t{3}, std::size_t{3}));
+        EXPECT_EQ(semi.column<int>("v")[2], 30);
+        const auto anti = left.merge(right, {"k"}, Join::ANTI);
+        ASSERT_EQ(anti.length(), 3u);
+        EXPECT_EQ(anti.column<int>("v")[0], 40);
+        EXPECT_EQ(anti.column<int>("v")[1], 50);
+
+        // the left frame has fewer rows and is built on, and two keys are matched at once
+        const auto flipped = right.merge(left, {"k"});
+        ASSERT_EQ(flipped.length(), 5u);
+        EXPECT_EQ(flipped.column<double>("v_x")[1], 0.5);
+        EXPECT_EQ(flipped.column<int>("v_y")[1], 30);
+        EXPECT_EQ(flipped.column<int>("v_y")[2], 10);
+        EXPECT_EQ(right.merge(left, {"k"}, Join::ANTI).length(), 2u);
+        const auto both = left.merge(right, {"k", "name"});
+        ASSERT_EQ(both.length(), 3u);
+        EXPECT_EQ(both.width(), 4u);
+        EXPECT_EQ(both.column<int>("v_x")[2], 30);
+        EXPECT_EQ(both.column<double>("v_y")[2], 2.5);
+
+        DataFrame doubles;
+        doubles.add("k", Series<double>({1, 2}));
+        EXPECT_THROW(left.merge(doubles, {"k"}), std::invalid_argument);
+        EXPECT_THROW(left.merge(right, {}), std::invalid_argument);
+        EXPECT_THROW(left.merge(right, {"missing"}), std::out_of_range);
+
+        // fact rows joined with tables of keys through direct arrays, a shared hash table and hash
+        // partitions, by different threads, against the matches found through std::map
+        const auto saved = parallel_config();
+        set_parallel_config({Backend::POOL, 3, false, 1000});
+        for (const auto policy : {ExecPolicy::SEQ, ExecPolicy::PAR}) {
+            const std::size_t n = 300'007;
+            Series<std::int64_t> facts{std::vector<std::int64_t>(n)};
+            Series<std::int64_t> rows{std::vector<std::int64_t>(n)};
+            for (std::size_t i = 0; i < n; ++i) {
+                facts[i] = static_cast<std::int64_t>(i * 7919 % 200'003);
+                rows[i] = static_cast<std::int64_t>(i);
+                if (i % 23 == 0) {
+                    facts.set_null(i);
+                }
+            }
+            for (const auto& [count, spread, repeat] : {std::tuple<std::size_t, std::int64_t, std::size_t>{3000, 1, 3}, {20'000, 1'000'003, 1}, {150'000, 1'000'003, 1}}) {
+                DataFrame fact;
+                Series<std::int64_t> keys{std::vector<std::int64_t>(n)};
+                for (std::size_t i = 0; i < n; ++i) {
+                    keys[i] = facts[i] % static_cast<std::int64_t>(2 * count) * spread;
+                }
+                keys.set_validity(*facts.validity());
+                keys.set_exec_policy(policy);
+                fact.add("key", keys);
+                fact.add("row", rows);
+                // every other key, each repeated
+                DataFrame dimension;
+                Series<std::int64_t> dimension_keys{std::vector<std::int64_t>(count * repeat)};
+                Series<std::int64_t> dimension_rows{std::vector<std::int64_t>(count * repeat)};
+                for (std::size_t j = 0; j < count * repeat; ++j) {
+                    dimension_keys[j] = static_cast<std::int64_t>(j % count * 2) * spread;
+                    dimension_rows[j] = static_cast<std::int64_t>(j);
+                }
+                dimension_keys.set_exec_policy(policy);
+                dimension.add("key", dimension_keys);
+                dimension.add("other", dimension_rows);
+
+                std::map<std::int64_t, std::vector<std::int64_t>> matches;
+                for (std::size_t j = 0; j < count * repeat; ++j) {
+                    matches[dimension_keys[j]].push_back(dimension_rows[j]);
+                }
+                std::vector<std::pair<std::int64_t, std::int64_t>> expected;
+                std::size_t unmatched = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    const auto it = keys.is_valid(i) ? matches.find(keys[i]) : matches.end();
+                    if (it == matches.end()) {
+                        ++unmatched;
+                        continue;
+                    }
+                    for (const auto other : it->second) {
+                        expected.emplace_back(static_cast<std::int64_t>(i), other);
+                    }
+                }
+                const auto joined = fact.merge(dimension, {"key"});
+                ASSERT_EQ(joined.length(), expected.size()) << count;
+                for (std::size_t r = 0; r < expected.size(); ++r) {
+                    ASSERT_EQ(joined.column<std::int64_t>("row")[r], expected[r].first) << count << " " << r;
+                    ASSERT_EQ(joined.column<std::int64_t>("other")[r], expected[r].second) << count << " " << r;
+                }
+                EXPECT_EQ(fact.merge(dimension, {"key"}, Join::LEFT).length(), expected.size() + unmatched);
+                EXPECT_EQ(fact.merge(dimension, {"key"}, Join::ANTI).length(), unmatched);
+                EXPECT_EQ(fact.merge(dimension, {"key"}, Join::SEMI).length(), n - unmatched);
+            }
+        }
+        set_parallel_config(saved);
+    }
+}